@@ -0,0 +1,28 @@
+# Findzstd.cmake - Find zstd library
+#
+# This module defines:
+#  zstd_FOUND - System has zstd
+#  zstd::zstd - Imported target for zstd
+
+find_path(ZSTD_INCLUDE_DIR
+    NAMES zstd.h
+)
+
+find_library(ZSTD_LIBRARY
+    NAMES zstd libzstd
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(zstd
+    REQUIRED_VARS ZSTD_LIBRARY ZSTD_INCLUDE_DIR
+)
+
+if(zstd_FOUND AND NOT TARGET zstd::zstd)
+    add_library(zstd::zstd UNKNOWN IMPORTED)
+    set_target_properties(zstd::zstd PROPERTIES
+        IMPORTED_LOCATION "${ZSTD_LIBRARY}"
+        INTERFACE_INCLUDE_DIRECTORIES "${ZSTD_INCLUDE_DIR}"
+    )
+endif()
+
+mark_as_advanced(ZSTD_INCLUDE_DIR ZSTD_LIBRARY)
@@ -0,0 +1,150 @@
+/**
+ * @file mds_backfill.c
+ * @brief Upload chunks from a local archive after a connectivity outage
+ *
+ * Reads the chunk archive written by a gateway (see mds_archive.h) and
+ * uploads everything after the saved checkpoint with many parallel requests
+ * under a global rate limit. Interrupting with Ctrl+C saves the checkpoint;
+ * running again resumes from it.
+ *
+ * Usage:
+ *   ./mds_backfill <archive-dir> <project-key> [options]
+ *
+ * Examples:
+ *   ./mds_backfill /var/lib/mds/archive KEY                  # Upload at full speed
+ *   ./mds_backfill /var/lib/mds/archive KEY --rate 200000    # Leave room for live traffic
+ */
+
+#include "mds_bridge/mds_archive.h"
+#include "mds_bridge/mds_backfill.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+
+static volatile sig_atomic_t keep_running = 1;
+
+static void signal_handler(int signum) {
+    (void)signum;
+    keep_running = 0;
+}
+
+static int progress_callback(const mds_backfill_stats_t *stats, void *user_data) {
+    (void)user_data;
+
+    double rate = stats->elapsed_s > 0 ? stats->bytes_uploaded / stats->elapsed_s : 0;
+    printf("\r%zu chunks, %zu bytes, %zu requests, %zu retries, %.1f KB/s   ",
+           stats->chunks_uploaded, stats->bytes_uploaded, stats->requests,
+           stats->retries, rate / 1024.0);
+    fflush(stdout);
+
+    return keep_running ? 0 : 1;
+}
+
+static int load_dictionary(mds_archive_t *archive, const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return -errno;
+    }
+
+    uint8_t *dict = malloc(1024 * 1024);
+    size_t len = dict ? fread(dict, 1, 1024 * 1024, fp) : 0;
+    fclose(fp);
+
+    int ret = dict ? mds_archive_set_dictionary(archive, dict, len) : -ENOMEM;
+    free(dict);
+    return ret;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s <archive-dir> <project-key> [options]\n", prog);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --rate <bytes/s>    Global upload rate limit (default: unlimited)\n");
+    fprintf(stderr, "  --parallel <n>      Concurrent requests (default: %d)\n",
+            MDS_BACKFILL_DEFAULT_PARALLEL);
+    fprintf(stderr, "  --batch <bytes>     Maximum chunk bytes per request (default: %d)\n",
+            MDS_BACKFILL_DEFAULT_BATCH_BYTES);
+    fprintf(stderr, "  --dict <file>       zstd dictionary the archive was written with\n");
+    fprintf(stderr, "  --uri-base <uri>    Chunks URI prefix (default: %s)\n",
+            MDS_BACKFILL_DEFAULT_URI_BASE);
+    fprintf(stderr, "  --verbose           Print libcurl details\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char *directory = argv[1];
+    char auth_header[256];
+    snprintf(auth_header, sizeof(auth_header), "Memfault-Project-Key:%s", argv[2]);
+
+    mds_backfill_config_t config = {
+        .auth_header = auth_header,
+    };
+    const char *dict_path = NULL;
+
+    for (int i = 3; i < argc; i++) {
+        bool has_value = (i + 1 < argc);
+        if (strcmp(argv[i], "--rate") == 0 && has_value) {
+            config.max_bytes_per_sec = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--parallel") == 0 && has_value) {
+            config.max_parallel = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--batch") == 0 && has_value) {
+            config.max_batch_bytes = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--dict") == 0 && has_value) {
+            dict_path = argv[++i];
+        } else if (strcmp(argv[i], "--uri-base") == 0 && has_value) {
+            config.uri_base = argv[++i];
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            config.verbose = true;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    mds_archive_t *archive = mds_archive_open(directory, NULL);
+    if (archive == NULL) {
+        fprintf(stderr, "Failed to open archive %s\n", directory);
+        return 1;
+    }
+
+    if (dict_path) {
+        int ret = load_dictionary(archive, dict_path);
+        if (ret < 0) {
+            fprintf(stderr, "Failed to load dictionary %s: %s\n", dict_path, strerror(-ret));
+            mds_archive_close(archive);
+            return 1;
+        }
+    }
+
+    printf("Backfilling %s\n", directory);
+
+    mds_backfill_stats_t stats;
+    int ret = mds_backfill_run(archive, &config, progress_callback, NULL, &stats);
+    printf("\n");
+
+    if (ret == 0) {
+        printf("Done: %zu chunks (%zu bytes) in %.1f s", stats.chunks_uploaded,
+               stats.bytes_uploaded, stats.elapsed_s);
+        if (stats.chunks_rejected > 0) {
+            printf(", %zu rejected by the server", stats.chunks_rejected);
+        }
+        printf("\n");
+    } else if (ret == -ECANCELED) {
+        printf("Interrupted; run again to resume from the checkpoint\n");
+    } else {
+        fprintf(stderr, "Backfill failed: %s\n", strerror(-ret));
+    }
+
+    mds_archive_close(archive);
+    return (ret == 0 || ret == -ECANCELED) ? 0 : 1;
+}
@@ -9,6 +9,8 @@
  *   ./mds_monitor                    # Interactive device selection
  *   ./mds_monitor <vid> <pid>        # Specify VID/PID in hex
  *   ./mds_monitor 0x1234 0x5678
+ *   ./mds_monitor --dashboard [interval_ms] [<vid> <pid>]
+ *                                    # Aggregated view of every MDS device
  */
 
 #include <stdio.h>
@@ -19,6 +21,7 @@
 #include <errno.h>
 #include <stdbool.h>
 #include <time.h>
+#include <pthread.h>
 #include "mds_bridge/memfault_hid.h"  /* For device enumeration */
 #include "mds_bridge/mds_protocol.h"
 
@@ -34,6 +37,39 @@ typedef struct {
     time_t start_time;
 } monitor_stats_t;
 
+/* Dashboard mode: log2 histogram buckets of microseconds (1us .. ~8s) */
+#define DASH_HIST_BUCKETS           24
+#define DASH_DEFAULT_INTERVAL_MS    1000
+#define DASH_READ_TIMEOUT_MS        100
+#define DASH_BAR_WIDTH              30
+
+/* Counters reset at every dashboard refresh */
+typedef struct {
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t gaps;
+    uint64_t read_errors;
+    uint32_t latency_hist[DASH_HIST_BUCKETS];
+    uint32_t interarrival_hist[DASH_HIST_BUCKETS];
+} dash_window_t;
+
+/* Per-device dashboard state */
+typedef struct {
+    char path[256];
+    char device_id[MDS_MAX_DEVICE_ID_LEN];
+    mds_session_t *session;
+    pthread_t thread;
+    bool thread_started;
+
+    /* Shared with the display; guarded by lock */
+    pthread_mutex_t lock;
+    dash_window_t window;
+    uint64_t total_packets;
+    uint64_t total_bytes;
+    uint64_t total_gaps;
+    double jitter_us;
+} dash_device_t;
+
 /**
  * Signal handler for graceful shutdown
  */
@@ -278,6 +314,289 @@ static int monitor_mds_stream(const char *path) {
     return 0;
 }
 
+/* ============================================================================
+ * Dashboard Mode
+ * ========================================================================== */
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/**
+ * Map a duration to its log2 histogram bucket (bucket i holds [2^i, 2^(i+1)) us)
+ */
+static int hist_bucket(uint64_t us) {
+    int bucket = 0;
+    while (us > 1 && bucket < DASH_HIST_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * Upper bound (us) of the bucket containing the given percentile
+ */
+static uint64_t hist_percentile(const uint32_t *hist, double pct) {
+    uint64_t total = 0;
+    for (int i = 0; i < DASH_HIST_BUCKETS; i++) {
+        total += hist[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)(pct / 100.0 * (double)total + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+
+    uint64_t seen = 0;
+    for (int i = 0; i < DASH_HIST_BUCKETS; i++) {
+        seen += hist[i];
+        if (seen >= target) {
+            return (uint64_t)1 << (i + 1);
+        }
+    }
+    return (uint64_t)1 << DASH_HIST_BUCKETS;
+}
+
+static void format_us(char *buf, size_t len, uint64_t us) {
+    if (us >= 1000000) {
+        snprintf(buf, len, "%.1fs", (double)us / 1e6);
+    } else if (us >= 1000) {
+        snprintf(buf, len, "%.1fms", (double)us / 1e3);
+    } else {
+        snprintf(buf, len, "%lluus", (unsigned long long)us);
+    }
+}
+
+/**
+ * Per-device reader thread
+ *
+ * Only counters are updated per packet; all formatting happens in the
+ * display loop at the refresh interval.
+ */
+static void *dash_reader_thread(void *arg) {
+    dash_device_t *dev = (dash_device_t *)arg;
+    uint64_t last_arrival = 0;
+    uint64_t last_interarrival = 0;
+    uint8_t last_seq = 0;
+    bool have_seq = false;
+    double jitter = 0.0;
+
+    while (g_running) {
+        mds_stream_packet_t packet;
+        uint64_t start = now_us();
+        int ret = mds_stream_read_packet(dev->session, &packet, DASH_READ_TIMEOUT_MS);
+        uint64_t end = now_us();
+
+        if (ret == -ETIMEDOUT || ret == MEMFAULT_HID_ERROR_TIMEOUT) {
+            continue;
+        }
+
+        if (ret < 0) {
+            pthread_mutex_lock(&dev->lock);
+            dev->window.read_errors++;
+            pthread_mutex_unlock(&dev->lock);
+            usleep(10000);
+            continue;
+        }
+
+        bool gap = have_seq &&
+                   packet.sequence != ((last_seq + 1) & MDS_SEQUENCE_MASK);
+        last_seq = packet.sequence;
+        have_seq = true;
+
+        uint64_t interarrival = last_arrival ? end - last_arrival : 0;
+        if (last_arrival && last_interarrival) {
+            /* RFC 3550 style smoothed jitter of inter-arrival times */
+            double d = (double)interarrival - (double)last_interarrival;
+            jitter += ((d < 0 ? -d : d) - jitter) / 16.0;
+        }
+
+        pthread_mutex_lock(&dev->lock);
+        dev->window.packets++;
+        dev->window.bytes += packet.data_len;
+        dev->window.gaps += gap;
+        dev->window.latency_hist[hist_bucket(end - start)]++;
+        if (last_arrival) {
+            dev->window.interarrival_hist[hist_bucket(interarrival)]++;
+        }
+        dev->jitter_us = jitter;
+        pthread_mutex_unlock(&dev->lock);
+
+        if (last_arrival) {
+            last_interarrival = interarrival;
+        }
+        last_arrival = end;
+    }
+
+    return NULL;
+}
+
+static void dash_render_histogram(const uint32_t *hist) {
+    uint32_t peak = 0;
+    int first = -1;
+    int last = -1;
+    for (int i = 0; i < DASH_HIST_BUCKETS; i++) {
+        if (hist[i] > 0) {
+            if (first < 0) {
+                first = i;
+            }
+            last = i;
+            if (hist[i] > peak) {
+                peak = hist[i];
+            }
+        }
+    }
+
+    if (first < 0) {
+        printf("      (no samples)\n");
+        return;
+    }
+
+    for (int i = first; i <= last; i++) {
+        char label[16];
+        char bar[DASH_BAR_WIDTH + 1];
+        int width = (int)((uint64_t)hist[i] * DASH_BAR_WIDTH / peak);
+
+        format_us(label, sizeof(label), (uint64_t)1 << i);
+        memset(bar, '#', (size_t)width);
+        bar[width] = '\0';
+        printf("      >=%-7s |%-*s| %u\n", label, DASH_BAR_WIDTH, bar, hist[i]);
+    }
+}
+
+static void dash_render(dash_device_t *devices, size_t count,
+                        double elapsed_s, uint64_t uptime_s) {
+    /* Clear screen and home the cursor */
+    printf("\033[H\033[2J");
+    printf("MDS Dashboard - %zu device(s), uptime %llus, refresh %.1fs (Ctrl+C to stop)\n\n",
+           count, (unsigned long long)uptime_s, elapsed_s);
+    printf("%-24s %9s %10s %7s %5s %26s %9s\n",
+           "DEVICE", "PKT/S", "B/S", "GAPS", "ERR", "READ LAT p50/p90/p99", "JITTER");
+
+    for (size_t i = 0; i < count; i++) {
+        dash_device_t *dev = &devices[i];
+        dash_window_t window;
+        double jitter;
+
+        pthread_mutex_lock(&dev->lock);
+        window = dev->window;
+        memset(&dev->window, 0, sizeof(dev->window));
+        dev->total_packets += window.packets;
+        dev->total_bytes += window.bytes;
+        dev->total_gaps += window.gaps;
+        jitter = dev->jitter_us;
+        pthread_mutex_unlock(&dev->lock);
+
+        char p50[16], p90[16], p99[16], lat[48], jit[16];
+        format_us(p50, sizeof(p50), hist_percentile(window.latency_hist, 50.0));
+        format_us(p90, sizeof(p90), hist_percentile(window.latency_hist, 90.0));
+        format_us(p99, sizeof(p99), hist_percentile(window.latency_hist, 99.0));
+        snprintf(lat, sizeof(lat), "%s/%s/%s", p50, p90, p99);
+        format_us(jit, sizeof(jit), (uint64_t)jitter);
+
+        printf("%-24.24s %9.0f %10.0f %7llu %5llu %26s %9s\n",
+               dev->device_id,
+               (double)window.packets / elapsed_s,
+               (double)window.bytes / elapsed_s,
+               (unsigned long long)dev->total_gaps,
+               (unsigned long long)window.read_errors,
+               lat, jit);
+        printf("    inter-arrival (this interval):\n");
+        dash_render_histogram(window.interarrival_hist);
+    }
+
+    fflush(stdout);
+}
+
+/**
+ * Open every MDS device matching vid/pid (0 = any) and show an aggregated,
+ * fixed-interval dashboard instead of per-packet output
+ */
+static int run_dashboard(uint16_t vid, uint16_t pid, unsigned int interval_ms) {
+    memfault_hid_device_info_t *infos = NULL;
+    size_t num_infos = 0;
+    int ret = memfault_hid_enumerate(vid, pid, &infos, &num_infos);
+    if (ret != MEMFAULT_HID_SUCCESS || num_infos == 0) {
+        fprintf(stderr, "Error: No HID devices found\n");
+        return -ENODEV;
+    }
+
+    dash_device_t *devices = calloc(num_infos, sizeof(*devices));
+    if (devices == NULL) {
+        memfault_hid_free_device_list(infos);
+        return -ENOMEM;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < num_infos; i++) {
+        dash_device_t *dev = &devices[count];
+        mds_device_config_t config = {0};
+
+        snprintf(dev->path, sizeof(dev->path), "%s", infos[i].path);
+        if (mds_session_create_hid_path(dev->path, &dev->session) < 0) {
+            continue;
+        }
+
+        /* Non-MDS HID devices fail the config read; skip them quietly */
+        if (mds_read_device_config(dev->session, &config) < 0 ||
+            mds_stream_enable(dev->session) < 0) {
+            mds_session_destroy(dev->session);
+            dev->session = NULL;
+            continue;
+        }
+
+        snprintf(dev->device_id, sizeof(dev->device_id), "%.*s",
+                 (int)sizeof(dev->device_id) - 1,
+                 config.device_identifier[0] ? config.device_identifier : dev->path);
+        pthread_mutex_init(&dev->lock, NULL);
+        if (pthread_create(&dev->thread, NULL, dash_reader_thread, dev) == 0) {
+            dev->thread_started = true;
+        }
+        count++;
+    }
+    memfault_hid_free_device_list(infos);
+
+    if (count == 0) {
+        fprintf(stderr, "Error: No MDS devices found\n");
+        free(devices);
+        return -ENODEV;
+    }
+
+    uint64_t start = now_us();
+    uint64_t last = start;
+    while (g_running) {
+        usleep(interval_ms * 1000u);
+        uint64_t now = now_us();
+        dash_render(devices, count, (double)(now - last) / 1e6, (now - start) / 1000000u);
+        last = now;
+    }
+
+    printf("\nTotals:\n");
+    for (size_t i = 0; i < count; i++) {
+        dash_device_t *dev = &devices[i];
+        if (dev->thread_started) {
+            pthread_join(dev->thread, NULL);
+        }
+        printf("  %-24.24s packets: %llu, bytes: %llu, gaps: %llu\n", dev->device_id,
+               (unsigned long long)(dev->total_packets + dev->window.packets),
+               (unsigned long long)(dev->total_bytes + dev->window.bytes),
+               (unsigned long long)(dev->total_gaps + dev->window.gaps));
+
+        mds_stream_disable(dev->session);
+        mds_session_destroy(dev->session);
+        pthread_mutex_destroy(&dev->lock);
+    }
+
+    free(devices);
+    return 0;
+}
+
 /**
  * Print usage information
  */
@@ -285,10 +604,13 @@ static void print_usage(const char *program) {
     printf("Usage:\n");
     printf("  %s                    # Interactive mode - select from available devices\n", program);
     printf("  %s <vid> <pid>        # Monitor specific device by VID/PID (hex)\n", program);
+    printf("  %s --dashboard [interval_ms] [<vid> <pid>]\n", program);
+    printf("                              # Aggregated stats for every MDS device\n");
     printf("\n");
     printf("Examples:\n");
     printf("  %s                    # Show all devices and select one\n", program);
     printf("  %s 0x1234 0x5678      # Monitor device with VID:0x1234 PID:0x5678\n", program);
+    printf("  %s --dashboard 500    # Refresh every 500ms, all devices\n", program);
     printf("\n");
 }
 
@@ -312,6 +634,33 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    /* Dashboard mode: --dashboard [interval_ms] [vid pid] */
+    if (argc >= 2 && strcmp(argv[1], "--dashboard") == 0) {
+        unsigned int interval_ms = DASH_DEFAULT_INTERVAL_MS;
+        uint16_t vid = 0;
+        uint16_t pid = 0;
+        int next = 2;
+
+        if (argc == 3 || argc == 5) {
+            interval_ms = (unsigned int)strtoul(argv[next++], NULL, 10);
+            if (interval_ms == 0) {
+                interval_ms = DASH_DEFAULT_INTERVAL_MS;
+            }
+        }
+        if (argc - next == 2) {
+            vid = (uint16_t)strtol(argv[next], NULL, 16);
+            pid = (uint16_t)strtol(argv[next + 1], NULL, 16);
+        } else if (argc - next != 0) {
+            print_usage(argv[0]);
+            memfault_hid_exit();
+            return 1;
+        }
+
+        ret = run_dashboard(vid, pid, interval_ms);
+        memfault_hid_exit();
+        return (ret < 0) ? 1 : 0;
+    }
+
     /* Parse command line arguments */
     if (argc == 1) {
         /* Interactive mode */
@@ -0,0 +1,299 @@
+"""
+Async MDS Client - asyncio integration via the session poll fd
+
+The C library opens the device itself and runs a background reader that
+queues stream reports in native memory. The reader's readiness descriptor
+(mds_session_get_poll_fd) is registered with loop.add_reader(), so each
+device costs one file descriptor on the event loop instead of a Python HID
+reader thread. On readiness, every pending report is drained with a single
+mds_process_pending() call.
+
+Each drain produces a PacketBatch:
+
+    batch = await client.next_batch()      # parsed, sequence-checked packets
+    results = await batch.uploaded         # upload result per packet
+
+Control transfers (configuration reads, stream enable/disable) are blocking
+USB calls; they run in the default executor, each bounded by
+control_timeout_ms, so one stuck device cannot freeze the others.
+
+Uploads never run on the event loop. With a NativeUploader attached they are
+performed by libcurl in the default executor (the GIL is released for the
+whole C call); alternatively an async upload handler can be supplied.
+Uploads for one client complete in order.
+"""
+
+import asyncio
+import ctypes
+from dataclasses import dataclass, field
+from typing import Awaitable, Callable, List, Optional, Tuple
+
+from bindings import (
+    lib,
+    mds_device_config_t,
+    mds_stream_packet_t,
+    mds_reader_stats_t,
+    memfault_hid_device_info_t,
+)
+from mds_client import DeviceConfig
+from native_uploader import NativeUploader
+
+# Async upload handler: (uri, auth_header, chunk) -> 0 on success, <0 on error
+UploadHandler = Callable[[str, str, bytes], Awaitable[int]]
+
+
+@dataclass
+class PacketBatch:
+    """Packets drained from the device in one readiness event"""
+    packets: List[Tuple[int, bytes]]
+    uploaded: asyncio.Future = field(repr=False)
+
+
+class MDSDeviceError(OSError):
+    """The background reader reported a backend error (e.g. device removed)"""
+
+
+def enumerate_devices(vendor_id: int = 0, product_id: int = 0) -> List[bytes]:
+    """
+    List HID device paths using the library's own enumeration
+
+    Args:
+        vendor_id: USB vendor ID filter (0 for any)
+        product_id: USB product ID filter (0 for any)
+
+    Returns:
+        Device paths suitable for AsyncMDSClient
+    """
+    devices = ctypes.POINTER(memfault_hid_device_info_t)()
+    count = ctypes.c_size_t(0)
+    result = lib.memfault_hid_enumerate(vendor_id, product_id,
+                                        ctypes.byref(devices), ctypes.byref(count))
+    if result < 0:
+        raise RuntimeError(f"Failed to enumerate HID devices: {result}")
+
+    try:
+        return [devices[i].path for i in range(count.value)]
+    finally:
+        if devices:
+            lib.memfault_hid_free_device_list(devices)
+
+
+class AsyncMDSClient:
+    """
+    asyncio MDS client for one device
+
+    Usage:
+        client = AsyncMDSClient(path)
+        await client.open()
+        client.attach_uploader(NativeUploader())
+        await client.start_streaming()
+        async for batch in client:
+            ...
+        await client.close()
+    """
+
+    def __init__(self, device_path: bytes, queue_depth: int = 256,
+                 max_batch: int = 256, control_timeout_ms: int = 2000):
+        """
+        Args:
+            device_path: HID device path (see enumerate_devices())
+            queue_depth: Native reader ring capacity in reports
+            max_batch: Maximum packets drained per native call
+            control_timeout_ms: Budget for each blocking control transfer
+        """
+        self.device_path = device_path
+        self.queue_depth = queue_depth
+        self.max_batch = max_batch
+        self.control_timeout_ms = control_timeout_ms
+
+        self.session: Optional[ctypes.c_void_p] = None
+        self.config: Optional[DeviceConfig] = None
+        self.config_struct: Optional[mds_device_config_t] = None
+        self.uploader: Optional[NativeUploader] = None
+        self.upload_handler: Optional[UploadHandler] = None
+
+        self._loop: Optional[asyncio.AbstractEventLoop] = None
+        self._fd = -1
+        self._batches: asyncio.Queue = asyncio.Queue()
+        self._upload_tail: Optional[asyncio.Future] = None
+        self._packets = (mds_stream_packet_t * max_batch)()
+        self._count = ctypes.c_size_t(0)
+        self._closed = False
+
+    async def open(self) -> DeviceConfig:
+        """
+        Open the device, read its configuration and start the native reader
+
+        On failure the session is destroyed before the error is raised.
+        """
+        self._loop = asyncio.get_running_loop()
+
+        session = ctypes.c_void_p()
+        result = await self._loop.run_in_executor(
+            None, lib.mds_session_create_hid_path, self.device_path, ctypes.byref(session))
+        if result < 0:
+            raise RuntimeError(f"Failed to open {self.device_path!r}: {result}")
+        self.session = session
+
+        try:
+            self.config_struct = mds_device_config_t()
+            result = await self._control(lib.mds_read_device_config_deadline,
+                                         ctypes.byref(self.config_struct))
+            if result < 0:
+                raise RuntimeError(f"Failed to read device configuration: {result}")
+
+            self.config = DeviceConfig(
+                supported_features=self.config_struct.supported_features,
+                device_identifier=self.config_struct.device_identifier.decode('utf-8'),
+                data_uri=self.config_struct.data_uri.decode('utf-8'),
+                authorization=self.config_struct.authorization.decode('utf-8'),
+            )
+
+            result = lib.mds_session_start_reader(self.session, self.queue_depth)
+            if result < 0:
+                raise RuntimeError(f"Failed to start reader: {result}")
+
+            self._fd = lib.mds_session_get_poll_fd(self.session)
+            self._loop.add_reader(self._fd, self._on_readable)
+        except BaseException:
+            self._destroy_session()
+            raise
+        return self.config
+
+    async def _control(self, function, *args) -> int:
+        """Run a blocking *_deadline control call in the executor"""
+        deadline = lib.mds_deadline_after(self.control_timeout_ms)
+        return await self._loop.run_in_executor(None, function, self.session, *args, deadline)
+
+    def _destroy_session(self) -> None:
+        if self._fd >= 0:
+            self._loop.remove_reader(self._fd)
+            self._fd = -1
+        if self.session:
+            lib.mds_session_destroy(self.session)   # also stops the reader
+            self.session = None
+
+    def attach_uploader(self, uploader: NativeUploader) -> None:
+        """
+        Upload chunks with a native libcurl uploader
+
+        The uploader must not be shared with another client: uploads run in
+        executor threads and one uploader owns a single curl handle.
+        """
+        self.uploader = uploader
+        self.upload_handler = None
+
+    def set_upload_handler(self, handler: Optional[UploadHandler]) -> None:
+        """Upload chunks with an async handler (e.g. an aiohttp session)"""
+        self.upload_handler = handler
+        self.uploader = None
+
+    async def start_streaming(self) -> None:
+        result = await self._control(lib.mds_stream_enable_deadline)
+        if result < 0:
+            raise RuntimeError(f"Failed to enable streaming: {result}")
+
+    async def stop_streaming(self) -> None:
+        result = await self._control(lib.mds_stream_disable_deadline)
+        if result < 0:
+            raise RuntimeError(f"Failed to disable streaming: {result}")
+
+    async def next_batch(self) -> PacketBatch:
+        """
+        Wait for the next batch of packets
+
+        Raises:
+            MDSDeviceError: the reader hit a backend error
+        """
+        item = await self._batches.get()
+        if isinstance(item, BaseException):
+            raise item
+        return item
+
+    def __aiter__(self) -> 'AsyncMDSClient':
+        return self
+
+    async def __anext__(self) -> PacketBatch:
+        if self._closed and self._batches.empty():
+            raise StopAsyncIteration
+        return await self.next_batch()
+
+    @property
+    def reader_stats(self) -> mds_reader_stats_t:
+        stats = mds_reader_stats_t()
+        lib.mds_session_get_reader_stats(self.session, ctypes.byref(stats))
+        return stats
+
+    def _on_readable(self) -> None:
+        """Drain every pending report in as few native calls as possible"""
+        packets: List[Tuple[int, bytes]] = []
+        while True:
+            result = lib.mds_process_pending(self.session, ctypes.byref(self.config_struct),
+                                             self._packets, None, self.max_batch,
+                                             ctypes.byref(self._count))
+            count = self._count.value
+            for pkt in self._packets[:count]:
+                packets.append((pkt.sequence, ctypes.string_at(pkt.data, pkt.data_len)))
+
+            if result < 0:
+                self._fail(MDSDeviceError(-result, f"MDS reader error on {self.device_path!r}"))
+                break
+            if count < self.max_batch:
+                break
+
+        if packets:
+            self._batches.put_nowait(PacketBatch(packets, self._schedule_upload(packets)))
+
+    def _schedule_upload(self, packets: List[Tuple[int, bytes]]) -> asyncio.Future:
+        """Chain the upload of a batch behind the previous one"""
+        if self.uploader is None and self.upload_handler is None:
+            done = self._loop.create_future()
+            done.set_result([])
+            return done
+
+        previous = self._upload_tail
+        self._upload_tail = asyncio.ensure_future(self._upload(packets, previous))
+        return self._upload_tail
+
+    async def _upload(self, packets, previous) -> List[int]:
+        if previous is not None:
+            await asyncio.wait([previous])
+
+        uri = self.config.data_uri
+        auth = self.config.authorization
+        if self.upload_handler is not None:
+            return [await self.upload_handler(uri, auth, data) for _, data in packets]
+
+        return await self._loop.run_in_executor(None, self._upload_native, packets)
+
+    def _upload_native(self, packets) -> List[int]:
+        """Runs in an executor thread; each C call releases the GIL"""
+        uri = self.config_struct.data_uri
+        auth = self.config_struct.authorization
+        handle = self.uploader.handle
+        return [lib.chunks_uploader_callback(uri, auth, data, len(data), handle)
+                for _, data in packets]
+
+    def _fail(self, error: BaseException) -> None:
+        if self._fd >= 0:
+            self._loop.remove_reader(self._fd)
+            self._fd = -1
+        self._batches.put_nowait(error)
+
+    async def close(self) -> None:
+        """Stop the reader, wait for in-flight uploads and destroy the session"""
+        if self._closed:
+            return
+        self._closed = True
+
+        if self._fd >= 0:
+            self._loop.remove_reader(self._fd)
+            self._fd = -1
+
+        if self._upload_tail is not None:
+            await asyncio.wait([self._upload_tail])
+
+        if self.session:
+            lib.mds_session_stop_reader(self.session)
+            await self._control(lib.mds_stream_disable_deadline)
+            self._destroy_session()
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""
+Async MDS Gateway - many devices on one asyncio event loop
+
+Every matching HID device gets an AsyncMDSClient whose native reader fd is
+registered with the event loop; no Python HID threads are used. Chunks are
+uploaded by a per-device NativeUploader, off the loop.
+
+Usage:
+  python3 async_gateway.py [--vid VID] [--pid PID] [--duration SECONDS]
+"""
+
+import argparse
+import asyncio
+import sys
+from typing import List
+
+from bindings import lib
+from async_client import AsyncMDSClient, MDSDeviceError, enumerate_devices
+from native_uploader import NativeUploader
+
+
+async def serve_device(client: AsyncMDSClient, totals: dict) -> None:
+    """Consume batches for one device until it disconnects or is closed"""
+    name = client.config.device_identifier
+    try:
+        async for batch in client:
+            totals['packets'] += len(batch.packets)
+            results = await batch.uploaded
+            failures = sum(1 for r in results if r < 0)
+            totals['upload_failures'] += failures
+            if failures:
+                print(f"[{name}] {failures}/{len(results)} uploads failed")
+    except MDSDeviceError as e:
+        print(f"[{name}] device error: {e}")
+
+
+async def run(vid: int, pid: int, duration: float) -> int:
+    paths = enumerate_devices(vid, pid)
+    if not paths:
+        print(f"No devices found for VID=0x{vid:04X} PID=0x{pid:04X}")
+        return 1
+
+    clients: List[AsyncMDSClient] = []
+    uploaders: List[NativeUploader] = []
+    for path in paths:
+        client = AsyncMDSClient(path)
+        try:
+            # A failed open() has already destroyed its session
+            config = await client.open()
+        except RuntimeError as e:
+            print(f"Skipping {path!r}: {e}")
+            continue
+
+        uploader = NativeUploader()
+        client.attach_uploader(uploader)
+        try:
+            await client.start_streaming()
+        except RuntimeError as e:
+            print(f"Skipping {path!r}: {e}")
+            await client.close()
+            uploader.destroy()
+            continue
+        print(f"Serving {config.device_identifier} ({path.decode(errors='replace')})")
+        clients.append(client)
+        uploaders.append(uploader)
+
+    if not clients:
+        return 1
+
+    totals = {'packets': 0, 'upload_failures': 0}
+    tasks = [asyncio.ensure_future(serve_device(c, totals)) for c in clients]
+
+    try:
+        await asyncio.sleep(duration)
+    finally:
+        for client in clients:
+            await client.close()
+        for task in tasks:
+            task.cancel()
+        await asyncio.gather(*tasks, return_exceptions=True)
+        for uploader in uploaders:
+            uploader.destroy()
+
+    print(f"\n{len(clients)} device(s), {totals['packets']} packets, "
+          f"{totals['upload_failures']} upload failures")
+    return 0
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description='Async MDS gateway for many devices')
+    parser.add_argument('--vid', type=lambda x: int(x, 0), default=0,
+                        help='USB vendor ID filter (default: any)')
+    parser.add_argument('--pid', type=lambda x: int(x, 0), default=0,
+                        help='USB product ID filter (default: any)')
+    parser.add_argument('--duration', type=float, default=60.0,
+                        help='Seconds to run (default: 60)')
+    args = parser.parse_args()
+
+    lib.memfault_hid_init()
+    try:
+        return asyncio.run(run(args.vid, args.pid, args.duration))
+    except KeyboardInterrupt:
+        return 0
+    finally:
+        lib.memfault_hid_exit()
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""
+Ingestion benchmark for the Python bindings
+
+Compares packets/sec for the per-report ctypes path the example used
+originally against the zero-copy batch path (mds_process_stream_batch):
+
+  legacy  - (c_uint8 * n)(*payload) per report + one C call per report
+  single  - payload passed by pointer + one C call per report
+  batch   - payloads joined into one buffer + one C call per batch
+
+Each mode is run with no upload callback (pure ingestion cost) and with a
+Python upload callback that copies the chunk out of C memory, comparing the
+original per-byte slice with ctypes.string_at().
+
+No device is needed: the session is created without a backend and fed
+synthetic 63-byte stream reports.
+
+Usage:
+  python3 bench_ingest.py [--packets N] [--batch N]
+"""
+
+import argparse
+import ctypes
+import time
+
+from bindings import (
+    lib,
+    MDS_MAX_CHUNK_DATA_LEN,
+    MDS_SEQUENCE_MASK,
+    MDS_CHUNK_UPLOAD_CALLBACK,
+    mds_device_config_t,
+    as_c_buffer,
+)
+
+
+def make_reports(count: int) -> list:
+    """Build `count` stream payloads (sequence byte + 63 data bytes)"""
+    data = bytes(range(MDS_MAX_CHUNK_DATA_LEN))
+    return [bytes([i & MDS_SEQUENCE_MASK]) + data for i in range(count)]
+
+
+def make_session() -> ctypes.c_void_p:
+    session = ctypes.c_void_p()
+    result = lib.mds_session_create(None, ctypes.byref(session))
+    if result < 0:
+        raise RuntimeError(f"Failed to create MDS session: {result}")
+    return session
+
+
+def make_config() -> mds_device_config_t:
+    config = mds_device_config_t()
+    config.device_identifier = b"bench-device"
+    config.data_uri = b"https://chunks.memfault.com/api/v0/chunks/bench-device"
+    config.authorization = b"Memfault-Project-Key:bench"
+    return config
+
+
+def run_legacy(session, config, reports, batch_size):
+    for payload in reports:
+        buf = (ctypes.c_uint8 * len(payload))(*payload)
+        lib.mds_process_stream_from_bytes(session, ctypes.byref(config),
+                                          buf, len(payload), None)
+
+
+def run_single(session, config, reports, batch_size):
+    for payload in reports:
+        lib.mds_process_stream_from_bytes(session, ctypes.byref(config),
+                                          as_c_buffer(payload), len(payload), None)
+
+
+def run_batch(session, config, reports, batch_size):
+    config_ref = ctypes.byref(config)
+    lens_type = ctypes.c_size_t * batch_size
+    for start in range(0, len(reports), batch_size):
+        chunk = reports[start:start + batch_size]
+        lens = lens_type(*map(len, chunk))
+        buffer = b''.join(chunk)
+        lib.mds_process_stream_batch(session, config_ref, buffer, len(buffer),
+                                     lens, len(chunk), None)
+
+
+def legacy_callback(uri, auth, chunk_data, chunk_len, user_data):
+    bytes(chunk_data[:chunk_len])
+    return 0
+
+
+def string_at_callback(uri, auth, chunk_data, chunk_len, user_data):
+    ctypes.string_at(chunk_data, chunk_len)
+    return 0
+
+
+def measure(name, runner, callback, reports, batch_size):
+    session = make_session()
+    config = make_config()
+    c_callback = MDS_CHUNK_UPLOAD_CALLBACK(callback) if callback else None
+    if c_callback:
+        lib.mds_set_upload_callback(session, c_callback, None)
+
+    start = time.perf_counter()
+    runner(session, config, reports, batch_size)
+    elapsed = time.perf_counter() - start
+
+    lib.mds_session_destroy(session)
+    rate = len(reports) / elapsed
+    print(f"  {name:<34} {rate:>14,.0f} pkt/s  ({elapsed * 1000:8.1f} ms)")
+    return rate
+
+
+def main():
+    parser = argparse.ArgumentParser(description='MDS Python ingestion benchmark')
+    parser.add_argument('--packets', type=int, default=200000,
+                        help='Number of stream reports per run (default: 200000)')
+    parser.add_argument('--batch', type=int, default=256,
+                        help='Reports per batch call (default: 256)')
+    args = parser.parse_args()
+
+    reports = make_reports(args.packets)
+
+    print(f"\n{args.packets} reports of {len(reports[0])} bytes, batch size {args.batch}\n")
+
+    print("No upload callback:")
+    legacy = measure("legacy (per-byte ctypes array)", run_legacy, None, reports, args.batch)
+    measure("single (zero-copy, 1 call/report)", run_single, None, reports, args.batch)
+    batch = measure("batch (zero-copy, 1 call/batch)", run_batch, None, reports, args.batch)
+    print(f"  speedup batch vs legacy: {batch / legacy:.1f}x\n")
+
+    print("Python upload callback copying the chunk:")
+    legacy = measure("legacy + slice copy", run_legacy, legacy_callback, reports, args.batch)
+    batch = measure("batch + string_at copy", run_batch, string_at_callback, reports, args.batch)
+    print(f"  speedup batch vs legacy: {batch / legacy:.1f}x\n")
+
+
+if __name__ == '__main__':
+    main()
@@ -6,6 +6,16 @@ This module provides ctypes bindings to the mds_bridge C library.
 It includes the public MDS API from mds_protocol.h, which provides:
 - High-level session management (mds_session_create, mds_read_device_config, etc.)
 - Stream processing for both blocking I/O (mds_process_stream) and event-driven I/O (mds_process_stream_from_bytes)
+- Batched event-driven I/O (mds_process_stream_batch) for many reports per call
+- The native libcurl chunk uploader (chunks_uploader.h)
+- The background reader and its poll fd (mds_session_start_reader,
+  mds_process_pending) for event-loop integration
+- Device enumeration (memfault_hid.h)
+
+The library is loaded with ctypes.CDLL, which releases the GIL for the
+duration of every foreign call. Blocking calls such as mds_process_stream()
+or an upload performed by the native uploader therefore never hold the GIL,
+as long as no Python callback is involved.
 """
 
 import ctypes
@@ -22,10 +32,10 @@ def get_library_path() -> str:
     system = platform.system()
     if system == 'Darwin':
         lib_name = 'libmds_bridge.dylib'
-        lib_name_versioned = 'libmds_bridge.2.dylib'
+        lib_name_versioned = 'libmds_bridge.3.dylib'
     elif system == 'Linux':
         lib_name = 'libmds_bridge.so'
-        lib_name_versioned = 'libmds_bridge.so.2'
+        lib_name_versioned = 'libmds_bridge.so.3'
     elif system == 'Windows':
         lib_name = 'mds_bridge.dll'
         lib_name_versioned = None
@@ -82,6 +92,7 @@ class MDS_REPORT_ID:
     AUTHORIZATION = 0x04
     STREAM_CONTROL = 0x05
     STREAM_DATA = 0x06
+    CONFIG = 0x07
 
 # MDS Stream modes
 class MDS_STREAM_MODE:
@@ -89,6 +100,9 @@ class MDS_STREAM_MODE:
     DISABLED = 0x00
     ENABLED = 0x01
 
+# Supported features bits
+MDS_FEATURE_CONFIG_REPORT = 0x01
+
 # Constants
 MDS_MAX_DEVICE_ID_LEN = 64
 MDS_MAX_URI_LEN = 128
@@ -115,6 +129,45 @@ class mds_stream_packet_t(ctypes.Structure):
         ('data_len', ctypes.c_size_t),
     ]
 
+class chunks_upload_stats_t(ctypes.Structure):
+    """Native uploader statistics (chunks_uploader.h)"""
+    _fields_ = [
+        ('chunks_uploaded', ctypes.c_size_t),
+        ('bytes_uploaded', ctypes.c_size_t),
+        ('upload_failures', ctypes.c_size_t),
+        ('last_http_status', ctypes.c_long),
+        ('failovers', ctypes.c_size_t),
+        ('duplicates_suppressed', ctypes.c_size_t),
+        ('ambiguous_replays', ctypes.c_size_t),
+        ('expired_chunks', ctypes.c_size_t),
+        ('expired_bytes', ctypes.c_size_t),
+        ('deadline_misses', ctypes.c_size_t),
+    ]
+
+class mds_reader_stats_t(ctypes.Structure):
+    """Background reader statistics"""
+    _fields_ = [
+        ('queued', ctypes.c_size_t),
+        ('capacity', ctypes.c_size_t),
+        ('overflows', ctypes.c_size_t),
+        ('last_error', ctypes.c_int),
+    ]
+
+class memfault_hid_device_info_t(ctypes.Structure):
+    """HID device information (memfault_hid.h)"""
+    _fields_ = [
+        ('path', ctypes.c_char * 256),
+        ('vendor_id', ctypes.c_uint16),
+        ('product_id', ctypes.c_uint16),
+        ('serial_number', ctypes.c_wchar * 128),
+        ('release_number', ctypes.c_uint16),
+        ('manufacturer', ctypes.c_wchar * 128),
+        ('product', ctypes.c_wchar * 128),
+        ('usage_page', ctypes.c_uint16),
+        ('usage', ctypes.c_uint16),
+        ('interface_number', ctypes.c_int),
+    ]
+
 # Backend callback function types
 BACKEND_READ_FN = ctypes.CFUNCTYPE(
     ctypes.c_int,  # return type
@@ -154,6 +207,7 @@ class mds_backend_t(ctypes.Structure):
     ]
 
 # Load the library
+# CDLL (not PyDLL) so that the GIL is released during C calls
 _lib_path = get_library_path()
 print(f"Loading MDS Bridge library from: {_lib_path}")
 lib = ctypes.CDLL(_lib_path)
@@ -182,6 +236,12 @@ lib.mds_session_create_hid.argtypes = [
 ]
 lib.mds_session_create_hid.restype = ctypes.c_int
 
+lib.mds_session_create_hid_path.argtypes = [
+    ctypes.c_char_p,  # path
+    ctypes.POINTER(ctypes.c_void_p)  # session
+]
+lib.mds_session_create_hid_path.restype = ctypes.c_int
+
 lib.mds_session_destroy.argtypes = [ctypes.c_void_p]
 lib.mds_session_destroy.restype = None
 
@@ -192,6 +252,16 @@ lib.mds_read_device_config.argtypes = [
 ]
 lib.mds_read_device_config.restype = ctypes.c_int
 
+lib.mds_read_device_config_deadline.argtypes = [
+    ctypes.c_void_p,  # session
+    ctypes.POINTER(mds_device_config_t),  # config
+    ctypes.c_uint64  # deadline_ms
+]
+lib.mds_read_device_config_deadline.restype = ctypes.c_int
+
+lib.mds_deadline_after.argtypes = [ctypes.c_uint32]  # timeout_ms
+lib.mds_deadline_after.restype = ctypes.c_uint64
+
 # Stream control - HIGH-LEVEL API
 lib.mds_stream_enable.argtypes = [ctypes.c_void_p]  # session
 lib.mds_stream_enable.restype = ctypes.c_int
@@ -199,6 +269,12 @@ lib.mds_stream_enable.restype = ctypes.c_int
 lib.mds_stream_disable.argtypes = [ctypes.c_void_p]  # session
 lib.mds_stream_disable.restype = ctypes.c_int
 
+lib.mds_stream_enable_deadline.argtypes = [ctypes.c_void_p, ctypes.c_uint64]  # session, deadline_ms
+lib.mds_stream_enable_deadline.restype = ctypes.c_int
+
+lib.mds_stream_disable_deadline.argtypes = [ctypes.c_void_p, ctypes.c_uint64]  # session, deadline_ms
+lib.mds_stream_disable_deadline.restype = ctypes.c_int
+
 # Upload callback registration
 lib.mds_set_upload_callback.argtypes = [
     ctypes.c_void_p,  # session
@@ -224,12 +300,142 @@ lib.mds_process_stream.argtypes = [
 lib.mds_process_stream.restype = ctypes.c_int
 
 # High-level stream processing - event-driven I/O (processes byte buffer)
+# The buffer is declared as c_void_p so that `bytes` objects are passed by
+# pointer (no copy) and ctypes arrays from as_c_buffer() are accepted as-is.
 lib.mds_process_stream_from_bytes.argtypes = [
     ctypes.c_void_p,  # session
     ctypes.POINTER(mds_device_config_t),  # config
-    ctypes.POINTER(ctypes.c_uint8),  # buffer
+    ctypes.c_void_p,  # buffer
     ctypes.c_size_t,  # buffer_len
     ctypes.POINTER(mds_stream_packet_t)  # packet (can be NULL)
 ]
 lib.mds_process_stream_from_bytes.restype = ctypes.c_int
 
+# Batched stream processing - many records per call (event-driven I/O)
+lib.mds_process_stream_batch.argtypes = [
+    ctypes.c_void_p,  # session
+    ctypes.POINTER(mds_device_config_t),  # config
+    ctypes.c_void_p,  # buffer (concatenated records)
+    ctypes.c_size_t,  # buffer_len
+    ctypes.POINTER(ctypes.c_size_t),  # record_lens
+    ctypes.c_size_t,  # record_count
+    ctypes.POINTER(ctypes.c_size_t)  # processed (can be NULL)
+]
+lib.mds_process_stream_batch.restype = ctypes.c_int
+
+# Native chunk uploader (chunks_uploader.h)
+lib.chunks_uploader_create.argtypes = []
+lib.chunks_uploader_create.restype = ctypes.c_void_p
+
+lib.chunks_uploader_destroy.argtypes = [ctypes.c_void_p]
+lib.chunks_uploader_destroy.restype = None
+
+lib.chunks_uploader_get_stats.argtypes = [
+    ctypes.c_void_p,  # uploader
+    ctypes.POINTER(chunks_upload_stats_t)  # stats
+]
+lib.chunks_uploader_get_stats.restype = ctypes.c_int
+
+lib.chunks_uploader_reset_stats.argtypes = [ctypes.c_void_p]
+lib.chunks_uploader_reset_stats.restype = ctypes.c_int
+
+lib.chunks_uploader_set_timeout.argtypes = [ctypes.c_void_p, ctypes.c_long]
+lib.chunks_uploader_set_timeout.restype = ctypes.c_int
+
+lib.chunks_uploader_set_verbose.argtypes = [ctypes.c_void_p, ctypes.c_bool]
+lib.chunks_uploader_set_verbose.restype = ctypes.c_int
+
+lib.chunks_uploader_enable_dedup.argtypes = [
+    ctypes.c_void_p,  # uploader
+    ctypes.c_size_t,  # window
+    ctypes.c_char_p  # path (None for memory only)
+]
+lib.chunks_uploader_enable_dedup.restype = ctypes.c_int
+
+lib.chunks_uploader_callback.argtypes = [
+    ctypes.c_char_p,  # uri
+    ctypes.c_char_p,  # auth_header
+    ctypes.c_void_p,  # chunk_data
+    ctypes.c_size_t,  # chunk_len
+    ctypes.c_void_p  # user_data (chunks_uploader_t*)
+]
+lib.chunks_uploader_callback.restype = ctypes.c_int
+# Background reader - event loop integration
+lib.mds_session_start_reader.argtypes = [ctypes.c_void_p, ctypes.c_size_t]  # session, queue_depth
+lib.mds_session_start_reader.restype = ctypes.c_int
+
+lib.mds_session_stop_reader.argtypes = [ctypes.c_void_p]  # session
+lib.mds_session_stop_reader.restype = ctypes.c_int
+
+lib.mds_session_get_poll_fd.argtypes = [ctypes.c_void_p]  # session
+lib.mds_session_get_poll_fd.restype = ctypes.c_int
+
+lib.mds_session_get_reader_stats.argtypes = [
+    ctypes.c_void_p,  # session
+    ctypes.POINTER(mds_reader_stats_t)  # stats
+]
+lib.mds_session_get_reader_stats.restype = ctypes.c_int
+
+lib.mds_process_pending.argtypes = [
+    ctypes.c_void_p,  # session
+    ctypes.POINTER(mds_device_config_t),  # config
+    ctypes.POINTER(mds_stream_packet_t),  # packets (optional)
+    ctypes.POINTER(ctypes.c_int),  # upload_results (optional)
+    ctypes.c_size_t,  # max_packets
+    ctypes.POINTER(ctypes.c_size_t)  # count
+]
+lib.mds_process_pending.restype = ctypes.c_int
+
+# Device enumeration (memfault_hid.h)
+lib.memfault_hid_init.argtypes = []
+lib.memfault_hid_init.restype = ctypes.c_int
+
+lib.memfault_hid_exit.argtypes = []
+lib.memfault_hid_exit.restype = ctypes.c_int
+
+lib.memfault_hid_enumerate.argtypes = [
+    ctypes.c_uint16,  # vendor_id (0 = any)
+    ctypes.c_uint16,  # product_id (0 = any)
+    ctypes.POINTER(ctypes.POINTER(memfault_hid_device_info_t)),  # devices
+    ctypes.POINTER(ctypes.c_size_t)  # num_devices
+]
+lib.memfault_hid_enumerate.restype = ctypes.c_int
+
+lib.memfault_hid_free_device_list.argtypes = [ctypes.POINTER(memfault_hid_device_info_t)]
+lib.memfault_hid_free_device_list.restype = None
+
+
+# chunks_uploader_callback() as a C function pointer, for passing straight to
+# mds_set_upload_callback(). Uploads then run entirely in C without
+# re-entering Python.
+CHUNKS_UPLOADER_CALLBACK = ctypes.cast(lib.chunks_uploader_callback,
+                                       MDS_CHUNK_UPLOAD_CALLBACK)
+
+
+def as_c_buffer(data):
+    """
+    Expose a bytes-like object to C without a per-byte conversion.
+
+    - bytes: passed as-is; ctypes hands C a pointer to the object's storage
+    - writable buffers (bytearray, memoryview, array): wrapped in place with
+      from_buffer(), sharing memory with the Python object
+    - read-only buffers other than bytes: copied once with a single memcpy
+
+    The returned object must stay alive for the duration of the C call.
+
+    Args:
+        data: Any object supporting the buffer protocol
+
+    Returns:
+        Object suitable for a c_void_p buffer argument
+    """
+    if isinstance(data, bytes):
+        return data
+
+    view = memoryview(data)
+    if view.format != 'B' or view.ndim != 1:
+        view = view.cast('B')
+    if view.readonly:
+        return view.tobytes()
+    return (ctypes.c_uint8 * view.nbytes).from_buffer(view)
+
@@ -92,9 +92,10 @@ class HIDBackend:
         Returns:
             Number of bytes read or negative error code
         """
-        # Determine if this is a feature report (0x01-0x05) or input report (0x06)
-        if (report_id >= MDS_REPORT_ID.SUPPORTED_FEATURES and
-            report_id <= MDS_REPORT_ID.STREAM_CONTROL):
+        # Determine if this is a feature report (0x01-0x05, 0x07) or input report (0x06)
+        if ((report_id >= MDS_REPORT_ID.SUPPORTED_FEATURES and
+             report_id <= MDS_REPORT_ID.STREAM_CONTROL) or
+                report_id == MDS_REPORT_ID.CONFIG):
             # Feature report - use get_feature_report()
             data = self.device.get_feature_report(report_id, length + 1)  # +1 for report ID
 
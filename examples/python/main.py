@@ -14,6 +14,7 @@ Usage:
   ./main.py <vid> <pid>        # Specify VID/PID in hex
   ./main.py 0x1234 0x5678
   ./main.py --no-upload        # Disable cloud uploads
+  ./main.py --native-upload    # Upload with the C library's libcurl uploader
 """
 
 import hid
@@ -21,10 +22,11 @@ import time
 import signal
 import sys
 import argparse
-from typing import Optional
+from typing import List, Optional
 from dataclasses import dataclass
 
 from mds_client import MDSClient
+from native_uploader import NativeUploader
 
 
 # Configuration - Default values, can be overridden via CLI
@@ -33,10 +35,14 @@ class Config:
     vendor_id: int = 0x1234    # Replace with your device's VID
     product_id: int = 0x5678   # Replace with your device's PID
     upload_chunks: bool = True # Set to True to upload chunks to Memfault cloud
+    native_upload: bool = False # Upload in C (libcurl) instead of Python (requests)
 
 
 CONFIG = Config()
 
+# Upper bound on reports handed to the C library per call
+MAX_REPORTS_PER_BATCH = 256
+
 
 def parse_hex(value: str) -> int:
     """Parse hex value with or without 0x prefix"""
@@ -56,6 +62,7 @@ Examples:
   %(prog)s 1234 5678          # VID=0x1234, PID=0x5678
   %(prog)s 0x1234 0x5678      # Same with 0x prefix
   %(prog)s 1234 5678 --no-upload  # Disable cloud uploads
+  %(prog)s 1234 5678 --native-upload  # Upload without re-entering Python
 """
     )
 
@@ -76,6 +83,11 @@ Examples:
         action='store_true',
         help='Disable chunk uploads to Memfault cloud'
     )
+    parser.add_argument(
+        '--native-upload',
+        action='store_true',
+        help='Upload with the native libcurl uploader (no Python callback, GIL released)'
+    )
 
     args = parser.parse_args()
 
@@ -86,6 +98,8 @@ Examples:
         CONFIG.product_id = args.pid
     if args.no_upload:
         CONFIG.upload_chunks = False
+    if args.native_upload:
+        CONFIG.native_upload = True
 
     # Validate that both VID and PID are provided if either is
     if (args.vid is None) != (args.pid is None):
@@ -100,6 +114,7 @@ class Application:
     def __init__(self):
         self.device: Optional[hid.device] = None
         self.mds_client: Optional[MDSClient] = None
+        self.uploader: Optional[NativeUploader] = None
         self.running = False
 
     def open_device(self) -> None:
@@ -149,23 +164,25 @@ class Application:
 
         # Enable upload to Memfault cloud if requested
         # The C library will automatically handle chunk upload via callback
-        if CONFIG.upload_chunks:
+        if CONFIG.upload_chunks and CONFIG.native_upload:
+            self.uploader = NativeUploader(timeout_ms=10000)
+            self.mds_client.attach_uploader(self.uploader)
+            print("[Application] Chunk upload to Memfault cloud is ENABLED (native)\n")
+        elif CONFIG.upload_chunks:
             self.mds_client.enable_upload(True)
             print("[Application] Chunk upload to Memfault cloud is ENABLED\n")
         else:
             print("[Application] Chunk upload is DISABLED (dry-run mode)\n")
 
-    def handle_hid_data(self, data: bytes) -> None:
+    def handle_hid_reports(self, reports: List[bytes]) -> None:
         """
-        Handle incoming HID data
-        Routes data to either MDS client or elsewhere
+        Handle a batch of incoming HID reports
+        MDS stream reports are processed in a single C call; anything else
+        is routed to the application
         """
-        # Let MDS process first - returns True if it handled the data
-        if self.mds_client.process(data):
-            return  # MDS handled it
-
-        # Non MDS HID report, handle with your own code here.
-        pass
+        for report in self.mds_client.process_batch(reports):
+            # Non MDS HID report, handle with your own code here.
+            pass
 
     def start(self) -> None:
         """Start the application"""
@@ -182,10 +199,18 @@ class Application:
         # Main loop
         try:
             while self.running:
-                # Read from HID device (non-blocking)
+                # Wait for the first report, then drain whatever else is
+                # already queued so it can be processed in one batch
+                reports = []
                 data = self.device.read(64, timeout_ms=100)
-                if data:
-                    self.handle_hid_data(bytes(data))
+                while data:
+                    reports.append(bytes(data))
+                    if len(reports) >= MAX_REPORTS_PER_BATCH:
+                        break
+                    data = self.device.read(64)
+
+                if reports:
+                    self.handle_hid_reports(reports)
 
                 # Small sleep to prevent busy-waiting
                 time.sleep(0.01)
@@ -202,7 +227,14 @@ class Application:
         self.running = False
 
         # Print stats before cleanup
-        if self.mds_client:
+        upload_stats = self.mds_client.get_upload_stats() if self.mds_client else None
+        if upload_stats:
+            print(f"\nFinal stats (native uploader):")
+            print(f"  Chunks uploaded: {upload_stats.chunks_uploaded}")
+            print(f"  Bytes uploaded: {upload_stats.bytes_uploaded}")
+            if upload_stats.upload_failures > 0:
+                print(f"  Upload errors: {upload_stats.upload_failures}")
+        elif self.mds_client:
             print(f"\nFinal stats:")
             print(f"  Chunks received: {self.mds_client.stats['chunks_received']}")
             print(f"  Chunks uploaded: {self.mds_client.stats['chunks_uploaded']}")
@@ -214,6 +246,11 @@ class Application:
             self.mds_client.destroy()
             self.mds_client = None
 
+        # The session is gone, so the native uploader can be released
+        if self.uploader:
+            self.uploader.destroy()
+            self.uploader = None
+
         # Close HID device
         if self.device:
             self.device.close()
@@ -11,7 +11,7 @@ a custom backend that bridges hidapi with the MDS C library. This approach:
 """
 
 import ctypes
-from typing import Optional, Callable
+from typing import Iterable, List, Optional, Callable
 import requests
 from dataclasses import dataclass
 
@@ -22,8 +22,11 @@ from bindings import (
     MDS_CHUNK_UPLOAD_CALLBACK,
     mds_device_config_t,
     mds_stream_packet_t,
+    as_c_buffer,
+    CHUNKS_UPLOADER_CALLBACK,
 )
 from hid_backend import HIDBackend
+from native_uploader import NativeUploader, UploadStats
 
 
 @dataclass
@@ -45,15 +48,23 @@ class MDSClient:
     - The C library handles all the protocol details via callbacks
     """
 
-    def __init__(self, hid_device):
+    def __init__(self, hid_device=None, device_path: Optional[bytes] = None):
         """
         Initialize MDS client
 
         Args:
-            hid_device: hidapi device instance
+            hid_device: hidapi device instance (Python backend)
+            device_path: HID device path (native backend). When given, the
+                C library opens the device itself and every read happens in
+                C with the GIL released; use process_stream() to drive it.
         """
+        if (hid_device is None) == (device_path is None):
+            raise ValueError("Specify exactly one of hid_device or device_path")
+
         self.device = hid_device
+        self.device_path = device_path
         self.backend: Optional[HIDBackend] = None
+        self.uploader: Optional[NativeUploader] = None
         self.session: Optional[ctypes.c_void_p] = None
         self.config: Optional[DeviceConfig] = None
         self.config_struct: Optional[mds_device_config_t] = None  # C struct for callbacks
@@ -66,16 +77,24 @@ class MDSClient:
         }
 
     def initialize(self) -> None:
-        """Initialize the MDS session with custom backend"""
-        # Create custom backend using hidapi
-        self.backend = HIDBackend(self.device)
-
-        # Create MDS session with our custom backend
+        """Initialize the MDS session with custom or native backend"""
         session_ptr = ctypes.c_void_p()
-        result = lib.mds_session_create(
-            self.backend.get_backend_ref(),
-            ctypes.byref(session_ptr)
-        )
+
+        if self.device_path is not None:
+            # Native HID backend - the C library owns the device
+            result = lib.mds_session_create_hid_path(
+                self.device_path,
+                ctypes.byref(session_ptr)
+            )
+        else:
+            # Create custom backend using hidapi
+            self.backend = HIDBackend(self.device)
+
+            # Create MDS session with our custom backend
+            result = lib.mds_session_create(
+                self.backend.get_backend_ref(),
+                ctypes.byref(session_ptr)
+            )
 
         if result < 0:
             raise RuntimeError(f"Failed to create MDS session: {result}")
@@ -154,7 +173,8 @@ class MDSClient:
                     # Convert C strings and data to Python
                     uri_str = uri.decode('utf-8')
                     auth_str = auth_header.decode('utf-8')
-                    data_bytes = bytes(chunk_data[:chunk_len])
+                    # Single memcpy instead of a per-byte slice of the pointer
+                    data_bytes = ctypes.string_at(chunk_data, chunk_len)
 
                     # Parse authorization header
                     auth_parts = auth_str.split(':', 1)
@@ -189,18 +209,70 @@ class MDSClient:
 
             # Store callback to prevent garbage collection
             self.upload_callback = upload_callback_impl
+            self.uploader = None
 
             # Register with C library
             result = lib.mds_set_upload_callback(self.session, self.upload_callback, None)
             if result < 0:
                 raise RuntimeError(f"Failed to register upload callback: {result}")
         else:
-            # Unregister callback
-            result = lib.mds_set_upload_callback(self.session, None, None)
+            # Unregister callback (a default-constructed CFUNCTYPE is a NULL
+            # function pointer; ctypes rejects a bare None here)
+            result = lib.mds_set_upload_callback(self.session,
+                                                 MDS_CHUNK_UPLOAD_CALLBACK(), None)
             if result < 0:
                 raise RuntimeError(f"Failed to unregister upload callback: {result}")
 
             self.upload_callback = None
+            self.uploader = None
+
+    def attach_uploader(self, uploader: NativeUploader) -> None:
+        """
+        Upload chunks with the C library's libcurl uploader.
+
+        chunks_uploader_callback() is registered directly as the session's
+        upload callback, so uploads never call back into Python and run with
+        the GIL released. Replaces any Python upload callback.
+
+        The uploader must outlive the session or be detached with
+        enable_upload(False) before it is destroyed.
+
+        Args:
+            uploader: Native uploader to attach
+        """
+        result = lib.mds_set_upload_callback(self.session,
+                                             CHUNKS_UPLOADER_CALLBACK,
+                                             uploader.handle)
+        if result < 0:
+            raise RuntimeError(f"Failed to attach native uploader: {result}")
+
+        self.upload_callback = None
+        self.uploader = uploader
+
+    def get_upload_stats(self) -> Optional[UploadStats]:
+        """Native uploader statistics, or None if no uploader is attached"""
+        return self.uploader.stats if self.uploader else None
+
+    def process_stream(self, timeout_ms: int = 1000) -> bool:
+        """
+        Read and process one packet using the native backend.
+
+        Blocks in C (GIL released) for up to timeout_ms. Only meaningful for
+        clients created with device_path.
+
+        Args:
+            timeout_ms: Read timeout in milliseconds
+
+        Returns:
+            True if a packet was processed, False on timeout or error
+        """
+        result = lib.mds_process_stream(
+            self.session,
+            ctypes.byref(self.config_struct),
+            timeout_ms,
+            None
+        )
+        return result == 0
 
     def process(self, data: bytes) -> bool:
         """
@@ -237,31 +309,59 @@ class MDSClient:
         self._process_stream_payload(payload)
         return True
 
+    def process_batch(self, reports: Iterable[bytes]) -> List[bytes]:
+        """
+        Process many transport packets with a single call into the C library.
+
+        MDS stream reports are stripped of their channel ID (via zero-copy
+        memoryview slices), concatenated into one buffer and handed to
+        mds_process_stream_batch(). Everything else is returned untouched so
+        the application can handle it.
+
+        Args:
+            reports: Raw packets from the transport (including channel ID)
+
+        Returns:
+            The reports that were not MDS stream data, in their original order
+        """
+        payloads = []
+        others = []
+        for report in reports:
+            if len(report) > 1 and report[0] == MDS_REPORT_ID.STREAM_DATA:
+                payloads.append(memoryview(report)[1:])
+            elif report:
+                others.append(report)
+
+        if payloads:
+            self._process_stream_batch(payloads)
+
+        return others
+
     def _process_stream_payload(self, payload: bytes) -> None:
         """
         Internal method to process MDS stream packet payload.
 
-        Uses the C library's mds_process_stream_packet_and_upload() which:
+        Uses the C library's mds_process_stream_from_bytes() which:
         - Parses the packet
         - Validates sequence number
         - Updates sequence tracking
         - Triggers upload callback if registered
 
+        The payload is passed to C by pointer (see as_c_buffer()), so no
+        per-byte ctypes array is built.
+
         Args:
             payload: Stream packet payload (sequence + data)
         """
         if not payload:
             return
 
-        # Convert to C buffer
-        packet_buffer = (ctypes.c_uint8 * len(payload))(*payload)
-
         # Process packet and trigger upload callback (if registered)
         # The C library handles everything!
         result = lib.mds_process_stream_from_bytes(
             self.session,
             ctypes.byref(self.config_struct),
-            packet_buffer,
+            as_c_buffer(payload),
             len(payload),
             None  # Don't need packet output
         )
@@ -270,6 +370,31 @@ class MDSClient:
             print(f"[MDSClient] Failed to process stream packet: {result}")
             return
 
+    def _process_stream_batch(self, payloads: List[memoryview]) -> None:
+        """
+        Internal method to process several stream payloads in one C call.
+
+        Args:
+            payloads: Stream packet payloads (sequence + data)
+        """
+        buffer = b''.join(payloads)
+        lengths = (ctypes.c_size_t * len(payloads))(*map(len, payloads))
+        processed = ctypes.c_size_t(0)
+
+        result = lib.mds_process_stream_batch(
+            self.session,
+            ctypes.byref(self.config_struct),
+            buffer,
+            len(buffer),
+            lengths,
+            len(payloads),
+            ctypes.byref(processed)
+        )
+
+        if result < 0:
+            print(f"[MDSClient] Failed to process stream batch at record "
+                  f"{processed.value}/{len(payloads)}: {result}")
+
     def get_config(self) -> Optional[DeviceConfig]:
         """Get device configuration"""
         return self.config
@@ -0,0 +1,117 @@
+"""
+Native Uploader - Wraps the C library's libcurl chunk uploader
+
+Attaching a NativeUploader to an MDS session registers
+chunks_uploader_callback() directly with mds_set_upload_callback(). Chunks
+then flow from mds_process_stream*() to libcurl without ever re-entering
+Python, and because the library is loaded with ctypes.CDLL the GIL is
+released for the whole call, network I/O included.
+"""
+
+import ctypes
+from dataclasses import dataclass
+from typing import Optional
+
+from bindings import (
+    lib,
+    chunks_upload_stats_t,
+)
+
+
+@dataclass
+class UploadStats:
+    """Snapshot of the native uploader statistics"""
+    chunks_uploaded: int
+    bytes_uploaded: int
+    upload_failures: int
+    last_http_status: int
+    failovers: int
+    duplicates_suppressed: int
+    ambiguous_replays: int
+    expired_chunks: int
+    expired_bytes: int
+    deadline_misses: int
+
+
+class NativeUploader:
+    """
+    Owner of a chunks_uploader_t instance
+
+    Usage:
+        with NativeUploader(timeout_ms=10000) as uploader:
+            mds_client.attach_uploader(uploader)
+            ...
+            print(uploader.stats)
+    """
+
+    def __init__(self, timeout_ms: Optional[int] = None, verbose: bool = False):
+        """
+        Create the native uploader
+
+        Args:
+            timeout_ms: HTTP timeout in milliseconds (None for library default)
+            verbose: Print libcurl request details
+        """
+        handle = lib.chunks_uploader_create()
+        if not handle:
+            raise RuntimeError("Failed to create native uploader")
+
+        self.handle: Optional[ctypes.c_void_p] = ctypes.c_void_p(handle)
+
+        if timeout_ms is not None:
+            lib.chunks_uploader_set_timeout(self.handle, timeout_ms)
+        lib.chunks_uploader_set_verbose(self.handle, verbose)
+
+    @property
+    def stats(self) -> UploadStats:
+        """Current upload statistics"""
+        raw = chunks_upload_stats_t()
+        result = lib.chunks_uploader_get_stats(self.handle, ctypes.byref(raw))
+        if result < 0:
+            raise RuntimeError(f"Failed to read uploader stats: {result}")
+
+        return UploadStats(
+            chunks_uploaded=raw.chunks_uploaded,
+            bytes_uploaded=raw.bytes_uploaded,
+            upload_failures=raw.upload_failures,
+            last_http_status=raw.last_http_status,
+            failovers=raw.failovers,
+            duplicates_suppressed=raw.duplicates_suppressed,
+            ambiguous_replays=raw.ambiguous_replays,
+            expired_chunks=raw.expired_chunks,
+            expired_bytes=raw.expired_bytes,
+            deadline_misses=raw.deadline_misses,
+        )
+
+    def enable_dedup(self, window: int = 4096, path: Optional[str] = None) -> None:
+        """
+        Skip re-uploads of chunks the server already acknowledged
+
+        Args:
+            window: Number of recent chunks remembered (0 disables)
+            path: File keeping the window across restarts (None for memory only)
+        """
+        result = lib.chunks_uploader_enable_dedup(
+            self.handle, window, path.encode() if path else None)
+        if result < 0:
+            raise RuntimeError(f"Failed to enable dedup: {result}")
+
+    def reset_stats(self) -> None:
+        """Reset the upload statistics counters"""
+        lib.chunks_uploader_reset_stats(self.handle)
+
+    def destroy(self) -> None:
+        """
+        Destroy the native uploader
+
+        Detach it from every session (or destroy those sessions) first.
+        """
+        if self.handle:
+            lib.chunks_uploader_destroy(self.handle)
+            self.handle = None
+
+    def __enter__(self) -> 'NativeUploader':
+        return self
+
+    def __exit__(self, exc_type, exc, tb) -> None:
+        self.destroy()
@@ -18,6 +18,7 @@
 extern "C" {
 #endif
 
+#include "mds_bridge/mds_config.h"
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
@@ -27,6 +28,45 @@ extern "C" {
  */
 typedef struct chunks_uploader chunks_uploader_t;
 
+/** Maximum length of an endpoint origin, including the terminator */
+#define CHUNKS_MAX_ORIGIN_LEN   128
+
+/** Maximum number of endpoints in one failover group */
+#define CHUNKS_MAX_ENDPOINTS    8
+
+/** Default dedup window size (chunks remembered) */
+#define CHUNKS_DEDUP_DEFAULT_WINDOW     4096
+
+/** Socket interest flags passed to chunks_uploader_socket_fn */
+#define CHUNKS_POLL_IN                  0x01
+#define CHUNKS_POLL_OUT                 0x02
+
+/** Concurrent requests in event-loop mode */
+#define CHUNKS_ASYNC_MAX_IN_FLIGHT      8
+
+/** Uploads waiting for a free request slot in event-loop mode */
+#define CHUNKS_ASYNC_MAX_QUEUED         256
+
+/** Default number of connections a shared pool keeps open */
+#define CHUNKS_POOL_DEFAULT_CONNECTIONS 4
+
+/** Default lifetime of a persisted TLS session (see chunks_uploader_set_tls_cache()) */
+#define CHUNKS_TLS_DEFAULT_MAX_AGE_S    (24 * 60 * 60)
+
+/** Time a resolved address is used before it is refreshed (see chunks_uploader_set_dns_cache()) */
+#define CHUNKS_DNS_DEFAULT_TTL_S        60
+
+/** Time an expired address may still be used while it is refreshed */
+#define CHUNKS_DNS_DEFAULT_MAX_STALE_S  (60 * 60)
+
+/** Buckets of the upload age histogram (see chunks_age_stats_t) */
+#define CHUNKS_AGE_BUCKETS              24
+
+/**
+ * @brief Opaque handle to a connection pool shared by uploaders
+ */
+typedef struct chunks_pool chunks_pool_t;
+
 /**
  * @brief Upload statistics
  */
@@ -42,8 +82,110 @@ typedef struct {
 
     /** Last HTTP status code */
     long last_http_status;
+
+    /** Uploads that were retried on an alternate endpoint */
+    size_t failovers;
+
+    /** Chunks not sent because an earlier upload was acknowledged */
+    size_t duplicates_suppressed;
+
+    /** Chunks re-sent after an earlier attempt ended without a response */
+    size_t ambiguous_replays;
+
+    /** Chunks past their maximum age that were dropped or diverted, not sent */
+    size_t expired_chunks;
+
+    /** Bytes of those chunks */
+    size_t expired_bytes;
+
+    /** Chunks uploaded after their deadline */
+    size_t deadline_misses;
 } chunks_upload_stats_t;
 
+/**
+ * @brief Order in which queued uploads are sent (event-loop mode)
+ */
+typedef enum {
+    CHUNKS_QUEUE_FIFO,          /**< Oldest first (default) */
+    CHUNKS_QUEUE_EDF,           /**< Earliest deadline first, chunks without one last */
+} chunks_queue_order_t;
+
+/**
+ * @brief Scheduling and expiry policy for uploads
+ */
+typedef struct {
+    /** Queue order */
+    chunks_queue_order_t order;
+
+    /** Chunks older than this when they are due to be sent expire (0 = never) */
+    uint32_t max_age_ms;
+
+    /** Deadline after receipt for chunks submitted without one (0 = none) */
+    uint32_t default_deadline_ms;
+
+    /**
+     * Receives expired chunks instead of dropping them, e.g. a local archive
+     * (NULL = drop). Called on the thread that sends uploads.
+     */
+    mds_chunk_upload_callback_t expired_fn;
+    void *expired_user_data;
+} chunks_queue_policy_t;
+
+/**
+ * @brief Age of chunks when their upload succeeded
+ */
+typedef struct {
+    /** counts[0]: under 1 ms; counts[i]: [2^(i-1), 2^i) ms; the last bucket is open-ended */
+    size_t counts[CHUNKS_AGE_BUCKETS];
+
+    /** Oldest and mean age in milliseconds */
+    uint64_t max_ms;
+    double mean_ms;
+} chunks_age_stats_t;
+
+/**
+ * @brief Connection pool statistics
+ */
+typedef struct {
+    /** Requests sent through the pool */
+    size_t requests;
+
+    /** Connections opened (requests minus this is the reuse count) */
+    size_t connections_opened;
+
+    /** Distinct origins (scheme, host, port) contacted */
+    size_t hosts;
+
+    /** Uploaders currently attached */
+    unsigned int uploaders;
+} chunks_pool_stats_t;
+
+/**
+ * @brief Health of one endpoint in a failover group
+ */
+typedef struct {
+    /** Endpoint origin ("scheme://host[:port]") */
+    char origin[CHUNKS_MAX_ORIGIN_LEN];
+
+    /** True for the group's primary endpoint */
+    bool primary;
+
+    /** Requests sent to this endpoint */
+    size_t requests;
+
+    /** Requests that failed (transport error, HTTP 5xx or 429) */
+    size_t failures;
+
+    /** Smoothed request latency in milliseconds */
+    double latency_ms;
+
+    /** Smoothed failure rate (0.0 - 1.0) */
+    double error_rate;
+
+    /** Fraction of the group's requests sent to this endpoint */
+    double share;
+} chunks_endpoint_stats_t;
+
 /**
  * @brief Create an HTTP uploader
  *
@@ -87,6 +229,59 @@ int chunks_uploader_callback(const char *uri,
                               size_t chunk_len,
                               void *user_data);
 
+/**
+ * @brief Upload a chunk that was received earlier, optionally with a deadline
+ *
+ * Same as chunks_uploader_callback(), but the chunk carries its receive time
+ * and deadline. Both drive the queue policy: a chunk older than max_age_ms
+ * when it is due to be sent expires, and in CHUNKS_QUEUE_EDF order the
+ * earliest deadline is sent first.
+ *
+ * @param uploader Uploader handle
+ * @param uri Data URI to POST to
+ * @param auth_header Authorization header (format: "HeaderName:HeaderValue")
+ * @param chunk_data Chunk data bytes
+ * @param chunk_len Length of chunk data
+ * @param age_ms How long ago the chunk was received (0 = now)
+ * @param deadline_ms Deadline after receipt (0 = the policy default)
+ *
+ * @return 0 on success (or queued in event-loop mode), the result of the
+ *         policy's expired_fn for an expired chunk, -ETIME if an expired
+ *         chunk was dropped, negative error code otherwise
+ */
+int chunks_uploader_submit(chunks_uploader_t *uploader,
+                           const char *uri,
+                           const char *auth_header,
+                           const uint8_t *chunk_data,
+                           size_t chunk_len,
+                           uint32_t age_ms,
+                           uint32_t deadline_ms);
+
+/**
+ * @brief Set the scheduling and expiry policy
+ *
+ * @param uploader Uploader handle
+ * @param policy Policy to copy, or NULL for the default (FIFO, no expiry)
+ *
+ * @return 0 on success, -EBUSY while event-loop uploads are pending,
+ *         negative error code otherwise
+ */
+int chunks_uploader_set_queue_policy(chunks_uploader_t *uploader,
+                                     const chunks_queue_policy_t *policy);
+
+/**
+ * @brief Get the distribution of chunk ages at successful upload
+ *
+ * Reset together with the upload statistics.
+ *
+ * @param uploader Uploader handle
+ * @param stats Pointer to receive the histogram
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int chunks_uploader_get_age_stats(chunks_uploader_t *uploader,
+                                  chunks_age_stats_t *stats);
+
 /**
  * @brief Get upload statistics
  *
@@ -137,6 +332,324 @@ int chunks_uploader_set_timeout(chunks_uploader_t *uploader,
 int chunks_uploader_set_verbose(chunks_uploader_t *uploader,
                                  bool verbose);
 
+/**
+ * @brief Configure failover endpoints for a data origin
+ *
+ * Uploads whose URI starts with origins[0] (the primary, matched
+ * case-insensitively on "scheme://host[:port]") are routed to the healthiest
+ * endpoint of the group, with the path and query preserved. Endpoints are
+ * scored by smoothed latency weighted by error rate. Transport errors, HTTP
+ * 5xx and 429 fail over to the next endpoint within the same upload; other
+ * 4xx responses are returned as-is. While failed over, the primary is probed
+ * every probe interval and traffic returns to it once it is healthy again.
+ *
+ * Calling this again with the same primary replaces the group and resets its
+ * health state.
+ *
+ * @param uploader Uploader handle
+ * @param origins Array of origins, primary first (e.g. "https://chunks.memfault.com")
+ * @param count Number of origins (1 - CHUNKS_MAX_ENDPOINTS)
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int chunks_uploader_set_endpoints(chunks_uploader_t *uploader,
+                                  const char *const *origins,
+                                  size_t count);
+
+/**
+ * @brief Set how often a failed-over primary endpoint is probed
+ *
+ * Also the base of the back-off applied to failing endpoints. Default is
+ * 5 seconds.
+ *
+ * @param uploader Uploader handle
+ * @param probe_interval_ms Probe interval in milliseconds
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int chunks_uploader_set_probe_interval(chunks_uploader_t *uploader,
+                                       long probe_interval_ms);
+
+/**
+ * @brief Get per-endpoint health for a failover group
+ *
+ * @param uploader Uploader handle
+ * @param primary_origin Primary origin the group was configured with
+ * @param stats Array to receive endpoint stats, primary first
+ * @param max_stats Size of the stats array
+ * @param count Pointer to receive the number of entries written
+ *
+ * @return 0 on success, -ENOENT if no group has that primary,
+ *         negative error code otherwise
+ */
+int chunks_uploader_get_endpoint_stats(chunks_uploader_t *uploader,
+                                       const char *primary_origin,
+                                       chunks_endpoint_stats_t *stats,
+                                       size_t max_stats,
+                                       size_t *count);
+
+/**
+ * @brief Suppress re-uploads of chunks the server already acknowledged
+ *
+ * The uploader remembers a hash of (device, payload) for the most recent
+ * uploads in a fixed-size window. A chunk whose earlier upload was
+ * acknowledged is not sent again and the callback returns 0. A chunk whose
+ * earlier attempt timed out or lost its response may or may not have been
+ * stored, so it is sent again and counted in ambiguous_replays.
+ *
+ * With a path, the window lives in that file (e.g. next to the chunk
+ * archive) and survives restarts. Calling this again replaces the window.
+ *
+ * @param uploader Uploader handle
+ * @param window Number of chunks remembered (0 disables dedup)
+ * @param path Window file, or NULL to keep the window in memory only
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int chunks_uploader_enable_dedup(chunks_uploader_t *uploader,
+                                 size_t window,
+                                 const char *path);
+
+/**
+ * @brief Called when a socket should be watched, or no longer watched
+ *
+ * @param fd Socket descriptor
+ * @param events CHUNKS_POLL_IN and/or CHUNKS_POLL_OUT, or 0 to stop watching fd
+ * @param user_data User data from chunks_uploader_set_event_loop()
+ *
+ * @return 0 on success, non-zero on failure
+ */
+typedef int (*chunks_uploader_socket_fn)(int fd, int events, void *user_data);
+
+/**
+ * @brief Called when the single uploader timer should be (re)armed
+ *
+ * When the timer expires the host calls chunks_uploader_on_timeout().
+ *
+ * @param timeout_ms Delay in milliseconds (0 = as soon as possible), or -1
+ *                   to cancel the timer
+ * @param user_data User data from chunks_uploader_set_event_loop()
+ *
+ * @return 0 on success, non-zero on failure
+ */
+typedef int (*chunks_uploader_timer_fn)(long timeout_ms, void *user_data);
+
+/**
+ * @brief Drive uploads from the host's event loop instead of blocking
+ *
+ * In event-loop mode chunks_uploader_callback() copies the chunk, queues it
+ * and returns 0 immediately (-ENOBUFS if CHUNKS_ASYNC_MAX_QUEUED uploads are
+ * already waiting). Up to CHUNKS_ASYNC_MAX_IN_FLIGHT requests run at once,
+ * but at most one per device (data URI), so each device's chunks reach the
+ * server in the order they were queued. The uploader reports the sockets and the timer it needs through the
+ * callbacks; the host watches them (epoll, libuv, ...) and calls
+ * chunks_uploader_on_socket() and chunks_uploader_on_timeout(). No threads
+ * are created. Outcomes are reported through chunks_uploader_get_stats();
+ * failover and dedup work as in blocking mode.
+ *
+ * All calls must come from the loop's thread. Passing a NULL socket_fn
+ * returns to blocking mode.
+ *
+ * @param uploader Uploader handle
+ * @param socket_fn Socket interest callback (NULL to leave event-loop mode)
+ * @param timer_fn Timer callback (required with socket_fn)
+ * @param user_data Passed to both callbacks
+ *
+ * @return 0 on success, -EBUSY while uploads are pending,
+ *         negative error code otherwise
+ */
+int chunks_uploader_set_event_loop(chunks_uploader_t *uploader,
+                                   chunks_uploader_socket_fn socket_fn,
+                                   chunks_uploader_timer_fn timer_fn,
+                                   void *user_data);
+
+/**
+ * @brief Report activity on a socket registered through socket_fn
+ *
+ * @param uploader Uploader handle
+ * @param fd Socket descriptor
+ * @param events CHUNKS_POLL_IN and/or CHUNKS_POLL_OUT that are ready
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int chunks_uploader_on_socket(chunks_uploader_t *uploader, int fd, int events);
+
+/**
+ * @brief Report that the timer armed through timer_fn expired
+ *
+ * @param uploader Uploader handle
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int chunks_uploader_on_timeout(chunks_uploader_t *uploader);
+
+/**
+ * @brief Number of uploads queued or in flight in event-loop mode
+ *
+ * Wait for this to reach 0 before destroying the uploader; unfinished
+ * uploads are discarded on destroy.
+ *
+ * @param uploader Uploader handle
+ *
+ * @return Pending uploads (0 in blocking mode)
+ */
+size_t chunks_uploader_pending(chunks_uploader_t *uploader);
+
+/**
+ * @brief Create a connection pool to share between uploaders
+ *
+ * Uploaders attached to a pool share one connection cache (plus DNS cache
+ * and TLS sessions). Connections are keyed on scheme, host and port, and
+ * the authorization header is sent with each request, so a few persistent
+ * connections per host serve every device and project key on the gateway.
+ *
+ * A pool is for uploaders driven from one thread, such as several uploaders
+ * on one event loop: libcurl does not support using a shared connection
+ * cache from concurrent threads, even with locking. Uploaders on different
+ * threads should each keep their own connections instead.
+ *
+ * @param max_connections Idle connections kept open (0 for the default)
+ *
+ * @return Pool handle, or NULL on failure
+ */
+chunks_pool_t *chunks_pool_create(unsigned int max_connections);
+
+/**
+ * @brief Destroy a pool and close its connections
+ *
+ * @param pool Pool handle
+ *
+ * @return 0 on success, -EBUSY while uploaders are still attached
+ */
+int chunks_pool_destroy(chunks_pool_t *pool);
+
+/**
+ * @brief Attach an uploader to a pool
+ *
+ * @param uploader Uploader handle
+ * @param pool Pool handle, or NULL to go back to a private connection cache
+ *
+ * @return 0 on success, -EBUSY while event-loop uploads are pending,
+ *         negative error code otherwise
+ */
+int chunks_uploader_set_pool(chunks_uploader_t *uploader, chunks_pool_t *pool);
+
+/**
+ * @brief Get pool statistics
+ *
+ * @param pool Pool handle
+ * @param stats Pointer to receive statistics
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int chunks_pool_get_stats(chunks_pool_t *pool, chunks_pool_stats_t *stats);
+
+/**
+ * @brief Persist TLS sessions in a file for fast reconnects
+ *
+ * Session tickets the uploader obtains are written to path (at most every
+ * few seconds, and on destroy) and loaded when the cache is set, so the
+ * first upload after a gateway restart can resume the TLS session with an
+ * abbreviated handshake instead of a full one. Sessions are dropped when
+ * the server's ticket lifetime or max_age_s runs out, whichever is first.
+ * With a pool, sessions are imported into the pool's shared cache.
+ *
+ * Requires libcurl 8.12 or later built with session export support, at
+ * run time: on ELF platforms the library may be built with older headers.
+ *
+ * @param uploader Uploader handle
+ * @param path Cache file (created if needed; should not be world-readable),
+ *             or NULL to stop persisting (the file is written one last time)
+ * @param max_age_s Longest time a session is kept (0 for CHUNKS_TLS_DEFAULT_MAX_AGE_S)
+ *
+ * @return 0 on success, -ENOTSUP if libcurl cannot export sessions,
+ *         -EBUSY while event-loop uploads are pending, negative error code otherwise
+ */
+int chunks_uploader_set_tls_cache(chunks_uploader_t *uploader, const char *path,
+                                  uint32_t max_age_s);
+
+/**
+ * @brief DNS cache statistics
+ */
+typedef struct {
+    /** Uploads given an address resolved less than ttl_s ago */
+    size_t fresh_hits;
+
+    /** Uploads given an expired address while it was being refreshed */
+    size_t stale_hits;
+
+    /** Uploads left to libcurl's resolver because nothing usable was cached */
+    size_t misses;
+
+    /** Lookups completed by the background resolver */
+    size_t lookups;
+
+    /** Background lookups that failed (the previous addresses stay in use) */
+    size_t lookup_failures;
+
+    /** Duration of the last background lookup in microseconds */
+    uint64_t last_lookup_us;
+
+    /** Longest background lookup in microseconds */
+    uint64_t max_lookup_us;
+
+    /** Sum of background lookup durations in microseconds */
+    uint64_t total_lookup_us;
+
+    /** Name lookup time libcurl reported for uploads, summed, in microseconds */
+    uint64_t transfer_lookup_us;
+} chunks_dns_stats_t;
+
+/**
+ * @brief Resolve upload hosts in the background and cache their addresses
+ *
+ * A resolver thread looks hosts up with getaddrinfo() and uploads hand the
+ * cached addresses to libcurl, so a slow or failing resolver no longer
+ * stalls uploads once a host has been resolved. Addresses are used for
+ * ttl_s after a lookup (getaddrinfo() does not report record TTLs), then
+ * for up to max_stale_s more while a refresh runs in the background. A
+ * failed refresh keeps the previous addresses. Uploads to a host with
+ * nothing usable cached are resolved by libcurl as before.
+ *
+ * @param uploader Uploader handle
+ * @param ttl_s Freshness period (CHUNKS_DNS_DEFAULT_TTL_S is a good start),
+ *              or 0 to stop caching
+ * @param max_stale_s How long expired addresses may still be used
+ *                    (0 = never; CHUNKS_DNS_DEFAULT_MAX_STALE_S is a good start)
+ *
+ * @return 0 on success, -EBUSY while event-loop uploads are pending,
+ *         negative error code otherwise
+ */
+int chunks_uploader_set_dns_cache(chunks_uploader_t *uploader, uint32_t ttl_s,
+                                  uint32_t max_stale_s);
+
+/**
+ * @brief Get DNS cache statistics
+ *
+ * All counters are zero while no DNS cache is set.
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int chunks_uploader_get_dns_stats(chunks_uploader_t *uploader, chunks_dns_stats_t *stats);
+
+/**
+ * @brief Recognize authorization strings interned in a config table
+ *
+ * When a session uploads with interned configuration (see
+ * mds_session_set_config()), the uploader maps the authorization pointer
+ * back to its entry and reuses request headers built once per entry,
+ * instead of parsing the string for every chunk. Other strings are handled
+ * as before.
+ *
+ * @param uploader Uploader handle
+ * @param table Config table (must outlive the uploader), or NULL
+ *
+ * @return 0 on success, -EBUSY while event-loop uploads are pending,
+ *         negative error code otherwise
+ */
+int chunks_uploader_set_config_table(chunks_uploader_t *uploader,
+                                     mds_config_table_t *table);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,241 @@
+/**
+ * @file mds_archive.h
+ * @brief Local compressed chunk archive indexed by device and time
+ *
+ * The archive keeps every chunk a gateway saw in time-partitioned segment
+ * files under one directory. Chunks are packed into blocks that are
+ * compressed as a whole (zstd, optionally with a dictionary trained on a
+ * chunk corpus, since single chunks are too small to compress well). Each
+ * segment has a compact index of (device, time range, block) entries, so
+ * range queries only decompress blocks that can contain matching chunks and
+ * read everything else through mmap.
+ *
+ * Usage:
+ * 1. Open: mds_archive_t *archive = mds_archive_open("/var/lib/mds/archive", NULL);
+ * 2. Use as a sink: mds_fanout_add_sink(fanout, mds_archive_callback, archive, 0);
+ * 3. Query: mds_archive_query(archive, "DEVICE123", from_us, to_us, on_chunk, ctx);
+ * 4. Close (flushes the open block): mds_archive_close(archive);
+ *
+ * Without zstd support (see the WITH_ZSTD CMake option) blocks are stored
+ * uncompressed and the dictionary functions return -ENOTSUP.
+ */
+
+#ifndef MDS_BRIDGE_MDS_ARCHIVE_H
+#define MDS_BRIDGE_MDS_ARCHIVE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** Default segment length (one file pair per hour) */
+#define MDS_ARCHIVE_DEFAULT_SEGMENT_SECONDS     3600
+
+/** Default uncompressed block size */
+#define MDS_ARCHIVE_DEFAULT_BLOCK_SIZE          (64 * 1024)
+
+/** Default zstd compression level */
+#define MDS_ARCHIVE_DEFAULT_LEVEL               3
+
+/**
+ * @brief Opaque handle to a chunk archive
+ */
+typedef struct mds_archive mds_archive_t;
+
+/**
+ * @brief Archive configuration
+ *
+ * Zero-valued fields select the defaults.
+ */
+typedef struct {
+    /** Length of each time partition in seconds */
+    uint32_t segment_seconds;
+
+    /** Uncompressed bytes buffered before a block is compressed and written */
+    size_t block_size;
+
+    /** Segments entirely older than this many seconds are deleted (0 = keep all) */
+    uint32_t retention_seconds;
+
+    /** zstd compression level */
+    int compression_level;
+} mds_archive_config_t;
+
+/**
+ * @brief Archive statistics
+ */
+typedef struct {
+    /** Chunks appended */
+    size_t chunks;
+
+    /** Blocks written */
+    size_t blocks;
+
+    /** Uncompressed block bytes written */
+    size_t raw_bytes;
+
+    /** Stored (compressed) block bytes written */
+    size_t stored_bytes;
+
+    /** Segments deleted by retention */
+    size_t segments_expired;
+
+    /** Blocks skipped by queries and backfill because they could not be
+     *  decoded (missing dictionary file, damaged data) */
+    size_t blocks_skipped;
+} mds_archive_stats_t;
+
+/**
+ * @brief Called for each chunk matched by mds_archive_query()
+ *
+ * The device_id and data pointers are only valid during the call.
+ *
+ * @return 0 to continue, non-zero to stop the query
+ */
+typedef int (*mds_archive_chunk_fn)(const char *device_id,
+                                    uint64_t timestamp_us,
+                                    const uint8_t *data,
+                                    size_t len,
+                                    void *user_data);
+
+/**
+ * @brief Open (or create) an archive directory
+ *
+ * @param directory Archive directory (created if missing)
+ * @param config Configuration, or NULL for defaults
+ *
+ * @return Archive handle, or NULL on failure (errno ENAMETOOLONG if the
+ *         directory path leaves no room for segment file names)
+ */
+mds_archive_t *mds_archive_open(const char *directory,
+                                const mds_archive_config_t *config);
+
+/**
+ * @brief Flush the open block and close the archive
+ *
+ * @param archive Archive handle
+ */
+void mds_archive_close(mds_archive_t *archive);
+
+/**
+ * @brief Append one chunk
+ *
+ * @param archive Archive handle
+ * @param device_id Device identifier (at most MDS_MAX_DEVICE_ID_LEN - 1 bytes)
+ * @param timestamp_us Receive time in microseconds since the Unix epoch
+ * @param data Chunk data
+ * @param len Length of chunk data
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_archive_append(mds_archive_t *archive,
+                       const char *device_id,
+                       uint64_t timestamp_us,
+                       const uint8_t *data,
+                       size_t len);
+
+/**
+ * @brief Upload callback that archives chunks
+ *
+ * Can be passed to mds_set_upload_callback() or mds_fanout_add_sink(). The
+ * device identifier is taken from the last path segment of the data URI and
+ * the receive time is the current wall-clock time.
+ *
+ * @param user_data Must be an mds_archive_t* instance
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_archive_callback(const char *uri,
+                         const char *auth_header,
+                         const uint8_t *chunk_data,
+                         size_t chunk_len,
+                         void *user_data);
+
+/**
+ * @brief Compress and write the open block
+ *
+ * Chunks become visible to queries once their block is written.
+ *
+ * @param archive Archive handle
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_archive_flush(mds_archive_t *archive);
+
+/**
+ * @brief Stream chunks for a device and time range
+ *
+ * Chunks are delivered in append order within each segment, segments in
+ * time order. The open block is flushed first. The callback runs without
+ * the archive lock, so appends continue during a long query; chunks
+ * appended meanwhile may or may not be delivered.
+ *
+ * @param archive Archive handle
+ * @param device_id Device identifier, or NULL for all devices
+ * @param from_us Start of range (inclusive), microseconds since the epoch
+ * @param to_us End of range (inclusive), microseconds since the epoch
+ * @param callback Called for each matching chunk
+ * @param user_data Passed to callback
+ *
+ * @return Number of chunks delivered, or negative error code
+ */
+int mds_archive_query(mds_archive_t *archive,
+                      const char *device_id,
+                      uint64_t from_us,
+                      uint64_t to_us,
+                      mds_archive_chunk_fn callback,
+                      void *user_data);
+
+/**
+ * @brief Compress new blocks with a zstd dictionary
+ *
+ * The dictionary is saved in the archive directory under its ID, and blocks
+ * written with it load it from there when read. Blocks written under earlier
+ * dictionaries stay readable after retraining or reopening. The open block
+ * is flushed first.
+ *
+ * @param archive Archive handle
+ * @param dict Dictionary (from mds_archive_train_dictionary() or `zstd --train`)
+ * @param dict_len Dictionary size in bytes
+ *
+ * @return 0 on success, -ENOTSUP without zstd, negative error code otherwise
+ */
+int mds_archive_set_dictionary(mds_archive_t *archive,
+                               const void *dict,
+                               size_t dict_len);
+
+/**
+ * @brief Train a zstd dictionary from sample chunks
+ *
+ * @param samples Concatenated sample chunks
+ * @param sample_sizes Size of each sample
+ * @param sample_count Number of samples
+ * @param dict Buffer receiving the dictionary
+ * @param dict_capacity Size of the dict buffer
+ *
+ * @return Dictionary size on success, -ENOTSUP without zstd,
+ *         negative error code otherwise (e.g. too few samples)
+ */
+int mds_archive_train_dictionary(const void *samples,
+                                 const size_t *sample_sizes,
+                                 unsigned int sample_count,
+                                 void *dict,
+                                 size_t dict_capacity);
+
+/**
+ * @brief Get archive statistics
+ *
+ * @param archive Archive handle
+ * @param stats Pointer to receive statistics
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_archive_get_stats(mds_archive_t *archive, mds_archive_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MDS_BRIDGE_MDS_ARCHIVE_H */
@@ -45,7 +45,10 @@ typedef struct {
      * @param report_id Report ID to read
      * @param buffer Output buffer for report data
      * @param length Maximum bytes to read
-     * @param timeout_ms Timeout in milliseconds (-1 for blocking)
+     * @param timeout_ms Timeout in milliseconds (-1 for blocking). The
+     *                   *_deadline() calls pass their share of the time left
+     *                   for feature reports too; honor it where the
+     *                   transport allows.
      * @return Number of bytes read on success, negative on error
      */
     int (*read)(void *impl_data, uint8_t report_id, uint8_t *buffer,
@@ -0,0 +1,146 @@
+/**
+ * @file mds_backfill.h
+ * @brief Bulk upload of archived chunks after an outage
+ *
+ * Backfill reads a chunk archive (see mds_archive.h) sequentially through
+ * mmap, groups consecutive chunks of each device into multipart batches, and
+ * uploads them over many parallel HTTP/2 streams under a global byte-rate
+ * limit. Progress is checkpointed to a file so an interrupted backfill
+ * resumes where it stopped.
+ *
+ * To leave room for live traffic, set max_bytes_per_sec below the uplink
+ * capacity and keep max_parallel modest; live uploads use their own
+ * connection and are never queued behind backfill requests.
+ *
+ * Usage:
+ *   mds_archive_t *archive = mds_archive_open("/var/lib/mds/archive", NULL);
+ *   mds_backfill_config_t config = {
+ *       .auth_header = "Memfault-Project-Key:YOUR_KEY",
+ *       .max_bytes_per_sec = 256 * 1024,
+ *   };
+ *   mds_backfill_run(archive, &config, NULL, NULL, &stats);
+ */
+
+#ifndef MDS_BRIDGE_MDS_BACKFILL_H
+#define MDS_BRIDGE_MDS_BACKFILL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "mds_bridge/mds_archive.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/** Default URI prefix; the device identifier is appended */
+#define MDS_BACKFILL_DEFAULT_URI_BASE       "https://chunks.memfault.com/api/v0/chunks/"
+
+/** Default number of concurrent requests */
+#define MDS_BACKFILL_DEFAULT_PARALLEL       8
+
+/** Default maximum payload bytes per request */
+#define MDS_BACKFILL_DEFAULT_BATCH_BYTES    (256 * 1024)
+
+/** Default attempts per batch before the backfill stops */
+#define MDS_BACKFILL_DEFAULT_RETRIES        5
+
+/** Upper bound on max_parallel */
+#define MDS_BACKFILL_MAX_PARALLEL           64
+
+/**
+ * @brief Backfill configuration
+ *
+ * Zero-valued fields select the defaults.
+ */
+typedef struct {
+    /** Authorization header ("HeaderName:HeaderValue"), required */
+    const char *auth_header;
+
+    /** URI prefix the device identifier is appended to */
+    const char *uri_base;
+
+    /** Checkpoint file (default: <archive dir>/backfill.checkpoint) */
+    const char *checkpoint_path;
+
+    /** Concurrent requests (1 - MDS_BACKFILL_MAX_PARALLEL) */
+    unsigned int max_parallel;
+
+    /** Maximum chunk bytes per request */
+    size_t max_batch_bytes;
+
+    /** Global upload rate limit in bytes per second (0 = unlimited) */
+    double max_bytes_per_sec;
+
+    /** Attempts per batch on transport errors, 5xx and 429 */
+    unsigned int max_retries;
+
+    /** Per-request timeout in milliseconds (default 30 s) */
+    long timeout_ms;
+
+    /** Print progress and libcurl details */
+    bool verbose;
+} mds_backfill_config_t;
+
+/**
+ * @brief Backfill progress
+ */
+typedef struct {
+    /** Chunks acknowledged by the server */
+    size_t chunks_uploaded;
+
+    /** Chunk bytes acknowledged by the server */
+    size_t bytes_uploaded;
+
+    /** HTTP requests completed (including failed attempts) */
+    size_t requests;
+
+    /** Failed attempts that were retried */
+    size_t retries;
+
+    /** Chunks dropped because the server rejected them (4xx other than 429) */
+    size_t chunks_rejected;
+
+    /** Archive blocks fully uploaded (checkpoint granularity) */
+    size_t blocks_completed;
+
+    /** Wall-clock time spent in mds_backfill_run() */
+    double elapsed_s;
+} mds_backfill_stats_t;
+
+/**
+ * @brief Progress callback, called after each completed request
+ *
+ * @return 0 to continue, non-zero to stop after saving the checkpoint
+ */
+typedef int (*mds_backfill_progress_fn)(const mds_backfill_stats_t *stats,
+                                        void *user_data);
+
+/**
+ * @brief Upload everything in the archive after the saved checkpoint
+ *
+ * Blocks until the archive is drained, the progress callback asks to stop,
+ * or a batch fails max_retries times. The checkpoint always records the
+ * first block that is not fully acknowledged, so chunks are never skipped;
+ * chunks of a partially uploaded block may be sent again on resume.
+ *
+ * @param archive Source archive (load its dictionary first, if any)
+ * @param config Backfill configuration
+ * @param progress Optional progress callback
+ * @param user_data Passed to progress
+ * @param stats Optional pointer to receive final statistics
+ *
+ * @return 0 when drained, -ECANCELED if stopped by the callback,
+ *         -EIO if a batch kept failing, negative error code otherwise
+ */
+int mds_backfill_run(mds_archive_t *archive,
+                     const mds_backfill_config_t *config,
+                     mds_backfill_progress_fn progress,
+                     void *user_data,
+                     mds_backfill_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MDS_BRIDGE_MDS_BACKFILL_H */
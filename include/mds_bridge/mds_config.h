@@ -0,0 +1,166 @@
+/**
+ * @file mds_config.h
+ * @brief Interned, shared device configuration strings
+ *
+ * Most devices of a fleet report the same authorization header, and every
+ * packet hands the data URI and authorization to the upload callback, which
+ * parses them again. A config table stores each distinct string once as an
+ * immutable, reference-counted entry that is parsed when it is interned:
+ * URIs have their origin, host and device split out, authorization strings
+ * have their HTTP header line prebuilt.
+ *
+ * Sessions given a table with mds_session_set_config() hold references to
+ * entries instead of copies and may be passed a NULL config when processing
+ * stream data. The strings they hand to the upload callback are the entries'
+ * own, so a consumer that knows the table (see chunks_uploader_set_config_table())
+ * can map them back to their entry with one pointer lookup and key caches on
+ * the entry id instead of comparing strings.
+ *
+ * Usage:
+ * 1. Create a table: mds_config_table_t *table = mds_config_table_create();
+ * 2. Per session: mds_session_set_config(session, table, &config);
+ * 3. Process: mds_process_stream(session, NULL, 1000, NULL);
+ * 4. Destroy sessions first, then: mds_config_table_destroy(table);
+ */
+
+#ifndef MDS_BRIDGE_MDS_CONFIG_H
+#define MDS_BRIDGE_MDS_CONFIG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "mds_bridge/mds_protocol.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Opaque handle to a config table
+ */
+typedef struct mds_config_table mds_config_table_t;
+
+/**
+ * @brief Kind of an interned string (selects how it is parsed)
+ */
+typedef enum {
+    MDS_CONFIG_URI,             /**< Data URI */
+    MDS_CONFIG_AUTH,            /**< Authorization, "HeaderName:HeaderValue" */
+} mds_config_kind_t;
+
+/**
+ * @brief Interned string and its parsed form (immutable)
+ *
+ * Entries are shared; never modify or free one. An entry stays valid until
+ * its last reference is released.
+ */
+typedef struct {
+    /** Unique for the life of the process; never reused */
+    uint64_t id;
+
+    mds_config_kind_t kind;
+
+    /** The string itself (null-terminated) */
+    const char *str;
+    size_t len;
+
+    /** URI: "scheme://host:port", lowercase, default port filled in ("" if not a URL) */
+    const char *origin;
+
+    /** URI: host name ("" if not a URL) */
+    const char *host;
+
+    /** URI: last path segment, the device serial for Memfault chunk URIs */
+    const char *device;
+
+    /** Authorization: "HeaderName: HeaderValue" (NULL if the string has no ':') */
+    const char *header;
+} mds_config_entry_t;
+
+/**
+ * @brief Create an empty config table
+ *
+ * @return Table handle, or NULL on failure
+ */
+mds_config_table_t *mds_config_table_create(void);
+
+/**
+ * @brief Destroy a config table
+ *
+ * @param table Table handle
+ *
+ * @return 0 on success, -EBUSY while entries are still referenced
+ *         (e.g. by sessions that were not destroyed)
+ */
+int mds_config_table_destroy(mds_config_table_t *table);
+
+/**
+ * @brief Intern a string
+ *
+ * Returns the existing entry for (kind, str) with its reference count
+ * raised, or parses and adds a new one. Thread-safe.
+ *
+ * @param table Table handle
+ * @param kind How str is parsed
+ * @param str String to intern
+ *
+ * @return Entry, or NULL on failure; release it with mds_config_release()
+ */
+const mds_config_entry_t *mds_config_intern(mds_config_table_t *table,
+                                            mds_config_kind_t kind,
+                                            const char *str);
+
+/**
+ * @brief Drop a reference taken by mds_config_intern()
+ *
+ * The entry is freed with its last reference. NULL is ignored.
+ *
+ * @param table Table the entry belongs to
+ * @param entry Entry to release
+ */
+void mds_config_release(mds_config_table_t *table, const mds_config_entry_t *entry);
+
+/**
+ * @brief Map a string pointer back to its entry
+ *
+ * Looks up the pointer itself, not the string contents, so only the str
+ * pointers of live entries match. No reference is taken: the result is
+ * valid as long as the caller's pointer is (e.g. for the duration of an
+ * upload callback).
+ *
+ * @param table Table handle
+ * @param str Pointer to test
+ *
+ * @return Entry whose str is exactly this pointer, or NULL
+ */
+const mds_config_entry_t *mds_config_find(mds_config_table_t *table, const char *str);
+
+/**
+ * @brief Number of live entries
+ */
+size_t mds_config_table_count(mds_config_table_t *table);
+
+/**
+ * @brief Give a session interned copies of a device configuration
+ *
+ * The data URI and authorization are interned in table and the session
+ * holds references to them, replacing any it held before. Afterwards a NULL
+ * config may be passed to mds_process_stream(), mds_process_stream_from_bytes()
+ * and mds_process_stream_batch(), and the upload callback receives the
+ * entries' strings. The references are released by mds_session_destroy() or
+ * by passing a NULL table.
+ *
+ * @param session MDS session handle
+ * @param table Config table, or NULL to drop the session's entries
+ * @param config Device configuration to intern (ignored if table is NULL)
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_session_set_config(mds_session_t *session,
+                           mds_config_table_t *table,
+                           const mds_device_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MDS_BRIDGE_MDS_CONFIG_H */
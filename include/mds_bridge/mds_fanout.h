@@ -0,0 +1,156 @@
+/**
+ * @file mds_fanout.h
+ * @brief Fan-out stage delivering each chunk to several sinks
+ *
+ * A fan-out stage is itself an upload callback. Each chunk it receives is
+ * stored once in a reference-counted buffer and queued to every registered
+ * sink. Each sink has its own queue and worker thread, so a slow or failing
+ * sink (e.g. a local archive) never delays the others (e.g. cloud upload),
+ * and the payload is never copied per sink.
+ *
+ * Usage:
+ * 1. Create the stage: mds_fanout_t *fanout = mds_fanout_create();
+ * 2. Add sinks: mds_fanout_add_sink(fanout, chunks_uploader_callback, uploader, 0);
+ * 3. Set it on the session: mds_set_upload_callback(session, mds_fanout_callback, fanout);
+ * 4. Destroy when done (drains all queues): mds_fanout_destroy(fanout);
+ */
+
+#ifndef MDS_BRIDGE_MDS_FANOUT_H
+#define MDS_BRIDGE_MDS_FANOUT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "mds_bridge/mds_protocol.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/** Maximum number of sinks per fan-out stage */
+#define MDS_FANOUT_MAX_SINKS        8
+
+/** Queue depth used when mds_fanout_add_sink() is passed 0 */
+#define MDS_FANOUT_DEFAULT_DEPTH    64
+
+/**
+ * @brief Opaque handle to a fan-out stage
+ */
+typedef struct mds_fanout mds_fanout_t;
+
+/**
+ * @brief Per-sink delivery statistics
+ */
+typedef struct {
+    /** Chunks the sink callback accepted (returned 0) */
+    size_t delivered;
+
+    /** Chunks the sink callback rejected */
+    size_t failed;
+
+    /** Chunks dropped because the sink's queue was full */
+    size_t dropped;
+
+    /** Payload bytes delivered */
+    size_t bytes_delivered;
+
+    /** Chunks currently queued (excluding one in delivery) */
+    size_t queued;
+
+    /** Highest queue occupancy observed */
+    size_t max_queued;
+
+    /** Last negative error returned by the sink callback (0 if none) */
+    int last_error;
+} mds_fanout_sink_stats_t;
+
+/**
+ * @brief Create a fan-out stage with no sinks
+ *
+ * @return Fan-out handle, or NULL on failure
+ */
+mds_fanout_t *mds_fanout_create(void);
+
+/**
+ * @brief Destroy a fan-out stage
+ *
+ * Delivers everything still queued, stops the sink threads and frees all
+ * resources. The stage must no longer be registered as an upload callback.
+ *
+ * @param fanout Fan-out handle
+ */
+void mds_fanout_destroy(mds_fanout_t *fanout);
+
+/**
+ * @brief Add a sink
+ *
+ * Starts a worker thread that calls callback for each chunk, in order. The
+ * data, uri and auth_header pointers passed to the callback are shared with
+ * the other sinks and only valid for the duration of the call.
+ *
+ * Sinks must be added before the first chunk is delivered.
+ *
+ * @param fanout Fan-out handle
+ * @param callback Sink callback (e.g. chunks_uploader_callback)
+ * @param user_data Passed to callback
+ * @param queue_depth Maximum queued chunks (0 = MDS_FANOUT_DEFAULT_DEPTH)
+ *
+ * @return Sink index (>= 0) on success, -EBUSY if chunks were already
+ *         delivered, -ENOSPC if MDS_FANOUT_MAX_SINKS sinks exist,
+ *         negative error code otherwise
+ */
+int mds_fanout_add_sink(mds_fanout_t *fanout,
+                        mds_chunk_upload_callback_t callback,
+                        void *user_data,
+                        size_t queue_depth);
+
+/**
+ * @brief Upload callback for use with mds_set_upload_callback()
+ *
+ * Queues the chunk to every sink without blocking. A sink whose queue is
+ * full drops the chunk and counts it in its stats; the other sinks are
+ * unaffected.
+ *
+ * @param uri Data URI
+ * @param auth_header Authorization header
+ * @param chunk_data Chunk data bytes
+ * @param chunk_len Length of chunk data
+ * @param user_data Must be an mds_fanout_t* instance
+ *
+ * @return 0 if at least one sink queued the chunk, -ENOSPC if every sink
+ *         dropped it, negative error code otherwise
+ */
+int mds_fanout_callback(const char *uri,
+                        const char *auth_header,
+                        const uint8_t *chunk_data,
+                        size_t chunk_len,
+                        void *user_data);
+
+/**
+ * @brief Wait until every sink has drained its queue
+ *
+ * @param fanout Fan-out handle
+ * @param timeout_ms Maximum time to wait (negative waits forever)
+ *
+ * @return 0 when all queues are empty, -ETIMEDOUT on timeout,
+ *         negative error code otherwise
+ */
+int mds_fanout_flush(mds_fanout_t *fanout, int timeout_ms);
+
+/**
+ * @brief Get delivery statistics for one sink
+ *
+ * @param fanout Fan-out handle
+ * @param sink Sink index returned by mds_fanout_add_sink()
+ * @param stats Pointer to receive statistics
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_fanout_get_sink_stats(mds_fanout_t *fanout,
+                              int sink,
+                              mds_fanout_sink_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MDS_BRIDGE_MDS_FANOUT_H */
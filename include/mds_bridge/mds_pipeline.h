@@ -0,0 +1,262 @@
+/**
+ * @file mds_pipeline.h
+ * @brief Ordered chain of processing stages between sessions and outputs
+ *
+ * A pipeline is an upload callback that passes each chunk through a list of
+ * stages. A stage takes a batch of chunks and emits a batch into an output
+ * buffer that the pipeline allocates when the stage is added, and the
+ * emitted batch goes to the next stage. Built-in stages filter, batch,
+ * rate-limit, tee to an upload callback and hand chunks to a sink; other
+ * stages implement mds_stage_ops_t.
+ *
+ * One pipeline can serve one session or be shared by several: stages run
+ * on the submitting thread under the pipeline lock, so they need no locking
+ * of their own. Every stage keeps its own statistics, including time spent
+ * in it, so a stage can be measured on its own (see test/bench_pipeline.c).
+ *
+ * Usage:
+ * 1. Create: mds_pipeline_t *pipeline = mds_pipeline_create();
+ * 2. Add stages in order: mds_pipeline_add_filter(...), mds_pipeline_add_sink(pipeline, sink);
+ * 3. Set it on the session: mds_set_upload_callback(session, mds_pipeline_callback, pipeline);
+ * 4. Call mds_pipeline_poll() from time to time (emits batches that are due)
+ * 5. Destroy when done (flushes): mds_pipeline_destroy(pipeline);
+ */
+
+#ifndef MDS_BRIDGE_MDS_PIPELINE_H
+#define MDS_BRIDGE_MDS_PIPELINE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "mds_bridge/mds_protocol.h"
+#include "mds_bridge/mds_sink.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/** Maximum number of stages per pipeline */
+#define MDS_PIPELINE_MAX_STAGES     16
+
+/** Largest batch passed between stages */
+#define MDS_PIPELINE_MAX_BATCH      MDS_SINK_MAX_BATCH
+
+/**
+ * @brief Opaque handle to a pipeline
+ */
+typedef struct mds_pipeline mds_pipeline_t;
+
+/**
+ * @brief Batch emitted by a stage
+ *
+ * chunks points to a buffer of capacity entries owned by the pipeline. The
+ * chunks a stage emits may point into its input or into its own storage;
+ * either must stay valid until the stage is called again.
+ */
+typedef struct {
+    mds_sink_chunk_t *chunks;
+    size_t count;
+    size_t capacity;
+
+    /** Set by the stage when chunks it consumed could not be delivered */
+    int error;
+} mds_stage_output_t;
+
+/**
+ * @brief Operations implemented by a stage
+ */
+typedef struct {
+    /** Stage name, for diagnostics */
+    const char *name;
+
+    /**
+     * Process chunks in order
+     *
+     * Appends any chunks to pass on to out and returns how many input
+     * chunks were consumed (at least one). The pipeline runs the next stage
+     * on out and then calls again with the rest of the input. Returns a
+     * negative error code if none could be consumed.
+     */
+    int (*process)(void *impl, const mds_sink_chunk_t *in, size_t count,
+                   mds_stage_output_t *out);
+
+    /** Emit held chunks that are due (optional) */
+    int (*poll)(void *impl, mds_stage_output_t *out);
+
+    /** Emit everything held and make delivered chunks durable (optional) */
+    int (*flush)(void *impl, mds_stage_output_t *out);
+
+    /** Release the stage (optional) */
+    void (*destroy)(void *impl);
+} mds_stage_ops_t;
+
+/**
+ * @brief Per-stage statistics
+ */
+typedef struct {
+    /** Chunks the stage consumed */
+    size_t chunks_in;
+
+    /** Chunks the stage emitted */
+    size_t chunks_out;
+
+    /** Chunks the stage refused with an error; they did not go on */
+    size_t chunks_refused;
+
+    /** Calls into the stage (process, poll and flush) */
+    size_t calls;
+
+    /** Time spent inside the stage, excluding the stages after it */
+    uint64_t busy_ns;
+
+    /** Last negative error reported by the stage (0 if none) */
+    int last_error;
+} mds_pipeline_stage_stats_t;
+
+/**
+ * @brief Decides whether a chunk passes a filter stage
+ */
+typedef bool (*mds_stage_filter_fn)(const mds_sink_chunk_t *chunk, void *user_data);
+
+/**
+ * @brief Create a pipeline with no stages
+ *
+ * A pipeline without stages accepts and discards every chunk.
+ *
+ * @return Pipeline handle, or NULL on failure
+ */
+mds_pipeline_t *mds_pipeline_create(void);
+
+/**
+ * @brief Flush and destroy a pipeline and its stages
+ *
+ * The pipeline must no longer be registered as an upload callback.
+ *
+ * @param pipeline Pipeline handle
+ */
+void mds_pipeline_destroy(mds_pipeline_t *pipeline);
+
+/**
+ * @brief Append a stage
+ *
+ * @param ops Stage operations (must outlive the pipeline)
+ * @param impl Stage state passed to every operation; released with
+ *             ops->destroy by mds_pipeline_destroy()
+ *
+ * @return Stage index (>= 0) on success, -ENOSPC if MDS_PIPELINE_MAX_STAGES
+ *         stages exist (impl is not destroyed), negative error code otherwise
+ */
+int mds_pipeline_add_stage(mds_pipeline_t *pipeline, const mds_stage_ops_t *ops, void *impl);
+
+/**
+ * @brief Append a stage passing only chunks for which filter returns true
+ *
+ * @return Stage index, or negative error code
+ */
+int mds_pipeline_add_filter(mds_pipeline_t *pipeline, mds_stage_filter_fn filter,
+                            void *user_data);
+
+/**
+ * @brief Append a stage collecting chunks into batches of max_batch
+ *
+ * Chunks are copied into a buffer reused from batch to batch. A partial
+ * batch is emitted by mds_pipeline_poll() once its oldest chunk waited
+ * max_delay_ms (0 = only on flush).
+ *
+ * @param max_batch Chunks per batch (0 = MDS_SINK_DEFAULT_BATCH, capped at
+ *                  MDS_PIPELINE_MAX_BATCH)
+ *
+ * @return Stage index, or negative error code
+ */
+int mds_pipeline_add_batch(mds_pipeline_t *pipeline, size_t max_batch, uint32_t max_delay_ms);
+
+/**
+ * @brief Append a stage limiting payload throughput with a token bucket
+ *
+ * Chunks that would exceed bytes_per_s (with bursts up to burst_bytes) are
+ * copied and held, in order, and passed on by mds_pipeline_poll() once the
+ * bucket has refilled; flushing passes on everything held. A chunk larger
+ * than the bucket goes when the bucket is full. When MDS_PIPELINE_MAX_BATCH
+ * chunks are held, further chunks are refused with -ENOBUFS (counted in
+ * chunks_refused) until some have gone out.
+ *
+ * @param burst_bytes Bucket size (0 = bytes_per_s)
+ *
+ * @return Stage index, or negative error code
+ */
+int mds_pipeline_add_rate_limit(mds_pipeline_t *pipeline, uint32_t bytes_per_s,
+                                uint32_t burst_bytes);
+
+/**
+ * @brief Append a stage calling an upload callback for each chunk
+ *
+ * The chunks are passed on unchanged, so a tee can sit anywhere in the
+ * chain (e.g. chunks_uploader_callback, mds_fanout_callback).
+ *
+ * @return Stage index, or negative error code
+ */
+int mds_pipeline_add_tee(mds_pipeline_t *pipeline, mds_chunk_upload_callback_t callback,
+                         void *user_data);
+
+/**
+ * @brief Append a stage handing each batch to a sink
+ *
+ * The chunks are also passed on. Flushing the pipeline flushes the sink,
+ * and polling the pipeline polls it. The sink is not owned.
+ *
+ * @return Stage index, or negative error code
+ */
+int mds_pipeline_add_sink(mds_pipeline_t *pipeline, mds_sink_t *sink);
+
+/**
+ * @brief Run a batch of chunks through the pipeline
+ *
+ * The chunks' sequence and received_us are kept as given.
+ *
+ * @return 0 on success, otherwise the first error a stage reported
+ *         (processing continues past it)
+ */
+int mds_pipeline_submit_batch(mds_pipeline_t *pipeline, const mds_sink_chunk_t *chunks,
+                              size_t count);
+
+/**
+ * @brief Emit held chunks that are due and poll sinks
+ *
+ * @return 0 on success, otherwise the first error a stage reported
+ */
+int mds_pipeline_poll(mds_pipeline_t *pipeline);
+
+/**
+ * @brief Emit everything held, stage by stage, and flush sinks
+ *
+ * @return 0 on success, otherwise the first error a stage reported
+ */
+int mds_pipeline_flush(mds_pipeline_t *pipeline);
+
+/**
+ * @brief Get statistics for one stage
+ *
+ * @param stage Stage index returned when the stage was added
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_pipeline_get_stage_stats(mds_pipeline_t *pipeline, int stage,
+                                 mds_pipeline_stage_stats_t *stats);
+
+/**
+ * @brief Upload callback for use with mds_set_upload_callback() or a fan-out
+ *
+ * Runs the chunk through the pipeline as a batch of one.
+ *
+ * @param user_data Must be an mds_pipeline_t* instance
+ *
+ * @return Same as mds_pipeline_submit_batch()
+ */
+int mds_pipeline_callback(const char *uri, const char *auth_header,
+                          const uint8_t *chunk_data, size_t chunk_len, void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MDS_BRIDGE_MDS_PIPELINE_H */
@@ -27,6 +27,7 @@ extern "C" {
 #include <stddef.h>
 #include <stdbool.h>
 #include <wchar.h>
+#include <stdio.h>
 
 /* Backend interface - include the backend header */
 #include "mds_backend.h"
@@ -35,7 +36,7 @@ extern "C" {
  * Report ID Definitions
  * ========================================================================== */
 
-/** Feature Report: Supported features bitmask (currently 0x00) */
+/** Feature Report: Supported features bitmask (MDS_FEATURE_*) */
 #define MDS_REPORT_ID_SUPPORTED_FEATURES    0x01
 
 /** Feature Report: Device identifier string */
@@ -53,6 +54,28 @@ extern "C" {
 /** Input Report: Stream data packets (chunk data) */
 #define MDS_REPORT_ID_STREAM_DATA           0x06
 
+/** Feature Report: Combined configuration (TLV, see MDS_FEATURE_CONFIG_REPORT) */
+#define MDS_REPORT_ID_CONFIG                0x07
+
+/* ============================================================================
+ * Supported Features
+ * ========================================================================== */
+
+/**
+ * Device answers MDS_REPORT_ID_CONFIG with features, identifier, URI and
+ * authorization in one report. Each field is a tag byte (MDS_CONFIG_TAG_*),
+ * a length byte and the value; a zero tag ends the list, unknown tags are
+ * skipped.
+ */
+#define MDS_FEATURE_CONFIG_REPORT           (1u << 0)
+
+/** Combined configuration report tags (the same as the single reports' IDs) */
+#define MDS_CONFIG_TAG_END                  0x00
+#define MDS_CONFIG_TAG_SUPPORTED_FEATURES   0x01
+#define MDS_CONFIG_TAG_DEVICE_IDENTIFIER    0x02
+#define MDS_CONFIG_TAG_DATA_URI             0x03
+#define MDS_CONFIG_TAG_AUTHORIZATION        0x04
+
 /* ============================================================================
  * Constants
  * ========================================================================== */
@@ -69,6 +92,9 @@ extern "C" {
 /** Maximum chunk data per packet (after sequence byte) */
 #define MDS_MAX_CHUNK_DATA_LEN              63
 
+/** Maximum combined configuration report length (after report ID) */
+#define MDS_MAX_CONFIG_REPORT_LEN           255
+
 /* ============================================================================
  * Stream Control Modes
  * ========================================================================== */
@@ -100,7 +126,7 @@ extern "C" {
  * used for diagnostic data upload.
  */
 typedef struct {
-    /** Supported features bitmask (currently always 0x00) */
+    /** Supported features bitmask (MDS_FEATURE_*) */
     uint32_t supported_features;
 
     /** Device identifier (null-terminated string) */
@@ -239,6 +265,25 @@ int mds_session_create_hid_path(const char *path,
  */
 void mds_session_destroy(mds_session_t *session);
 
+/* ============================================================================
+ * Deadlines
+ * ========================================================================== */
+
+/** Deadline that never expires: the call blocks like its plain variant */
+#define MDS_DEADLINE_NONE   0
+
+/**
+ * @brief Absolute deadline timeout_ms from now
+ *
+ * Deadlines are milliseconds on the monotonic clock, so one deadline can be
+ * handed to several calls to bound all of them together.
+ *
+ * @param timeout_ms Time from now
+ *
+ * @return Deadline for the *_deadline() calls (never MDS_DEADLINE_NONE)
+ */
+uint64_t mds_deadline_after(uint32_t timeout_ms);
+
 /* ============================================================================
  * Device Configuration
  * ========================================================================== */
@@ -249,6 +294,12 @@ void mds_session_destroy(mds_session_t *session);
  * Reads the supported features, device identifier, data URI, and
  * authorization header from the device using feature reports.
  *
+ * Tries the combined configuration report first, which takes one
+ * transfer. If the device does not answer it with a complete report that
+ * advertises MDS_FEATURE_CONFIG_REPORT, the four single reports are read
+ * instead, and the session keeps using them unless supported_features
+ * advertises the combined report.
+ *
  * @param session MDS session handle
  * @param config Pointer to receive device configuration
  *
@@ -257,6 +308,21 @@ void mds_session_destroy(mds_session_t *session);
 int mds_read_device_config(mds_session_t *session,
                            mds_device_config_t *config);
 
+/**
+ * @brief Parse a combined configuration report (MDS_REPORT_ID_CONFIG)
+ *
+ * For sessions that do their own I/O. Strings longer than the config
+ * fields are truncated.
+ *
+ * @param data Report data (after the report ID)
+ * @param len Length of data
+ * @param config Receives the configuration; unchanged on failure
+ *
+ * @return 0 on success, -EINVAL if the report is malformed or lacks a field
+ */
+int mds_parse_config_report(const uint8_t *data, size_t len,
+                            mds_device_config_t *config);
+
 /**
  * @brief Get supported features
  *
@@ -307,6 +373,81 @@ int mds_get_authorization(mds_session_t *session,
                          char *auth,
                          size_t max_len);
 
+/**
+ * @brief Read device configuration, giving up at a deadline
+ *
+ * Like mds_read_device_config(), but each backend read gets the time left
+ * until the deadline as its timeout. The optional combined report only gets
+ * a fifth of it, so if it stalls there is still time to fall back to the
+ * single reports. A read that times out before the deadline returns the
+ * backend's error, not -ETIME.
+ *
+ * A backend that cannot interrupt a transfer (hidapi feature reports) is
+ * only checked between transfers, so the call can overrun the deadline by
+ * at most one transfer.
+ *
+ * @param session MDS session handle
+ * @param config Pointer to receive device configuration
+ * @param deadline_ms Deadline from mds_deadline_after() (MDS_DEADLINE_NONE = none)
+ *
+ * @return 0 on success, -ETIME if the deadline passed,
+ *         negative error code otherwise
+ */
+int mds_read_device_config_deadline(mds_session_t *session,
+                                    mds_device_config_t *config,
+                                    uint64_t deadline_ms);
+
+/**
+ * @brief Get supported features, giving up at a deadline
+ *
+ * @return 0 on success, -ETIME if the deadline passed,
+ *         negative error code otherwise
+ *
+ * @see mds_get_supported_features(), mds_read_device_config_deadline()
+ */
+int mds_get_supported_features_deadline(mds_session_t *session,
+                                        uint32_t *features,
+                                        uint64_t deadline_ms);
+
+/**
+ * @brief Get device identifier, giving up at a deadline
+ *
+ * @return 0 on success, -ETIME if the deadline passed,
+ *         negative error code otherwise
+ *
+ * @see mds_get_device_identifier(), mds_read_device_config_deadline()
+ */
+int mds_get_device_identifier_deadline(mds_session_t *session,
+                                       char *device_id,
+                                       size_t max_len,
+                                       uint64_t deadline_ms);
+
+/**
+ * @brief Get data URI, giving up at a deadline
+ *
+ * @return 0 on success, -ETIME if the deadline passed,
+ *         negative error code otherwise
+ *
+ * @see mds_get_data_uri(), mds_read_device_config_deadline()
+ */
+int mds_get_data_uri_deadline(mds_session_t *session,
+                              char *uri,
+                              size_t max_len,
+                              uint64_t deadline_ms);
+
+/**
+ * @brief Get authorization header, giving up at a deadline
+ *
+ * @return 0 on success, -ETIME if the deadline passed,
+ *         negative error code otherwise
+ *
+ * @see mds_get_authorization(), mds_read_device_config_deadline()
+ */
+int mds_get_authorization_deadline(mds_session_t *session,
+                                   char *auth,
+                                   size_t max_len,
+                                   uint64_t deadline_ms);
+
 /* ============================================================================
  * Stream Control
  * ========================================================================== */
@@ -334,6 +475,30 @@ int mds_stream_enable(mds_session_t *session);
  */
 int mds_stream_disable(mds_session_t *session);
 
+/**
+ * @brief Enable streaming unless a deadline has passed
+ *
+ * Backend writes take no timeout, so the deadline is checked before the
+ * stream control report is sent; a write that was sent is not undone.
+ *
+ * @param session MDS session handle
+ * @param deadline_ms Deadline from mds_deadline_after() (MDS_DEADLINE_NONE = none)
+ *
+ * @return 0 on success, -ETIME if the deadline passed,
+ *         negative error code otherwise
+ */
+int mds_stream_enable_deadline(mds_session_t *session, uint64_t deadline_ms);
+
+/**
+ * @brief Disable streaming unless a deadline has passed
+ *
+ * @return 0 on success, -ETIME if the deadline passed,
+ *         negative error code otherwise
+ *
+ * @see mds_stream_enable_deadline()
+ */
+int mds_stream_disable_deadline(mds_session_t *session, uint64_t deadline_ms);
+
 /* ============================================================================
  * Stream Data Reception
  * ========================================================================== */
@@ -369,7 +534,9 @@ int mds_stream_read_packet(mds_session_t *session,
  * Use this when you receive HID reports via callbacks or event loops.
  *
  * @param session MDS session handle
- * @param config Device configuration (contains URI and auth for upload callback)
+ * @param config Device configuration (contains URI and auth for upload callback),
+ *               or NULL to use the session's interned configuration
+ *               (see mds_session_set_config() in mds_config.h)
  * @param buffer Buffer containing stream packet (sequence byte + data)
  * @param buffer_len Length of buffer
  * @param packet Optional pointer to receive parsed packet (NULL to skip)
@@ -399,6 +566,52 @@ int mds_process_stream_from_bytes(mds_session_t *session,
                                    size_t buffer_len,
                                    mds_stream_packet_t *packet);
 
+/**
+ * @brief Process a batch of stream packets from a contiguous byte buffer
+ *
+ * Batch variant of mds_process_stream_from_bytes() for event-driven I/O that
+ * has accumulated several reports. Records are laid out back to back in
+ * buffer, and record_lens[i] holds the length of record i (sequence byte +
+ * data, no report ID). Each record is parsed, sequence-checked and uploaded
+ * in order, exactly as if passed to mds_process_stream_from_bytes() one at a
+ * time, but with a single call across the FFI boundary.
+ *
+ * Processing stops at the first record that fails to parse or whose upload
+ * callback returns an error. The lengths are checked against buffer_len
+ * first: if the records would run past the buffer, nothing is processed.
+ *
+ * @param session MDS session handle
+ * @param config Device configuration (contains URI and auth for upload callback),
+ *               or NULL to use the session's interned configuration
+ *               (see mds_session_set_config() in mds_config.h)
+ * @param buffer Buffer containing the concatenated records
+ * @param buffer_len Size of buffer in bytes
+ * @param record_lens Array of record_count record lengths
+ * @param record_count Number of records in buffer
+ * @param processed Optional pointer to receive the number of records
+ *                  processed successfully (NULL to skip)
+ *
+ * @return 0 on success, negative error code otherwise
+ *         Returns -EINVAL if the record lengths add up to more than buffer_len
+ *         Returns upload callback error code if an upload fails
+ *
+ * Example:
+ * @code
+ * // Two reports received since the last poll
+ * uint8_t buf[] = { 0x00, 'a', 'b', 0x01, 'c' };
+ * size_t lens[] = { 3, 2 };
+ * size_t done = 0;
+ * int ret = mds_process_stream_batch(session, &config, buf, sizeof(buf), lens, 2, &done);
+ * @endcode
+ */
+int mds_process_stream_batch(mds_session_t *session,
+                              const mds_device_config_t *config,
+                              const uint8_t *buffer,
+                              size_t buffer_len,
+                              const size_t *record_lens,
+                              size_t record_count,
+                              size_t *processed);
+
 /* ============================================================================
  * Chunk Upload
  * ========================================================================== */
@@ -434,7 +647,9 @@ int mds_set_upload_callback(mds_session_t *session,
  * after enabling streaming.
  *
  * @param session MDS session handle
- * @param config Device configuration (contains URI and auth for upload callback)
+ * @param config Device configuration (contains URI and auth for upload callback),
+ *               or NULL to use the session's interned configuration
+ *               (see mds_session_set_config() in mds_config.h)
  * @param timeout_ms Timeout in milliseconds for reading packets
  * @param packet Optional pointer to receive parsed packet (NULL to skip)
  *
@@ -461,6 +676,195 @@ int mds_process_stream(mds_session_t *session,
                        int timeout_ms,
                        mds_stream_packet_t *packet);
 
+/* ============================================================================
+ * Background Reader (Event Loop Integration)
+ * ========================================================================== */
+
+/**
+ * @brief Background reader statistics
+ */
+typedef struct {
+    size_t queued;      /**< Records waiting for mds_process_pending() */
+    size_t capacity;    /**< Ring capacity in records */
+    size_t overflows;   /**< Records dropped because the ring was full */
+    int last_error;     /**< Pending backend read error (0 if none) */
+} mds_reader_stats_t;
+
+/**
+ * @brief Start the background stream reader
+ *
+ * Spawns a thread that reads stream data from the backend and queues the raw
+ * records. Once started, mds_session_get_poll_fd() returns a descriptor that
+ * becomes readable whenever records are pending, so the session can be
+ * registered with poll()/epoll/kqueue or an asyncio loop instead of blocking
+ * in mds_process_stream().
+ *
+ * Control calls (config reads, stream enable/disable) remain usable while the
+ * reader runs and do not wait for its stream reads, so the backend must
+ * allow a stream read and a feature report transfer at the same time (HID
+ * does). mds_stream_read_packet() and mds_process_stream() return -EBUSY.
+ *
+ * @param session MDS session handle (must have a backend)
+ * @param queue_depth Ring capacity in records (0 for the default of 256).
+ *                    When full, newly read records are dropped and counted.
+ *
+ * @return 0 on success, negative error code otherwise
+ *         -EALREADY if the reader is already running
+ */
+int mds_session_start_reader(mds_session_t *session, size_t queue_depth);
+
+/**
+ * @brief Stop the background stream reader
+ *
+ * Joins the reader thread, discards queued records and closes the poll fd.
+ * Called automatically by mds_session_destroy().
+ *
+ * @param session MDS session handle
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_session_stop_reader(mds_session_t *session);
+
+/**
+ * @brief Get the readiness descriptor of the background reader
+ *
+ * The descriptor is non-blocking and level-triggered: it stays readable
+ * until mds_process_pending() has drained every queued record. Do not read
+ * from or close it.
+ *
+ * @param session MDS session handle
+ *
+ * @return File descriptor on success, negative error code otherwise
+ *         -ENOTCONN if the reader is not running
+ */
+int mds_session_get_poll_fd(mds_session_t *session);
+
+/**
+ * @brief Get background reader statistics
+ *
+ * @param session MDS session handle
+ * @param stats Pointer to receive the statistics
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_session_get_reader_stats(mds_session_t *session,
+                                 mds_reader_stats_t *stats);
+
+/**
+ * @brief Process every record queued by the background reader
+ *
+ * Drains the reader queue, running each record through the same parse,
+ * sequence check and upload path as mds_process_stream_from_bytes(). Unlike
+ * mds_process_stream_batch(), an upload failure does not stop the drain;
+ * per-record results are reported through upload_results.
+ *
+ * @param session MDS session handle
+ * @param config Device configuration (contains URI and auth for upload callback),
+ *               or NULL to use the session's interned configuration
+ *               (see mds_session_set_config() in mds_config.h)
+ * @param packets Optional array to receive parsed packets (NULL to skip)
+ * @param upload_results Optional array to receive each record's upload
+ *                       result (NULL to skip)
+ * @param max_packets Capacity of packets/upload_results. Ignored when both
+ *                    are NULL, in which case the whole queue is drained.
+ * @param count Pointer to receive the number of records processed
+ *
+ * @return 0 on success, negative error code otherwise
+ *         Returns the reader's backend error (e.g. device removed) once the
+ *         queue is empty, so the host can tear the session down
+ *
+ * Example:
+ * @code
+ * mds_session_start_reader(session, 0);
+ * struct pollfd pfd = { .fd = mds_session_get_poll_fd(session), .events = POLLIN };
+ * while (poll(&pfd, 1, -1) > 0) {
+ *     size_t n;
+ *     if (mds_process_pending(session, &config, NULL, NULL, 0, &n) < 0) {
+ *         break;
+ *     }
+ * }
+ * @endcode
+ */
+int mds_process_pending(mds_session_t *session,
+                        const mds_device_config_t *config,
+                        mds_stream_packet_t *packets,
+                        int *upload_results,
+                        size_t max_packets,
+                        size_t *count);
+
+/* ============================================================================
+ * Time-Series Recorder
+ * ========================================================================== */
+
+/**
+ * @brief One second of stream activity
+ */
+typedef struct {
+    uint64_t timestamp;             /**< Wall-clock second (Unix time) */
+    uint32_t packets;               /**< Stream packets received */
+    uint32_t bytes;                 /**< Payload bytes received */
+    uint32_t gaps;                  /**< Sequence discontinuities */
+    uint32_t max_interarrival_us;   /**< Longest gap between two packets */
+    uint32_t read_stall_us;         /**< Time blocked in reads that returned no data */
+} mds_timeseries_bucket_t;
+
+/**
+ * @brief Enable the per-second time-series recorder
+ *
+ * Keeps a fixed-memory ring of the most recent num_buckets seconds of
+ * stream activity. Packets are recorded where they enter the session:
+ * mds_stream_read_packet()/mds_process_stream(), the background reader, or
+ * mds_process_stream_from_bytes()/mds_process_stream_batch(). Seconds with
+ * no activity appear as zero buckets, so throughput dips stay visible.
+ *
+ * Calling again resets the recorder; num_buckets of 0 disables it.
+ *
+ * @param session MDS session handle
+ * @param num_buckets Seconds of history to keep (e.g. 3600 for one hour)
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_session_enable_timeseries(mds_session_t *session, size_t num_buckets);
+
+/**
+ * @brief Copy the recorded time series, oldest bucket first
+ *
+ * @param session MDS session handle
+ * @param buckets Array to receive the buckets
+ * @param max_buckets Capacity of buckets
+ * @param count Pointer to receive the number of buckets copied
+ *
+ * @return 0 on success, negative error code otherwise
+ *         -ENODATA if the recorder is not enabled
+ */
+int mds_session_get_timeseries(mds_session_t *session,
+                               mds_timeseries_bucket_t *buckets,
+                               size_t max_buckets,
+                               size_t *count);
+
+/**
+ * @brief Write the recorded time series as CSV
+ *
+ * Columns: timestamp,packets,bytes,gaps,max_interarrival_us,read_stall_us
+ *
+ * @param session MDS session handle
+ * @param fp Output stream
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_timeseries_dump_csv(mds_session_t *session, FILE *fp);
+
+/**
+ * @brief Write the recorded time series as a JSON array of objects
+ *
+ * Keys match the CSV column names.
+ *
+ * @param session MDS session handle
+ * @param fp Output stream
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_timeseries_dump_json(mds_session_t *session, FILE *fp);
 
 #ifdef __cplusplus
 }
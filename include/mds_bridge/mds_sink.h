@@ -0,0 +1,362 @@
+/**
+ * @file mds_sink.h
+ * @brief Pluggable chunk outputs sharing one batching and queueing core
+ *
+ * A sink delivers chunks to one output. The output only implements a small
+ * set of operations (mds_sink_ops_t); the sink wraps it with the common
+ * machinery: chunks are copied into a bounded queue, handed to the output in
+ * batches, kept for a retry when the output cannot take them, and the queue
+ * overflow policy decides what happens when it is full. Features added to
+ * the core (batching, backpressure, statistics) apply to every output.
+ *
+ * Built-in outputs: HTTP (a chunks_uploader_t), an append-only file, a
+ * UNIX stream socket, an NDJSON export and a null output that discards
+ * everything.
+ *
+ * Usage:
+ * 1. Create a sink: mds_sink_t *sink = mds_sink_create_http(uploader, NULL);
+ * 2. Set it on the session: mds_set_upload_callback(session, mds_sink_callback, sink);
+ * 3. Call mds_sink_poll() from time to time (delivers batches that are due)
+ * 4. Destroy when done (flushes): mds_sink_destroy(sink);
+ *
+ * File and socket outputs write one record per chunk, all integers little-endian:
+ *   u32 data length, u16 URI length, URI bytes, data bytes
+ *
+ * The NDJSON output writes one JSON object per line:
+ *   {"device":"<last URI segment>","seq":<sequence>,"received_us":<time>,"data":"<base64>"}
+ */
+
+#ifndef MDS_BRIDGE_MDS_SINK_H
+#define MDS_BRIDGE_MDS_SINK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "mds_bridge/mds_protocol.h"
+#include "mds_bridge/chunks_uploader.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/** Queue depth used when mds_sink_config_t.queue_depth is 0 */
+#define MDS_SINK_DEFAULT_DEPTH      256
+
+/** Batch size used when mds_sink_config_t.max_batch is 0 */
+#define MDS_SINK_DEFAULT_BATCH      16
+
+/** Largest batch handed to an output */
+#define MDS_SINK_MAX_BATCH          64
+
+/** Size of the record header written by file and socket outputs */
+#define MDS_SINK_RECORD_HEADER_LEN  6
+
+/** Delivered chunks per batch-tuning decision (see mds_sink_config_t.target_p99_age_ms) */
+#define MDS_SINK_TUNE_WINDOW        128
+
+/** Batch-tuning decisions kept for mds_sink_get_tune_history() */
+#define MDS_SINK_TUNE_HISTORY       32
+
+/**
+ * @brief Opaque handle to a sink
+ */
+typedef struct mds_sink mds_sink_t;
+
+/**
+ * @brief One chunk handed to an output
+ */
+typedef struct {
+    const char *uri;
+    const char *auth_header;
+    const uint8_t *data;
+    size_t len;
+
+    /** Position in the sink's submission order, set when queued (gaps mean drops) */
+    uint64_t sequence;
+
+    /** Wall-clock receive time in microseconds since the epoch, set when queued */
+    uint64_t received_us;
+} mds_sink_chunk_t;
+
+/**
+ * @brief What a submit does when the queue is full
+ */
+typedef enum {
+    MDS_SINK_OVERFLOW_DELIVER,      /**< Deliver a batch first; reject if the output is stuck (default) */
+    MDS_SINK_OVERFLOW_REJECT,       /**< Reject the new chunk with -ENOBUFS */
+    MDS_SINK_OVERFLOW_DROP_OLDEST,  /**< Drop the oldest queued chunk */
+} mds_sink_overflow_t;
+
+/**
+ * @brief Sink configuration (zero-initialize for defaults)
+ */
+typedef struct {
+    /** Maximum queued chunks (0 = MDS_SINK_DEFAULT_DEPTH) */
+    size_t queue_depth;
+
+    /** Chunks per batch; a full batch is delivered at once (0 = MDS_SINK_DEFAULT_BATCH) */
+    size_t max_batch;
+
+    /** Deliver a partial batch once its oldest chunk waited this long (0 = only on poll/flush) */
+    uint32_t max_delay_ms;
+
+    /** Queue overflow policy */
+    mds_sink_overflow_t overflow;
+
+    /**
+     * Adapt max_batch and max_delay_ms to keep the p99 chunk age (queued to
+     * delivered) under this many milliseconds (0 = fixed batching). The
+     * configured values are the starting point, with max_delay_ms capped
+     * at half the target (and at least 1).
+     */
+    uint32_t target_p99_age_ms;
+} mds_sink_config_t;
+
+/**
+ * @brief Batch-tuning decision
+ */
+typedef enum {
+    MDS_SINK_TUNE_HOLD,     /**< Age within target, or output not busy enough to gain from batching */
+    MDS_SINK_TUNE_GROW,     /**< Age well under target and output busy: larger, longer batches */
+    MDS_SINK_TUNE_SHRINK,   /**< Age close to or over target: smaller, shorter batches */
+} mds_sink_tune_action_t;
+
+/**
+ * @brief One batch-tuning decision and the window it was based on
+ */
+typedef struct {
+    /** Monotonic time of the decision in microseconds */
+    uint64_t time_us;
+
+    /** p99 age of the chunks delivered in the window, in microseconds */
+    uint32_t p99_age_us;
+
+    /** Share of the window the output spent delivering (0-100) */
+    uint32_t utilization_pct;
+
+    mds_sink_tune_action_t action;
+
+    /** Batch size and linger in effect after the decision */
+    size_t max_batch;
+    uint32_t max_delay_ms;
+} mds_sink_tune_decision_t;
+
+/**
+ * @brief Operations implemented by an output
+ */
+typedef struct {
+    /** Output name, for diagnostics */
+    const char *name;
+
+    /**
+     * Deliver chunks in order
+     *
+     * Returns how many chunks from the front were consumed, with results[i]
+     * set to 0 (delivered) or a negative error (rejected for good) for each
+     * of them. The rest stay queued and are offered again later. Returns a
+     * negative error code if none could be consumed right now.
+     */
+    int (*submit_batch)(void *impl, const mds_sink_chunk_t *chunks, size_t count,
+                        int *results);
+
+    /** Make delivered chunks durable (optional) */
+    int (*flush)(void *impl);
+
+    /** Do background work, waiting up to timeout_ms (optional) */
+    int (*poll)(void *impl, int timeout_ms);
+
+    /** Release the output (optional) */
+    void (*destroy)(void *impl);
+
+    /**
+     * Each chunk costs the output the same whatever the batch size (e.g. one
+     * HTTP request per chunk), so tuning never grows batches or the linger
+     */
+    bool per_chunk;
+} mds_sink_ops_t;
+
+/**
+ * @brief Sink statistics
+ */
+typedef struct {
+    /** Chunks accepted into the queue */
+    size_t submitted;
+
+    /** Chunks the output delivered */
+    size_t delivered;
+
+    /** Chunks the output rejected for good */
+    size_t failed;
+
+    /** Chunks rejected or dropped because the queue was full */
+    size_t dropped;
+
+    /** Payload bytes delivered */
+    size_t bytes_delivered;
+
+    /** Batches handed to the output */
+    size_t batches;
+
+    /** Chunks currently queued */
+    size_t queued;
+
+    /** Highest queue occupancy observed */
+    size_t max_queued;
+
+    /** Last negative error returned by the output (0 if none) */
+    int last_error;
+
+    /** Batch size and linger currently in effect (tuned if target_p99_age_ms is set) */
+    size_t max_batch;
+    uint32_t max_delay_ms;
+} mds_sink_stats_t;
+
+/**
+ * @brief Create a sink around an output
+ *
+ * @param ops Output operations (must outlive the sink)
+ * @param impl Output state passed to every operation; released with
+ *             ops->destroy by mds_sink_destroy()
+ * @param config Configuration, or NULL for defaults
+ *
+ * @return Sink handle, or NULL on failure (impl is not destroyed)
+ */
+mds_sink_t *mds_sink_create(const mds_sink_ops_t *ops, void *impl,
+                            const mds_sink_config_t *config);
+
+/**
+ * @brief Flush and destroy a sink
+ *
+ * Chunks the output still cannot take are discarded.
+ *
+ * @param sink Sink handle
+ */
+void mds_sink_destroy(mds_sink_t *sink);
+
+/**
+ * @brief Queue a chunk
+ *
+ * The chunk is copied. A full batch, or a partial one older than
+ * max_delay_ms, is delivered before returning.
+ *
+ * @return 0 if queued, -ENOBUFS if the queue overflowed and the chunk was
+ *         rejected, negative error code otherwise
+ */
+int mds_sink_submit(mds_sink_t *sink, const char *uri, const char *auth_header,
+                    const uint8_t *data, size_t len);
+
+/**
+ * @brief Queue several chunks
+ *
+ * @param accepted Optional pointer to receive the number of chunks queued
+ *
+ * @return 0 if all were queued, otherwise the error for the first rejected chunk
+ */
+int mds_sink_submit_batch(mds_sink_t *sink, const mds_sink_chunk_t *chunks,
+                          size_t count, size_t *accepted);
+
+/**
+ * @brief Deliver everything queued and make it durable
+ *
+ * @return 0 on success, the output's error if chunks remain queued
+ */
+int mds_sink_flush(mds_sink_t *sink);
+
+/**
+ * @brief Deliver due batches and let the output do background work
+ *
+ * A partial batch is due once its oldest chunk waited max_delay_ms, or at
+ * once when max_delay_ms is 0. Use mds_sink_flush() to force delivery.
+ *
+ * @param timeout_ms Passed to the output's poll operation
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_sink_poll(mds_sink_t *sink, int timeout_ms);
+
+/**
+ * @brief Get sink statistics
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_sink_get_stats(mds_sink_t *sink, mds_sink_stats_t *stats);
+
+/**
+ * @brief Get the most recent batch-tuning decisions, oldest first
+ *
+ * A decision is made every MDS_SINK_TUNE_WINDOW delivered chunks while
+ * target_p99_age_ms is set.
+ *
+ * @param decisions Array receiving up to max decisions
+ * @param count Receives the number written
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_sink_get_tune_history(mds_sink_t *sink, mds_sink_tune_decision_t *decisions,
+                              size_t max, size_t *count);
+
+/**
+ * @brief Upload callback for use with mds_set_upload_callback() or a fan-out
+ *
+ * @param user_data Must be an mds_sink_t* instance
+ *
+ * @return Same as mds_sink_submit()
+ */
+int mds_sink_callback(const char *uri, const char *auth_header,
+                      const uint8_t *chunk_data, size_t chunk_len, void *user_data);
+
+/**
+ * @brief Sink posting chunks with an uploader
+ *
+ * A 4xx response other than 429 counts as failed; transport errors, 5xx
+ * and 429 leave the chunks queued for a retry. The uploader is not owned.
+ *
+ * @return Sink handle, or NULL on failure
+ */
+mds_sink_t *mds_sink_create_http(chunks_uploader_t *uploader, const mds_sink_config_t *config);
+
+/**
+ * @brief Sink appending records to a file (created if needed)
+ *
+ * @return Sink handle, or NULL on failure
+ */
+mds_sink_t *mds_sink_create_file(const char *path, const mds_sink_config_t *config);
+
+/**
+ * @brief Sink streaming records to a UNIX socket
+ *
+ * The socket is connected on creation and reconnected after an error.
+ *
+ * @return Sink handle, or NULL on failure
+ */
+mds_sink_t *mds_sink_create_unix(const char *path, const mds_sink_config_t *config);
+
+/** Prefix of an mds_sink_create_ndjson() path naming a UNIX socket */
+#define MDS_SINK_UNIX_PREFIX    "unix:"
+
+/**
+ * @brief Sink exporting chunks as NDJSON records
+ *
+ * A path of the form "unix:/run/collector.sock" streams the records to that
+ * UNIX socket. If nothing listens there yet, the chunks stay queued until a
+ * batch can connect, and a file is never created in the socket's place.
+ * Any other path is a file the records are appended to (created if needed);
+ * a plain path that is a socket is rejected. Each batch is encoded into
+ * reusable buffers and written with one writev().
+ *
+ * @return Sink handle, or NULL on failure
+ */
+mds_sink_t *mds_sink_create_ndjson(const char *path, const mds_sink_config_t *config);
+
+/**
+ * @brief Sink that discards every chunk (counts them as delivered)
+ *
+ * @return Sink handle, or NULL on failure
+ */
+mds_sink_t *mds_sink_create_null(const mds_sink_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MDS_BRIDGE_MDS_SINK_H */
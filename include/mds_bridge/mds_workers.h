@@ -0,0 +1,192 @@
+/**
+ * @file mds_workers.h
+ * @brief Upload worker pool balancing devices across threads by work stealing
+ *
+ * A worker pool is an upload callback shared by several sessions. Chunks
+ * are queued per device (by URI). A device with queued chunks is a ready
+ * batch in the deque of its home worker; a worker takes the oldest batch
+ * from its own deque and, when that is empty, steals the newest from a
+ * peer's, so one busy device does not leave the other workers idle.
+ *
+ * A device is in at most one deque or being uploaded by one worker at a
+ * time, so its chunks are always uploaded one after the other, in order.
+ *
+ * Every worker has its own callback and user data, e.g. one uploader per
+ * worker. Workers run on different threads, so their uploaders must not
+ * share a chunks_pool_t.
+ *
+ * Usage:
+ * 1. Create the pool: mds_workers_t *workers = mds_workers_create(0, 0);
+ * 2. Add workers: mds_workers_add_worker(workers, chunks_uploader_callback, uploader);
+ * 3. Set it on each session: mds_set_upload_callback(session, mds_workers_callback, workers);
+ * 4. Destroy when done (drains all queues): mds_workers_destroy(workers);
+ */
+
+#ifndef MDS_BRIDGE_MDS_WORKERS_H
+#define MDS_BRIDGE_MDS_WORKERS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "mds_bridge/mds_protocol.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/** Maximum number of workers per pool */
+#define MDS_WORKERS_MAX             16
+
+/** Chunks of one device uploaded per batch when mds_workers_create() is passed 0 */
+#define MDS_WORKERS_DEFAULT_BATCH   8
+
+/** Queued chunks across all devices when mds_workers_create() is passed 0 */
+#define MDS_WORKERS_DEFAULT_DEPTH   1024
+
+/**
+ * @brief Opaque handle to a worker pool
+ */
+typedef struct mds_workers mds_workers_t;
+
+/**
+ * @brief Per-worker statistics
+ */
+typedef struct {
+    /** Batches uploaded */
+    size_t batches;
+
+    /** Batches taken from a peer's deque */
+    size_t steals;
+
+    /** Chunks the worker callback accepted (returned 0) */
+    size_t delivered;
+
+    /** Chunks the worker callback rejected */
+    size_t failed;
+
+    /** Ready batches currently in the worker's deque */
+    size_t queued;
+
+    /** Time spent in the worker callback, in microseconds */
+    uint64_t busy_us;
+
+    /** busy_us as a share of the time since the worker started (0-100) */
+    uint32_t utilization_pct;
+
+    /** Last negative error returned by the worker callback (0 if none) */
+    int last_error;
+} mds_worker_stats_t;
+
+/**
+ * @brief Pool-wide statistics
+ */
+typedef struct {
+    /** Devices seen */
+    size_t devices;
+
+    /** Chunks queued or being uploaded */
+    size_t queued;
+
+    /** Highest value of queued observed */
+    size_t max_queued;
+
+    /** Chunks dropped because the pool was full */
+    size_t dropped;
+} mds_workers_stats_t;
+
+/**
+ * @brief Create a worker pool with no workers
+ *
+ * @param max_batch Chunks of one device uploaded before the worker moves on
+ *                  (0 = MDS_WORKERS_DEFAULT_BATCH)
+ * @param queue_depth Maximum chunks queued across all devices
+ *                    (0 = MDS_WORKERS_DEFAULT_DEPTH)
+ *
+ * @return Pool handle, or NULL on failure
+ */
+mds_workers_t *mds_workers_create(size_t max_batch, size_t queue_depth);
+
+/**
+ * @brief Destroy a worker pool
+ *
+ * Uploads everything still queued, stops the worker threads and frees all
+ * resources. The pool must no longer be registered as an upload callback.
+ *
+ * @param workers Pool handle
+ */
+void mds_workers_destroy(mds_workers_t *workers);
+
+/**
+ * @brief Add a worker
+ *
+ * Starts a thread that calls callback for each chunk it uploads. The data,
+ * uri and auth_header pointers are only valid for the duration of the call.
+ *
+ * Workers must be added before the first chunk is delivered.
+ *
+ * @param workers Pool handle
+ * @param callback Upload callback (e.g. chunks_uploader_callback)
+ * @param user_data Passed to callback
+ *
+ * @return Worker index (>= 0) on success, -EBUSY if chunks were already
+ *         delivered, -ENOSPC if MDS_WORKERS_MAX workers exist,
+ *         negative error code otherwise
+ */
+int mds_workers_add_worker(mds_workers_t *workers,
+                           mds_chunk_upload_callback_t callback,
+                           void *user_data);
+
+/**
+ * @brief Upload callback for use with mds_set_upload_callback()
+ *
+ * Queues the chunk behind the earlier chunks of the same device without
+ * blocking.
+ *
+ * @param user_data Must be an mds_workers_t* instance
+ *
+ * @return 0 on success, -ENOSPC if the pool is full or has no workers,
+ *         negative error code otherwise
+ */
+int mds_workers_callback(const char *uri,
+                         const char *auth_header,
+                         const uint8_t *chunk_data,
+                         size_t chunk_len,
+                         void *user_data);
+
+/**
+ * @brief Wait until every queued chunk has been uploaded
+ *
+ * @param workers Pool handle
+ * @param timeout_ms Maximum time to wait (negative waits forever)
+ *
+ * @return 0 when nothing is queued, -ETIMEDOUT on timeout,
+ *         negative error code otherwise
+ */
+int mds_workers_flush(mds_workers_t *workers, int timeout_ms);
+
+/**
+ * @brief Get statistics for one worker
+ *
+ * @param workers Pool handle
+ * @param worker Worker index returned by mds_workers_add_worker()
+ * @param stats Pointer to receive statistics
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_workers_get_worker_stats(mds_workers_t *workers, int worker,
+                                 mds_worker_stats_t *stats);
+
+/**
+ * @brief Get pool-wide statistics
+ *
+ * @param workers Pool handle
+ * @param stats Pointer to receive statistics
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_workers_get_stats(mds_workers_t *workers, mds_workers_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MDS_BRIDGE_MDS_WORKERS_H */
@@ -0,0 +1,513 @@
+/**
+ * @file chunks_async.c
+ * @brief Uploader event-loop mode on the curl multi socket interface
+ *
+ * Uploads are copied into requests and run on one multi handle. libcurl
+ * tells us which sockets to watch and when to time out; both are forwarded
+ * to the host loop, which calls back into curl_multi_socket_action(). A
+ * request that should fail over is re-added with the next endpoint's URL.
+ *
+ * Chunks of one device (one data URI) must reach the server in order, so
+ * each device has at most one request in flight; other devices' requests
+ * start past it. The device's next request is prepared (easy handle set up)
+ * while the current one runs and is added as soon as it completes, unless
+ * the endpoint it was prepared for has gone down in the meantime.
+ */
+
+#include "chunks_uploader_internal.h"
+#include <curl/curl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+
+typedef struct chunks_async_request {
+    CURL *easy;
+    struct curl_slist *headers;
+    bool owns_headers;              /* false: from the uploader's header cache */
+    struct curl_slist *resolve;     /* Addresses for the current attempt, read when it starts */
+    uint8_t *data;
+    size_t len;
+    char uri[CHUNKS_MAX_URL_LEN];
+    char url[CHUNKS_MAX_URL_LEN];
+    char *auth;                     /* Handed to the policy's expired_fn */
+    const char *target;             /* uri or url, for the current attempt */
+    chunks_upload_route_t route;
+    chunks_endpoint_t *endpoint;
+    uint64_t dedup_key;
+    bool ambiguous;                 /* Some attempt may have been stored */
+    chunks_upload_times_t times;
+    bool prepared;                  /* easy set up for target, not yet added */
+    struct chunks_async_request *successor;     /* Same device, prepared; started when this ends */
+    struct chunks_async_request *next;
+} chunks_async_request_t;
+
+struct chunks_async {
+    CURLM *multi;
+    chunks_uploader_socket_fn socket_fn;
+    chunks_uploader_timer_fn timer_fn;
+    void *user_data;
+
+    /* Requests waiting for a slot, oldest first */
+    chunks_async_request_t *queue_head;
+    chunks_async_request_t *queue_tail;
+    size_t queued;
+
+    /* Requests added to the multi handle */
+    chunks_async_request_t *active[CHUNKS_ASYNC_MAX_IN_FLIGHT];
+    size_t in_flight;
+
+    /* Easy handles kept for reuse (connections stay warm) */
+    CURL *idle[CHUNKS_ASYNC_MAX_IN_FLIGHT];
+    size_t idle_count;
+};
+
+/* ============================================================================
+ * libcurl Callbacks
+ * ========================================================================== */
+
+static int async_socket_cb(CURL *easy, curl_socket_t s, int what,
+                           void *userp, void *socketp) {
+    (void)easy;
+    (void)socketp;
+    chunks_async_t *async = (chunks_async_t *)userp;
+
+    int events = 0;
+    if (what != CURL_POLL_REMOVE) {
+        events |= (what & CURL_POLL_IN) ? CHUNKS_POLL_IN : 0;
+        events |= (what & CURL_POLL_OUT) ? CHUNKS_POLL_OUT : 0;
+    }
+
+    return async->socket_fn((int)s, events, async->user_data) == 0 ? 0 : -1;
+}
+
+static int async_timer_cb(CURLM *multi, long timeout_ms, void *userp) {
+    (void)multi;
+    chunks_async_t *async = (chunks_async_t *)userp;
+    return async->timer_fn(timeout_ms, async->user_data) == 0 ? 0 : -1;
+}
+
+/* ============================================================================
+ * Requests
+ * ========================================================================== */
+
+static void async_request_free(chunks_async_t *async, chunks_async_request_t *req) {
+    if (req->easy) {
+        if (async->idle_count < CHUNKS_ASYNC_MAX_IN_FLIGHT) {
+            async->idle[async->idle_count++] = req->easy;
+        } else {
+            curl_easy_cleanup(req->easy);
+        }
+    }
+    if (req->owns_headers) {
+        curl_slist_free_all(req->headers);
+    }
+    curl_slist_free_all(req->resolve);
+    free(req->auth);
+    free(req->data);
+    free(req);
+}
+
+static void async_finish(chunks_uploader_t *uploader, chunks_async_request_t *req,
+                         int ret, CURLcode res, long http_code) {
+    chunks_upload_finish(uploader, req->dedup_key, ret, res, http_code, req->ambiguous,
+                         req->len, &req->times);
+    async_request_free(uploader->async, req);
+}
+
+/* Set up req's easy handle for its current attempt */
+static int async_prepare(chunks_uploader_t *uploader, chunks_async_request_t *req) {
+    chunks_async_t *async = uploader->async;
+
+    req->target = chunks_upload_target(uploader, &req->route, req->uri,
+                                       req->url, sizeof(req->url), &req->endpoint);
+    if (req->target == NULL) {
+        return -ENAMETOOLONG;
+    }
+
+    if (req->easy == NULL) {
+        req->easy = async->idle_count ? async->idle[--async->idle_count] : curl_easy_init();
+        if (req->easy == NULL) {
+            return -ENOMEM;
+        }
+    }
+
+    /* The reset in setup lets go of the previous attempt's list */
+    struct curl_slist *previous = req->resolve;
+    chunks_upload_setup(uploader, req->easy, req->target, req->headers, req->data, req->len,
+                        &req->resolve);
+    curl_slist_free_all(previous);
+    curl_easy_setopt(req->easy, CURLOPT_PRIVATE, (void *)req);
+    req->prepared = true;
+    return 0;
+}
+
+/* Route a first attempt again if the endpoint picked for it has gone down */
+static void async_reroute(chunks_uploader_t *uploader, chunks_async_request_t *req) {
+    chunks_upload_route_t *route = &req->route;
+    if (route->group == NULL || route->index != 0 ||
+        route->group->endpoints[route->order[0]].down_until_ms <= chunks_now_ms()) {
+        return;
+    }
+
+    size_t first = route->order[0];
+    chunks_upload_route(uploader, req->uri, route);
+    if (route->order[0] != first) {
+        req->prepared = false;
+    }
+}
+
+/* Add the current attempt of req to the multi handle */
+static int async_start(chunks_uploader_t *uploader, chunks_async_request_t *req) {
+    chunks_async_t *async = uploader->async;
+
+    async_reroute(uploader, req);
+    int ret = req->prepared ? 0 : async_prepare(uploader, req);
+    if (ret < 0) {
+        return ret;
+    }
+    req->prepared = false;
+
+    if (curl_multi_add_handle(async->multi, req->easy) != CURLM_OK) {
+        return -EIO;
+    }
+
+    async->active[async->in_flight++] = req;
+    return 0;
+}
+
+static void async_remove_active(chunks_async_t *async, chunks_async_request_t *req) {
+    curl_multi_remove_handle(async->multi, req->easy);
+    for (size_t i = 0; i < async->in_flight; i++) {
+        if (async->active[i] == req) {
+            async->active[i] = async->active[--async->in_flight];
+            break;
+        }
+    }
+}
+
+/* The request in flight for the same device as req, if any */
+static chunks_async_request_t *async_device_active(chunks_async_t *async,
+                                                   const chunks_async_request_t *req) {
+    for (size_t i = 0; i < async->in_flight; i++) {
+        if (strcmp(async->active[i]->uri, req->uri) == 0) {
+            return async->active[i];
+        }
+    }
+    return NULL;
+}
+
+/* Start a request taken off the queue; stale chunks are dropped or diverted now */
+static void async_launch(chunks_uploader_t *uploader, chunks_async_request_t *req) {
+    if (chunks_upload_expired(uploader, &req->times)) {
+        chunks_upload_expire(uploader, req->uri, req->auth, req->data, req->len,
+                             req->dedup_key);
+        async_request_free(uploader->async, req);
+        return;
+    }
+
+    int ret = async_start(uploader, req);
+    if (ret < 0) {
+        async_finish(uploader, req, ret, CURLE_OK, 0);
+    }
+}
+
+/* Take req off the queue */
+static void async_dequeue(chunks_async_t *async, chunks_async_request_t *req) {
+    chunks_async_request_t **link = &async->queue_head;
+    chunks_async_request_t *prev = NULL;
+
+    while (*link && *link != req) {
+        prev = *link;
+        link = &prev->next;
+    }
+    if (*link == NULL) {
+        return;
+    }
+
+    *link = req->next;
+    if (async->queue_tail == req) {
+        async->queue_tail = prev;
+    }
+    async->queued--;
+    req->next = NULL;
+}
+
+/*
+ * Start queued requests, in queue order, while slots are free. A request
+ * whose device already has one in flight stays queued; the first such
+ * request per device is prepared so it can start as soon as that one ends.
+ */
+static void async_pump(chunks_uploader_t *uploader) {
+    chunks_async_t *async = uploader->async;
+    chunks_async_request_t **link = &async->queue_head;
+    chunks_async_request_t *prev = NULL;
+
+    while (*link && async->in_flight < CHUNKS_ASYNC_MAX_IN_FLIGHT) {
+        chunks_async_request_t *req = *link;
+        chunks_async_request_t *ahead = async_device_active(async, req);
+        if (ahead) {
+            if (ahead->successor == NULL && async_prepare(uploader, req) == 0) {
+                ahead->successor = req;
+            }
+            prev = req;
+            link = &req->next;
+            continue;
+        }
+
+        *link = req->next;
+        if (async->queue_tail == req) {
+            async->queue_tail = prev;
+        }
+        async->queued--;
+        req->next = NULL;
+        async_launch(uploader, req);
+    }
+}
+
+/*
+ * Queue position: FIFO appends; EDF goes before the first later deadline,
+ * but never ahead of a request for the same device
+ */
+static void async_enqueue(chunks_uploader_t *uploader, chunks_async_request_t *req) {
+    chunks_async_t *async = uploader->async;
+    chunks_async_request_t **link = &async->queue_head;
+
+    if (uploader->queue_policy.order == CHUNKS_QUEUE_EDF && req->times.deadline_ms) {
+        while (*link && (*link)->times.deadline_ms &&
+               (*link)->times.deadline_ms <= req->times.deadline_ms) {
+            link = &(*link)->next;
+        }
+        for (chunks_async_request_t **scan = link; *scan; scan = &(*scan)->next) {
+            if (strcmp((*scan)->uri, req->uri) == 0) {
+                link = &(*scan)->next;
+            }
+        }
+    } else if (async->queue_tail) {
+        link = &async->queue_tail->next;
+    }
+
+    req->next = *link;
+    *link = req;
+    if (req->next == NULL) {
+        async->queue_tail = req;
+    }
+    async->queued++;
+}
+
+/* Handle finished transfers: fail over or record the outcome */
+static void async_check_done(chunks_uploader_t *uploader) {
+    chunks_async_t *async = uploader->async;
+    CURLMsg *msg;
+    int remaining;
+
+    while ((msg = curl_multi_info_read(async->multi, &remaining)) != NULL) {
+        if (msg->msg != CURLMSG_DONE) {
+            continue;
+        }
+
+        CURLcode res = msg->data.result;
+        chunks_async_request_t *req = NULL;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&req);
+
+        long http_code;
+        double latency_ms;
+        chunks_upload_result(uploader, req->easy, req->target, &http_code, &latency_ms);
+        bool fail_over = chunks_upload_attempt_done(uploader, req->endpoint, res,
+                                                    http_code, latency_ms);
+        async_remove_active(async, req);
+        req->ambiguous |= chunks_upload_ambiguous(res);
+
+        int ret = (res == CURLE_OK && http_code >= 200 && http_code < 300) ? 0 : -EIO;
+        if (fail_over && req->route.index + 1 < req->route.count) {
+            if (uploader->verbose) {
+                printf("Endpoint %s failed, trying next endpoint\n", req->target);
+            }
+            req->route.index++;
+            int err = async_start(uploader, req);
+            if (err == 0) {
+                continue;
+            }
+            ret = err;
+        }
+
+        /* The device's prepared request takes the slot before anything else */
+        chunks_async_request_t *successor = req->successor;
+        async_finish(uploader, req, ret, res, http_code);
+        if (successor) {
+            async_dequeue(async, successor);
+            async_launch(uploader, successor);
+        }
+    }
+
+    async_pump(uploader);
+}
+
+int chunks_async_submit(chunks_uploader_t *uploader, const char *uri,
+                        const char *auth_header, struct curl_slist *headers, bool owned,
+                        const uint8_t *chunk_data, size_t chunk_len,
+                        uint64_t dedup_key, const chunks_upload_times_t *times) {
+    chunks_async_t *async = uploader->async;
+
+    if (async->queued >= CHUNKS_ASYNC_MAX_QUEUED) {
+        if (owned) {
+            curl_slist_free_all(headers);
+        }
+        return chunks_upload_finish(uploader, dedup_key, -ENOBUFS, CURLE_OK, 0, false, chunk_len, times);
+    }
+
+    chunks_async_request_t *req = calloc(1, sizeof(*req));
+    uint8_t *data = malloc(chunk_len ? chunk_len : 1);
+    size_t auth_len = strlen(auth_header) + 1;
+    char *auth = malloc(auth_len);
+    if (req == NULL || data == NULL || auth == NULL || strlen(uri) >= sizeof(req->uri)) {
+        int ret = (req && data && auth) ? -ENAMETOOLONG : -ENOMEM;
+        free(req);
+        free(data);
+        free(auth);
+        if (owned) {
+            curl_slist_free_all(headers);
+        }
+        return chunks_upload_finish(uploader, dedup_key, ret, CURLE_OK, 0, false, chunk_len, times);
+    }
+
+    memcpy(data, chunk_data, chunk_len);
+    strcpy(req->uri, uri);
+    memcpy(auth, auth_header, auth_len);
+    req->auth = auth;
+    req->headers = headers;
+    req->owns_headers = owned;
+    req->data = data;
+    req->len = chunk_len;
+    req->dedup_key = dedup_key;
+    req->times = *times;
+    chunks_upload_route(uploader, uri, &req->route);
+    async_enqueue(uploader, req);
+
+    /* Adding handles arms the timer; the transfer starts from the host loop */
+    async_pump(uploader);
+    return 0;
+}
+
+void chunks_async_free(chunks_uploader_t *uploader) {
+    chunks_async_t *async = uploader->async;
+    if (async == NULL) {
+        return;
+    }
+
+    while (async->in_flight > 0) {
+        chunks_async_request_t *req = async->active[0];
+        async_remove_active(async, req);
+        async_request_free(async, req);
+    }
+
+    while (async->queue_head) {
+        chunks_async_request_t *req = async->queue_head;
+        async->queue_head = req->next;
+        async_request_free(async, req);
+    }
+
+    chunks_async_release_idle(uploader);
+    curl_multi_cleanup(async->multi);
+    free(async);
+    uploader->async = NULL;
+}
+
+void chunks_async_release_idle(chunks_uploader_t *uploader) {
+    chunks_async_t *async = uploader->async;
+    if (async == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < async->idle_count; i++) {
+        curl_easy_cleanup(async->idle[i]);
+    }
+    async->idle_count = 0;
+}
+
+/* ============================================================================
+ * Public API
+ * ========================================================================== */
+
+int chunks_uploader_set_event_loop(chunks_uploader_t *uploader,
+                                   chunks_uploader_socket_fn socket_fn,
+                                   chunks_uploader_timer_fn timer_fn,
+                                   void *user_data) {
+    if (uploader == NULL || (socket_fn != NULL && timer_fn == NULL)) {
+        return -EINVAL;
+    }
+
+    if (chunks_uploader_pending(uploader) > 0) {
+        return -EBUSY;
+    }
+
+    chunks_async_free(uploader);
+    if (socket_fn == NULL) {
+        return 0;
+    }
+
+    chunks_async_t *async = calloc(1, sizeof(*async));
+    if (async == NULL) {
+        return -ENOMEM;
+    }
+
+    async->multi = curl_multi_init();
+    if (async->multi == NULL) {
+        free(async);
+        return -ENOMEM;
+    }
+
+    async->socket_fn = socket_fn;
+    async->timer_fn = timer_fn;
+    async->user_data = user_data;
+
+    curl_multi_setopt(async->multi, CURLMOPT_SOCKETFUNCTION, async_socket_cb);
+    curl_multi_setopt(async->multi, CURLMOPT_SOCKETDATA, async);
+    curl_multi_setopt(async->multi, CURLMOPT_TIMERFUNCTION, async_timer_cb);
+    curl_multi_setopt(async->multi, CURLMOPT_TIMERDATA, async);
+
+    uploader->async = async;
+    return 0;
+}
+
+int chunks_uploader_on_socket(chunks_uploader_t *uploader, int fd, int events) {
+    if (uploader == NULL || uploader->async == NULL) {
+        return -EINVAL;
+    }
+
+    int mask = 0;
+    mask |= (events & CHUNKS_POLL_IN) ? CURL_CSELECT_IN : 0;
+    mask |= (events & CHUNKS_POLL_OUT) ? CURL_CSELECT_OUT : 0;
+
+    int running;
+    if (curl_multi_socket_action(uploader->async->multi, (curl_socket_t)fd, mask,
+                                 &running) != CURLM_OK) {
+        return -EIO;
+    }
+
+    async_check_done(uploader);
+    return 0;
+}
+
+int chunks_uploader_on_timeout(chunks_uploader_t *uploader) {
+    if (uploader == NULL || uploader->async == NULL) {
+        return -EINVAL;
+    }
+
+    int running;
+    if (curl_multi_socket_action(uploader->async->multi, CURL_SOCKET_TIMEOUT, 0,
+                                 &running) != CURLM_OK) {
+        return -EIO;
+    }
+
+    async_check_done(uploader);
+    return 0;
+}
+
+size_t chunks_uploader_pending(chunks_uploader_t *uploader) {
+    if (uploader == NULL || uploader->async == NULL) {
+        return 0;
+    }
+
+    return uploader->async->queued + uploader->async->in_flight;
+}
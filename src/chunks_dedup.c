@@ -0,0 +1,253 @@
+/**
+ * @file chunks_dedup.c
+ * @brief Fixed-size dedup window for re-uploaded chunks
+ *
+ * The window is a set-associative table of 64-bit content hashes: a key
+ * selects one bucket of CHUNKS_DEDUP_WAYS slots, and inserting into a full
+ * bucket evicts its oldest entry. Memory is fixed at creation and lookups
+ * touch a single cache line. A persistent window is a shared mapping of the
+ * window file, so every update reaches the file without explicit writes.
+ */
+
+#include "chunks_uploader_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Slots per bucket (16-byte entries, one 64-byte line per bucket) */
+#define CHUNKS_DEDUP_WAYS           4
+
+/* Window file header: "MDSD" */
+#define CHUNKS_DEDUP_MAGIC          0x4453444Du
+#define CHUNKS_DEDUP_VERSION        1
+
+typedef struct {
+    uint64_t key;                   /* 0 = empty slot */
+    uint32_t seq;                   /* Insertion order, for eviction */
+    uint32_t state;                 /* CHUNKS_DEDUP_PENDING or _CONFIRMED */
+} chunks_dedup_entry_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t bucket_count;
+    uint32_t seq;
+} chunks_dedup_header_t;
+
+struct chunks_dedup {
+    chunks_dedup_header_t *header;
+    chunks_dedup_entry_t *entries;
+    size_t map_len;                 /* 0 when heap-allocated */
+};
+
+/* ============================================================================
+ * Hashing
+ * ========================================================================== */
+
+static uint64_t dedup_rotl(uint64_t v, int r) {
+    return (v << r) | (v >> (64 - r));
+}
+
+static uint64_t dedup_mix(uint64_t h, uint64_t v) {
+    h ^= v * 0x9E3779B97F4A7C15ull;
+    return dedup_rotl(h, 31) * 0xBF58476D1CE4E5B9ull;
+}
+
+/* Word-at-a-time hash; chunks are small, so this beats any setup-heavy hash */
+static uint64_t dedup_hash(uint64_t h, const uint8_t *data, size_t len) {
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, data, sizeof(v));
+        h = dedup_mix(h, v);
+        data += 8;
+        len -= 8;
+    }
+
+    uint64_t tail = 0;
+    memcpy(&tail, data, len);
+    return dedup_mix(h, tail ^ ((uint64_t)len << 56));
+}
+
+uint64_t chunks_dedup_key(const char *uri, const uint8_t *data, size_t len) {
+    /* The device is the last path segment, so failover origins share keys */
+    const char *device = strrchr(uri, '/');
+    device = device ? device + 1 : uri;
+
+    uint64_t h = dedup_hash(0x243F6A8885A308D3ull, (const uint8_t *)device, strlen(device));
+    h = dedup_hash(h, data, len);
+
+    /* Final avalanche (splitmix64) */
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+
+    return h ? h : 1;
+}
+
+/* ============================================================================
+ * Window Management
+ * ========================================================================== */
+
+static size_t dedup_bucket_count(size_t window) {
+    size_t buckets = 1;
+    while (buckets * CHUNKS_DEDUP_WAYS < window) {
+        buckets <<= 1;
+    }
+    return buckets;
+}
+
+static int dedup_map_file(chunks_dedup_t *dedup, const char *path, size_t bucket_count) {
+    size_t len = sizeof(chunks_dedup_header_t) +
+                 bucket_count * CHUNKS_DEDUP_WAYS * sizeof(chunks_dedup_entry_t);
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int err = -errno;
+        close(fd);
+        return err;
+    }
+
+    /* A file of another size was written with another window; start over */
+    bool fresh = ((size_t)st.st_size != len);
+    if (fresh && (ftruncate(fd, 0) < 0 || ftruncate(fd, (off_t)len) < 0)) {
+        int err = -errno;
+        close(fd);
+        return err;
+    }
+
+    void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -errno;
+    }
+
+    dedup->header = map;
+    dedup->entries = (chunks_dedup_entry_t *)(dedup->header + 1);
+    dedup->map_len = len;
+
+    if (dedup->header->magic != CHUNKS_DEDUP_MAGIC ||
+        dedup->header->version != CHUNKS_DEDUP_VERSION ||
+        dedup->header->bucket_count != bucket_count) {
+        memset(map, 0, len);
+        dedup->header->magic = CHUNKS_DEDUP_MAGIC;
+        dedup->header->version = CHUNKS_DEDUP_VERSION;
+        dedup->header->bucket_count = (uint32_t)bucket_count;
+    }
+
+    return 0;
+}
+
+int chunks_dedup_open(size_t window, const char *path, chunks_dedup_t **out) {
+    *out = NULL;
+
+    if (window == 0 || window > CHUNKS_DEDUP_MAX_WINDOW) {
+        return -EINVAL;
+    }
+
+    chunks_dedup_t *dedup = calloc(1, sizeof(*dedup));
+    if (dedup == NULL) {
+        return -ENOMEM;
+    }
+
+    size_t bucket_count = dedup_bucket_count(window);
+    int ret = 0;
+
+    if (path) {
+        ret = dedup_map_file(dedup, path, bucket_count);
+    } else {
+        dedup->header = calloc(1, sizeof(chunks_dedup_header_t) +
+                                  bucket_count * CHUNKS_DEDUP_WAYS * sizeof(chunks_dedup_entry_t));
+        if (dedup->header == NULL) {
+            ret = -ENOMEM;
+        } else {
+            dedup->entries = (chunks_dedup_entry_t *)(dedup->header + 1);
+            dedup->header->bucket_count = (uint32_t)bucket_count;
+        }
+    }
+
+    if (ret < 0) {
+        free(dedup);
+        return ret;
+    }
+
+    *out = dedup;
+    return 0;
+}
+
+void chunks_dedup_close(chunks_dedup_t *dedup) {
+    if (dedup == NULL) {
+        return;
+    }
+
+    if (dedup->map_len) {
+        msync(dedup->header, dedup->map_len, MS_ASYNC);
+        munmap(dedup->header, dedup->map_len);
+    } else {
+        free(dedup->header);
+    }
+    free(dedup);
+}
+
+/* ============================================================================
+ * Lookup and Update
+ * ========================================================================== */
+
+static chunks_dedup_entry_t *dedup_bucket(chunks_dedup_t *dedup, uint64_t key) {
+    size_t index = (size_t)(key & (dedup->header->bucket_count - 1));
+    return &dedup->entries[index * CHUNKS_DEDUP_WAYS];
+}
+
+int chunks_dedup_lookup(chunks_dedup_t *dedup, uint64_t key) {
+    chunks_dedup_entry_t *bucket = dedup_bucket(dedup, key);
+
+    for (size_t i = 0; i < CHUNKS_DEDUP_WAYS; i++) {
+        if (bucket[i].key == key) {
+            return (int)bucket[i].state;
+        }
+    }
+    return CHUNKS_DEDUP_NONE;
+}
+
+void chunks_dedup_mark(chunks_dedup_t *dedup, uint64_t key, int state) {
+    chunks_dedup_entry_t *bucket = dedup_bucket(dedup, key);
+    chunks_dedup_entry_t *slot = NULL;
+
+    for (size_t i = 0; i < CHUNKS_DEDUP_WAYS; i++) {
+        if (bucket[i].key == key) {
+            slot = &bucket[i];
+            break;
+        }
+    }
+
+    if (state == CHUNKS_DEDUP_NONE) {
+        if (slot) {
+            memset(slot, 0, sizeof(*slot));
+        }
+        return;
+    }
+
+    if (slot == NULL) {
+        /* Empty slot if any, otherwise the oldest (wrap-safe comparison) */
+        slot = &bucket[0];
+        for (size_t i = 0; i < CHUNKS_DEDUP_WAYS && slot->key != 0; i++) {
+            if (bucket[i].key == 0 || (int32_t)(bucket[i].seq - slot->seq) < 0) {
+                slot = &bucket[i];
+            }
+        }
+        slot->key = key;
+    }
+
+    slot->seq = ++dedup->header->seq;
+    slot->state = (uint32_t)state;
+}
@@ -0,0 +1,401 @@
+/**
+ * @file chunks_dns.c
+ * @brief Background host resolution with a stale-while-revalidate cache
+ *
+ * A worker thread resolves hosts with getaddrinfo(). Uploads only read the
+ * cache and pass the addresses to libcurl as a CURLOPT_RESOLVE entry, so a
+ * slow resolver never blocks them once a host has been seen. An entry is
+ * fresh for ttl after its lookup, then served stale for up to max_stale
+ * while the worker refreshes it. A host with nothing usable cached is left
+ * to libcurl's own resolver for that upload and queued for the worker.
+ *
+ * Entries are added with a '+' prefix so that they time out of libcurl's
+ * DNS cache like resolved ones, instead of pinning an address forever.
+ * libcurl reads a CURLOPT_RESOLVE list when the transfer starts, which for a
+ * queued or prepared request can be long after setup, so every request gets
+ * its own copy of the list and frees it when the request is done.
+ */
+
+#include "chunks_uploader_internal.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+/* Longest port number, including the terminator */
+#define DNS_PORT_LEN                8
+
+/* Wait before looking a host up again after a failure */
+#define DNS_RETRY_MS                1000
+
+typedef struct {
+    char host[CHUNKS_MAX_ORIGIN_LEN];
+    char port[DNS_PORT_LEN];
+    char addrs[CHUNKS_DNS_MAX_ADDRS_LEN];   /* Empty until the first lookup succeeds */
+    uint64_t resolved_ms;                   /* Time of the last successful lookup */
+    uint64_t used_ms;                       /* For eviction */
+    uint64_t retry_ms;                      /* No new lookup before then (after a failure) */
+    bool wanted;                            /* Queued for the worker */
+    bool busy;                              /* Being looked up */
+} dns_entry_t;
+
+struct chunks_dns_cache {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;            /* Lookup wanted or stopping */
+    pthread_t thread;
+    bool stopping;
+
+    uint64_t ttl_ms;
+    uint64_t max_stale_ms;
+
+    dns_entry_t entries[CHUNKS_DNS_MAX_HOSTS];
+    size_t count;
+
+    chunks_dns_stats_t stats;
+};
+
+/* ============================================================================
+ * Internal Helper Functions
+ * ========================================================================== */
+
+static uint64_t dns_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/* Split "scheme://[user@]host[:port]/..." into host and port; false for IP literals */
+static bool dns_parse_url(const char *url, char *host, size_t host_len, char *port) {
+    const char *p = strstr(url, "://");
+    if (p == NULL) {
+        return false;
+    }
+
+    bool https = (size_t)(p - url) == 5 && strncmp(url, "https", 5) == 0;
+    const char *start = p + 3;
+    size_t authority = strcspn(start, "/?#");
+    const char *at = memchr(start, '@', authority);
+    if (at) {
+        authority -= (size_t)(at + 1 - start);
+        start = at + 1;
+    }
+    if (authority == 0 || start[0] == '[') {
+        return false;
+    }
+
+    const char *colon = memchr(start, ':', authority);
+    size_t name_len = colon ? (size_t)(colon - start) : authority;
+    size_t port_len = colon ? authority - name_len - 1 : 0;
+    if (name_len == 0 || name_len >= host_len || port_len >= DNS_PORT_LEN ||
+        (colon && port_len == 0)) {
+        return false;
+    }
+
+    memcpy(host, start, name_len);
+    host[name_len] = '\0';
+    if (colon) {
+        memcpy(port, colon + 1, port_len);
+        port[port_len] = '\0';
+    } else {
+        strcpy(port, https ? "443" : "80");
+    }
+
+    struct in_addr v4;
+    return inet_pton(AF_INET, host, &v4) != 1;
+}
+
+/* Resolve into a comma-separated address list ("a,b,[c]") */
+static int dns_lookup(const char *host, const char *port, char *addrs, size_t addrs_len) {
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(host, port, &hints, &res) != 0 || res == NULL) {
+        return -EHOSTUNREACH;
+    }
+
+    size_t used = 0;
+    addrs[0] = '\0';
+    for (struct addrinfo *ai = res; ai; ai = ai->ai_next) {
+        char text[INET6_ADDRSTRLEN];
+        const void *src;
+        if (ai->ai_family == AF_INET) {
+            src = &((const struct sockaddr_in *)(const void *)ai->ai_addr)->sin_addr;
+        } else if (ai->ai_family == AF_INET6) {
+            src = &((const struct sockaddr_in6 *)(const void *)ai->ai_addr)->sin6_addr;
+        } else {
+            continue;
+        }
+        if (inet_ntop(ai->ai_family, src, text, sizeof(text)) == NULL) {
+            continue;
+        }
+
+        int n = snprintf(addrs + used, addrs_len - used,
+                         ai->ai_family == AF_INET6 ? "%s[%s]" : "%s%s",
+                         used ? "," : "", text);
+        if (n < 0 || (size_t)n >= addrs_len - used) {
+            addrs[used] = '\0';
+            break;
+        }
+        used += (size_t)n;
+    }
+
+    freeaddrinfo(res);
+    return used > 0 ? 0 : -EHOSTUNREACH;
+}
+
+/* Find the entry for host:port, or take a free or least recently used one */
+static dns_entry_t *dns_entry_get_locked(chunks_dns_cache_t *cache, const char *host,
+                                         const char *port) {
+    dns_entry_t *victim = NULL;
+
+    for (size_t i = 0; i < cache->count; i++) {
+        dns_entry_t *entry = &cache->entries[i];
+        if (strcmp(entry->host, host) == 0 && strcmp(entry->port, port) == 0) {
+            return entry;
+        }
+        if (!entry->busy && (victim == NULL || entry->used_ms < victim->used_ms)) {
+            victim = entry;
+        }
+    }
+
+    if (cache->count < CHUNKS_DNS_MAX_HOSTS) {
+        victim = &cache->entries[cache->count++];
+    } else if (victim == NULL) {
+        return NULL;
+    } else {
+        memset(victim, 0, sizeof(*victim));
+    }
+
+    snprintf(victim->host, sizeof(victim->host), "%s", host);
+    snprintf(victim->port, sizeof(victim->port), "%s", port);
+    return victim;
+}
+
+/* Resolve list for the current addresses, owned by the caller */
+static struct curl_slist *dns_entry_resolve_locked(const dns_entry_t *entry) {
+    char line[CHUNKS_MAX_ORIGIN_LEN + DNS_PORT_LEN + CHUNKS_DNS_MAX_ADDRS_LEN + 4];
+    snprintf(line, sizeof(line), "+%s:%s:%s", entry->host, entry->port, entry->addrs);
+    return curl_slist_append(NULL, line);
+}
+
+static void *dns_worker(void *arg) {
+    chunks_dns_cache_t *cache = arg;
+
+    pthread_mutex_lock(&cache->lock);
+    while (!cache->stopping) {
+        dns_entry_t *entry = NULL;
+        for (size_t i = 0; i < cache->count && entry == NULL; i++) {
+            if (cache->entries[i].wanted) {
+                entry = &cache->entries[i];
+            }
+        }
+        if (entry == NULL) {
+            pthread_cond_wait(&cache->wake, &cache->lock);
+            continue;
+        }
+
+        char host[CHUNKS_MAX_ORIGIN_LEN];
+        char port[DNS_PORT_LEN];
+        char addrs[CHUNKS_DNS_MAX_ADDRS_LEN];
+        memcpy(host, entry->host, sizeof(host));
+        memcpy(port, entry->port, sizeof(port));
+        entry->wanted = false;
+        entry->busy = true;
+        pthread_mutex_unlock(&cache->lock);
+
+        uint64_t start = dns_now_us();
+        int ret = dns_lookup(host, port, addrs, sizeof(addrs));
+        uint64_t elapsed = dns_now_us() - start;
+
+        pthread_mutex_lock(&cache->lock);
+        entry->busy = false;
+        cache->stats.lookups++;
+        cache->stats.last_lookup_us = elapsed;
+        cache->stats.total_lookup_us += elapsed;
+        if (elapsed > cache->stats.max_lookup_us) {
+            cache->stats.max_lookup_us = elapsed;
+        }
+
+        if (ret < 0) {
+            cache->stats.lookup_failures++;
+            entry->retry_ms = chunks_now_ms() + DNS_RETRY_MS;
+            continue;
+        }
+        memcpy(entry->addrs, addrs, sizeof(addrs));
+        entry->resolved_ms = chunks_now_ms();
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    return NULL;
+}
+
+/* ============================================================================
+ * Cache Lifecycle
+ * ========================================================================== */
+
+int chunks_dns_open(uint32_t ttl_s, uint32_t max_stale_s, chunks_dns_cache_t **cache) {
+    chunks_dns_cache_t *c = calloc(1, sizeof(*c));
+    if (c == NULL) {
+        return -ENOMEM;
+    }
+
+    c->ttl_ms = (uint64_t)ttl_s * 1000u;
+    c->max_stale_ms = (uint64_t)max_stale_s * 1000u;
+
+    if (pthread_mutex_init(&c->lock, NULL) != 0) {
+        free(c);
+        return -ENOMEM;
+    }
+    if (pthread_cond_init(&c->wake, NULL) != 0) {
+        pthread_mutex_destroy(&c->lock);
+        free(c);
+        return -ENOMEM;
+    }
+
+    int err = pthread_create(&c->thread, NULL, dns_worker, c);
+    if (err != 0) {
+        pthread_cond_destroy(&c->wake);
+        pthread_mutex_destroy(&c->lock);
+        free(c);
+        return -err;
+    }
+
+    *cache = c;
+    return 0;
+}
+
+void chunks_dns_close(chunks_dns_cache_t *cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    cache->stopping = true;
+    pthread_cond_signal(&cache->wake);
+    pthread_mutex_unlock(&cache->lock);
+    pthread_join(cache->thread, NULL);
+
+    pthread_cond_destroy(&cache->wake);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+/* ============================================================================
+ * Upload Hooks
+ * ========================================================================== */
+
+void chunks_dns_apply(chunks_uploader_t *uploader, CURL *curl, const char *url,
+                      struct curl_slist **resolve) {
+    chunks_dns_cache_t *cache = uploader->dns_cache;
+    char host[CHUNKS_MAX_ORIGIN_LEN];
+    char port[DNS_PORT_LEN];
+
+    *resolve = NULL;
+    if (cache == NULL || !dns_parse_url(url, host, sizeof(host), port)) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    dns_entry_t *entry = dns_entry_get_locked(cache, host, port);
+    if (entry == NULL) {
+        cache->stats.misses++;
+        pthread_mutex_unlock(&cache->lock);
+        return;
+    }
+
+    uint64_t now = chunks_now_ms();
+    uint64_t age = now - entry->resolved_ms;
+    bool usable = entry->addrs[0] != '\0';
+    entry->used_ms = now;
+
+    if (usable && age < cache->ttl_ms) {
+        cache->stats.fresh_hits++;
+    } else {
+        if (usable && age < cache->ttl_ms + cache->max_stale_ms) {
+            cache->stats.stale_hits++;
+        } else {
+            cache->stats.misses++;
+            usable = false;
+        }
+        if (!entry->busy && !entry->wanted && now >= entry->retry_ms) {
+            entry->wanted = true;
+            pthread_cond_signal(&cache->wake);
+        }
+    }
+
+    if (usable) {
+        *resolve = dns_entry_resolve_locked(entry);
+        if (*resolve) {
+            curl_easy_setopt(curl, CURLOPT_RESOLVE, *resolve);
+        }
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void chunks_dns_record(chunks_uploader_t *uploader, CURL *curl) {
+    chunks_dns_cache_t *cache = uploader->dns_cache;
+    curl_off_t lookup_us = 0;
+
+    if (cache == NULL || curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &lookup_us) != CURLE_OK ||
+        lookup_us <= 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    cache->stats.transfer_lookup_us += (uint64_t)lookup_us;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/* ============================================================================
+ * Public API
+ * ========================================================================== */
+
+int chunks_uploader_set_dns_cache(chunks_uploader_t *uploader, uint32_t ttl_s,
+                                  uint32_t max_stale_s) {
+    if (uploader == NULL) {
+        return -EINVAL;
+    }
+
+    if (chunks_uploader_pending(uploader) > 0) {
+        return -EBUSY;
+    }
+
+    chunks_dns_cache_t *cache = NULL;
+    if (ttl_s > 0) {
+        int ret = chunks_dns_open(ttl_s, max_stale_s, &cache);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    chunks_dns_close(uploader->dns_cache);
+    uploader->dns_cache = cache;
+    return 0;
+}
+
+int chunks_uploader_get_dns_stats(chunks_uploader_t *uploader, chunks_dns_stats_t *stats) {
+    if (uploader == NULL || stats == NULL) {
+        return -EINVAL;
+    }
+
+    chunks_dns_cache_t *cache = uploader->dns_cache;
+    if (cache == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return 0;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    *stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+    return 0;
+}
@@ -0,0 +1,296 @@
+/**
+ * @file chunks_endpoints.c
+ * @brief Multi-endpoint failover with EWMA health scoring
+ *
+ * Each failover group is an ordered list of equivalent origins. Requests for
+ * URIs under the primary origin are routed to the healthiest endpoint, scored
+ * as EWMA latency weighted by EWMA error rate. The primary wins ties (within
+ * a hysteresis margin) and is probed periodically while failed over, so
+ * traffic returns to it once it recovers.
+ */
+
+#include "chunks_uploader_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+
+/* EWMA smoothing factor for latency and error rate */
+#define CHUNKS_EWMA_ALPHA                   0.2
+
+/* score = latency * (1 + weight * error_rate) */
+#define CHUNKS_ERROR_WEIGHT                 4.0
+
+/* Primary is preferred while its score is within this margin of the best */
+#define CHUNKS_PRIMARY_HYSTERESIS           0.25
+
+/* Primary is only preferred while its error rate is below this */
+#define CHUNKS_HEALTHY_ERROR_RATE           0.5
+
+/* ============================================================================
+ * Internal Helper Functions
+ * ========================================================================== */
+
+uint64_t chunks_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static double endpoint_score(const chunks_endpoint_t *e) {
+    return e->latency_ms * (1.0 + CHUNKS_ERROR_WEIGHT * e->error_rate);
+}
+
+/* Rank: available+measured by score, then available+unmeasured in list
+ * order, then endpoints still backing off by expiry */
+static int endpoint_rank(const chunks_endpoint_t *e, uint64_t now) {
+    if (e->down_until_ms > now) {
+        return 2;
+    }
+    return e->measured ? 0 : 1;
+}
+
+static bool endpoint_before(const chunks_endpoint_group_t *group,
+                            size_t a, size_t b, uint64_t now) {
+    const chunks_endpoint_t *ea = &group->endpoints[a];
+    const chunks_endpoint_t *eb = &group->endpoints[b];
+    int ra = endpoint_rank(ea, now);
+    int rb = endpoint_rank(eb, now);
+
+    if (ra != rb) {
+        return ra < rb;
+    }
+    if (ra == 0 && endpoint_score(ea) != endpoint_score(eb)) {
+        return endpoint_score(ea) < endpoint_score(eb);
+    }
+    if (ra == 2 && ea->down_until_ms != eb->down_until_ms) {
+        return ea->down_until_ms < eb->down_until_ms;
+    }
+    return a < b;
+}
+
+static void move_to_front(size_t *order, size_t count, size_t index) {
+    for (size_t i = 0; i < count; i++) {
+        if (order[i] == index) {
+            memmove(&order[1], &order[0], i * sizeof(order[0]));
+            order[0] = index;
+            return;
+        }
+    }
+}
+
+/* Length of the scheme://authority prefix of url */
+static size_t origin_length(const char *url) {
+    const char *authority = strstr(url, "://");
+    if (authority == NULL) {
+        return 0;
+    }
+    authority += 3;
+    return (size_t)(authority - url) + strcspn(authority, "/?#");
+}
+
+/* ============================================================================
+ * Endpoint Groups
+ * ========================================================================== */
+
+chunks_endpoint_group_t *chunks_endpoints_find(chunks_uploader_t *uploader,
+                                               const char *uri) {
+    for (size_t i = 0; i < uploader->group_count; i++) {
+        chunks_endpoint_group_t *group = &uploader->groups[i];
+        const char *primary = group->endpoints[0].origin;
+        size_t len = strlen(primary);
+
+        if (origin_length(uri) == len && strncasecmp(uri, primary, len) == 0) {
+            return group;
+        }
+    }
+    return NULL;
+}
+
+size_t chunks_endpoints_route(chunks_uploader_t *uploader,
+                              chunks_endpoint_group_t *group,
+                              size_t *order) {
+    uint64_t now = chunks_now_ms();
+    size_t count = group->count;
+
+    /* Insertion sort; groups are tiny */
+    for (size_t i = 0; i < count; i++) {
+        size_t j = i;
+        order[i] = i;
+        while (j > 0 && endpoint_before(group, order[j], order[j - 1], now)) {
+            size_t tmp = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = tmp;
+            j--;
+        }
+    }
+
+    const chunks_endpoint_t *primary = &group->endpoints[0];
+    if (order[0] == 0 || primary->down_until_ms > now) {
+        return count;
+    }
+
+    /* Prefer a healthy primary that is close enough to the best */
+    const chunks_endpoint_t *best = &group->endpoints[order[0]];
+    if (primary->measured && best->measured &&
+        primary->error_rate < CHUNKS_HEALTHY_ERROR_RATE &&
+        endpoint_score(primary) <= endpoint_score(best) * (1.0 + CHUNKS_PRIMARY_HYSTERESIS)) {
+        move_to_front(order, count, 0);
+        return count;
+    }
+
+    /* Otherwise send an occasional probe so recovery is noticed */
+    if (now - group->last_probe_ms >= (uint64_t)uploader->probe_interval_ms) {
+        group->last_probe_ms = now;
+        move_to_front(order, count, 0);
+    }
+
+    return count;
+}
+
+void chunks_endpoints_report(chunks_uploader_t *uploader,
+                             chunks_endpoint_t *endpoint,
+                             bool ok, double latency_ms) {
+    double error = ok ? 0.0 : 1.0;
+
+    if (!endpoint->measured) {
+        /* Start from a healthy prior so one failure does not bury an endpoint */
+        endpoint->latency_ms = latency_ms;
+        endpoint->error_rate = CHUNKS_EWMA_ALPHA * error;
+        endpoint->measured = true;
+    } else {
+        endpoint->latency_ms += CHUNKS_EWMA_ALPHA * (latency_ms - endpoint->latency_ms);
+        endpoint->error_rate += CHUNKS_EWMA_ALPHA * (error - endpoint->error_rate);
+    }
+
+    endpoint->requests++;
+    if (ok) {
+        endpoint->consecutive_failures = 0;
+        endpoint->down_until_ms = 0;
+        return;
+    }
+
+    endpoint->failures++;
+    endpoint->consecutive_failures++;
+
+    /* Exponential back-off based on the probe interval */
+    unsigned int shift = endpoint->consecutive_failures - 1;
+    uint64_t backoff = (uint64_t)uploader->probe_interval_ms << (shift > 10 ? 10 : shift);
+    if (backoff > CHUNKS_ENDPOINT_MAX_BACKOFF_MS) {
+        backoff = CHUNKS_ENDPOINT_MAX_BACKOFF_MS;
+    }
+    endpoint->down_until_ms = backoff ? chunks_now_ms() + backoff : 0;
+}
+
+int chunks_endpoints_rewrite(const chunks_endpoint_group_t *group,
+                             const chunks_endpoint_t *endpoint,
+                             const char *uri, char *out, size_t out_len) {
+    const char *path = uri + strlen(group->endpoints[0].origin);
+    size_t origin_len = strlen(endpoint->origin);
+    size_t path_len = strlen(path);
+
+    if (origin_len + path_len + 1 > out_len) {
+        return -ENAMETOOLONG;
+    }
+
+    memcpy(out, endpoint->origin, origin_len);
+    memcpy(out + origin_len, path, path_len + 1);
+    return 0;
+}
+
+void chunks_endpoints_free(chunks_uploader_t *uploader) {
+    free(uploader->groups);
+    uploader->groups = NULL;
+    uploader->group_count = 0;
+}
+
+/* ============================================================================
+ * Public API
+ * ========================================================================== */
+
+int chunks_uploader_set_endpoints(chunks_uploader_t *uploader,
+                                  const char *const *origins,
+                                  size_t count) {
+    if (uploader == NULL || origins == NULL || count == 0 ||
+        count > CHUNKS_MAX_ENDPOINTS) {
+        return -EINVAL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (origins[i] == NULL || origin_length(origins[i]) == 0 ||
+            origin_length(origins[i]) != strlen(origins[i]) ||
+            strlen(origins[i]) >= CHUNKS_MAX_ORIGIN_LEN) {
+            return -EINVAL;
+        }
+    }
+
+    /* Replace an existing group for the same primary */
+    chunks_endpoint_group_t *group = chunks_endpoints_find(uploader, origins[0]);
+    if (group == NULL) {
+        chunks_endpoint_group_t *groups = realloc(uploader->groups,
+                                                  (uploader->group_count + 1) * sizeof(*groups));
+        if (groups == NULL) {
+            return -ENOMEM;
+        }
+        uploader->groups = groups;
+        group = &groups[uploader->group_count++];
+    }
+
+    memset(group, 0, sizeof(*group));
+    for (size_t i = 0; i < count; i++) {
+        strcpy(group->endpoints[i].origin, origins[i]);
+    }
+    group->count = count;
+
+    return 0;
+}
+
+int chunks_uploader_set_probe_interval(chunks_uploader_t *uploader,
+                                       long probe_interval_ms) {
+    if (uploader == NULL || probe_interval_ms < 0) {
+        return -EINVAL;
+    }
+
+    uploader->probe_interval_ms = probe_interval_ms;
+    return 0;
+}
+
+int chunks_uploader_get_endpoint_stats(chunks_uploader_t *uploader,
+                                       const char *primary_origin,
+                                       chunks_endpoint_stats_t *stats,
+                                       size_t max_stats,
+                                       size_t *count) {
+    if (count) {
+        *count = 0;
+    }
+
+    if (uploader == NULL || primary_origin == NULL || stats == NULL || count == NULL) {
+        return -EINVAL;
+    }
+
+    chunks_endpoint_group_t *group = chunks_endpoints_find(uploader, primary_origin);
+    if (group == NULL) {
+        return -ENOENT;
+    }
+
+    size_t total = 0;
+    for (size_t i = 0; i < group->count; i++) {
+        total += group->endpoints[i].requests;
+    }
+
+    size_t n = group->count < max_stats ? group->count : max_stats;
+    for (size_t i = 0; i < n; i++) {
+        const chunks_endpoint_t *e = &group->endpoints[i];
+        memcpy(stats[i].origin, e->origin, sizeof(stats[i].origin));
+        stats[i].primary = (i == 0);
+        stats[i].requests = e->requests;
+        stats[i].failures = e->failures;
+        stats[i].latency_ms = e->latency_ms;
+        stats[i].error_rate = e->error_rate;
+        stats[i].share = total ? (double)e->requests / (double)total : 0.0;
+    }
+
+    *count = n;
+    return 0;
+}
@@ -0,0 +1,248 @@
+/**
+ * @file chunks_pool.c
+ * @brief Connection pool shared by uploaders
+ *
+ * The pool is a libcurl share handle holding the connection cache, DNS
+ * cache and TLS sessions. libcurl matches cached connections on scheme,
+ * host and port only, and the authorization header is sent per request, so
+ * every uploader attached to the pool reuses the same few connections no
+ * matter which project key a chunk carries. The pool also counts requests
+ * and newly opened connections per origin.
+ *
+ * libcurl does not support a connection cache shared between concurrent
+ * threads, so the uploaders of one pool must all run on the same thread.
+ */
+
+#include "chunks_uploader_internal.h"
+#include <curl/curl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <errno.h>
+
+/* Origins tracked for statistics */
+#define CHUNKS_POOL_MAX_HOSTS       32
+
+typedef struct {
+    char origin[CHUNKS_MAX_ORIGIN_LEN];
+    size_t requests;
+    size_t connections_opened;
+} chunks_pool_host_t;
+
+struct chunks_pool {
+    CURLSH *share;
+    long max_connections;
+
+    /* One lock per shared data kind, as libcurl may lock several at once */
+    pthread_mutex_t locks[CURL_LOCK_DATA_LAST];
+
+    pthread_mutex_t stats_lock;
+    chunks_pool_host_t hosts[CHUNKS_POOL_MAX_HOSTS];
+    size_t host_count;
+    unsigned int uploaders;
+};
+
+/* ============================================================================
+ * Share Locking
+ * ========================================================================== */
+
+static void pool_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr) {
+    (void)handle;
+    (void)access;
+    chunks_pool_t *pool = (chunks_pool_t *)userptr;
+    pthread_mutex_lock(&pool->locks[data]);
+}
+
+static void pool_unlock(CURL *handle, curl_lock_data data, void *userptr) {
+    (void)handle;
+    chunks_pool_t *pool = (chunks_pool_t *)userptr;
+    pthread_mutex_unlock(&pool->locks[data]);
+}
+
+/* ============================================================================
+ * Internal Helper Functions
+ * ========================================================================== */
+
+/* Normalize "scheme://host[:port]/..." to "scheme://host:port" (lowercase) */
+static int pool_origin(const char *url, char *out, size_t out_len) {
+    const char *sep = strstr(url, "://");
+    if (sep == NULL) {
+        return -EINVAL;
+    }
+
+    size_t scheme_len = (size_t)(sep - url);
+    const char *host = sep + 3;
+    size_t host_len = strcspn(host, ":/?#");
+    const char *port = NULL;
+    size_t port_len = 0;
+    if (host[host_len] == ':') {
+        port = host + host_len + 1;
+        port_len = strcspn(port, "/?#");
+    }
+
+    const char *default_port = (scheme_len == 5 && strncasecmp(url, "https", 5) == 0) ? "443" : "80";
+    int len = snprintf(out, out_len, "%.*s://%.*s:%.*s",
+                       (int)scheme_len, url, (int)host_len, host,
+                       port ? (int)port_len : (int)strlen(default_port),
+                       port ? port : default_port);
+    if (len < 0 || (size_t)len >= out_len) {
+        return -ENAMETOOLONG;
+    }
+
+    for (char *p = out; *p; p++) {
+        *p = (char)tolower((unsigned char)*p);
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * Uploader Integration
+ * ========================================================================== */
+
+void chunks_pool_apply(chunks_pool_t *pool, CURL *curl) {
+    curl_easy_setopt(curl, CURLOPT_SHARE, pool->share);
+    curl_easy_setopt(curl, CURLOPT_MAXCONNECTS, pool->max_connections);
+}
+
+void chunks_pool_record(chunks_pool_t *pool, CURL *curl, const char *url) {
+    char origin[CHUNKS_MAX_ORIGIN_LEN];
+    if (pool_origin(url, origin, sizeof(origin)) < 0) {
+        return;
+    }
+
+    long connects = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+
+    pthread_mutex_lock(&pool->stats_lock);
+
+    chunks_pool_host_t *host = NULL;
+    for (size_t i = 0; i < pool->host_count; i++) {
+        if (strcmp(pool->hosts[i].origin, origin) == 0) {
+            host = &pool->hosts[i];
+            break;
+        }
+    }
+    if (host == NULL && pool->host_count < CHUNKS_POOL_MAX_HOSTS) {
+        host = &pool->hosts[pool->host_count++];
+        strcpy(host->origin, origin);
+    }
+    if (host) {
+        host->requests++;
+        host->connections_opened += (size_t)(connects > 0 ? connects : 0);
+    }
+
+    pthread_mutex_unlock(&pool->stats_lock);
+}
+
+void chunks_pool_attach(chunks_pool_t *pool, bool attach) {
+    pthread_mutex_lock(&pool->stats_lock);
+    if (attach) {
+        pool->uploaders++;
+    } else {
+        pool->uploaders--;
+    }
+    pthread_mutex_unlock(&pool->stats_lock);
+}
+
+/* ============================================================================
+ * Public API
+ * ========================================================================== */
+
+chunks_pool_t *chunks_pool_create(unsigned int max_connections) {
+    chunks_pool_t *pool = calloc(1, sizeof(*pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pool->share = curl_share_init();
+    if (pool->share == NULL) {
+        free(pool);
+        return NULL;
+    }
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&pool->locks[i], NULL);
+    }
+    pthread_mutex_init(&pool->stats_lock, NULL);
+    pool->max_connections = max_connections ? (long)max_connections : CHUNKS_POOL_DEFAULT_CONNECTIONS;
+
+    curl_share_setopt(pool->share, CURLSHOPT_LOCKFUNC, pool_lock);
+    curl_share_setopt(pool->share, CURLSHOPT_UNLOCKFUNC, pool_unlock);
+    curl_share_setopt(pool->share, CURLSHOPT_USERDATA, pool);
+    curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(pool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+    return pool;
+}
+
+int chunks_pool_destroy(chunks_pool_t *pool) {
+    if (pool == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->stats_lock);
+    unsigned int uploaders = pool->uploaders;
+    pthread_mutex_unlock(&pool->stats_lock);
+    if (uploaders > 0) {
+        return -EBUSY;
+    }
+
+    curl_share_cleanup(pool->share);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_destroy(&pool->locks[i]);
+    }
+    pthread_mutex_destroy(&pool->stats_lock);
+    free(pool);
+    return 0;
+}
+
+int chunks_uploader_set_pool(chunks_uploader_t *uploader, chunks_pool_t *pool) {
+    if (uploader == NULL) {
+        return -EINVAL;
+    }
+
+    if (chunks_uploader_pending(uploader) > 0) {
+        return -EBUSY;
+    }
+
+    if (uploader->pool) {
+        chunks_pool_attach(uploader->pool, false);
+    }
+    if (pool) {
+        chunks_pool_attach(pool, true);
+    }
+    uploader->pool = pool;
+
+    /* The private connection cache is no longer used; let it go */
+    if (uploader->curl) {
+        CURL *fresh = curl_easy_init();
+        if (fresh) {
+            curl_easy_cleanup(uploader->curl);
+            uploader->curl = fresh;
+        }
+    }
+    return 0;
+}
+
+int chunks_pool_get_stats(chunks_pool_t *pool, chunks_pool_stats_t *stats) {
+    if (pool == NULL || stats == NULL) {
+        return -EINVAL;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+
+    pthread_mutex_lock(&pool->stats_lock);
+    stats->hosts = pool->host_count;
+    stats->uploaders = pool->uploaders;
+    for (size_t i = 0; i < pool->host_count; i++) {
+        stats->requests += pool->hosts[i].requests;
+        stats->connections_opened += pool->hosts[i].connections_opened;
+    }
+    pthread_mutex_unlock(&pool->stats_lock);
+
+    return 0;
+}
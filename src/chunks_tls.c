@@ -0,0 +1,470 @@
+/**
+ * @file chunks_tls.c
+ * @brief TLS sessions persisted across uploader restarts
+ *
+ * libcurl 8.12+ can export the TLS sessions (tickets) it holds and import
+ * them into another handle (looked up at run time when the headers are
+ * older, see CHUNKS_HAVE_TLS_EXPORT). The uploader keeps the exported sessions in
+ * memory, writes them to a small file after a new connection brought a new
+ * session (at most every CHUNKS_TLS_SAVE_INTERVAL_MS, and on close), and
+ * imports them before the first request of a new uploader, so that its
+ * first connection resumes instead of paying a full handshake.
+ *
+ * Sessions go through a share handle: the pool's when the uploader has
+ * one, otherwise a private share owned by the cache, so blocking and
+ * event-loop handles see the same sessions.
+ *
+ * File format, integers little-endian: "MDSTLS1\n", then per session
+ *   u64 expiry (Unix seconds), u16 key length, u16 shmac length,
+ *   u32 data length, key, shmac, data
+ */
+
+#include "chunks_uploader_internal.h"
+#include <curl/curl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if CHUNKS_HAVE_TLS_EXPORT
+
+#define TLS_FILE_MAGIC          "MDSTLS1\n"
+#define TLS_FILE_MAGIC_LEN      8
+#define TLS_RECORD_HEADER_LEN   16
+
+/* Larger files are not ours */
+#define TLS_FILE_MAX_SIZE       (1024 * 1024)
+
+typedef struct {
+    char *key;                  /* NULL when only the hashed key is known */
+    uint8_t *shmac;
+    size_t shmac_len;
+    uint8_t *data;
+    size_t data_len;
+    uint64_t expires_s;
+} chunks_tls_session_t;
+
+typedef struct {
+    chunks_tls_session_t sessions[CHUNKS_TLS_MAX_SESSIONS];
+    size_t count;
+} chunks_tls_set_t;
+
+struct chunks_tls_cache {
+    char *path;
+    uint32_t max_age_s;
+    CURLSH *share;              /* Used when the uploader has no pool */
+    const void *imported_into;  /* Share (or pool) holding the loaded sessions */
+
+    chunks_tls_set_t set;
+    bool dirty;
+    uint64_t last_save_ms;
+};
+
+/* ============================================================================
+ * Session Sets
+ * ========================================================================== */
+
+static uint64_t wall_time_s(void) {
+    return (uint64_t)time(NULL);
+}
+
+static void set_clear(chunks_tls_set_t *set) {
+    for (size_t i = 0; i < set->count; i++) {
+        free(set->sessions[i].key);
+        free(set->sessions[i].shmac);
+        free(set->sessions[i].data);
+    }
+    set->count = 0;
+}
+
+/* Add a copy of a session, replacing the one closest to expiry when full */
+static int set_add(chunks_tls_set_t *set, const char *key, size_t key_len, const uint8_t *shmac,
+                   size_t shmac_len, const uint8_t *data, size_t data_len, uint64_t expires_s) {
+    chunks_tls_session_t s = {0};
+
+    s.key = key ? malloc(key_len + 1) : NULL;
+    s.shmac = shmac_len ? malloc(shmac_len) : NULL;
+    s.data = malloc(data_len ? data_len : 1);
+    if ((key && s.key == NULL) || (shmac_len && s.shmac == NULL) || s.data == NULL) {
+        free(s.key);
+        free(s.shmac);
+        free(s.data);
+        return -ENOMEM;
+    }
+
+    if (key) {
+        memcpy(s.key, key, key_len);
+        s.key[key_len] = '\0';
+    }
+    if (shmac_len) {
+        memcpy(s.shmac, shmac, shmac_len);
+    }
+    memcpy(s.data, data, data_len);
+    s.shmac_len = shmac_len;
+    s.data_len = data_len;
+    s.expires_s = expires_s;
+
+    size_t slot = set->count;
+    if (slot == CHUNKS_TLS_MAX_SESSIONS) {
+        slot = 0;
+        for (size_t i = 1; i < set->count; i++) {
+            if (set->sessions[i].expires_s < set->sessions[slot].expires_s) {
+                slot = i;
+            }
+        }
+        free(set->sessions[slot].key);
+        free(set->sessions[slot].shmac);
+        free(set->sessions[slot].data);
+    } else {
+        set->count++;
+    }
+    set->sessions[slot] = s;
+    return 0;
+}
+
+/* ============================================================================
+ * Cache File
+ * ========================================================================== */
+
+static void put_le(uint8_t *p, uint64_t v, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint64_t get_le(const uint8_t *p, size_t bytes) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        v |= (uint64_t)p[i] << (8 * i);
+    }
+    return v;
+}
+
+static bool write_field(FILE *f, const void *p, size_t len) {
+    return len == 0 || fwrite(p, 1, len, f) == len;
+}
+
+static void tls_load(chunks_tls_cache_t *cache) {
+    FILE *f = fopen(cache->path, "rb");
+    if (f == NULL) {
+        return;
+    }
+
+    uint8_t *buf = malloc(TLS_FILE_MAX_SIZE);
+    size_t len = buf ? fread(buf, 1, TLS_FILE_MAX_SIZE, f) : 0;
+    fclose(f);
+
+    if (len < TLS_FILE_MAGIC_LEN || memcmp(buf, TLS_FILE_MAGIC, TLS_FILE_MAGIC_LEN) != 0) {
+        free(buf);
+        return;
+    }
+
+    uint64_t now = wall_time_s();
+    size_t pos = TLS_FILE_MAGIC_LEN;
+    while (len - pos >= TLS_RECORD_HEADER_LEN) {
+        const uint8_t *h = buf + pos;
+        uint64_t expires_s = get_le(h, 8);
+        size_t key_len = (size_t)get_le(h + 8, 2);
+        size_t shmac_len = (size_t)get_le(h + 10, 2);
+        size_t data_len = (size_t)get_le(h + 12, 4);
+        pos += TLS_RECORD_HEADER_LEN;
+        if (len - pos < key_len + shmac_len + data_len) {
+            break;
+        }
+
+        const char *key = (const char *)buf + pos;
+        const uint8_t *shmac = buf + pos + key_len;
+        const uint8_t *data = shmac + shmac_len;
+        pos += key_len + shmac_len + data_len;
+
+        if (expires_s > now) {
+            set_add(&cache->set, key_len ? key : NULL, key_len, shmac, shmac_len,
+                    data, data_len, expires_s);
+        }
+    }
+    free(buf);
+}
+
+/* Write to a temporary file and rename, so a crash never leaves half a file */
+static int tls_save(chunks_tls_cache_t *cache) {
+    size_t path_len = strlen(cache->path);
+    char *tmp = malloc(path_len + 5);
+    if (tmp == NULL) {
+        return -ENOMEM;
+    }
+    memcpy(tmp, cache->path, path_len);
+    memcpy(tmp + path_len, ".tmp", 5);
+
+    /* Tickets let anyone resume the session: keep the file private */
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    FILE *f = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (f == NULL) {
+        int err = -errno;
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(tmp);
+        return err;
+    }
+
+    uint64_t now = wall_time_s();
+    bool ok = fwrite(TLS_FILE_MAGIC, 1, TLS_FILE_MAGIC_LEN, f) == TLS_FILE_MAGIC_LEN;
+    for (size_t i = 0; ok && i < cache->set.count; i++) {
+        const chunks_tls_session_t *s = &cache->set.sessions[i];
+        size_t key_len = s->key ? strlen(s->key) : 0;
+        if (s->expires_s <= now || key_len > UINT16_MAX || s->shmac_len > UINT16_MAX ||
+            s->data_len > UINT32_MAX) {
+            continue;
+        }
+
+        uint8_t h[TLS_RECORD_HEADER_LEN];
+        put_le(h, s->expires_s, 8);
+        put_le(h + 8, key_len, 2);
+        put_le(h + 10, s->shmac_len, 2);
+        put_le(h + 12, s->data_len, 4);
+        ok = write_field(f, h, sizeof(h)) && write_field(f, s->key, key_len) &&
+             write_field(f, s->shmac, s->shmac_len) && write_field(f, s->data, s->data_len);
+    }
+
+    ok = fclose(f) == 0 && ok;
+    int ret = ok && rename(tmp, cache->path) == 0 ? 0 : -EIO;
+    if (ret < 0) {
+        remove(tmp);
+    }
+    free(tmp);
+
+    if (ret == 0) {
+        cache->dirty = false;
+        cache->last_save_ms = chunks_now_ms();
+    }
+    return ret;
+}
+
+/* ============================================================================
+ * libcurl Session Export
+ * ========================================================================== */
+
+typedef struct {
+    chunks_tls_set_t *set;
+    uint64_t max_expiry_s;
+} tls_export_ctx_t;
+
+static CURLcode tls_export_cb(CURL *handle, void *userptr, const char *session_key,
+                              const unsigned char *shmac, size_t shmac_len,
+                              const unsigned char *sdata, size_t sdata_len,
+                              curl_off_t valid_until, int ietf_tls_id, const char *alpn,
+                              size_t earlydata_max) {
+    tls_export_ctx_t *ctx = userptr;
+    (void)handle;
+    (void)ietf_tls_id;
+    (void)alpn;
+    (void)earlydata_max;
+
+    uint64_t expires_s = ctx->max_expiry_s;
+    if (valid_until > 0 && (uint64_t)valid_until < expires_s) {
+        expires_s = (uint64_t)valid_until;
+    }
+    set_add(ctx->set, session_key, session_key ? strlen(session_key) : 0,
+            shmac, shmac_len, sdata, sdata_len, expires_s);
+    return CURLE_OK;
+}
+
+static CURLcode tls_probe_cb(CURL *handle, void *userptr, const char *session_key,
+                             const unsigned char *shmac, size_t shmac_len,
+                             const unsigned char *sdata, size_t sdata_len,
+                             curl_off_t valid_until, int ietf_tls_id, const char *alpn,
+                             size_t earlydata_max) {
+    (void)handle;
+    (void)userptr;
+    (void)session_key;
+    (void)shmac;
+    (void)shmac_len;
+    (void)sdata;
+    (void)sdata_len;
+    (void)valid_until;
+    (void)ietf_tls_id;
+    (void)alpn;
+    (void)earlydata_max;
+    return CURLE_OK;
+}
+
+/* ============================================================================
+ * Internal API
+ * ========================================================================== */
+
+int chunks_tls_open(const char *path, uint32_t max_age_s, CURL *probe,
+                    chunks_tls_cache_t **cache) {
+    if (!CHUNKS_TLS_EXPORT_LINKED() ||
+        (probe && curl_easy_ssls_export(probe, tls_probe_cb, NULL) == CURLE_NOT_BUILT_IN)) {
+        return -ENOTSUP;
+    }
+
+    chunks_tls_cache_t *c = calloc(1, sizeof(*c));
+    if (c == NULL) {
+        return -ENOMEM;
+    }
+
+    size_t path_len = strlen(path) + 1;
+    c->path = malloc(path_len);
+    c->share = curl_share_init();
+    if (c->path == NULL || c->share == NULL) {
+        if (c->share) {
+            curl_share_cleanup(c->share);
+        }
+        free(c->path);
+        free(c);
+        return -ENOMEM;
+    }
+    memcpy(c->path, path, path_len);
+    c->max_age_s = max_age_s ? max_age_s : CHUNKS_TLS_DEFAULT_MAX_AGE_S;
+    curl_share_setopt(c->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+    tls_load(c);
+    *cache = c;
+    return 0;
+}
+
+void chunks_tls_close(chunks_tls_cache_t *cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    if (cache->dirty) {
+        tls_save(cache);
+    }
+    set_clear(&cache->set);
+    curl_share_cleanup(cache->share);
+    free(cache->path);
+    free(cache);
+}
+
+void chunks_tls_apply(chunks_uploader_t *uploader, CURL *curl) {
+    chunks_tls_cache_t *cache = uploader->tls_cache;
+    if (cache == NULL) {
+        return;
+    }
+
+    const void *target = cache->share;
+    if (uploader->pool) {
+        target = uploader->pool;
+    } else {
+        curl_easy_setopt(curl, CURLOPT_SHARE, cache->share);
+    }
+
+    if (cache->imported_into == target) {
+        return;
+    }
+
+    uint64_t now = wall_time_s();
+    for (size_t i = 0; i < cache->set.count; i++) {
+        const chunks_tls_session_t *s = &cache->set.sessions[i];
+        if (s->expires_s > now) {
+            curl_easy_ssls_import(curl, s->key, s->shmac, s->shmac_len, s->data, s->data_len);
+        }
+    }
+    cache->imported_into = target;
+}
+
+void chunks_tls_record(chunks_uploader_t *uploader, CURL *curl) {
+    chunks_tls_cache_t *cache = uploader->tls_cache;
+    if (cache == NULL) {
+        return;
+    }
+
+    /* Only a new connection can bring a new session */
+    long connects = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    if (connects > 0) {
+        chunks_tls_set_t fresh = {0};
+        tls_export_ctx_t ctx = {&fresh, wall_time_s() + cache->max_age_s};
+        if (curl_easy_ssls_export(curl, tls_export_cb, &ctx) == CURLE_OK) {
+            set_clear(&cache->set);
+            cache->set = fresh;
+            cache->dirty = true;
+        } else {
+            set_clear(&fresh);
+        }
+    }
+
+    uint64_t now = chunks_now_ms();
+    if (cache->dirty &&
+        (cache->last_save_ms == 0 || now - cache->last_save_ms >= CHUNKS_TLS_SAVE_INTERVAL_MS)) {
+        tls_save(cache);
+    }
+}
+
+#else /* !CHUNKS_HAVE_TLS_EXPORT */
+
+int chunks_tls_open(const char *path, uint32_t max_age_s, CURL *probe,
+                    chunks_tls_cache_t **cache) {
+    (void)path;
+    (void)max_age_s;
+    (void)probe;
+    (void)cache;
+    return -ENOTSUP;
+}
+
+void chunks_tls_close(chunks_tls_cache_t *cache) {
+    (void)cache;
+}
+
+void chunks_tls_apply(chunks_uploader_t *uploader, CURL *curl) {
+    (void)uploader;
+    (void)curl;
+}
+
+void chunks_tls_record(chunks_uploader_t *uploader, CURL *curl) {
+    (void)uploader;
+    (void)curl;
+}
+
+#endif /* CHUNKS_HAVE_TLS_EXPORT */
+
+/* ============================================================================
+ * Public API
+ * ========================================================================== */
+
+int chunks_uploader_set_tls_cache(chunks_uploader_t *uploader, const char *path,
+                                  uint32_t max_age_s) {
+    if (uploader == NULL) {
+        return -EINVAL;
+    }
+
+    if (chunks_uploader_pending(uploader) > 0) {
+        return -EBUSY;
+    }
+
+    /* Handles must let go of the old share before it is freed, so the
+     * replacement handle has to exist before anything is changed */
+    CURL *fresh = NULL;
+    if (uploader->tls_cache) {
+        fresh = curl_easy_init();
+        if (fresh == NULL) {
+            return -ENOMEM;
+        }
+    }
+
+    chunks_tls_cache_t *cache = NULL;
+    if (path) {
+        int ret = chunks_tls_open(path, max_age_s, uploader->curl, &cache);
+        if (ret < 0) {
+            if (fresh) {
+                curl_easy_cleanup(fresh);
+            }
+            return ret;
+        }
+    }
+
+    if (uploader->tls_cache) {
+        curl_easy_cleanup(uploader->curl);
+        uploader->curl = fresh;
+        chunks_async_release_idle(uploader);
+        chunks_tls_close(uploader->tls_cache);
+    }
+
+    uploader->tls_cache = cache;
+    return 0;
+}
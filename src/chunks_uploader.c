@@ -4,6 +4,7 @@
  */
 
 #include "mds_bridge/chunks_uploader.h"
+#include "chunks_uploader_internal.h"
 #include <curl/curl.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,15 +12,6 @@
 #include <stdio.h>
 #include <stdbool.h>
 
-/* Uploader structure */
-struct chunks_uploader {
-    CURL *curl;
-    struct curl_slist *headers;
-    chunks_upload_stats_t stats;
-    long timeout_ms;
-    bool verbose;
-};
-
 /* ============================================================================
  * Uploader Management
  * ========================================================================== */
@@ -40,6 +32,7 @@ chunks_uploader_t *chunks_uploader_create(void) {
     /* Set default timeout (30 seconds) */
     uploader->timeout_ms = 30000;
     uploader->verbose = false;
+    uploader->probe_interval_ms = CHUNKS_DEFAULT_PROBE_INTERVAL_MS;
 
     return uploader;
 }
@@ -57,113 +50,265 @@ void chunks_uploader_destroy(chunks_uploader_t *uploader) {
         curl_easy_cleanup(uploader->curl);
     }
 
+    chunks_async_free(uploader);
+    chunks_tls_close(uploader->tls_cache);
+    chunks_dns_close(uploader->dns_cache);
+    chunks_uploader_set_config_table(uploader, NULL);
+    if (uploader->pool) {
+        chunks_pool_attach(uploader->pool, false);
+    }
+    chunks_endpoints_free(uploader);
+    chunks_dedup_close(uploader->dedup);
     free(uploader);
 }
 
 /* ============================================================================
- * Upload Callback
+ * Request Helpers (shared with the event-loop mode)
  * ========================================================================== */
 
-int chunks_uploader_callback(const char *uri,
-                              const char *auth_header,
-                              const uint8_t *chunk_data,
-                              size_t chunk_len,
-                              void *user_data) {
-    if (uri == NULL || auth_header == NULL || chunk_data == NULL || user_data == NULL) {
+int chunks_upload_build_headers(const char *auth_header, struct curl_slist **headers) {
+    /* Parse authorization header (format: "HeaderName:HeaderValue") */
+    const char *colon = strchr(auth_header, ':');
+    if (colon == NULL) {
+        fprintf(stderr, "Invalid authorization header format: %s\n", auth_header);
         return -EINVAL;
     }
 
-    chunks_uploader_t *uploader = (chunks_uploader_t *)user_data;
-    CURLcode res;
+    /* Build full header string for curl: name + ": " + value */
+    size_t header_name_len = colon - auth_header;
+    const char *header_value = colon + 1;
+    size_t full_header_len = header_name_len + 2 + strlen(header_value) + 1;
+    char *full_header = malloc(full_header_len);
+    if (full_header == NULL) {
+        return -ENOMEM;
+    }
+    snprintf(full_header, full_header_len, "%.*s: %s",
+             (int)header_name_len, auth_header, header_value);
+
+    *headers = NULL;
+    *headers = curl_slist_append(*headers, full_header);
+    *headers = curl_slist_append(*headers, "Content-Type: application/octet-stream");
+    free(full_header);
+
+    return *headers ? 0 : -ENOMEM;
+}
+
+int chunks_upload_headers(chunks_uploader_t *uploader, const char *auth_header,
+                          struct curl_slist **headers, bool *owned) {
+    *owned = true;
+
+    /* Interned strings map to their entry by address; no parsing needed */
+    const mds_config_entry_t *entry = mds_config_find(uploader->config_table, auth_header);
+    if (entry == NULL || entry->kind != MDS_CONFIG_AUTH || entry->header == NULL) {
+        return chunks_upload_build_headers(auth_header, headers);
+    }
+
+    for (size_t i = 0; i < uploader->header_cache_count; i++) {
+        if (uploader->header_cache[i].id == entry->id) {
+            *headers = uploader->header_cache[i].headers;
+            *owned = false;
+            return 0;
+        }
+    }
+
+    *headers = curl_slist_append(NULL, entry->header);
+    if (*headers) {
+        struct curl_slist *tail = curl_slist_append(*headers, "Content-Type: application/octet-stream");
+        if (tail == NULL) {
+            curl_slist_free_all(*headers);
+            *headers = NULL;
+        }
+    }
+    if (*headers == NULL) {
+        return -ENOMEM;
+    }
+
+    /* Keep it for the entry's next chunk; when full, the caller frees it */
+    if (uploader->header_cache_count < CHUNKS_HEADER_CACHE_SIZE) {
+        chunks_header_cache_t *slot = &uploader->header_cache[uploader->header_cache_count++];
+        slot->id = entry->id;
+        slot->headers = *headers;
+        *owned = false;
+    }
+    return 0;
+}
 
+void chunks_upload_setup(chunks_uploader_t *uploader,
+                         CURL *curl,
+                         const char *url,
+                         struct curl_slist *headers,
+                         const uint8_t *chunk_data,
+                         size_t chunk_len,
+                         struct curl_slist **resolve) {
     /* Reset curl for new request */
-    curl_easy_reset(uploader->curl);
+    curl_easy_reset(curl);
 
     /* Set URL */
-    curl_easy_setopt(uploader->curl, CURLOPT_URL, uri);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
 
     /* Set POST method */
-    curl_easy_setopt(uploader->curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
 
     /* Set POST data */
-    curl_easy_setopt(uploader->curl, CURLOPT_POSTFIELDS, chunk_data);
-    curl_easy_setopt(uploader->curl, CURLOPT_POSTFIELDSIZE, (long)chunk_len);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, chunk_data);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)chunk_len);
 
-    /* Parse authorization header (format: "HeaderName:HeaderValue") */
-    const char *colon = strchr(auth_header, ':');
-    if (colon == NULL) {
-        fprintf(stderr, "Invalid authorization header format: %s\n", auth_header);
-        uploader->stats.upload_failures++;
-        return -EINVAL;
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+
+    /* Set timeout */
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, uploader->timeout_ms);
+
+    /* Set verbose if enabled */
+    if (uploader->verbose) {
+        curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
     }
 
-    /* Extract header name and value */
-    size_t header_name_len = colon - auth_header;
-    char *header_name = malloc(header_name_len + 1);
-    if (header_name == NULL) {
-        uploader->stats.upload_failures++;
-        return -ENOMEM;
+    /* Reuse connections shared with other uploaders */
+    if (uploader->pool) {
+        chunks_pool_apply(uploader->pool, curl);
     }
-    memcpy(header_name, auth_header, header_name_len);
-    header_name[header_name_len] = '\0';
 
-    const char *header_value = colon + 1;
+    /* Resume TLS sessions persisted by an earlier uploader */
+    chunks_tls_apply(uploader, curl);
 
-    /* Build full header string for curl */
-    size_t full_header_len = strlen(header_name) + 2 + strlen(header_value) + 1; /* name + ": " + value + \0 */
-    char *full_header = malloc(full_header_len);
-    if (full_header == NULL) {
-        free(header_name);
-        uploader->stats.upload_failures++;
-        return -ENOMEM;
+    /* Connect to addresses resolved off the upload path */
+    chunks_dns_apply(uploader, curl, url, resolve);
+}
+
+void chunks_upload_result(chunks_uploader_t *uploader, CURL *curl, const char *url,
+                          long *http_code, double *latency_ms) {
+    /* Get HTTP status code and total time (failed requests report time spent) */
+    double total_time = 0.0;
+    *http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, http_code);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME, &total_time);
+    *latency_ms = total_time * 1000.0;
+    uploader->stats.last_http_status = *http_code;
+
+    if (uploader->pool) {
+        chunks_pool_record(uploader->pool, curl, url);
     }
-    snprintf(full_header, full_header_len, "%s: %s", header_name, header_value);
+    chunks_tls_record(uploader, curl);
+    chunks_dns_record(uploader, curl);
+}
 
-    /* Set headers */
-    struct curl_slist *headers = NULL;
-    headers = curl_slist_append(headers, full_header);
-    headers = curl_slist_append(headers, "Content-Type: application/octet-stream");
+const char *chunks_upload_target(chunks_uploader_t *uploader,
+                                 const chunks_upload_route_t *route,
+                                 const char *uri, char *url, size_t url_len,
+                                 chunks_endpoint_t **endpoint) {
+    *endpoint = NULL;
+    if (route->group == NULL) {
+        return uri;
+    }
 
-    curl_easy_setopt(uploader->curl, CURLOPT_HTTPHEADER, headers);
+    *endpoint = &route->group->endpoints[route->order[route->index]];
+    if (chunks_endpoints_rewrite(route->group, *endpoint, uri, url, url_len) < 0) {
+        return NULL;
+    }
 
-    /* Set timeout */
-    curl_easy_setopt(uploader->curl, CURLOPT_TIMEOUT_MS, uploader->timeout_ms);
+    if (route->index == 1) {
+        uploader->stats.failovers++;
+    }
+    return url;
+}
 
-    /* Set verbose if enabled */
-    if (uploader->verbose) {
-        curl_easy_setopt(uploader->curl, CURLOPT_VERBOSE, 1L);
+/* Transport errors, server errors and throttling are worth another endpoint */
+bool chunks_upload_attempt_done(chunks_uploader_t *uploader,
+                                chunks_endpoint_t *endpoint,
+                                CURLcode res, long http_code, double latency_ms) {
+    bool fail_over = res != CURLE_OK || http_code >= 500 || http_code == 429;
+
+    if (endpoint) {
+        /* A 4xx is the client's fault, not the endpoint's */
+        chunks_endpoints_report(uploader, endpoint, !fail_over, latency_ms);
     }
+    return fail_over;
+}
 
-    /* Perform the request */
-    res = curl_easy_perform(uploader->curl);
+/* The request may have been stored even though no response arrived */
+bool chunks_upload_ambiguous(CURLcode res) {
+    return res == CURLE_OPERATION_TIMEDOUT || res == CURLE_RECV_ERROR ||
+           res == CURLE_GOT_NOTHING || res == CURLE_PARTIAL_FILE;
+}
 
-    /* Get HTTP status code */
-    long http_code = 0;
-    curl_easy_getinfo(uploader->curl, CURLINFO_RESPONSE_CODE, &http_code);
-    uploader->stats.last_http_status = http_code;
+bool chunks_upload_begin(chunks_uploader_t *uploader, const char *uri,
+                         const uint8_t *chunk_data, size_t chunk_len,
+                         uint64_t *dedup_key) {
+    *dedup_key = 0;
+    if (uploader->dedup == NULL) {
+        return false;
+    }
 
-    /* Clean up headers */
-    curl_slist_free_all(headers);
-    free(full_header);
-    free(header_name);
+    /* Skip chunks the server already has */
+    *dedup_key = chunks_dedup_key(uri, chunk_data, chunk_len);
+    int state = chunks_dedup_lookup(uploader->dedup, *dedup_key);
+    if (state == CHUNKS_DEDUP_CONFIRMED) {
+        uploader->stats.duplicates_suppressed++;
+        if (uploader->verbose) {
+            printf("Skipped duplicate chunk: %zu bytes\n", chunk_len);
+        }
+        return true;
+    }
+    if (state == CHUNKS_DEDUP_PENDING) {
+        uploader->stats.ambiguous_replays++;
+        if (uploader->verbose) {
+            printf("Re-sending chunk with unknown upload outcome: %zu bytes\n", chunk_len);
+        }
+    }
+    chunks_dedup_mark(uploader->dedup, *dedup_key, CHUNKS_DEDUP_PENDING);
+    return false;
+}
 
-    /* Check result */
-    if (res != CURLE_OK) {
-        fprintf(stderr, "Upload failed: %s\n", curl_easy_strerror(res));
-        uploader->stats.upload_failures++;
-        return -EIO;
+/* Bucket i holds ages of bit length i, i.e. [2^(i-1), 2^i) ms */
+static void upload_record_age(chunks_uploader_t *uploader, const chunks_upload_times_t *times) {
+    uint64_t now = chunks_now_ms();
+    uint64_t age = now > times->received_ms ? now - times->received_ms : 0;
+
+    size_t bucket = 0;
+    for (uint64_t a = age; a > 0 && bucket < CHUNKS_AGE_BUCKETS - 1; a >>= 1) {
+        bucket++;
+    }
+
+    chunks_age_stats_t *ages = &uploader->age_stats;
+    ages->counts[bucket]++;
+    if (age > ages->max_ms) {
+        ages->max_ms = age;
+    }
+    uploader->age_total_ms += age;
+
+    if (times->deadline_ms && now > times->deadline_ms) {
+        uploader->stats.deadline_misses++;
     }
+}
 
-    /* Check HTTP status */
-    if (http_code < 200 || http_code >= 300) {
-        fprintf(stderr, "Upload failed with HTTP status %ld\n", http_code);
+int chunks_upload_finish(chunks_uploader_t *uploader, uint64_t dedup_key, int ret,
+                         CURLcode res, long http_code, bool ambiguous, size_t chunk_len,
+                         const chunks_upload_times_t *times) {
+    if (uploader->dedup) {
+        int state = CHUNKS_DEDUP_NONE;
+        if (ret == 0) {
+            state = CHUNKS_DEDUP_CONFIRMED;
+        } else if (ambiguous) {
+            state = CHUNKS_DEDUP_PENDING;
+        }
+        chunks_dedup_mark(uploader->dedup, dedup_key, state);
+    }
+
+    /* Check result */
+    if (ret < 0) {
+        if (res != CURLE_OK) {
+            fprintf(stderr, "Upload failed: %s\n", curl_easy_strerror(res));
+        } else if (ret == -EIO) {
+            fprintf(stderr, "Upload failed with HTTP status %ld\n", http_code);
+        }
         uploader->stats.upload_failures++;
-        return -EIO;
+        return ret;
     }
 
     /* Success - update stats */
     uploader->stats.chunks_uploaded++;
     uploader->stats.bytes_uploaded += chunk_len;
+    upload_record_age(uploader, times);
 
     if (uploader->verbose) {
         printf("Uploaded chunk: %zu bytes, HTTP %ld\n", chunk_len, http_code);
@@ -172,6 +317,146 @@ int chunks_uploader_callback(const char *uri,
     return 0;
 }
 
+bool chunks_upload_expired(chunks_uploader_t *uploader, const chunks_upload_times_t *times) {
+    uint32_t max_age_ms = uploader->queue_policy.max_age_ms;
+    return max_age_ms > 0 && chunks_now_ms() - times->received_ms > max_age_ms;
+}
+
+int chunks_upload_expire(chunks_uploader_t *uploader, const char *uri,
+                         const char *auth_header, const uint8_t *chunk_data,
+                         size_t chunk_len, uint64_t dedup_key) {
+    /* Never sent, so a later copy of the chunk is not a replay */
+    if (uploader->dedup && dedup_key) {
+        chunks_dedup_mark(uploader->dedup, dedup_key, CHUNKS_DEDUP_NONE);
+    }
+
+    uploader->stats.expired_chunks++;
+    uploader->stats.expired_bytes += chunk_len;
+    if (uploader->verbose) {
+        printf("Expired chunk: %zu bytes\n", chunk_len);
+    }
+
+    const chunks_queue_policy_t *policy = &uploader->queue_policy;
+    if (policy->expired_fn == NULL) {
+        return -ETIME;
+    }
+    return policy->expired_fn(uri, auth_header, chunk_data, chunk_len, policy->expired_user_data);
+}
+
+void chunks_upload_route(chunks_uploader_t *uploader, const char *uri,
+                         chunks_upload_route_t *route) {
+    /* Endpoints to try, best first; a URI outside any group is sent as-is */
+    route->group = chunks_endpoints_find(uploader, uri);
+    route->count = route->group ? chunks_endpoints_route(uploader, route->group, route->order) : 1;
+    route->index = 0;
+}
+
+/* ============================================================================
+ * Upload Callback
+ * ========================================================================== */
+
+int chunks_uploader_callback(const char *uri,
+                              const char *auth_header,
+                              const uint8_t *chunk_data,
+                              size_t chunk_len,
+                              void *user_data) {
+    return chunks_uploader_submit((chunks_uploader_t *)user_data, uri, auth_header,
+                                  chunk_data, chunk_len, 0, 0);
+}
+
+int chunks_uploader_submit(chunks_uploader_t *uploader,
+                           const char *uri,
+                           const char *auth_header,
+                           const uint8_t *chunk_data,
+                           size_t chunk_len,
+                           uint32_t age_ms,
+                           uint32_t deadline_ms) {
+    if (uri == NULL || auth_header == NULL || chunk_data == NULL || uploader == NULL) {
+        return -EINVAL;
+    }
+
+    chunks_upload_times_t times;
+    uint64_t now = chunks_now_ms();
+    times.received_ms = now > age_ms ? now - age_ms : 0;
+    if (deadline_ms == 0) {
+        deadline_ms = uploader->queue_policy.default_deadline_ms;
+    }
+    times.deadline_ms = deadline_ms ? times.received_ms + deadline_ms : 0;
+
+    if (chunks_upload_expired(uploader, &times)) {
+        return chunks_upload_expire(uploader, uri, auth_header, chunk_data, chunk_len, 0);
+    }
+
+    /* Set headers (shared by every attempt) */
+    struct curl_slist *headers = NULL;
+    bool owned;
+    int ret = chunks_upload_headers(uploader, auth_header, &headers, &owned);
+    if (ret < 0) {
+        uploader->stats.upload_failures++;
+        return ret;
+    }
+
+    uint64_t dedup_key;
+    if (chunks_upload_begin(uploader, uri, chunk_data, chunk_len, &dedup_key)) {
+        if (owned) {
+            curl_slist_free_all(headers);
+        }
+        return 0;
+    }
+
+    /* Host event loop: queue the request and return */
+    if (uploader->async) {
+        return chunks_async_submit(uploader, uri, auth_header, headers, owned,
+                                   chunk_data, chunk_len, dedup_key, &times);
+    }
+
+    chunks_upload_route_t route;
+    chunks_upload_route(uploader, uri, &route);
+
+    CURLcode res = CURLE_OK;
+    long http_code = 0;
+    bool ambiguous = false;     /* An earlier endpoint may have stored it */
+    ret = -EIO;
+
+    for (; route.index < route.count; route.index++) {
+        char url[CHUNKS_MAX_URL_LEN];
+        chunks_endpoint_t *endpoint;
+        const char *target = chunks_upload_target(uploader, &route, uri, url, sizeof(url), &endpoint);
+        if (target == NULL) {
+            ret = -ENAMETOOLONG;
+            break;
+        }
+
+        /* POST once to target */
+        double latency_ms;
+        struct curl_slist *resolve;
+        chunks_upload_setup(uploader, uploader->curl, target, headers, chunk_data, chunk_len,
+                            &resolve);
+        res = curl_easy_perform(uploader->curl);
+        curl_slist_free_all(resolve);
+        chunks_upload_result(uploader, uploader->curl, target, &http_code, &latency_ms);
+        bool fail_over = chunks_upload_attempt_done(uploader, endpoint, res, http_code, latency_ms);
+        ambiguous |= chunks_upload_ambiguous(res);
+
+        ret = (res == CURLE_OK && http_code >= 200 && http_code < 300) ? 0 : -EIO;
+        if (!fail_over) {
+            break;
+        }
+
+        if (uploader->verbose && route.index + 1 < route.count) {
+            printf("Endpoint %s failed, trying next endpoint\n", target);
+        }
+    }
+
+    /* Clean up headers */
+    if (owned) {
+        curl_slist_free_all(headers);
+    }
+
+    return chunks_upload_finish(uploader, dedup_key, ret, res, http_code, ambiguous,
+                                chunk_len, &times);
+}
+
 /* ============================================================================
  * Statistics
  * ========================================================================== */
@@ -192,6 +477,32 @@ int chunks_uploader_reset_stats(chunks_uploader_t *uploader) {
     }
 
     memset(&uploader->stats, 0, sizeof(uploader->stats));
+    memset(&uploader->age_stats, 0, sizeof(uploader->age_stats));
+    uploader->age_total_ms = 0;
+
+    for (size_t i = 0; i < uploader->group_count; i++) {
+        chunks_endpoint_group_t *group = &uploader->groups[i];
+        for (size_t j = 0; j < group->count; j++) {
+            group->endpoints[j].requests = 0;
+            group->endpoints[j].failures = 0;
+        }
+    }
+    return 0;
+}
+
+int chunks_uploader_get_age_stats(chunks_uploader_t *uploader,
+                                  chunks_age_stats_t *stats) {
+    if (uploader == NULL || stats == NULL) {
+        return -EINVAL;
+    }
+
+    *stats = uploader->age_stats;
+
+    size_t count = 0;
+    for (size_t i = 0; i < CHUNKS_AGE_BUCKETS; i++) {
+        count += stats->counts[i];
+    }
+    stats->mean_ms = count ? (double)uploader->age_total_ms / (double)count : 0.0;
     return 0;
 }
 
@@ -218,3 +529,61 @@ int chunks_uploader_set_verbose(chunks_uploader_t *uploader,
     uploader->verbose = verbose;
     return 0;
 }
+
+int chunks_uploader_enable_dedup(chunks_uploader_t *uploader,
+                                 size_t window,
+                                 const char *path) {
+    if (uploader == NULL) {
+        return -EINVAL;
+    }
+
+    chunks_dedup_t *dedup = NULL;
+    if (window > 0) {
+        int ret = chunks_dedup_open(window, path, &dedup);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    chunks_dedup_close(uploader->dedup);
+    uploader->dedup = dedup;
+    return 0;
+}
+
+int chunks_uploader_set_config_table(chunks_uploader_t *uploader,
+                                     mds_config_table_t *table) {
+    if (uploader == NULL) {
+        return -EINVAL;
+    }
+
+    /* Queued uploads may still point at cached headers */
+    if (chunks_uploader_pending(uploader) > 0) {
+        return -EBUSY;
+    }
+
+    for (size_t i = 0; i < uploader->header_cache_count; i++) {
+        curl_slist_free_all(uploader->header_cache[i].headers);
+    }
+    uploader->header_cache_count = 0;
+    uploader->config_table = table;
+    return 0;
+}
+
+int chunks_uploader_set_queue_policy(chunks_uploader_t *uploader,
+                                     const chunks_queue_policy_t *policy) {
+    if (uploader == NULL) {
+        return -EINVAL;
+    }
+
+    /* The queue is kept sorted for the policy it was filled under */
+    if (chunks_uploader_pending(uploader) > 0) {
+        return -EBUSY;
+    }
+
+    if (policy) {
+        uploader->queue_policy = *policy;
+    } else {
+        memset(&uploader->queue_policy, 0, sizeof(uploader->queue_policy));
+    }
+    return 0;
+}
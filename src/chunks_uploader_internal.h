@@ -0,0 +1,468 @@
+/**
+ * @file chunks_uploader_internal.h
+ * @brief Internal uploader state shared between uploader source files
+ *
+ * This header is for internal use only and should not be installed as a public API.
+ */
+
+#ifndef CHUNKS_UPLOADER_INTERNAL_H
+#define CHUNKS_UPLOADER_INTERNAL_H
+
+#include "mds_bridge/chunks_uploader.h"
+#include <curl/curl.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Maximum length of a rewritten request URL */
+#define CHUNKS_MAX_URL_LEN                  512
+
+/** Default probe interval for a failed-over primary endpoint */
+#define CHUNKS_DEFAULT_PROBE_INTERVAL_MS    5000
+
+/** Upper bound on how long a failing endpoint is skipped */
+#define CHUNKS_ENDPOINT_MAX_BACKOFF_MS      30000
+
+/**
+ * Health state of one endpoint (origin) in a failover group
+ */
+typedef struct {
+    char origin[CHUNKS_MAX_ORIGIN_LEN];
+    bool measured;                  /* At least one request completed */
+    double latency_ms;              /* EWMA of request latency */
+    double error_rate;              /* EWMA of failures (0..1) */
+    unsigned int consecutive_failures;
+    uint64_t down_until_ms;         /* Skipped (unless nothing else) until then */
+    size_t requests;
+    size_t failures;
+} chunks_endpoint_t;
+
+/**
+ * Ordered list of equivalent endpoints; endpoints[0] is the primary, whose
+ * origin is matched against request URIs
+ */
+typedef struct {
+    chunks_endpoint_t endpoints[CHUNKS_MAX_ENDPOINTS];
+    size_t count;
+    uint64_t last_probe_ms;
+} chunks_endpoint_group_t;
+
+/**
+ * libcurl can export and import TLS sessions (8.12+). Built against older
+ * headers, the 8.12 entry points are declared weak and looked up when the
+ * program runs, so a newer shared libcurl still gets session persistence;
+ * CHUNKS_TLS_EXPORT_LINKED() tells whether they resolved.
+ */
+#if LIBCURL_VERSION_NUM >= 0x080c00
+#define CHUNKS_HAVE_TLS_EXPORT              1
+#define CHUNKS_TLS_EXPORT_LINKED()          true
+#elif defined(__ELF__) && defined(__GNUC__)
+#define CHUNKS_HAVE_TLS_EXPORT              1
+#define CHUNKS_TLS_EXPORT_LINKED() \
+    (curl_easy_ssls_export != NULL && curl_easy_ssls_import != NULL)
+
+typedef CURLcode curl_ssls_export_cb(CURL *handle, void *userptr, const char *session_key,
+                                     const unsigned char *shmac, size_t shmac_len,
+                                     const unsigned char *sdata, size_t sdata_len,
+                                     curl_off_t valid_until, int ietf_tls_id, const char *alpn,
+                                     size_t earlydata_max);
+
+CURLcode curl_easy_ssls_import(CURL *handle, const char *session_key,
+                               const unsigned char *shmac, size_t shmac_len,
+                               const unsigned char *sdata, size_t sdata_len)
+    __attribute__((weak));
+
+CURLcode curl_easy_ssls_export(CURL *handle, curl_ssls_export_cb *export_fn, void *userptr)
+    __attribute__((weak));
+#else
+#define CHUNKS_HAVE_TLS_EXPORT              0
+#endif
+
+/** Persisted TLS sessions kept per uploader */
+#define CHUNKS_TLS_MAX_SESSIONS             32
+
+/** Minimum time between two writes of the TLS session file */
+#define CHUNKS_TLS_SAVE_INTERVAL_MS         10000
+
+/**
+ * Persisted TLS sessions (see chunks_tls.c)
+ */
+typedef struct chunks_tls_cache chunks_tls_cache_t;
+
+/** Hosts kept in an uploader's DNS cache */
+#define CHUNKS_DNS_MAX_HOSTS                16
+
+/** Room for one host's addresses in CURLOPT_RESOLVE form ("a,b,[c]") */
+#define CHUNKS_DNS_MAX_ADDRS_LEN            256
+
+/**
+ * Background resolver and address cache (see chunks_dns.c)
+ */
+typedef struct chunks_dns_cache chunks_dns_cache_t;
+
+/** Interned authorizations whose request headers are kept per uploader */
+#define CHUNKS_HEADER_CACHE_SIZE            16
+
+/**
+ * Request headers built for one interned authorization entry
+ */
+typedef struct {
+    uint64_t id;                    /* mds_config_entry_t id */
+    struct curl_slist *headers;
+} chunks_header_cache_t;
+
+/** Largest accepted dedup window (entries) */
+#define CHUNKS_DEDUP_MAX_WINDOW             (1u << 24)
+
+/** Dedup window entry states */
+#define CHUNKS_DEDUP_NONE                   0
+#define CHUNKS_DEDUP_PENDING                1   /* Sent, outcome unknown */
+#define CHUNKS_DEDUP_CONFIRMED              2   /* Acknowledged by the server */
+
+/**
+ * Fixed-size window of recently uploaded chunk hashes
+ */
+typedef struct chunks_dedup chunks_dedup_t;
+
+/**
+ * Host event-loop state (see chunks_async.c)
+ */
+typedef struct chunks_async chunks_async_t;
+
+/**
+ * Receive time and deadline of one upload (chunks_now_ms() clock)
+ */
+typedef struct {
+    uint64_t received_ms;
+    uint64_t deadline_ms;           /* 0: none */
+} chunks_upload_times_t;
+
+/**
+ * Endpoints one upload may try, and the attempt in progress
+ */
+typedef struct {
+    chunks_endpoint_group_t *group;     /* NULL: send to the URI as-is */
+    size_t order[CHUNKS_MAX_ENDPOINTS];
+    size_t count;
+    size_t index;
+} chunks_upload_route_t;
+
+/* Uploader structure */
+struct chunks_uploader {
+    CURL *curl;
+    struct curl_slist *headers;
+    chunks_upload_stats_t stats;
+    long timeout_ms;
+    bool verbose;
+
+    /* Multi-endpoint failover */
+    chunks_endpoint_group_t *groups;
+    size_t group_count;
+    long probe_interval_ms;
+
+    /* Re-upload suppression (NULL when disabled) */
+    chunks_dedup_t *dedup;
+
+    /* Host event-loop mode (NULL: uploads block in the callback) */
+    chunks_async_t *async;
+
+    /* Shared connection pool (NULL: private connection cache) */
+    chunks_pool_t *pool;
+
+    /* Scheduling and expiry (see chunks_uploader_set_queue_policy()) */
+    chunks_queue_policy_t queue_policy;
+    chunks_age_stats_t age_stats;
+    uint64_t age_total_ms;
+
+    /* Persisted TLS sessions (NULL when disabled) */
+    chunks_tls_cache_t *tls_cache;
+
+    /* Background DNS resolution (NULL: libcurl resolves each new connection) */
+    chunks_dns_cache_t *dns_cache;
+
+    /* Interned authorizations (see chunks_uploader_set_config_table()) */
+    mds_config_table_t *config_table;
+    chunks_header_cache_t header_cache[CHUNKS_HEADER_CACHE_SIZE];
+    size_t header_cache_count;
+};
+
+/**
+ * Monotonic clock in milliseconds
+ */
+uint64_t chunks_now_ms(void);
+
+/**
+ * Find the failover group whose primary origin prefixes uri
+ *
+ * @return Group, or NULL if uri is not covered by any group
+ */
+chunks_endpoint_group_t *chunks_endpoints_find(chunks_uploader_t *uploader,
+                                               const char *uri);
+
+/**
+ * Compute the order in which endpoints should be tried for a new request
+ *
+ * @param order Array of at least group->count entries receiving endpoint indexes
+ *
+ * @return Number of entries written (always group->count)
+ */
+size_t chunks_endpoints_route(chunks_uploader_t *uploader,
+                              chunks_endpoint_group_t *group,
+                              size_t *order);
+
+/**
+ * Feed the outcome of one request into an endpoint's health score
+ */
+void chunks_endpoints_report(chunks_uploader_t *uploader,
+                             chunks_endpoint_t *endpoint,
+                             bool ok, double latency_ms);
+
+/**
+ * Build the URL for endpoint by replacing the primary origin prefix of uri
+ *
+ * @return 0 on success, -ENAMETOOLONG if the result does not fit
+ */
+int chunks_endpoints_rewrite(const chunks_endpoint_group_t *group,
+                             const chunks_endpoint_t *endpoint,
+                             const char *uri, char *out, size_t out_len);
+
+/**
+ * Free all failover groups
+ */
+void chunks_endpoints_free(chunks_uploader_t *uploader);
+
+/**
+ * Build the request header list from an "HeaderName:HeaderValue" string
+ *
+ * @return 0 on success, -EINVAL for a malformed header, -ENOMEM
+ */
+int chunks_upload_build_headers(const char *auth_header, struct curl_slist **headers);
+
+/**
+ * Request headers for auth_header, from the cache when it is interned
+ *
+ * @param owned Set to true if the caller must free headers, false if they
+ *              belong to the uploader's header cache
+ *
+ * @return 0 on success, -EINVAL for a malformed header, -ENOMEM
+ */
+int chunks_upload_headers(chunks_uploader_t *uploader, const char *auth_header,
+                          struct curl_slist **headers, bool *owned);
+
+/**
+ * Configure an easy handle for one POST attempt
+ *
+ * @param resolve Set to a list the handle reads when the transfer starts;
+ *                free it with curl_slist_free_all() after the attempt (or
+ *                after the handle is reset), NULL if none
+ */
+void chunks_upload_setup(chunks_uploader_t *uploader,
+                         CURL *curl,
+                         const char *url,
+                         struct curl_slist *headers,
+                         const uint8_t *chunk_data,
+                         size_t chunk_len,
+                         struct curl_slist **resolve);
+
+/**
+ * Read status and latency of a finished attempt
+ */
+void chunks_upload_result(chunks_uploader_t *uploader, CURL *curl, const char *url,
+                          long *http_code, double *latency_ms);
+
+/**
+ * Pick the endpoints to try for uri, best first
+ */
+void chunks_upload_route(chunks_uploader_t *uploader, const char *uri,
+                         chunks_upload_route_t *route);
+
+/**
+ * URL for the current attempt of route (uri itself outside any group)
+ *
+ * @param endpoint Receives the endpoint being tried, or NULL
+ *
+ * @return URL, or NULL if the rewritten URL does not fit
+ */
+const char *chunks_upload_target(chunks_uploader_t *uploader,
+                                 const chunks_upload_route_t *route,
+                                 const char *uri, char *url, size_t url_len,
+                                 chunks_endpoint_t **endpoint);
+
+/**
+ * Score a finished attempt
+ *
+ * @return true if the upload should fail over to the next endpoint
+ */
+bool chunks_upload_attempt_done(chunks_uploader_t *uploader,
+                                chunks_endpoint_t *endpoint,
+                                CURLcode res, long http_code, double latency_ms);
+
+/**
+ * Consult the dedup window before an upload
+ *
+ * @return true if the chunk was already acknowledged and must not be sent
+ */
+bool chunks_upload_begin(chunks_uploader_t *uploader, const char *uri,
+                         const uint8_t *chunk_data, size_t chunk_len,
+                         uint64_t *dedup_key);
+
+/**
+ * True if an attempt that ended with res may still have been stored
+ */
+bool chunks_upload_ambiguous(CURLcode res);
+
+/**
+ * Record the final outcome of an upload in the stats and dedup window
+ *
+ * @param ambiguous True if any attempt, not just the last, may have been
+ *        stored; a failed upload then stays flagged for replay
+ * @return ret
+ */
+int chunks_upload_finish(chunks_uploader_t *uploader, uint64_t dedup_key, int ret,
+                         CURLcode res, long http_code, bool ambiguous, size_t chunk_len,
+                         const chunks_upload_times_t *times);
+
+/**
+ * True if an upload is past the policy's maximum age
+ */
+bool chunks_upload_expired(chunks_uploader_t *uploader, const chunks_upload_times_t *times);
+
+/**
+ * Drop or divert an expired upload instead of sending it
+ *
+ * @return Result of the policy's expired_fn, or -ETIME if dropped
+ */
+int chunks_upload_expire(chunks_uploader_t *uploader, const char *uri,
+                         const char *auth_header, const uint8_t *chunk_data,
+                         size_t chunk_len, uint64_t dedup_key);
+
+/**
+ * Queue an upload in event-loop mode; takes ownership of headers if owned
+ *
+ * @return 0 if queued, -ENOBUFS if the queue is full, negative error code otherwise
+ */
+int chunks_async_submit(chunks_uploader_t *uploader, const char *uri,
+                        const char *auth_header, struct curl_slist *headers, bool owned,
+                        const uint8_t *chunk_data, size_t chunk_len,
+                        uint64_t dedup_key, const chunks_upload_times_t *times);
+
+/**
+ * Drop all event-loop state, including unfinished uploads
+ */
+void chunks_async_free(chunks_uploader_t *uploader);
+
+/**
+ * Point an easy handle at the pool's shared caches (after curl_easy_reset)
+ */
+void chunks_pool_apply(chunks_pool_t *pool, CURL *curl);
+
+/**
+ * Count a finished request and the connections it opened
+ */
+void chunks_pool_record(chunks_pool_t *pool, CURL *curl, const char *url);
+
+/**
+ * Track the number of uploaders using a pool
+ */
+void chunks_pool_attach(chunks_pool_t *pool, bool attach);
+
+/**
+ * Drop the idle easy handles kept for reuse in event-loop mode
+ */
+void chunks_async_release_idle(chunks_uploader_t *uploader);
+
+/**
+ * Open a TLS session cache and load the sessions stored at path
+ *
+ * @param probe Handle used to check that libcurl can export sessions
+ *
+ * @return 0 on success, -ENOTSUP without session export, negative error code otherwise
+ */
+int chunks_tls_open(const char *path, uint32_t max_age_s, CURL *probe,
+                    chunks_tls_cache_t **cache);
+
+/**
+ * Write unsaved sessions and free the cache (handles must no longer use its share)
+ */
+void chunks_tls_close(chunks_tls_cache_t *cache);
+
+/**
+ * Attach an easy handle to the session cache and import the stored
+ * sessions into its share once (after curl_easy_reset)
+ */
+void chunks_tls_apply(chunks_uploader_t *uploader, CURL *curl);
+
+/**
+ * Pick up the session of a newly opened connection after an attempt
+ */
+void chunks_tls_record(chunks_uploader_t *uploader, CURL *curl);
+
+/**
+ * Start the resolver thread of a new DNS cache
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int chunks_dns_open(uint32_t ttl_s, uint32_t max_stale_s, chunks_dns_cache_t **cache);
+
+/**
+ * Stop the resolver thread (waiting for a lookup in progress) and free the
+ * cache; handles must no longer be set up with its entries
+ */
+void chunks_dns_close(chunks_dns_cache_t *cache);
+
+/**
+ * Give an easy handle the cached addresses of the URL's host, queueing a
+ * refresh when they are stale or missing (after curl_easy_reset)
+ *
+ * @param resolve Set to the handle's own copy of the CURLOPT_RESOLVE list,
+ *                which the caller frees once the transfer is over (NULL if none)
+ */
+void chunks_dns_apply(chunks_uploader_t *uploader, CURL *curl, const char *url,
+                      struct curl_slist **resolve);
+
+/**
+ * Add the name lookup time libcurl reports for an attempt
+ */
+void chunks_dns_record(chunks_uploader_t *uploader, CURL *curl);
+
+/**
+ * Create a dedup window of at least window entries
+ *
+ * @param path Window file to load and keep updated, or NULL for memory only
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int chunks_dedup_open(size_t window, const char *path, chunks_dedup_t **dedup);
+
+/**
+ * Free a dedup window (flushing a persistent one)
+ */
+void chunks_dedup_close(chunks_dedup_t *dedup);
+
+/**
+ * Hash a chunk together with the device (last path segment of uri)
+ *
+ * @return Non-zero key
+ */
+uint64_t chunks_dedup_key(const char *uri, const uint8_t *data, size_t len);
+
+/**
+ * Look up a key
+ *
+ * @return CHUNKS_DEDUP_NONE, CHUNKS_DEDUP_PENDING or CHUNKS_DEDUP_CONFIRMED
+ */
+int chunks_dedup_lookup(chunks_dedup_t *dedup, uint64_t key);
+
+/**
+ * Set the state of a key; CHUNKS_DEDUP_NONE removes it
+ */
+void chunks_dedup_mark(chunks_dedup_t *dedup, uint64_t key, int state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHUNKS_UPLOADER_INTERNAL_H */
@@ -0,0 +1,1193 @@
+/**
+ * @file mds_archive.c
+ * @brief Local compressed chunk archive indexed by device and time
+ *
+ * On-disk layout, per time partition starting at <start> (Unix seconds):
+ *   <start>.seg  sequence of blocks: block header + stored (compressed) bytes
+ *   <start>.idx  array of index entries, one per (block, device)
+ *
+ *   <dict_id>.dict  zstd dictionary used by blocks with that dict_id
+ *
+ * A block holds records of: u64 timestamp_us, u32 data_len, u16 device_len,
+ * device bytes, data bytes. Integers are host-endian; the archive is meant to
+ * be read on the gateway that wrote it.
+ */
+
+#include "mds_bridge/mds_archive.h"
+#include "mds_bridge/mds_protocol.h"
+#include "mds_archive_internal.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+#define ARCHIVE_BLOCK_MAGIC         0x4244414Du   /* "MADB" */
+#define ARCHIVE_RECORD_HEADER_LEN   14
+#define ARCHIVE_MAX_PATH_LEN        512
+
+/* Longest file name appended to the directory: "/<start>.seg" */
+#define ARCHIVE_MAX_NAME_LEN        32
+
+/* Block codecs */
+#define ARCHIVE_CODEC_NONE          0
+#define ARCHIVE_CODEC_ZSTD          1
+#define ARCHIVE_CODEC_ZSTD_DICT     2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t codec;
+    uint32_t dict_id;
+    uint32_t raw_len;
+    uint32_t stored_len;
+    uint32_t count;
+} archive_block_header_t;
+
+/* Decompression state; queries and each cursor have their own. The
+ * dictionary of the last dictionary block is kept for the next one. */
+typedef struct {
+    const char *directory;
+    uint8_t *buf;
+    size_t capacity;
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+    ZSTD_DCtx *dctx;
+    ZSTD_DDict *ddict;
+    uint32_t dict_id;
+#endif
+} archive_decoder_t;
+
+typedef struct {
+    uint64_t device_hash;
+    uint64_t first_us;
+    uint64_t last_us;
+    uint64_t block_offset;
+    uint32_t count;
+    uint32_t reserved;
+} archive_index_entry_t;
+
+struct mds_archive_cursor {
+    mds_archive_t *archive;
+    archive_decoder_t decoder;
+    uint64_t *starts;
+    size_t segment_count;
+    size_t segment_index;
+    uint64_t offset;
+    const uint8_t *seg;
+    size_t seg_len;
+};
+
+struct mds_archive {
+    pthread_mutex_t lock;
+    char directory[ARCHIVE_MAX_PATH_LEN];
+    mds_archive_config_t config;
+    mds_archive_stats_t stats;
+
+    /* Open segment */
+    bool have_segment;
+    uint64_t segment_start;
+    FILE *seg;
+    FILE *idx;
+    uint64_t seg_offset;
+    uint64_t idx_offset;
+
+    /* Open block and its per-device index entries */
+    uint8_t *raw;
+    size_t raw_len;
+    size_t raw_capacity;
+    uint32_t raw_count;
+    archive_index_entry_t *pending;
+    size_t pending_count;
+    size_t pending_capacity;
+
+    /* Scratch for compressed output */
+    uint8_t *scratch;
+    size_t scratch_capacity;
+
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+    ZSTD_CCtx *cctx;
+    ZSTD_CDict *cdict;
+    uint32_t dict_id;
+#endif
+};
+
+/* ============================================================================
+ * Internal Helper Functions
+ * ========================================================================== */
+
+static uint64_t device_hash(const char *device_id, size_t len) {
+    /* FNV-1a */
+    uint64_t hash = 1469598103934665603ull;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)device_id[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static uint64_t wall_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static int ensure_capacity(uint8_t **buf, size_t *capacity, size_t needed) {
+    if (needed <= *capacity) {
+        return 0;
+    }
+
+    uint8_t *grown = realloc(*buf, needed);
+    if (grown == NULL) {
+        return -ENOMEM;
+    }
+    *buf = grown;
+    *capacity = needed;
+    return 0;
+}
+
+static int decoder_init(archive_decoder_t *decoder, const char *directory) {
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->directory = directory;
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+    decoder->dctx = ZSTD_createDCtx();
+    if (decoder->dctx == NULL) {
+        return -ENOMEM;
+    }
+#endif
+    return 0;
+}
+
+static void decoder_free(archive_decoder_t *decoder) {
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+    ZSTD_freeDCtx(decoder->dctx);
+    ZSTD_freeDDict(decoder->ddict);
+#endif
+    free(decoder->buf);
+    memset(decoder, 0, sizeof(*decoder));
+}
+
+static int segment_path(const mds_archive_t *archive, uint64_t start,
+                        const char *ext, char *out, size_t out_len) {
+    int len = snprintf(out, out_len, "%s/%010" PRIu64 ".%s", archive->directory, start, ext);
+    if (len < 0 || (size_t)len >= out_len) {
+        return -ENAMETOOLONG;
+    }
+    return 0;
+}
+
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+static int dict_path(const char *directory, uint32_t dict_id, char *out, size_t out_len) {
+    int len = snprintf(out, out_len, "%s/%010" PRIu32 ".dict", directory, dict_id);
+    if (len < 0 || (size_t)len >= out_len) {
+        return -ENAMETOOLONG;
+    }
+    return 0;
+}
+
+/* Make the decoder's dictionary the one saved under dict_id */
+static int decoder_load_dict(archive_decoder_t *decoder, uint32_t dict_id) {
+    if (decoder->ddict && decoder->dict_id == dict_id) {
+        return 0;
+    }
+
+    char path[ARCHIVE_MAX_PATH_LEN];
+    int ret = dict_path(decoder->directory, dict_id, path, sizeof(path));
+    if (ret < 0) {
+        return ret;
+    }
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return -errno;
+    }
+
+    uint8_t *dict = NULL;
+    long len = -1;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        len = ftell(fp);
+    }
+    if (len > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        dict = malloc((size_t)len);
+    }
+    ret = (dict && fread(dict, 1, (size_t)len, fp) == (size_t)len) ? 0 : -EIO;
+    fclose(fp);
+
+    ZSTD_DDict *ddict = ret == 0 ? ZSTD_createDDict(dict, (size_t)len) : NULL;
+    free(dict);
+    if (ddict == NULL) {
+        return ret < 0 ? ret : -ENOMEM;
+    }
+
+    ZSTD_freeDDict(decoder->ddict);
+    decoder->ddict = ddict;
+    decoder->dict_id = dict_id;
+    return 0;
+}
+#endif
+
+static void archive_close_segment(mds_archive_t *archive) {
+    if (archive->seg) {
+        fclose(archive->seg);
+        archive->seg = NULL;
+    }
+    if (archive->idx) {
+        fclose(archive->idx);
+        archive->idx = NULL;
+    }
+    archive->have_segment = false;
+}
+
+static int archive_open_segment(mds_archive_t *archive, uint64_t start) {
+    char path[ARCHIVE_MAX_PATH_LEN];
+
+    archive_close_segment(archive);
+
+    if (segment_path(archive, start, "seg", path, sizeof(path)) < 0) {
+        return -ENAMETOOLONG;
+    }
+    archive->seg = fopen(path, "ab");
+    if (segment_path(archive, start, "idx", path, sizeof(path)) < 0) {
+        archive_close_segment(archive);
+        return -ENAMETOOLONG;
+    }
+    archive->idx = fopen(path, "ab");
+    if (archive->seg == NULL || archive->idx == NULL) {
+        int err = errno ? -errno : -EIO;
+        archive_close_segment(archive);
+        return err;
+    }
+
+    /* Unbuffered: a failed write must not leave bytes behind to be flushed
+     * after the files are cut back (see archive_flush_locked) */
+    setvbuf(archive->seg, NULL, _IONBF, 0);
+    setvbuf(archive->idx, NULL, _IONBF, 0);
+
+    /* Append mode: blocks go after whatever a previous run wrote */
+    fseek(archive->seg, 0, SEEK_END);
+    fseek(archive->idx, 0, SEEK_END);
+    long end = ftell(archive->seg);
+    long idx_end = ftell(archive->idx);
+    if (end < 0 || idx_end < 0) {
+        archive_close_segment(archive);
+        return -EIO;
+    }
+
+    archive->seg_offset = (uint64_t)end;
+    archive->idx_offset = (uint64_t)idx_end;
+    archive->segment_start = start;
+    archive->have_segment = true;
+    return 0;
+}
+
+/* Delete segments that ended more than retention_seconds ago */
+static void archive_expire_locked(mds_archive_t *archive) {
+    if (archive->config.retention_seconds == 0) {
+        return;
+    }
+
+    uint64_t now_s = wall_time_us() / 1000000u;
+    DIR *dir = opendir(archive->directory);
+    if (dir == NULL) {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        uint64_t start;
+        char ext[4];
+        if (sscanf(entry->d_name, "%" SCNu64 ".%3s", &start, ext) != 2 ||
+            (strcmp(ext, "seg") != 0 && strcmp(ext, "idx") != 0)) {
+            continue;
+        }
+        if (archive->have_segment && start == archive->segment_start) {
+            continue;
+        }
+        if (start + archive->config.segment_seconds +
+            archive->config.retention_seconds > now_s) {
+            continue;
+        }
+
+        char path[ARCHIVE_MAX_PATH_LEN];
+        if (segment_path(archive, start, ext, path, sizeof(path)) == 0 && unlink(path) == 0 && strcmp(ext, "seg") == 0) {
+            archive->stats.segments_expired++;
+        }
+    }
+    closedir(dir);
+}
+
+/* Compress the open block into scratch; returns the stored length */
+static int archive_encode_block(mds_archive_t *archive,
+                                archive_block_header_t *header,
+                                const uint8_t **stored) {
+    header->codec = ARCHIVE_CODEC_NONE;
+    header->dict_id = 0;
+    header->stored_len = (uint32_t)archive->raw_len;
+    *stored = archive->raw;
+
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+    size_t bound = ZSTD_compressBound(archive->raw_len);
+    int ret = ensure_capacity(&archive->scratch, &archive->scratch_capacity, bound);
+    if (ret < 0) {
+        return ret;
+    }
+
+    size_t len;
+    if (archive->cdict) {
+        len = ZSTD_compress_usingCDict(archive->cctx, archive->scratch, bound,
+                                       archive->raw, archive->raw_len, archive->cdict);
+    } else {
+        len = ZSTD_compressCCtx(archive->cctx, archive->scratch, bound,
+                                archive->raw, archive->raw_len,
+                                archive->config.compression_level);
+    }
+
+    /* Keep incompressible blocks raw */
+    if (!ZSTD_isError(len) && len < archive->raw_len) {
+        header->codec = archive->cdict ? ARCHIVE_CODEC_ZSTD_DICT : ARCHIVE_CODEC_ZSTD;
+        header->dict_id = archive->cdict ? archive->dict_id : 0;
+        header->stored_len = (uint32_t)len;
+        *stored = archive->scratch;
+    }
+#endif
+
+    return 0;
+}
+
+static int archive_flush_locked(mds_archive_t *archive) {
+    if (archive->raw_len == 0) {
+        return 0;
+    }
+
+    archive_block_header_t header = {
+        .magic = ARCHIVE_BLOCK_MAGIC,
+        .raw_len = (uint32_t)archive->raw_len,
+        .count = archive->raw_count,
+    };
+    const uint8_t *stored;
+    int ret = archive_encode_block(archive, &header, &stored);
+    if (ret < 0) {
+        return ret;
+    }
+
+    /* Block first, then its index entries, so the index never points past
+     * the end of the segment */
+    for (size_t i = 0; i < archive->pending_count; i++) {
+        archive->pending[i].block_offset = archive->seg_offset;
+    }
+    size_t idx_len = archive->pending_count * sizeof(archive->pending[0]);
+    errno = 0;
+    if (fwrite(&header, sizeof(header), 1, archive->seg) != 1 ||
+        fwrite(stored, 1, header.stored_len, archive->seg) != header.stored_len ||
+        fflush(archive->seg) != 0 ||
+        fwrite(archive->pending, 1, idx_len, archive->idx) != idx_len ||
+        fflush(archive->idx) != 0) {
+        /* Cut both files back to the last complete block (e.g. after
+         * ENOSPC) so a retry lands where the index expects it */
+        int err = errno ? -errno : -EIO;
+        clearerr(archive->seg);
+        clearerr(archive->idx);
+        if (ftruncate(fileno(archive->seg), (off_t)archive->seg_offset) != 0 ||
+            ftruncate(fileno(archive->idx), (off_t)archive->idx_offset) != 0) {
+            /* Offsets are unknown now; the next append reopens the segment */
+            archive_close_segment(archive);
+        }
+        return err;
+    }
+
+    archive->seg_offset += sizeof(header) + header.stored_len;
+    archive->idx_offset += idx_len;
+    archive->stats.blocks++;
+    archive->stats.raw_bytes += header.raw_len;
+    archive->stats.stored_bytes += sizeof(header) + header.stored_len;
+
+    archive->raw_len = 0;
+    archive->raw_count = 0;
+    archive->pending_count = 0;
+    return 0;
+}
+
+static int archive_note_device(mds_archive_t *archive, uint64_t hash, uint64_t timestamp_us) {
+    for (size_t i = 0; i < archive->pending_count; i++) {
+        archive_index_entry_t *e = &archive->pending[i];
+        if (e->device_hash == hash) {
+            if (timestamp_us < e->first_us) {
+                e->first_us = timestamp_us;
+            }
+            if (timestamp_us > e->last_us) {
+                e->last_us = timestamp_us;
+            }
+            e->count++;
+            return 0;
+        }
+    }
+
+    if (archive->pending_count == archive->pending_capacity) {
+        size_t capacity = archive->pending_capacity ? archive->pending_capacity * 2 : 16;
+        archive_index_entry_t *grown = realloc(archive->pending, capacity * sizeof(*grown));
+        if (grown == NULL) {
+            return -ENOMEM;
+        }
+        archive->pending = grown;
+        archive->pending_capacity = capacity;
+    }
+
+    archive->pending[archive->pending_count++] = (archive_index_entry_t){
+        .device_hash = hash,
+        .first_us = timestamp_us,
+        .last_us = timestamp_us,
+        .count = 1,
+    };
+    return 0;
+}
+
+/* Decode the block at offset in a mapped segment. Returns 1 with a pointer to
+ * its records and the offset of the following block, 0 if no complete block
+ * starts at offset (end of segment, or a block still being written), or a
+ * negative error. *next_offset is set for any block with a valid header, so
+ * a block that fails to decode can be skipped. */
+static int archive_decode_block(archive_decoder_t *decoder,
+                                const uint8_t *seg, size_t seg_len, uint64_t offset,
+                                const uint8_t **records, size_t *records_len,
+                                uint64_t *next_offset) {
+    archive_block_header_t header;
+
+    if (offset > seg_len || seg_len - offset < sizeof(header)) {
+        return 0;
+    }
+    memcpy(&header, seg + offset, sizeof(header));
+    if (header.magic != ARCHIVE_BLOCK_MAGIC) {
+        return -EBADMSG;
+    }
+    if (seg_len - offset - sizeof(header) < header.stored_len) {
+        return 0;
+    }
+
+    const uint8_t *stored = seg + offset + sizeof(header);
+    *next_offset = offset + sizeof(header) + header.stored_len;
+
+    if (header.codec == ARCHIVE_CODEC_NONE) {
+        /* Read straight from the mapping */
+        *records = stored;
+        *records_len = header.stored_len;
+        return 1;
+    }
+
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+    if (header.codec == ARCHIVE_CODEC_ZSTD || header.codec == ARCHIVE_CODEC_ZSTD_DICT) {
+        int ret = ensure_capacity(&decoder->buf, &decoder->capacity, header.raw_len);
+        if (ret < 0) {
+            return ret;
+        }
+
+        size_t len;
+        if (header.codec == ARCHIVE_CODEC_ZSTD_DICT) {
+            ret = decoder_load_dict(decoder, header.dict_id);
+            if (ret < 0) {
+                return ret;
+            }
+            len = ZSTD_decompress_usingDDict(decoder->dctx, decoder->buf, header.raw_len,
+                                             stored, header.stored_len, decoder->ddict);
+        } else {
+            len = ZSTD_decompressDCtx(decoder->dctx, decoder->buf, header.raw_len,
+                                      stored, header.stored_len);
+        }
+        if (ZSTD_isError(len) || len != header.raw_len) {
+            return -EBADMSG;
+        }
+
+        *records = decoder->buf;
+        *records_len = len;
+        return 1;
+    }
+#else
+    (void)decoder;
+#endif
+
+    return -ENOTSUP;
+}
+
+int mds_archive_record_next(const uint8_t *records, size_t records_len,
+                            size_t *pos, mds_archive_record_t *record) {
+    uint32_t len;
+    uint16_t device_len;
+
+    if (*pos + ARCHIVE_RECORD_HEADER_LEN > records_len) {
+        return 0;
+    }
+
+    const uint8_t *p = records + *pos;
+    memcpy(&record->timestamp_us, p, sizeof(record->timestamp_us));
+    memcpy(&len, p + 8, sizeof(len));
+    memcpy(&device_len, p + 12, sizeof(device_len));
+    p += ARCHIVE_RECORD_HEADER_LEN;
+
+    if (records_len - *pos - ARCHIVE_RECORD_HEADER_LEN < (size_t)device_len + len ||
+        device_len >= MDS_MAX_DEVICE_ID_LEN) {
+        return 0;
+    }
+
+    record->device_id = (const char *)p;
+    record->device_len = device_len;
+    record->data = p + device_len;
+    record->len = len;
+    *pos += ARCHIVE_RECORD_HEADER_LEN + device_len + len;
+    return 1;
+}
+
+static int map_file(const char *path, const uint8_t **data, size_t *len) {
+    *data = NULL;
+    *len = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -errno;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int err = -errno;
+        close(fd);
+        return err;
+    }
+
+    if (st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            int err = -errno;
+            close(fd);
+            return err;
+        }
+        *data = map;
+        *len = (size_t)st.st_size;
+    }
+
+    close(fd);
+    return 0;
+}
+
+static void unmap_file(const uint8_t *data, size_t len) {
+    if (data) {
+        munmap((void *)data, len);
+    }
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Sorted start times of all segments in the directory */
+static int list_segments(const mds_archive_t *archive, uint64_t **starts, size_t *count) {
+    *starts = NULL;
+    *count = 0;
+
+    DIR *dir = opendir(archive->directory);
+    if (dir == NULL) {
+        return -errno;
+    }
+
+    size_t capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        uint64_t start;
+        char ext[4];
+        if (sscanf(entry->d_name, "%" SCNu64 ".%3s", &start, ext) != 2 ||
+            strcmp(ext, "seg") != 0) {
+            continue;
+        }
+
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 32;
+            uint64_t *grown = realloc(*starts, capacity * sizeof(*grown));
+            if (grown == NULL) {
+                closedir(dir);
+                free(*starts);
+                *starts = NULL;
+                *count = 0;
+                return -ENOMEM;
+            }
+            *starts = grown;
+        }
+        (*starts)[(*count)++] = start;
+    }
+    closedir(dir);
+
+    if (*count > 1) {
+        qsort(*starts, *count, sizeof(**starts), compare_u64);
+    }
+    return 0;
+}
+
+/* Map a segment and its index. The mappings are taken under the lock, when
+ * no flush is half done; later flushes only write (or cut back) bytes past
+ * them, so they stay valid without the lock. */
+static int archive_map_segment(mds_archive_t *archive, uint64_t start,
+                               const uint8_t **idx, size_t *idx_len,
+                               const uint8_t **seg, size_t *seg_len) {
+    char idx_path[ARCHIVE_MAX_PATH_LEN], seg_path[ARCHIVE_MAX_PATH_LEN];
+    int ret = segment_path(archive, start, "idx", idx_path, sizeof(idx_path));
+    if (ret == 0) {
+        ret = segment_path(archive, start, "seg", seg_path, sizeof(seg_path));
+    }
+    if (ret < 0) {
+        return ret;
+    }
+
+    pthread_mutex_lock(&archive->lock);
+    /* Index before segment, so every entry refers to a block inside the
+     * segment mapping */
+    ret = map_file(idx_path, idx, idx_len);
+    if (ret == 0) {
+        ret = map_file(seg_path, seg, seg_len);
+        if (ret < 0) {
+            unmap_file(*idx, *idx_len);
+        }
+    }
+    pthread_mutex_unlock(&archive->lock);
+    return ret;
+}
+
+/* Stream matching records from one segment; returns delivered count or error,
+ * and sets *stop when the callback asked to stop. Runs without the archive
+ * lock, so callbacks do not hold up appends. */
+static int archive_query_segment(mds_archive_t *archive, archive_decoder_t *decoder,
+                                 uint64_t start,
+                                 const char *device_id, uint64_t from_us, uint64_t to_us,
+                                 mds_archive_chunk_fn callback, void *user_data,
+                                 bool *stop, size_t *skipped) {
+    const uint8_t *idx, *seg;
+    size_t idx_len, seg_len;
+
+    int ret = archive_map_segment(archive, start, &idx, &idx_len, &seg, &seg_len);
+    if (ret < 0) {
+        /* Expired since the directory was listed */
+        return ret == -ENOENT ? 0 : ret;
+    }
+
+    size_t device_len = device_id ? strlen(device_id) : 0;
+    uint64_t hash = device_id ? device_hash(device_id, device_len) : 0;
+    size_t entries = idx_len / sizeof(archive_index_entry_t);
+    uint64_t last_block = UINT64_MAX;
+    int delivered = 0;
+
+    for (size_t i = 0; i < entries && !*stop; i++) {
+        archive_index_entry_t e;
+        memcpy(&e, idx + i * sizeof(e), sizeof(e));
+
+        if ((device_id && e.device_hash != hash) ||
+            e.last_us < from_us || e.first_us > to_us ||
+            e.block_offset == last_block) {
+            continue;
+        }
+        last_block = e.block_offset;
+
+        const uint8_t *records;
+        size_t records_len;
+        uint64_t next_offset;
+        ret = archive_decode_block(decoder, seg, seg_len, e.block_offset,
+                                   &records, &records_len, &next_offset);
+        if (ret <= 0) {
+            /* Lost dictionary or damaged block: the rest is still readable */
+            (*skipped)++;
+            continue;
+        }
+
+        size_t pos = 0;
+        mds_archive_record_t record;
+        while (!*stop && mds_archive_record_next(records, records_len, &pos, &record)) {
+            if (record.timestamp_us < from_us || record.timestamp_us > to_us ||
+                (device_id && (record.device_len != device_len ||
+                               memcmp(record.device_id, device_id, device_len) != 0))) {
+                continue;
+            }
+
+            char dev_str[MDS_MAX_DEVICE_ID_LEN];
+            memcpy(dev_str, record.device_id, record.device_len);
+            dev_str[record.device_len] = '\0';
+
+            delivered++;
+            if (callback(dev_str, record.timestamp_us, record.data, record.len, user_data) != 0) {
+                *stop = true;
+            }
+        }
+    }
+
+    unmap_file(seg, seg_len);
+    unmap_file(idx, idx_len);
+    return delivered;
+}
+
+/* ============================================================================
+ * Archive Management
+ * ========================================================================== */
+
+mds_archive_t *mds_archive_open(const char *directory,
+                                const mds_archive_config_t *config) {
+    if (directory == NULL) {
+        return NULL;
+    }
+    if (strlen(directory) >= ARCHIVE_MAX_PATH_LEN - ARCHIVE_MAX_NAME_LEN) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+
+    if (mkdir(directory, 0755) < 0 && errno != EEXIST) {
+        return NULL;
+    }
+
+    mds_archive_t *archive = calloc(1, sizeof(mds_archive_t));
+    if (archive == NULL) {
+        return NULL;
+    }
+
+    strcpy(archive->directory, directory);
+    if (config) {
+        archive->config = *config;
+    }
+    if (archive->config.segment_seconds == 0) {
+        archive->config.segment_seconds = MDS_ARCHIVE_DEFAULT_SEGMENT_SECONDS;
+    }
+    if (archive->config.block_size == 0) {
+        archive->config.block_size = MDS_ARCHIVE_DEFAULT_BLOCK_SIZE;
+    }
+    if (archive->config.compression_level == 0) {
+        archive->config.compression_level = MDS_ARCHIVE_DEFAULT_LEVEL;
+    }
+
+    if (ensure_capacity(&archive->raw, &archive->raw_capacity, archive->config.block_size) < 0) {
+        free(archive);
+        return NULL;
+    }
+
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+    archive->cctx = ZSTD_createCCtx();
+    if (archive->cctx == NULL) {
+        free(archive->raw);
+        free(archive);
+        return NULL;
+    }
+#endif
+
+    pthread_mutex_init(&archive->lock, NULL);
+    return archive;
+}
+
+void mds_archive_close(mds_archive_t *archive) {
+    if (archive == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&archive->lock);
+    if (archive->have_segment) {
+        archive_flush_locked(archive);
+    }
+    archive_close_segment(archive);
+    pthread_mutex_unlock(&archive->lock);
+
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+    ZSTD_freeCCtx(archive->cctx);
+    ZSTD_freeCDict(archive->cdict);
+#endif
+
+    pthread_mutex_destroy(&archive->lock);
+    free(archive->pending);
+    free(archive->scratch);
+    free(archive->raw);
+    free(archive);
+}
+
+/* ============================================================================
+ * Writing
+ * ========================================================================== */
+
+int mds_archive_append(mds_archive_t *archive,
+                       const char *device_id,
+                       uint64_t timestamp_us,
+                       const uint8_t *data,
+                       size_t len) {
+    if (archive == NULL || device_id == NULL || (data == NULL && len > 0)) {
+        return -EINVAL;
+    }
+
+    size_t device_len = strlen(device_id);
+    if (device_len == 0 || device_len >= MDS_MAX_DEVICE_ID_LEN || len > UINT32_MAX) {
+        return -EINVAL;
+    }
+
+    size_t record_len = ARCHIVE_RECORD_HEADER_LEN + device_len + len;
+    uint64_t start = timestamp_us / 1000000u;
+    start -= start % archive->config.segment_seconds;
+
+    pthread_mutex_lock(&archive->lock);
+
+    int ret = 0;
+    if (!archive->have_segment || start != archive->segment_start) {
+        if (archive->have_segment) {
+            ret = archive_flush_locked(archive);
+        }
+        if (ret == 0) {
+            ret = archive_open_segment(archive, start);
+        }
+        if (ret == 0) {
+            archive_expire_locked(archive);
+        }
+    }
+
+    if (ret == 0 && archive->raw_len > 0 &&
+        archive->raw_len + record_len > archive->config.block_size) {
+        ret = archive_flush_locked(archive);
+    }
+
+    /* A chunk larger than a block gets a block of its own */
+    if (ret == 0) {
+        ret = ensure_capacity(&archive->raw, &archive->raw_capacity,
+                              archive->raw_len + record_len);
+    }
+    if (ret == 0) {
+        ret = archive_note_device(archive, device_hash(device_id, device_len), timestamp_us);
+    }
+
+    if (ret == 0) {
+        uint8_t *p = archive->raw + archive->raw_len;
+        uint32_t len32 = (uint32_t)len;
+        uint16_t dev_len16 = (uint16_t)device_len;
+        memcpy(p, &timestamp_us, sizeof(timestamp_us));
+        memcpy(p + 8, &len32, sizeof(len32));
+        memcpy(p + 12, &dev_len16, sizeof(dev_len16));
+        memcpy(p + ARCHIVE_RECORD_HEADER_LEN, device_id, device_len);
+        if (len > 0) {
+            memcpy(p + ARCHIVE_RECORD_HEADER_LEN + device_len, data, len);
+        }
+        archive->raw_len += record_len;
+        archive->raw_count++;
+        archive->stats.chunks++;
+    }
+
+    pthread_mutex_unlock(&archive->lock);
+    return ret;
+}
+
+int mds_archive_callback(const char *uri,
+                         const char *auth_header,
+                         const uint8_t *chunk_data,
+                         size_t chunk_len,
+                         void *user_data) {
+    (void)auth_header;
+
+    if (uri == NULL || chunk_data == NULL || user_data == NULL) {
+        return -EINVAL;
+    }
+
+    /* Device identifier is the last path segment of .../chunks/<device> */
+    size_t path_len = strcspn(uri, "?#");
+    const char *device = uri + path_len;
+    while (device > uri && device[-1] != '/') {
+        device--;
+    }
+
+    size_t device_len = (size_t)(uri + path_len - device);
+    if (device_len == 0 || device_len >= MDS_MAX_DEVICE_ID_LEN) {
+        return -EINVAL;
+    }
+
+    char device_id[MDS_MAX_DEVICE_ID_LEN];
+    memcpy(device_id, device, device_len);
+    device_id[device_len] = '\0';
+
+    return mds_archive_append((mds_archive_t *)user_data, device_id, wall_time_us(),
+                              chunk_data, chunk_len);
+}
+
+int mds_archive_flush(mds_archive_t *archive) {
+    if (archive == NULL) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&archive->lock);
+    int ret = archive->have_segment ? archive_flush_locked(archive) : 0;
+    pthread_mutex_unlock(&archive->lock);
+
+    return ret;
+}
+
+/* ============================================================================
+ * Queries
+ * ========================================================================== */
+
+int mds_archive_query(mds_archive_t *archive,
+                      const char *device_id,
+                      uint64_t from_us,
+                      uint64_t to_us,
+                      mds_archive_chunk_fn callback,
+                      void *user_data) {
+    if (archive == NULL || callback == NULL || from_us > to_us) {
+        return -EINVAL;
+    }
+
+    /* The lock is only taken to flush and to map segments: a long query
+     * must not hold up appends (and make a fan-out sink drop chunks) */
+    pthread_mutex_lock(&archive->lock);
+    int ret = archive->have_segment ? archive_flush_locked(archive) : 0;
+    pthread_mutex_unlock(&archive->lock);
+    if (ret < 0) {
+        return ret;
+    }
+
+    /* Own decoder: dictionaries load per query, concurrent queries are fine */
+    archive_decoder_t decoder;
+    uint64_t *starts = NULL;
+    size_t count = 0;
+    ret = decoder_init(&decoder, archive->directory);
+    if (ret == 0) {
+        ret = list_segments(archive, &starts, &count);
+    }
+
+    int delivered = 0;
+    size_t skipped = 0;
+    bool stop = false;
+    for (size_t i = 0; ret == 0 && i < count && !stop; i++) {
+        /* Segments are partitioned by append time, so any that start after
+         * the range cannot match */
+        if (starts[i] * 1000000u > to_us) {
+            break;
+        }
+
+        int n = archive_query_segment(archive, &decoder, starts[i], device_id, from_us, to_us,
+                                      callback, user_data, &stop, &skipped);
+        if (n < 0) {
+            ret = n;
+        } else {
+            delivered += n;
+        }
+    }
+
+    if (skipped > 0) {
+        pthread_mutex_lock(&archive->lock);
+        archive->stats.blocks_skipped += skipped;
+        pthread_mutex_unlock(&archive->lock);
+    }
+    decoder_free(&decoder);
+    free(starts);
+
+    return ret < 0 ? ret : delivered;
+}
+
+/* ============================================================================
+ * Dictionaries
+ * ========================================================================== */
+
+int mds_archive_set_dictionary(mds_archive_t *archive,
+                               const void *dict,
+                               size_t dict_len) {
+    if (archive == NULL || dict == NULL || dict_len == 0) {
+        return -EINVAL;
+    }
+
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+    /* Raw-content dictionaries have no zstd ID; key them by content */
+    uint32_t dict_id = ZSTD_getDictID_fromDict(dict, dict_len);
+    if (dict_id == 0) {
+        uint64_t hash = device_hash(dict, dict_len);
+        dict_id = (uint32_t)(hash ^ (hash >> 32)) | 1u;
+    }
+
+    /* Saved before any block uses it, so every block stays readable after
+     * retraining or reopening */
+    char path[ARCHIVE_MAX_PATH_LEN], tmp[ARCHIVE_MAX_PATH_LEN + 4];
+    int ret = dict_path(archive->directory, dict_id, path, sizeof(path));
+    if (ret < 0) {
+        return ret;
+    }
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "wb");
+    if (fp == NULL) {
+        return -errno;
+    }
+    bool written = fwrite(dict, 1, dict_len, fp) == dict_len;
+    if (fclose(fp) != 0 || !written || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -EIO;
+    }
+
+    ZSTD_CDict *cdict = ZSTD_createCDict(dict, dict_len, archive->config.compression_level);
+    if (cdict == NULL) {
+        return -ENOMEM;
+    }
+
+    pthread_mutex_lock(&archive->lock);
+
+    /* Blocks already buffered belong to the previous dictionary */
+    ret = archive->have_segment ? archive_flush_locked(archive) : 0;
+    if (ret == 0) {
+        ZSTD_freeCDict(archive->cdict);
+        archive->cdict = cdict;
+        archive->dict_id = dict_id;
+    }
+
+    pthread_mutex_unlock(&archive->lock);
+
+    if (ret < 0) {
+        ZSTD_freeCDict(cdict);
+    }
+    return ret;
+#else
+    return -ENOTSUP;
+#endif
+}
+
+int mds_archive_train_dictionary(const void *samples,
+                                 const size_t *sample_sizes,
+                                 unsigned int sample_count,
+                                 void *dict,
+                                 size_t dict_capacity) {
+    if (samples == NULL || sample_sizes == NULL || sample_count == 0 ||
+        dict == NULL || dict_capacity == 0) {
+        return -EINVAL;
+    }
+
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+    size_t len = ZDICT_trainFromBuffer(dict, dict_capacity, samples, sample_sizes, sample_count);
+    if (ZDICT_isError(len)) {
+        return -EINVAL;
+    }
+    return (int)len;
+#else
+    return -ENOTSUP;
+#endif
+}
+
+/* ============================================================================
+ * Sequential Cursor
+ * ========================================================================== */
+
+const char *mds_archive_get_directory(const mds_archive_t *archive) {
+    return archive->directory;
+}
+
+int mds_archive_cursor_open(mds_archive_t *archive, uint64_t segment, uint64_t offset,
+                            mds_archive_cursor_t **cursor) {
+    *cursor = NULL;
+
+    mds_archive_cursor_t *c = calloc(1, sizeof(*c));
+    if (c == NULL) {
+        return -ENOMEM;
+    }
+
+    int ret = decoder_init(&c->decoder, archive->directory);
+    if (ret == 0) {
+        ret = list_segments(archive, &c->starts, &c->segment_count);
+    }
+    if (ret < 0) {
+        decoder_free(&c->decoder);
+        free(c);
+        return ret;
+    }
+
+    /* Skip segments before the resume point */
+    c->archive = archive;
+    while (c->segment_index < c->segment_count && c->starts[c->segment_index] < segment) {
+        c->segment_index++;
+    }
+    if (c->segment_index < c->segment_count && c->starts[c->segment_index] == segment) {
+        c->offset = offset;
+    }
+
+    *cursor = c;
+    return 0;
+}
+
+int mds_archive_cursor_next_block(mds_archive_cursor_t *cursor,
+                                  mds_archive_block_t *block) {
+    while (cursor->segment_index < cursor->segment_count) {
+        uint64_t start = cursor->starts[cursor->segment_index];
+
+        if (cursor->seg == NULL) {
+            char path[ARCHIVE_MAX_PATH_LEN];
+            int ret = segment_path(cursor->archive, start, "seg", path, sizeof(path));
+            if (ret == 0) {
+                /* Not while a flush is half done (see archive_map_segment) */
+                pthread_mutex_lock(&cursor->archive->lock);
+                ret = map_file(path, &cursor->seg, &cursor->seg_len);
+                pthread_mutex_unlock(&cursor->archive->lock);
+            }
+            if (ret < 0 && ret != -ENOENT) {
+                return ret;
+            }
+            if (cursor->seg) {
+                madvise((void *)cursor->seg, cursor->seg_len, MADV_SEQUENTIAL);
+            }
+        }
+
+        uint64_t next_offset = 0;
+        int ret = archive_decode_block(&cursor->decoder, cursor->seg, cursor->seg_len,
+                                       cursor->offset, &block->records, &block->records_len,
+                                       &next_offset);
+        if (ret < 0 && next_offset > cursor->offset) {
+            /* Undecodable block: skip it rather than stall every later one */
+            pthread_mutex_lock(&cursor->archive->lock);
+            cursor->archive->stats.blocks_skipped++;
+            pthread_mutex_unlock(&cursor->archive->lock);
+            cursor->offset = next_offset;
+            continue;
+        }
+        if (ret < 0) {
+            return ret;
+        }
+
+        if (ret > 0) {
+            block->segment = start;
+            block->offset = cursor->offset;
+            block->next_offset = next_offset;
+            cursor->offset = next_offset;
+            return 1;
+        }
+
+        /* End of this segment */
+        unmap_file(cursor->seg, cursor->seg_len);
+        cursor->seg = NULL;
+        cursor->seg_len = 0;
+        cursor->offset = 0;
+        cursor->segment_index++;
+    }
+
+    return 0;
+}
+
+void mds_archive_cursor_close(mds_archive_cursor_t *cursor) {
+    if (cursor == NULL) {
+        return;
+    }
+
+    unmap_file(cursor->seg, cursor->seg_len);
+    decoder_free(&cursor->decoder);
+    free(cursor->starts);
+    free(cursor);
+}
+
+/* ============================================================================
+ * Statistics
+ * ========================================================================== */
+
+int mds_archive_get_stats(mds_archive_t *archive, mds_archive_stats_t *stats) {
+    if (archive == NULL || stats == NULL) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&archive->lock);
+    *stats = archive->stats;
+    pthread_mutex_unlock(&archive->lock);
+
+    return 0;
+}
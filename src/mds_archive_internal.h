@@ -0,0 +1,85 @@
+/**
+ * @file mds_archive_internal.h
+ * @brief Internal sequential access to archive blocks
+ *
+ * This header is for internal use only and should not be installed as a public API.
+ */
+
+#ifndef MDS_ARCHIVE_INTERNAL_H
+#define MDS_ARCHIVE_INTERNAL_H
+
+#include "mds_bridge/mds_archive.h"
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sequential reader over every block of every segment, oldest first
+ */
+typedef struct mds_archive_cursor mds_archive_cursor_t;
+
+/**
+ * One decoded block; records stay valid until the next cursor call
+ */
+typedef struct {
+    uint64_t segment;               /* Segment start (Unix seconds) */
+    uint64_t offset;                /* Block offset in the segment */
+    uint64_t next_offset;           /* Offset of the following block */
+    const uint8_t *records;
+    size_t records_len;
+} mds_archive_block_t;
+
+/**
+ * One record inside a block; pointers refer into the block
+ */
+typedef struct {
+    uint64_t timestamp_us;
+    const char *device_id;          /* Not NUL-terminated */
+    size_t device_len;
+    const uint8_t *data;
+    size_t len;
+} mds_archive_record_t;
+
+/**
+ * Directory the archive was opened on
+ */
+const char *mds_archive_get_directory(const mds_archive_t *archive);
+
+/**
+ * Open a cursor positioned at (segment, offset); earlier blocks are skipped
+ *
+ * @return 0 on success, negative error code otherwise
+ */
+int mds_archive_cursor_open(mds_archive_t *archive, uint64_t segment, uint64_t offset,
+                            mds_archive_cursor_t **cursor);
+
+/**
+ * Decode the next complete block
+ *
+ * @return 1 if a block was returned, 0 at the end of the archive,
+ *         negative error code otherwise
+ */
+int mds_archive_cursor_next_block(mds_archive_cursor_t *cursor,
+                                  mds_archive_block_t *block);
+
+/**
+ * Close a cursor
+ */
+void mds_archive_cursor_close(mds_archive_cursor_t *cursor);
+
+/**
+ * Parse the record at *pos and advance *pos past it
+ *
+ * @return 1 if a record was parsed, 0 at the end of the block
+ */
+int mds_archive_record_next(const uint8_t *records, size_t records_len,
+                            size_t *pos, mds_archive_record_t *record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MDS_ARCHIVE_INTERNAL_H */
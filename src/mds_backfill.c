@@ -0,0 +1,688 @@
+/**
+ * @file mds_backfill.c
+ * @brief Parallel, rate-limited, resumable upload of archived chunks
+ *
+ * Blocks are read from the archive in order and split into one multipart
+ * batch per device (more if a device exceeds max_batch_bytes). Batches are
+ * uploaded with a curl multi handle multiplexing HTTP/2 streams. A FIFO of
+ * blocks tracks outstanding batches; the checkpoint advances past a block
+ * only once every batch from it has been acknowledged.
+ */
+
+#include "mds_bridge/mds_backfill.h"
+#include "mds_bridge/mds_protocol.h"
+#include "mds_archive_internal.h"
+#include <curl/curl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define BACKFILL_BOUNDARY           "mds-backfill-7c1e4a9d2b5f8036"
+#define BACKFILL_PART_HEADER        "--" BACKFILL_BOUNDARY "\r\nContent-Type: application/octet-stream\r\n\r\n"
+#define BACKFILL_TRAILER            "--" BACKFILL_BOUNDARY "--\r\n"
+#define BACKFILL_MAX_URL_LEN        512
+#define BACKFILL_MAX_PATH_LEN       512
+
+/* Retry back-off: base << (attempt - 1), capped */
+#define BACKFILL_RETRY_BASE_MS      250
+#define BACKFILL_RETRY_MAX_MS       30000
+
+/* Idle wait while requests are in flight */
+#define BACKFILL_POLL_MS            100
+
+/* One archive block; freed once all its batches are acknowledged */
+typedef struct backfill_block {
+    uint64_t segment;
+    uint64_t next_offset;
+    size_t outstanding;
+    struct backfill_block *next;
+} backfill_block_t;
+
+/* One request body: consecutive chunks of one device from one block */
+typedef struct backfill_batch {
+    backfill_block_t *block;
+    char device_id[MDS_MAX_DEVICE_ID_LEN];
+    uint8_t *body;
+    size_t body_len;
+    size_t body_capacity;
+    size_t chunk_count;
+    size_t chunk_bytes;
+    unsigned int attempts;
+    uint64_t retry_at_ms;
+    struct backfill_batch *next;
+} backfill_batch_t;
+
+typedef struct {
+    CURL *easy;
+    backfill_batch_t *batch;
+    char url[BACKFILL_MAX_URL_LEN];
+} backfill_slot_t;
+
+typedef struct {
+    mds_backfill_config_t config;
+    char checkpoint_path[BACKFILL_MAX_PATH_LEN];
+    mds_backfill_stats_t stats;
+
+    CURLM *multi;
+    struct curl_slist *headers;
+    backfill_slot_t slots[MDS_BACKFILL_MAX_PARALLEL];
+    unsigned int in_flight;
+
+    /* Blocks in archive order, oldest first */
+    backfill_block_t *blocks_head;
+    backfill_block_t *blocks_tail;
+
+    /* Batches waiting to be sent (or re-sent) */
+    backfill_batch_t *ready_head;
+    backfill_batch_t *ready_tail;
+    size_t ready_count;
+
+    /* Last saved checkpoint */
+    uint64_t checkpoint_segment;
+    uint64_t checkpoint_offset;
+
+    /* Global token bucket, in bytes */
+    double tokens;
+    double bucket_size;
+    uint64_t tokens_at_ms;
+} backfill_t;
+
+/* ============================================================================
+ * Internal Helper Functions
+ * ========================================================================== */
+
+static uint64_t backfill_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+static void backfill_sleep_ms(uint64_t ms) {
+    struct timespec ts = {
+        .tv_sec = (time_t)(ms / 1000),
+        .tv_nsec = (long)(ms % 1000) * 1000000L,
+    };
+    nanosleep(&ts, NULL);
+}
+
+static int batch_append(backfill_batch_t *batch, const void *data, size_t len) {
+    if (batch->body_len + len > batch->body_capacity) {
+        size_t capacity = batch->body_capacity ? batch->body_capacity * 2 : 4096;
+        while (capacity < batch->body_len + len) {
+            capacity *= 2;
+        }
+        uint8_t *grown = realloc(batch->body, capacity);
+        if (grown == NULL) {
+            return -ENOMEM;
+        }
+        batch->body = grown;
+        batch->body_capacity = capacity;
+    }
+
+    memcpy(batch->body + batch->body_len, data, len);
+    batch->body_len += len;
+    return 0;
+}
+
+static void batch_free(backfill_batch_t *batch) {
+    free(batch->body);
+    free(batch);
+}
+
+static void ready_push_back(backfill_t *bf, backfill_batch_t *batch) {
+    batch->next = NULL;
+    if (bf->ready_tail) {
+        bf->ready_tail->next = batch;
+    } else {
+        bf->ready_head = batch;
+    }
+    bf->ready_tail = batch;
+    bf->ready_count++;
+}
+
+static void ready_push_front(backfill_t *bf, backfill_batch_t *batch) {
+    batch->next = bf->ready_head;
+    bf->ready_head = batch;
+    if (bf->ready_tail == NULL) {
+        bf->ready_tail = batch;
+    }
+    bf->ready_count++;
+}
+
+/* True if an earlier batch of the same device is in flight or still waiting */
+static bool ready_device_busy(const backfill_t *bf, const backfill_batch_t *batch) {
+    for (unsigned int i = 0; i < bf->config.max_parallel; i++) {
+        const backfill_batch_t *sent = bf->slots[i].batch;
+        if (sent && strcmp(sent->device_id, batch->device_id) == 0) {
+            return true;
+        }
+    }
+    for (const backfill_batch_t *b = bf->ready_head; b != batch; b = b->next) {
+        if (strcmp(b->device_id, batch->device_id) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Remove the first batch that may be sent now. The server reassembles a
+ * device's chunks in order, so each device has at most one batch in flight
+ * and a retry holds back the batches behind it. */
+static backfill_batch_t *ready_take(backfill_t *bf, uint64_t now) {
+    backfill_batch_t *prev = NULL;
+    for (backfill_batch_t *b = bf->ready_head; b; prev = b, b = b->next) {
+        if (b->retry_at_ms > now || ready_device_busy(bf, b)) {
+            continue;
+        }
+        if (prev) {
+            prev->next = b->next;
+        } else {
+            bf->ready_head = b->next;
+        }
+        if (bf->ready_tail == b) {
+            bf->ready_tail = prev;
+        }
+        bf->ready_count--;
+        b->next = NULL;
+        return b;
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * Checkpoint
+ * ========================================================================== */
+
+static void checkpoint_load(backfill_t *bf) {
+    FILE *fp = fopen(bf->checkpoint_path, "r");
+    if (fp == NULL) {
+        return;
+    }
+
+    uint64_t segment, offset;
+    if (fscanf(fp, "%" SCNu64 " %" SCNu64, &segment, &offset) == 2) {
+        bf->checkpoint_segment = segment;
+        bf->checkpoint_offset = offset;
+    }
+    fclose(fp);
+}
+
+static int checkpoint_save(backfill_t *bf) {
+    char tmp[BACKFILL_MAX_PATH_LEN + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", bf->checkpoint_path);
+
+    FILE *fp = fopen(tmp, "w");
+    if (fp == NULL) {
+        return -errno;
+    }
+    fprintf(fp, "%" PRIu64 " %" PRIu64 "\n", bf->checkpoint_segment, bf->checkpoint_offset);
+    if (fclose(fp) != 0) {
+        return -EIO;
+    }
+
+    /* Atomic replace so a crash never leaves a torn checkpoint */
+    return rename(tmp, bf->checkpoint_path) == 0 ? 0 : -errno;
+}
+
+/* Release fully acknowledged blocks from the front and move the checkpoint */
+static int checkpoint_advance(backfill_t *bf) {
+    bool moved = false;
+
+    while (bf->blocks_head && bf->blocks_head->outstanding == 0) {
+        backfill_block_t *block = bf->blocks_head;
+        bf->checkpoint_segment = block->segment;
+        bf->checkpoint_offset = block->next_offset;
+        bf->blocks_head = block->next;
+        if (bf->blocks_head == NULL) {
+            bf->blocks_tail = NULL;
+        }
+        free(block);
+        bf->stats.blocks_completed++;
+        moved = true;
+    }
+
+    return moved ? checkpoint_save(bf) : 0;
+}
+
+/* ============================================================================
+ * Reading
+ * ========================================================================== */
+
+/* Split one archive block into per-device batches */
+static int backfill_load_block(backfill_t *bf, const mds_archive_block_t *archive_block) {
+    backfill_block_t *block = calloc(1, sizeof(*block));
+    if (block == NULL) {
+        return -ENOMEM;
+    }
+    block->segment = archive_block->segment;
+    block->next_offset = archive_block->next_offset;
+
+    if (bf->blocks_tail) {
+        bf->blocks_tail->next = block;
+    } else {
+        bf->blocks_head = block;
+    }
+    bf->blocks_tail = block;
+
+    /* Open batches for this block, one per device */
+    backfill_batch_t *open = NULL;
+    int ret = 0;
+    size_t pos = 0;
+    mds_archive_record_t record;
+
+    while (ret == 0 && mds_archive_record_next(archive_block->records,
+                                               archive_block->records_len, &pos, &record)) {
+        backfill_batch_t *batch = open;
+        while (batch && (strlen(batch->device_id) != record.device_len ||
+                         memcmp(batch->device_id, record.device_id, record.device_len) != 0)) {
+            batch = batch->next;
+        }
+
+        /* Full batch: queue it and start another for this device */
+        if (batch && batch->chunk_bytes + record.len > bf->config.max_batch_bytes) {
+            backfill_batch_t **link = &open;
+            while (*link != batch) {
+                link = &(*link)->next;
+            }
+            *link = batch->next;
+            ret = batch_append(batch, BACKFILL_TRAILER, strlen(BACKFILL_TRAILER));
+            ready_push_back(bf, batch);
+            batch = NULL;
+        }
+
+        if (ret == 0 && batch == NULL) {
+            batch = calloc(1, sizeof(*batch));
+            if (batch == NULL) {
+                ret = -ENOMEM;
+                break;
+            }
+            memcpy(batch->device_id, record.device_id, record.device_len);
+            batch->block = block;
+            block->outstanding++;
+            batch->next = open;
+            open = batch;
+        }
+
+        if (ret == 0) {
+            ret = batch_append(batch, BACKFILL_PART_HEADER, strlen(BACKFILL_PART_HEADER));
+        }
+        if (ret == 0) {
+            ret = batch_append(batch, record.data, record.len);
+        }
+        if (ret == 0) {
+            ret = batch_append(batch, "\r\n", 2);
+        }
+        if (ret == 0) {
+            batch->chunk_count++;
+            batch->chunk_bytes += record.len;
+        }
+    }
+
+    while (open) {
+        backfill_batch_t *batch = open;
+        open = batch->next;
+        if (ret == 0) {
+            ret = batch_append(batch, BACKFILL_TRAILER, strlen(BACKFILL_TRAILER));
+        }
+        ready_push_back(bf, batch);
+    }
+
+    return ret;
+}
+
+/* ============================================================================
+ * Requests
+ * ========================================================================== */
+
+static void backfill_refill_tokens(backfill_t *bf, uint64_t now) {
+    if (bf->config.max_bytes_per_sec <= 0) {
+        return;
+    }
+
+    bf->tokens += (double)(now - bf->tokens_at_ms) * bf->config.max_bytes_per_sec / 1000.0;
+    if (bf->tokens > bf->bucket_size) {
+        bf->tokens = bf->bucket_size;
+    }
+    bf->tokens_at_ms = now;
+}
+
+static int backfill_start(backfill_t *bf, backfill_slot_t *slot, backfill_batch_t *batch) {
+    int len = snprintf(slot->url, sizeof(slot->url), "%s%s",
+                       bf->config.uri_base, batch->device_id);
+    if (len < 0 || (size_t)len >= sizeof(slot->url)) {
+        return -ENAMETOOLONG;
+    }
+
+    CURL *easy = slot->easy;
+    curl_easy_reset(easy);
+    curl_easy_setopt(easy, CURLOPT_URL, slot->url);
+    curl_easy_setopt(easy, CURLOPT_POST, 1L);
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDS, batch->body);
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, (long)batch->body_len);
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, bf->headers);
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, bf->config.timeout_ms);
+    curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, (void *)slot);
+    if (bf->config.verbose) {
+        curl_easy_setopt(easy, CURLOPT_VERBOSE, 1L);
+    }
+
+    if (curl_multi_add_handle(bf->multi, easy) != CURLM_OK) {
+        return -EIO;
+    }
+
+    slot->batch = batch;
+    bf->in_flight++;
+    return 0;
+}
+
+/* Handle a finished request; returns a fatal error, or 0 */
+static int backfill_complete(backfill_t *bf, backfill_slot_t *slot, CURLcode res) {
+    backfill_batch_t *batch = slot->batch;
+    long http_code = 0;
+
+    curl_easy_getinfo(slot->easy, CURLINFO_RESPONSE_CODE, &http_code);
+    curl_multi_remove_handle(bf->multi, slot->easy);
+    slot->batch = NULL;
+    bf->in_flight--;
+    bf->stats.requests++;
+
+    bool ok = (res == CURLE_OK && http_code >= 200 && http_code < 300);
+    bool retryable = (res != CURLE_OK || http_code >= 500 || http_code == 429);
+
+    if (!ok && retryable) {
+        batch->attempts++;
+        if (batch->attempts >= bf->config.max_retries) {
+            fprintf(stderr, "Backfill: %s failed %u times (%s, HTTP %ld)\n",
+                    batch->device_id, batch->attempts, curl_easy_strerror(res), http_code);
+            ready_push_front(bf, batch);
+            return -EIO;
+        }
+
+        uint64_t backoff = (uint64_t)BACKFILL_RETRY_BASE_MS << (batch->attempts - 1);
+        batch->retry_at_ms = backfill_now_ms() +
+                             (backoff > BACKFILL_RETRY_MAX_MS ? BACKFILL_RETRY_MAX_MS : backoff);
+        bf->stats.retries++;
+        ready_push_front(bf, batch);
+        return 0;
+    }
+
+    if (ok) {
+        bf->stats.chunks_uploaded += batch->chunk_count;
+        bf->stats.bytes_uploaded += batch->chunk_bytes;
+    } else {
+        /* Client error: resending the same bytes cannot succeed */
+        fprintf(stderr, "Backfill: %s rejected %zu chunks (HTTP %ld)\n",
+                batch->device_id, batch->chunk_count, http_code);
+        bf->stats.chunks_rejected += batch->chunk_count;
+    }
+
+    batch->block->outstanding--;
+    batch_free(batch);
+    return 0;
+}
+
+static void backfill_cleanup(backfill_t *bf) {
+    for (unsigned int i = 0; i < bf->config.max_parallel; i++) {
+        backfill_slot_t *slot = &bf->slots[i];
+        if (slot->batch) {
+            curl_multi_remove_handle(bf->multi, slot->easy);
+            batch_free(slot->batch);
+        }
+        if (slot->easy) {
+            curl_easy_cleanup(slot->easy);
+        }
+    }
+
+    while (bf->ready_head) {
+        backfill_batch_t *batch = bf->ready_head;
+        bf->ready_head = batch->next;
+        batch_free(batch);
+    }
+
+    while (bf->blocks_head) {
+        backfill_block_t *block = bf->blocks_head;
+        bf->blocks_head = block->next;
+        free(block);
+    }
+
+    if (bf->multi) {
+        curl_multi_cleanup(bf->multi);
+    }
+    curl_slist_free_all(bf->headers);
+}
+
+static int backfill_init(backfill_t *bf, mds_archive_t *archive,
+                         const mds_backfill_config_t *config) {
+    bf->config = *config;
+    if (bf->config.uri_base == NULL) {
+        bf->config.uri_base = MDS_BACKFILL_DEFAULT_URI_BASE;
+    }
+    if (bf->config.max_parallel == 0) {
+        bf->config.max_parallel = MDS_BACKFILL_DEFAULT_PARALLEL;
+    }
+    if (bf->config.max_parallel > MDS_BACKFILL_MAX_PARALLEL) {
+        bf->config.max_parallel = MDS_BACKFILL_MAX_PARALLEL;
+    }
+    if (bf->config.max_batch_bytes == 0) {
+        bf->config.max_batch_bytes = MDS_BACKFILL_DEFAULT_BATCH_BYTES;
+    }
+    if (bf->config.max_retries == 0) {
+        bf->config.max_retries = MDS_BACKFILL_DEFAULT_RETRIES;
+    }
+    if (bf->config.timeout_ms == 0) {
+        bf->config.timeout_ms = 30000;
+    }
+
+    if (config->checkpoint_path) {
+        snprintf(bf->checkpoint_path, sizeof(bf->checkpoint_path), "%s", config->checkpoint_path);
+    } else {
+        snprintf(bf->checkpoint_path, sizeof(bf->checkpoint_path), "%s/backfill.checkpoint",
+                 mds_archive_get_directory(archive));
+    }
+
+    /* Authorization header "Name:Value" -> "Name: Value" */
+    const char *colon = strchr(config->auth_header, ':');
+    if (colon == NULL) {
+        return -EINVAL;
+    }
+    char auth[MDS_MAX_AUTH_LEN + 2];
+    snprintf(auth, sizeof(auth), "%.*s: %s", (int)(colon - config->auth_header),
+             config->auth_header, colon + 1);
+    bf->headers = curl_slist_append(bf->headers, auth);
+    bf->headers = curl_slist_append(bf->headers,
+                                    "Content-Type: multipart/mixed; boundary=" BACKFILL_BOUNDARY);
+
+    bf->multi = curl_multi_init();
+    if (bf->multi == NULL || bf->headers == NULL) {
+        return -ENOMEM;
+    }
+    curl_multi_setopt(bf->multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+
+    for (unsigned int i = 0; i < bf->config.max_parallel; i++) {
+        bf->slots[i].easy = curl_easy_init();
+        if (bf->slots[i].easy == NULL) {
+            return -ENOMEM;
+        }
+    }
+
+    /* One second of burst, but always enough for a full batch */
+    bf->bucket_size = bf->config.max_bytes_per_sec;
+    if (bf->bucket_size < (double)bf->config.max_batch_bytes * 2) {
+        bf->bucket_size = (double)bf->config.max_batch_bytes * 2;
+    }
+    bf->tokens = bf->config.max_bytes_per_sec;
+    bf->tokens_at_ms = backfill_now_ms();
+
+    checkpoint_load(bf);
+    return 0;
+}
+
+/* ============================================================================
+ * Backfill
+ * ========================================================================== */
+
+int mds_backfill_run(mds_archive_t *archive,
+                     const mds_backfill_config_t *config,
+                     mds_backfill_progress_fn progress,
+                     void *user_data,
+                     mds_backfill_stats_t *stats) {
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+    }
+
+    if (archive == NULL || config == NULL || config->auth_header == NULL) {
+        return -EINVAL;
+    }
+
+    backfill_t *bf = calloc(1, sizeof(*bf));
+    if (bf == NULL) {
+        return -ENOMEM;
+    }
+
+    uint64_t started = backfill_now_ms();
+    mds_archive_cursor_t *cursor = NULL;
+    int ret = backfill_init(bf, archive, config);
+
+    /* Include chunks still buffered in the archive's open block */
+    if (ret == 0) {
+        ret = mds_archive_flush(archive);
+    }
+    if (ret == 0) {
+        ret = mds_archive_cursor_open(archive, bf->checkpoint_segment,
+                                      bf->checkpoint_offset, &cursor);
+    }
+
+    bool eof = false;
+    int stop = 0;
+
+    while (ret == 0) {
+        /* Keep a bounded amount of work ready */
+        while (!eof && stop == 0 && ret == 0 && bf->ready_count < 2 * bf->config.max_parallel) {
+            mds_archive_block_t block;
+            int n = mds_archive_cursor_next_block(cursor, &block);
+            if (n < 0) {
+                ret = n;
+            } else if (n == 0) {
+                eof = true;
+            } else {
+                ret = backfill_load_block(bf, &block);
+            }
+        }
+        if (ret == 0) {
+            ret = checkpoint_advance(bf);
+        }
+        if (ret < 0) {
+            break;
+        }
+
+        if (bf->in_flight == 0 && (stop != 0 || (eof && bf->ready_count == 0))) {
+            break;
+        }
+
+        /* Start as many requests as slots and the rate limit allow */
+        uint64_t now = backfill_now_ms();
+        uint64_t wait_ms = BACKFILL_POLL_MS;
+        backfill_refill_tokens(bf, now);
+
+        for (unsigned int i = 0; stop == 0 && i < bf->config.max_parallel; i++) {
+            backfill_slot_t *slot = &bf->slots[i];
+            if (slot->batch) {
+                continue;
+            }
+
+            if (bf->config.max_bytes_per_sec > 0 && bf->ready_head &&
+                bf->tokens < (double)bf->ready_head->body_len) {
+                double deficit = (double)bf->ready_head->body_len - bf->tokens;
+                uint64_t ms = (uint64_t)(deficit * 1000.0 / bf->config.max_bytes_per_sec) + 1;
+                wait_ms = ms < wait_ms ? ms : wait_ms;
+                break;
+            }
+
+            backfill_batch_t *batch = ready_take(bf, now);
+            if (batch == NULL) {
+                break;
+            }
+
+            ret = backfill_start(bf, slot, batch);
+            if (ret < 0) {
+                ready_push_front(bf, batch);
+                break;
+            }
+            if (bf->config.max_bytes_per_sec > 0) {
+                bf->tokens -= (double)batch->body_len;
+            }
+        }
+        if (ret < 0) {
+            break;
+        }
+
+        /* Earliest retry among waiting batches */
+        for (backfill_batch_t *b = bf->ready_head; b; b = b->next) {
+            if (b->retry_at_ms > now && b->retry_at_ms - now < wait_ms) {
+                wait_ms = b->retry_at_ms - now;
+            }
+        }
+
+        if (bf->in_flight == 0) {
+            backfill_sleep_ms(wait_ms);
+            continue;
+        }
+
+        int running = 0;
+        curl_multi_perform(bf->multi, &running);
+
+        CURLMsg *msg;
+        int queued;
+        while ((msg = curl_multi_info_read(bf->multi, &queued)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+
+            CURL *easy = msg->easy_handle;
+            CURLcode res = msg->data.result;
+            backfill_slot_t *slot = NULL;
+            curl_easy_getinfo(easy, CURLINFO_PRIVATE, (char **)&slot);
+
+            int err = backfill_complete(bf, slot, res);
+            if (err < 0 && stop == 0) {
+                stop = err;
+            }
+
+            if (progress && stop == 0) {
+                bf->stats.elapsed_s = (double)(backfill_now_ms() - started) / 1000.0;
+                if (progress(&bf->stats, user_data) != 0) {
+                    stop = -ECANCELED;
+                }
+            }
+        }
+
+        if (bf->in_flight > 0) {
+            curl_multi_poll(bf->multi, NULL, 0, (int)wait_ms, NULL);
+        }
+    }
+
+    if (ret == 0) {
+        ret = stop;
+    }
+
+    if (bf->config.verbose) {
+        printf("Backfill: %zu chunks (%zu bytes) in %zu requests, checkpoint %" PRIu64 ":%" PRIu64 "\n",
+               bf->stats.chunks_uploaded, bf->stats.bytes_uploaded, bf->stats.requests,
+               bf->checkpoint_segment, bf->checkpoint_offset);
+    }
+
+    bf->stats.elapsed_s = (double)(backfill_now_ms() - started) / 1000.0;
+    if (stats) {
+        *stats = bf->stats;
+    }
+
+    mds_archive_cursor_close(cursor);
+    backfill_cleanup(bf);
+    free(bf);
+    return ret;
+}
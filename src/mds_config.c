@@ -0,0 +1,400 @@
+/**
+ * @file mds_config.c
+ * @brief Config table of interned, pre-parsed URI and authorization strings
+ *
+ * Each entry lives in one allocation: the node, then the string and the
+ * parsed strings pointing into it. Nodes are chained in two hash indexes,
+ * one by (kind, contents) for interning and one by the address of the
+ * string for mds_config_find().
+ */
+
+#include "mds_bridge/mds_config.h"
+#include "mds_protocol_internal.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <errno.h>
+
+/* Initial bucket count of both indexes (power of two) */
+#define CONFIG_INITIAL_BUCKETS      64
+
+typedef struct config_node {
+    mds_config_entry_t entry;       /* First, so an entry pointer is a node pointer */
+    unsigned int refs;
+    uint64_t hash;
+    struct config_node *next_by_value;
+    struct config_node *next_by_ptr;
+    char text[];
+} config_node_t;
+
+struct mds_config_table {
+    pthread_mutex_t lock;
+    config_node_t **by_value;
+    config_node_t **by_ptr;
+    size_t bucket_count;
+    size_t count;
+};
+
+/* Entry ids are unique across tables so consumers can cache on them */
+static uint64_t config_next_id = 0;
+
+/* ============================================================================
+ * Internal Helper Functions
+ * ========================================================================== */
+
+/* FNV-1a over the kind and the string */
+static uint64_t config_hash(mds_config_kind_t kind, const char *str, size_t len) {
+    uint64_t h = 0xCBF29CE484222325ull ^ (uint64_t)kind;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)str[i];
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+static size_t config_ptr_bucket(const mds_config_table_t *table, const char *str) {
+    uint64_t h = (uint64_t)(uintptr_t)str * 0x9E3779B97F4A7C15ull;
+    return (size_t)(h >> 32) & (table->bucket_count - 1);
+}
+
+static void config_link(mds_config_table_t *table, config_node_t *node) {
+    size_t v = (size_t)node->hash & (table->bucket_count - 1);
+    node->next_by_value = table->by_value[v];
+    table->by_value[v] = node;
+
+    size_t p = config_ptr_bucket(table, node->entry.str);
+    node->next_by_ptr = table->by_ptr[p];
+    table->by_ptr[p] = node;
+}
+
+static void config_unlink(mds_config_table_t *table, config_node_t *node) {
+    config_node_t **link = &table->by_value[(size_t)node->hash & (table->bucket_count - 1)];
+    while (*link != node) {
+        link = &(*link)->next_by_value;
+    }
+    *link = node->next_by_value;
+
+    link = &table->by_ptr[config_ptr_bucket(table, node->entry.str)];
+    while (*link != node) {
+        link = &(*link)->next_by_ptr;
+    }
+    *link = node->next_by_ptr;
+}
+
+/* Double both indexes once the load factor reaches 1 (keeps the old ones on failure) */
+static void config_grow(mds_config_table_t *table) {
+    size_t old_count = table->bucket_count;
+    config_node_t **old_by_value = table->by_value;
+
+    config_node_t **by_value = calloc(old_count * 2, sizeof(*by_value));
+    config_node_t **by_ptr = calloc(old_count * 2, sizeof(*by_ptr));
+    if (by_value == NULL || by_ptr == NULL) {
+        free(by_value);
+        free(by_ptr);
+        return;
+    }
+
+    free(table->by_ptr);
+    table->by_value = by_value;
+    table->by_ptr = by_ptr;
+    table->bucket_count = old_count * 2;
+
+    for (size_t i = 0; i < old_count; i++) {
+        config_node_t *node = old_by_value[i];
+        while (node) {
+            config_node_t *next = node->next_by_value;
+            config_link(table, node);
+            node = next;
+        }
+    }
+    free(old_by_value);
+}
+
+/* Split "scheme://host[:port]/.../device" into normalized origin, host and device */
+static void config_parse_uri(const char *str, char *out, const char **origin,
+                             const char **host, const char **device) {
+    const char *last_slash = strrchr(str, '/');
+    const char *device_src = last_slash ? last_slash + 1 : str;
+    const char *sep = strstr(str, "://");
+
+    char *p = out;
+    *origin = p;
+    if (sep) {
+        size_t scheme_len = (size_t)(sep - str);
+        const char *host_src = sep + 3;
+        size_t host_len = strcspn(host_src, ":/?#");
+        const char *port = "";
+        size_t port_len = 0;
+        if (host_src[host_len] == ':') {
+            port = host_src + host_len + 1;
+            port_len = strcspn(port, "/?#");
+        }
+        if (port_len == 0) {
+            port = (scheme_len == 5 && strncasecmp(str, "https", 5) == 0) ? "443" : "80";
+            port_len = strlen(port);
+        }
+
+        memcpy(p, str, scheme_len);
+        p += scheme_len;
+        memcpy(p, "://", 3);
+        p += 3;
+        memcpy(p, host_src, host_len);
+        p += host_len;
+        *p++ = ':';
+        memcpy(p, port, port_len);
+        p += port_len;
+        for (char *c = out; c < p; c++) {
+            *c = (char)tolower((unsigned char)*c);
+        }
+        *p++ = '\0';
+
+        /* The host is the lowercased copy inside the origin */
+        *host = p;
+        memcpy(p, out + scheme_len + 3, host_len);
+        p += host_len;
+    } else {
+        *host = p;
+    }
+    *p++ = '\0';
+
+    *device = p;
+    memcpy(p, device_src, strlen(device_src) + 1);
+}
+
+/* Build "Name: Value" from "Name:Value" */
+static void config_parse_auth(const char *str, char *out, const char **header) {
+    const char *colon = strchr(str, ':');
+    if (colon == NULL) {
+        *header = NULL;
+        return;
+    }
+
+    size_t name_len = (size_t)(colon - str);
+    size_t value_len = strlen(colon + 1);
+    *header = out;
+    memcpy(out, str, name_len);
+    memcpy(out + name_len, ": ", 2);
+    memcpy(out + name_len + 2, colon + 1, value_len + 1);
+}
+
+static config_node_t *config_node_create(mds_config_kind_t kind, const char *str,
+                                         size_t len, uint64_t hash) {
+    /* Origin, host and device (or the header line) are each at most the
+     * string plus separators and a default port */
+    size_t text_len = (len + 1) + 3 * len + 16;
+
+    config_node_t *node = calloc(1, sizeof(*node) + text_len);
+    if (node == NULL) {
+        return NULL;
+    }
+
+    memcpy(node->text, str, len + 1);
+    char *parsed = node->text + len + 1;
+
+    mds_config_entry_t *entry = &node->entry;
+    entry->id = __atomic_add_fetch(&config_next_id, 1, __ATOMIC_RELAXED);
+    entry->kind = kind;
+    entry->str = node->text;
+    entry->len = len;
+    entry->origin = "";
+    entry->host = "";
+    entry->device = "";
+
+    /* Parse the caller's string: it cannot overlap the output */
+    if (kind == MDS_CONFIG_URI) {
+        config_parse_uri(str, parsed, &entry->origin, &entry->host, &entry->device);
+    } else {
+        config_parse_auth(str, parsed, &entry->header);
+    }
+
+    node->refs = 1;
+    node->hash = hash;
+    return node;
+}
+
+/* ============================================================================
+ * Public API
+ * ========================================================================== */
+
+mds_config_table_t *mds_config_table_create(void) {
+    mds_config_table_t *table = calloc(1, sizeof(*table));
+    if (table == NULL) {
+        return NULL;
+    }
+
+    table->bucket_count = CONFIG_INITIAL_BUCKETS;
+    table->by_value = calloc(table->bucket_count, sizeof(*table->by_value));
+    table->by_ptr = calloc(table->bucket_count, sizeof(*table->by_ptr));
+    if (table->by_value == NULL || table->by_ptr == NULL ||
+        pthread_mutex_init(&table->lock, NULL) != 0) {
+        free(table->by_value);
+        free(table->by_ptr);
+        free(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+int mds_config_table_destroy(mds_config_table_t *table) {
+    if (table == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&table->lock);
+    size_t count = table->count;
+    pthread_mutex_unlock(&table->lock);
+    if (count > 0) {
+        return -EBUSY;
+    }
+
+    pthread_mutex_destroy(&table->lock);
+    free(table->by_value);
+    free(table->by_ptr);
+    free(table);
+    return 0;
+}
+
+const mds_config_entry_t *mds_config_intern(mds_config_table_t *table,
+                                            mds_config_kind_t kind,
+                                            const char *str) {
+    if (table == NULL || str == NULL) {
+        return NULL;
+    }
+
+    size_t len = strlen(str);
+    uint64_t hash = config_hash(kind, str, len);
+
+    pthread_mutex_lock(&table->lock);
+
+    config_node_t *node = table->by_value[(size_t)hash & (table->bucket_count - 1)];
+    for (; node; node = node->next_by_value) {
+        if (node->hash == hash && node->entry.kind == kind &&
+            node->entry.len == len && memcmp(node->entry.str, str, len) == 0) {
+            node->refs++;
+            break;
+        }
+    }
+
+    if (node == NULL) {
+        node = config_node_create(kind, str, len, hash);
+        if (node) {
+            if (table->count >= table->bucket_count) {
+                config_grow(table);
+            }
+            config_link(table, node);
+            table->count++;
+        }
+    }
+
+    pthread_mutex_unlock(&table->lock);
+    return node ? &node->entry : NULL;
+}
+
+void mds_config_release(mds_config_table_t *table, const mds_config_entry_t *entry) {
+    if (table == NULL || entry == NULL) {
+        return;
+    }
+
+    config_node_t *node = (config_node_t *)entry;
+
+    pthread_mutex_lock(&table->lock);
+    bool last = --node->refs == 0;
+    if (last) {
+        config_unlink(table, node);
+        table->count--;
+    }
+    pthread_mutex_unlock(&table->lock);
+
+    if (last) {
+        free(node);
+    }
+}
+
+void mds_config_retain(mds_config_table_t *table, const mds_config_entry_t *entry) {
+    if (table == NULL || entry == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&table->lock);
+    ((config_node_t *)entry)->refs++;
+    pthread_mutex_unlock(&table->lock);
+}
+
+const mds_config_entry_t *mds_config_find(mds_config_table_t *table, const char *str) {
+    if (table == NULL || str == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&table->lock);
+    config_node_t *node = table->by_ptr[config_ptr_bucket(table, str)];
+    while (node && node->entry.str != str) {
+        node = node->next_by_ptr;
+    }
+    pthread_mutex_unlock(&table->lock);
+
+    return node ? &node->entry : NULL;
+}
+
+size_t mds_config_table_count(mds_config_table_t *table) {
+    if (table == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&table->lock);
+    size_t count = table->count;
+    pthread_mutex_unlock(&table->lock);
+    return count;
+}
+
+/* ============================================================================
+ * Session Integration
+ * ========================================================================== */
+
+int mds_session_set_config(mds_session_t *session,
+                           mds_config_table_t *table,
+                           const mds_device_config_t *config) {
+    if (session == NULL || (table != NULL && config == NULL)) {
+        return -EINVAL;
+    }
+
+    const mds_config_entry_t *uri = NULL;
+    const mds_config_entry_t *auth = NULL;
+    if (table) {
+        uri = mds_config_intern(table, MDS_CONFIG_URI, config->data_uri);
+        auth = mds_config_intern(table, MDS_CONFIG_AUTH, config->authorization);
+        if (uri == NULL || auth == NULL) {
+            mds_config_release(table, uri);
+            mds_config_release(table, auth);
+            return -ENOMEM;
+        }
+    }
+
+    /* Swap in the new entries under the session lock; packets being
+     * processed hold their own references, so the old ones are dropped
+     * after unlocking */
+    pthread_mutex_lock(&session->lock);
+    mds_config_table_t *old_table = session->config_table;
+    const mds_config_entry_t *old_uri = session->config_uri;
+    const mds_config_entry_t *old_auth = session->config_auth;
+    session->config_table = table;
+    session->config_uri = uri;
+    session->config_auth = auth;
+    pthread_mutex_unlock(&session->lock);
+
+    mds_config_release(old_table, old_uri);
+    mds_config_release(old_table, old_auth);
+    return 0;
+}
+
+bool mds_session_has_config(mds_session_t *session) {
+    pthread_mutex_lock(&session->lock);
+    bool has_config = session->config_uri != NULL;
+    pthread_mutex_unlock(&session->lock);
+    return has_config;
+}
@@ -0,0 +1,349 @@
+/**
+ * @file mds_fanout.c
+ * @brief Fan-out stage sharing one reference-counted payload across sinks
+ */
+
+#include "mds_bridge/mds_fanout.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+/* One chunk, allocated once and shared by every sink queue */
+typedef struct {
+    unsigned int refs;
+    const char *uri;
+    const char *auth_header;
+    size_t len;
+    uint8_t data[];
+} fanout_payload_t;
+
+typedef struct {
+    mds_chunk_upload_callback_t callback;
+    void *user_data;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;           /* Queue non-empty or stopping */
+    pthread_cond_t idle;            /* Queue empty and nothing in delivery */
+
+    fanout_payload_t **queue;       /* Ring of payload references */
+    size_t capacity;
+    size_t head;
+    size_t count;
+    bool busy;
+    bool stopping;
+
+    mds_fanout_sink_stats_t stats;
+} fanout_sink_t;
+
+struct mds_fanout {
+    pthread_mutex_t lock;           /* Orders adding sinks against the first delivery */
+    fanout_sink_t *sinks[MDS_FANOUT_MAX_SINKS];
+    size_t sink_count;              /* Fixed once started */
+    bool started;
+};
+
+/* ============================================================================
+ * Internal Helper Functions
+ * ========================================================================== */
+
+static fanout_payload_t *payload_create(const char *uri, const char *auth_header,
+                                        const uint8_t *data, size_t len) {
+    size_t uri_len = strlen(uri) + 1;
+    size_t auth_len = strlen(auth_header) + 1;
+
+    fanout_payload_t *payload = malloc(sizeof(*payload) + len + uri_len + auth_len);
+    if (payload == NULL) {
+        return NULL;
+    }
+
+    /* Strings live after the data in the same allocation */
+    char *strings = (char *)payload->data + len;
+    memcpy(payload->data, data, len);
+    memcpy(strings, uri, uri_len);
+    memcpy(strings + uri_len, auth_header, auth_len);
+
+    payload->refs = 1;
+    payload->uri = strings;
+    payload->auth_header = strings + uri_len;
+    payload->len = len;
+    return payload;
+}
+
+static void payload_retain(fanout_payload_t *payload) {
+    __atomic_add_fetch(&payload->refs, 1, __ATOMIC_RELAXED);
+}
+
+static void payload_release(fanout_payload_t *payload) {
+    if (__atomic_sub_fetch(&payload->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        free(payload);
+    }
+}
+
+static void *sink_thread(void *arg) {
+    fanout_sink_t *sink = arg;
+
+    pthread_mutex_lock(&sink->lock);
+    for (;;) {
+        while (sink->count == 0 && !sink->stopping) {
+            pthread_cond_wait(&sink->ready, &sink->lock);
+        }
+        if (sink->count == 0) {
+            break;
+        }
+
+        fanout_payload_t *payload = sink->queue[sink->head];
+        sink->head = (sink->head + 1) % sink->capacity;
+        sink->count--;
+        sink->busy = true;
+        pthread_mutex_unlock(&sink->lock);
+
+        int ret = sink->callback(payload->uri, payload->auth_header,
+                                 payload->data, payload->len, sink->user_data);
+
+        pthread_mutex_lock(&sink->lock);
+        if (ret == 0) {
+            sink->stats.delivered++;
+            sink->stats.bytes_delivered += payload->len;
+        } else {
+            sink->stats.failed++;
+            sink->stats.last_error = ret;
+        }
+        sink->busy = false;
+        if (sink->count == 0) {
+            pthread_cond_broadcast(&sink->idle);
+        }
+
+        payload_release(payload);
+    }
+    pthread_cond_broadcast(&sink->idle);
+    pthread_mutex_unlock(&sink->lock);
+
+    return NULL;
+}
+
+static bool sink_enqueue(fanout_sink_t *sink, fanout_payload_t *payload) {
+    bool queued = false;
+
+    pthread_mutex_lock(&sink->lock);
+    if (sink->count < sink->capacity) {
+        payload_retain(payload);
+        sink->queue[(sink->head + sink->count) % sink->capacity] = payload;
+        sink->count++;
+        if (sink->count > sink->stats.max_queued) {
+            sink->stats.max_queued = sink->count;
+        }
+        pthread_cond_signal(&sink->ready);
+        queued = true;
+    } else {
+        sink->stats.dropped++;
+    }
+    pthread_mutex_unlock(&sink->lock);
+
+    return queued;
+}
+
+static void sink_free(fanout_sink_t *sink) {
+    pthread_mutex_destroy(&sink->lock);
+    pthread_cond_destroy(&sink->ready);
+    pthread_cond_destroy(&sink->idle);
+    free(sink->queue);
+    free(sink);
+}
+
+/* ============================================================================
+ * Fan-Out Management
+ * ========================================================================== */
+
+mds_fanout_t *mds_fanout_create(void) {
+    mds_fanout_t *fanout = calloc(1, sizeof(mds_fanout_t));
+    if (fanout) {
+        pthread_mutex_init(&fanout->lock, NULL);
+    }
+    return fanout;
+}
+
+void mds_fanout_destroy(mds_fanout_t *fanout) {
+    if (fanout == NULL) {
+        return;
+    }
+
+    /* Workers exit once their queue is drained */
+    for (size_t i = 0; i < fanout->sink_count; i++) {
+        fanout_sink_t *sink = fanout->sinks[i];
+        pthread_mutex_lock(&sink->lock);
+        sink->stopping = true;
+        pthread_cond_signal(&sink->ready);
+        pthread_mutex_unlock(&sink->lock);
+    }
+
+    for (size_t i = 0; i < fanout->sink_count; i++) {
+        pthread_join(fanout->sinks[i]->thread, NULL);
+        sink_free(fanout->sinks[i]);
+    }
+
+    pthread_mutex_destroy(&fanout->lock);
+    free(fanout);
+}
+
+/* Sinks below the returned count are never moved or removed until destroy */
+static size_t fanout_sink_count(mds_fanout_t *fanout) {
+    pthread_mutex_lock(&fanout->lock);
+    size_t count = fanout->sink_count;
+    pthread_mutex_unlock(&fanout->lock);
+    return count;
+}
+
+static int fanout_add_sink_locked(mds_fanout_t *fanout,
+                                  mds_chunk_upload_callback_t callback,
+                                  void *user_data,
+                                  size_t queue_depth) {
+    if (fanout->started) {
+        return -EBUSY;
+    }
+
+    if (fanout->sink_count >= MDS_FANOUT_MAX_SINKS) {
+        return -ENOSPC;
+    }
+
+    fanout_sink_t *sink = calloc(1, sizeof(*sink));
+    if (sink == NULL) {
+        return -ENOMEM;
+    }
+
+    sink->capacity = queue_depth ? queue_depth : MDS_FANOUT_DEFAULT_DEPTH;
+    sink->queue = calloc(sink->capacity, sizeof(*sink->queue));
+    if (sink->queue == NULL) {
+        free(sink);
+        return -ENOMEM;
+    }
+
+    sink->callback = callback;
+    sink->user_data = user_data;
+
+    pthread_mutex_init(&sink->lock, NULL);
+    pthread_cond_init(&sink->ready, NULL);
+    pthread_cond_init(&sink->idle, NULL);
+
+    if (pthread_create(&sink->thread, NULL, sink_thread, sink) != 0) {
+        sink_free(sink);
+        return -EAGAIN;
+    }
+
+    fanout->sinks[fanout->sink_count] = sink;
+    return (int)fanout->sink_count++;
+}
+
+int mds_fanout_add_sink(mds_fanout_t *fanout,
+                        mds_chunk_upload_callback_t callback,
+                        void *user_data,
+                        size_t queue_depth) {
+    if (fanout == NULL || callback == NULL) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&fanout->lock);
+    int ret = fanout_add_sink_locked(fanout, callback, user_data, queue_depth);
+    pthread_mutex_unlock(&fanout->lock);
+    return ret;
+}
+
+/* ============================================================================
+ * Delivery
+ * ========================================================================== */
+
+int mds_fanout_callback(const char *uri,
+                        const char *auth_header,
+                        const uint8_t *chunk_data,
+                        size_t chunk_len,
+                        void *user_data) {
+    if (uri == NULL || auth_header == NULL || chunk_data == NULL || user_data == NULL) {
+        return -EINVAL;
+    }
+
+    mds_fanout_t *fanout = (mds_fanout_t *)user_data;
+    pthread_mutex_lock(&fanout->lock);
+    fanout->started = true;
+    size_t sink_count = fanout->sink_count;
+    pthread_mutex_unlock(&fanout->lock);
+
+    if (sink_count == 0) {
+        return -ENOSPC;
+    }
+
+    fanout_payload_t *payload = payload_create(uri, auth_header, chunk_data, chunk_len);
+    if (payload == NULL) {
+        return -ENOMEM;
+    }
+
+    size_t queued = 0;
+    for (size_t i = 0; i < sink_count; i++) {
+        if (sink_enqueue(fanout->sinks[i], payload)) {
+            queued++;
+        }
+    }
+
+    /* Drop the creation reference; the sinks hold their own */
+    payload_release(payload);
+
+    return queued > 0 ? 0 : -ENOSPC;
+}
+
+int mds_fanout_flush(mds_fanout_t *fanout, int timeout_ms) {
+    if (fanout == NULL) {
+        return -EINVAL;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeout_ms >= 0) {
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    size_t sink_count = fanout_sink_count(fanout);
+    for (size_t i = 0; i < sink_count; i++) {
+        fanout_sink_t *sink = fanout->sinks[i];
+        int ret = 0;
+
+        pthread_mutex_lock(&sink->lock);
+        while ((sink->count > 0 || sink->busy) && ret == 0) {
+            if (timeout_ms < 0) {
+                pthread_cond_wait(&sink->idle, &sink->lock);
+            } else {
+                ret = pthread_cond_timedwait(&sink->idle, &sink->lock, &deadline);
+            }
+        }
+        bool drained = (sink->count == 0 && !sink->busy);
+        pthread_mutex_unlock(&sink->lock);
+
+        if (!drained) {
+            return -ETIMEDOUT;
+        }
+    }
+
+    return 0;
+}
+
+int mds_fanout_get_sink_stats(mds_fanout_t *fanout,
+                              int sink,
+                              mds_fanout_sink_stats_t *stats) {
+    if (fanout == NULL || stats == NULL || sink < 0 || (size_t)sink >= fanout_sink_count(fanout)) {
+        return -EINVAL;
+    }
+
+    fanout_sink_t *s = fanout->sinks[sink];
+    pthread_mutex_lock(&s->lock);
+    *stats = s->stats;
+    stats->queued = s->count;
+    pthread_mutex_unlock(&s->lock);
+
+    return 0;
+}
@@ -0,0 +1,810 @@
+/**
+ * @file mds_pipeline.c
+ * @brief Stage chain with per-stage output buffers, and the built-in stages
+ *
+ * Each stage gets an output array of MDS_PIPELINE_MAX_BATCH chunks when it
+ * is added, so running a batch through the chain does not allocate. A batch
+ * is pushed depth-first: whatever a stage emits runs through the rest of
+ * the chain before the stage is called again, which is what lets stages
+ * emit pointers into their own storage.
+ */
+
+#include "mds_bridge/mds_pipeline.h"
+#include "mds_protocol_internal.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+/* Arena bytes reserved per chunk held by a batch stage */
+#define BATCH_SLOT_RESERVE          (MDS_MAX_CHUNK_DATA_LEN + 256)
+
+typedef struct {
+    const mds_stage_ops_t *ops;
+    void *impl;
+    mds_sink_chunk_t *out;          /* MDS_PIPELINE_MAX_BATCH entries */
+    mds_pipeline_stage_stats_t stats;
+} pipeline_stage_t;
+
+struct mds_pipeline {
+    pthread_mutex_t lock;
+    pipeline_stage_t stages[MDS_PIPELINE_MAX_STAGES];
+    size_t stage_count;
+
+    /* Sequence numbers for chunks arriving through the callback */
+    uint64_t submitted;
+};
+
+typedef int (*stage_emit_fn)(void *impl, mds_stage_output_t *out);
+
+/* ============================================================================
+ * Internal Helper Functions
+ * ========================================================================== */
+
+static uint64_t mono_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t wall_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static void note_error(int *first, int err) {
+    if (err < 0 && *first == 0) {
+        *first = err;
+    }
+}
+
+static void stage_account(pipeline_stage_t *stage, uint64_t start_ns, int ret,
+                          const mds_stage_output_t *out) {
+    stage->stats.calls++;
+    stage->stats.busy_ns += mono_time_ns() - start_ns;
+    stage->stats.chunks_out += out->count;
+    if (ret < 0) {
+        stage->stats.last_error = ret;
+    } else if (out->error < 0) {
+        stage->stats.last_error = out->error;
+    }
+}
+
+/* Run chunks through stages[index..]; returns the first error seen */
+static int pipeline_run_locked(mds_pipeline_t *pipeline, size_t index,
+                               const mds_sink_chunk_t *chunks, size_t count) {
+    int first = 0;
+    if (index >= pipeline->stage_count) {
+        return 0;
+    }
+
+    pipeline_stage_t *stage = &pipeline->stages[index];
+    while (count > 0) {
+        mds_stage_output_t out = {
+            .chunks = stage->out,
+            .capacity = MDS_PIPELINE_MAX_BATCH,
+        };
+
+        uint64_t start = mono_time_ns();
+        int ret = stage->ops->process(stage->impl, chunks, count, &out);
+        stage_account(stage, start, ret, &out);
+        note_error(&first, ret < 0 ? ret : out.error);
+
+        if (out.count > 0) {
+            note_error(&first, pipeline_run_locked(pipeline, index + 1, out.chunks, out.count));
+        }
+        if (ret <= 0) {
+            /* A stage that takes nothing would be called forever */
+            note_error(&first, -EAGAIN);
+            stage->stats.chunks_refused += count;
+            break;
+        }
+
+        size_t consumed = (size_t)ret < count ? (size_t)ret : count;
+        stage->stats.chunks_in += consumed;
+        chunks += consumed;
+        count -= consumed;
+    }
+    return first;
+}
+
+/* Let each stage emit held chunks (poll or flush) into the rest of the chain */
+static int pipeline_drain_locked(mds_pipeline_t *pipeline, bool all) {
+    int first = 0;
+
+    for (size_t i = 0; i < pipeline->stage_count; i++) {
+        pipeline_stage_t *stage = &pipeline->stages[i];
+        stage_emit_fn emit = all ? stage->ops->flush : stage->ops->poll;
+        if (emit == NULL) {
+            continue;
+        }
+
+        mds_stage_output_t out = {
+            .chunks = stage->out,
+            .capacity = MDS_PIPELINE_MAX_BATCH,
+        };
+
+        uint64_t start = mono_time_ns();
+        int ret = emit(stage->impl, &out);
+        stage_account(stage, start, ret, &out);
+        note_error(&first, ret < 0 ? ret : out.error);
+
+        if (out.count > 0) {
+            note_error(&first, pipeline_run_locked(pipeline, i + 1, out.chunks, out.count));
+        }
+    }
+    return first;
+}
+
+/* ============================================================================
+ * Pipeline Management
+ * ========================================================================== */
+
+mds_pipeline_t *mds_pipeline_create(void) {
+    mds_pipeline_t *pipeline = calloc(1, sizeof(*pipeline));
+    if (pipeline == NULL) {
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&pipeline->lock, NULL) != 0) {
+        free(pipeline);
+        return NULL;
+    }
+    return pipeline;
+}
+
+void mds_pipeline_destroy(mds_pipeline_t *pipeline) {
+    if (pipeline == NULL) {
+        return;
+    }
+
+    mds_pipeline_flush(pipeline);
+
+    for (size_t i = 0; i < pipeline->stage_count; i++) {
+        pipeline_stage_t *stage = &pipeline->stages[i];
+        if (stage->ops->destroy) {
+            stage->ops->destroy(stage->impl);
+        }
+        free(stage->out);
+    }
+
+    pthread_mutex_destroy(&pipeline->lock);
+    free(pipeline);
+}
+
+int mds_pipeline_add_stage(mds_pipeline_t *pipeline, const mds_stage_ops_t *ops, void *impl) {
+    if (pipeline == NULL || ops == NULL || ops->process == NULL) {
+        return -EINVAL;
+    }
+
+    mds_sink_chunk_t *out = calloc(MDS_PIPELINE_MAX_BATCH, sizeof(*out));
+    if (out == NULL) {
+        return -ENOMEM;
+    }
+
+    pthread_mutex_lock(&pipeline->lock);
+    if (pipeline->stage_count >= MDS_PIPELINE_MAX_STAGES) {
+        pthread_mutex_unlock(&pipeline->lock);
+        free(out);
+        return -ENOSPC;
+    }
+
+    int index = (int)pipeline->stage_count;
+    pipeline_stage_t *stage = &pipeline->stages[index];
+    memset(stage, 0, sizeof(*stage));
+    stage->ops = ops;
+    stage->impl = impl;
+    stage->out = out;
+    pipeline->stage_count++;
+    pthread_mutex_unlock(&pipeline->lock);
+
+    return index;
+}
+
+/* Add a built-in stage, releasing impl if that fails */
+static int pipeline_add_owned(mds_pipeline_t *pipeline, const mds_stage_ops_t *ops, void *impl) {
+    int ret = mds_pipeline_add_stage(pipeline, ops, impl);
+    if (ret < 0 && ops->destroy) {
+        ops->destroy(impl);
+    }
+    return ret;
+}
+
+/* ============================================================================
+ * Delivery
+ * ========================================================================== */
+
+int mds_pipeline_submit_batch(mds_pipeline_t *pipeline, const mds_sink_chunk_t *chunks,
+                              size_t count) {
+    if (pipeline == NULL || (chunks == NULL && count > 0)) {
+        return -EINVAL;
+    }
+
+    int first = 0;
+    pthread_mutex_lock(&pipeline->lock);
+    while (count > 0) {
+        size_t n = count < MDS_PIPELINE_MAX_BATCH ? count : MDS_PIPELINE_MAX_BATCH;
+        note_error(&first, pipeline_run_locked(pipeline, 0, chunks, n));
+        chunks += n;
+        count -= n;
+    }
+    pthread_mutex_unlock(&pipeline->lock);
+
+    return first;
+}
+
+int mds_pipeline_poll(mds_pipeline_t *pipeline) {
+    if (pipeline == NULL) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&pipeline->lock);
+    int ret = pipeline_drain_locked(pipeline, false);
+    pthread_mutex_unlock(&pipeline->lock);
+
+    return ret;
+}
+
+int mds_pipeline_flush(mds_pipeline_t *pipeline) {
+    if (pipeline == NULL) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&pipeline->lock);
+    int ret = pipeline_drain_locked(pipeline, true);
+    pthread_mutex_unlock(&pipeline->lock);
+
+    return ret;
+}
+
+int mds_pipeline_get_stage_stats(mds_pipeline_t *pipeline, int stage,
+                                 mds_pipeline_stage_stats_t *stats) {
+    if (pipeline == NULL || stats == NULL || stage < 0) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&pipeline->lock);
+    if ((size_t)stage >= pipeline->stage_count) {
+        pthread_mutex_unlock(&pipeline->lock);
+        return -EINVAL;
+    }
+    *stats = pipeline->stages[stage].stats;
+    pthread_mutex_unlock(&pipeline->lock);
+
+    return 0;
+}
+
+int mds_pipeline_callback(const char *uri, const char *auth_header,
+                          const uint8_t *chunk_data, size_t chunk_len, void *user_data) {
+    mds_pipeline_t *pipeline = user_data;
+    if (pipeline == NULL || uri == NULL || auth_header == NULL ||
+        (chunk_data == NULL && chunk_len > 0)) {
+        return -EINVAL;
+    }
+
+    mds_sink_chunk_t chunk = {
+        .uri = uri,
+        .auth_header = auth_header,
+        .data = chunk_data,
+        .len = chunk_len,
+        .received_us = wall_time_us(),
+    };
+
+    pthread_mutex_lock(&pipeline->lock);
+    chunk.sequence = pipeline->submitted++;
+    int ret = pipeline_run_locked(pipeline, 0, &chunk, 1);
+    pthread_mutex_unlock(&pipeline->lock);
+
+    return ret;
+}
+
+/* ============================================================================
+ * Filter Stage
+ * ========================================================================== */
+
+typedef struct {
+    mds_stage_filter_fn filter;
+    void *user_data;
+} filter_stage_t;
+
+static int filter_process(void *impl, const mds_sink_chunk_t *in, size_t count,
+                          mds_stage_output_t *out) {
+    filter_stage_t *f = impl;
+    size_t n = count < out->capacity ? count : out->capacity;
+
+    for (size_t i = 0; i < n; i++) {
+        if (f->filter(&in[i], f->user_data)) {
+            out->chunks[out->count++] = in[i];
+        }
+    }
+    return (int)n;
+}
+
+static const mds_stage_ops_t filter_ops = {
+    .name = "filter",
+    .process = filter_process,
+    .destroy = free,
+};
+
+int mds_pipeline_add_filter(mds_pipeline_t *pipeline, mds_stage_filter_fn filter,
+                            void *user_data) {
+    if (pipeline == NULL || filter == NULL) {
+        return -EINVAL;
+    }
+
+    filter_stage_t *f = calloc(1, sizeof(*f));
+    if (f == NULL) {
+        return -ENOMEM;
+    }
+    f->filter = filter;
+    f->user_data = user_data;
+    return pipeline_add_owned(pipeline, &filter_ops, f);
+}
+
+/* ============================================================================
+ * Batch Stage
+ * ========================================================================== */
+
+/* A held chunk; offsets into the arena, which may move when it grows */
+typedef struct {
+    size_t data_off;
+    size_t uri_off;
+    size_t auth_off;
+    size_t len;
+    uint64_t sequence;
+    uint64_t received_us;
+} batch_slot_t;
+
+typedef struct {
+    size_t max_batch;
+    uint32_t max_delay_ms;
+
+    batch_slot_t slots[MDS_PIPELINE_MAX_BATCH];
+    size_t count;
+    uint64_t first_us;              /* When the oldest held chunk arrived */
+    bool emitted;                   /* Held chunks were emitted; clear on next call */
+
+    char *arena;
+    size_t arena_used;
+    size_t arena_capacity;
+} batch_stage_t;
+
+static int batch_arena_put(batch_stage_t *b, const void *src, size_t len, size_t *off) {
+    if (b->arena_used + len > b->arena_capacity) {
+        size_t capacity = b->arena_capacity * 2;
+        if (capacity < b->arena_used + len) {
+            capacity = b->arena_used + len;
+        }
+        char *arena = realloc(b->arena, capacity);
+        if (arena == NULL) {
+            return -ENOMEM;
+        }
+        b->arena = arena;
+        b->arena_capacity = capacity;
+    }
+
+    memcpy(b->arena + b->arena_used, src, len);
+    *off = b->arena_used;
+    b->arena_used += len;
+    return 0;
+}
+
+/* Chunks from one session share their URI and header; store them once */
+static int batch_string_put(batch_stage_t *b, const char *s, size_t prev_off, size_t *off) {
+    if (b->count > 0 && strcmp(b->arena + prev_off, s) == 0) {
+        *off = prev_off;
+        return 0;
+    }
+    return batch_arena_put(b, s, strlen(s) + 1, off);
+}
+
+static int batch_hold(batch_stage_t *b, const mds_sink_chunk_t *chunk) {
+    batch_slot_t *slot = &b->slots[b->count];
+    const batch_slot_t *prev = b->count > 0 ? &b->slots[b->count - 1] : NULL;
+    size_t used = b->arena_used;
+
+    if (batch_arena_put(b, chunk->data, chunk->len, &slot->data_off) < 0 ||
+        batch_string_put(b, chunk->uri, prev ? prev->uri_off : 0, &slot->uri_off) < 0 ||
+        batch_string_put(b, chunk->auth_header, prev ? prev->auth_off : 0, &slot->auth_off) < 0) {
+        b->arena_used = used;
+        return -ENOMEM;
+    }
+
+    slot->len = chunk->len;
+    slot->sequence = chunk->sequence;
+    slot->received_us = chunk->received_us;
+    if (b->count == 0) {
+        b->first_us = mds_time_now_us();
+    }
+    b->count++;
+    return 0;
+}
+
+static void batch_emit(batch_stage_t *b, mds_stage_output_t *out) {
+    for (size_t i = 0; i < b->count; i++) {
+        const batch_slot_t *slot = &b->slots[i];
+        mds_sink_chunk_t *c = &out->chunks[out->count++];
+        c->uri = b->arena + slot->uri_off;
+        c->auth_header = b->arena + slot->auth_off;
+        c->data = (const uint8_t *)b->arena + slot->data_off;
+        c->len = slot->len;
+        c->sequence = slot->sequence;
+        c->received_us = slot->received_us;
+    }
+    b->emitted = true;
+}
+
+/* The emitted chunks have been through the rest of the chain by now */
+static void batch_reclaim(batch_stage_t *b) {
+    if (b->emitted) {
+        b->count = 0;
+        b->arena_used = 0;
+        b->emitted = false;
+    }
+}
+
+static int batch_process(void *impl, const mds_sink_chunk_t *in, size_t count,
+                         mds_stage_output_t *out) {
+    batch_stage_t *b = impl;
+    size_t i = 0;
+
+    batch_reclaim(b);
+    for (; i < count && b->count < b->max_batch; i++) {
+        int ret = batch_hold(b, &in[i]);
+        if (ret < 0) {
+            if (i == 0) {
+                return ret;
+            }
+            break;
+        }
+    }
+
+    if (b->count >= b->max_batch) {
+        batch_emit(b, out);
+    }
+    return (int)i;
+}
+
+static int batch_poll(void *impl, mds_stage_output_t *out) {
+    batch_stage_t *b = impl;
+
+    batch_reclaim(b);
+    if (b->count > 0 && b->max_delay_ms > 0 &&
+        mds_time_now_us() - b->first_us >= (uint64_t)b->max_delay_ms * 1000u) {
+        batch_emit(b, out);
+    }
+    return 0;
+}
+
+static int batch_flush(void *impl, mds_stage_output_t *out) {
+    batch_stage_t *b = impl;
+
+    batch_reclaim(b);
+    if (b->count > 0) {
+        batch_emit(b, out);
+    }
+    return 0;
+}
+
+static void batch_destroy(void *impl) {
+    batch_stage_t *b = impl;
+    free(b->arena);
+    free(b);
+}
+
+static const mds_stage_ops_t batch_ops = {
+    .name = "batch",
+    .process = batch_process,
+    .poll = batch_poll,
+    .flush = batch_flush,
+    .destroy = batch_destroy,
+};
+
+int mds_pipeline_add_batch(mds_pipeline_t *pipeline, size_t max_batch, uint32_t max_delay_ms) {
+    if (pipeline == NULL) {
+        return -EINVAL;
+    }
+
+    batch_stage_t *b = calloc(1, sizeof(*b));
+    if (b == NULL) {
+        return -ENOMEM;
+    }
+
+    b->max_batch = max_batch ? max_batch : MDS_SINK_DEFAULT_BATCH;
+    if (b->max_batch > MDS_PIPELINE_MAX_BATCH) {
+        b->max_batch = MDS_PIPELINE_MAX_BATCH;
+    }
+    b->max_delay_ms = max_delay_ms;
+    b->arena_capacity = b->max_batch * BATCH_SLOT_RESERVE;
+    b->arena = malloc(b->arena_capacity);
+    if (b->arena == NULL) {
+        free(b);
+        return -ENOMEM;
+    }
+    return pipeline_add_owned(pipeline, &batch_ops, b);
+}
+
+/* ============================================================================
+ * Rate Limit Stage
+ * ========================================================================== */
+
+/*
+ * Token bucket in byte-microseconds, so refills need no division. Chunks
+ * over budget wait in a queue kept like a batch stage's storage, and go out
+ * in order once the bucket has refilled, so no chunk of a message is lost.
+ */
+typedef struct {
+    uint64_t rate;                  /* Bytes per second */
+    uint64_t capacity;
+    uint64_t tokens;
+    uint64_t last_us;
+
+    batch_stage_t queue;
+    size_t emitted;                 /* Queued chunks emitted; released on next call */
+} rate_stage_t;
+
+static void rate_refill(rate_stage_t *r) {
+    uint64_t now = mds_time_now_us();
+    uint64_t elapsed = now - r->last_us;
+    r->last_us = now;
+
+    /* Cap elapsed so the product cannot overflow */
+    uint64_t to_full = (r->capacity - r->tokens) / r->rate + 1;
+    if (elapsed > to_full) {
+        elapsed = to_full;
+    }
+
+    r->tokens += elapsed * r->rate;
+    if (r->tokens > r->capacity) {
+        r->tokens = r->capacity;
+    }
+}
+
+/* Take tokens for a chunk; one larger than the bucket goes when it is full */
+static bool rate_admit(rate_stage_t *r, size_t len) {
+    uint64_t cost = (uint64_t)len * 1000000u;
+    if (cost > r->tokens && r->tokens < r->capacity) {
+        return false;
+    }
+    r->tokens = cost < r->tokens ? r->tokens - cost : 0;
+    return true;
+}
+
+/* Drop the queued chunks emitted last time and compact what is left */
+static void rate_release(rate_stage_t *r) {
+    batch_stage_t *q = &r->queue;
+    if (r->emitted == 0) {
+        return;
+    }
+
+    size_t left = q->count - r->emitted;
+    memmove(q->slots, q->slots + r->emitted, left * sizeof(q->slots[0]));
+    q->count = left;
+    r->emitted = 0;
+
+    /* Strings may be shared with released slots: keep from the lowest offset used */
+    size_t base = q->arena_used;
+    for (size_t i = 0; i < left; i++) {
+        const batch_slot_t *slot = &q->slots[i];
+        size_t lowest = slot->data_off;
+        lowest = slot->uri_off < lowest ? slot->uri_off : lowest;
+        lowest = slot->auth_off < lowest ? slot->auth_off : lowest;
+        base = lowest < base ? lowest : base;
+    }
+
+    memmove(q->arena, q->arena + base, q->arena_used - base);
+    q->arena_used -= base;
+    for (size_t i = 0; i < left; i++) {
+        q->slots[i].data_off -= base;
+        q->slots[i].uri_off -= base;
+        q->slots[i].auth_off -= base;
+    }
+}
+
+/* Emit queued chunks in order while tokens last (all of them when forced) */
+static void rate_emit_queued(rate_stage_t *r, mds_stage_output_t *out, bool force) {
+    batch_stage_t *q = &r->queue;
+
+    while (r->emitted < q->count && out->count < out->capacity) {
+        const batch_slot_t *slot = &q->slots[r->emitted];
+        if (!rate_admit(r, slot->len) && !force) {
+            break;
+        }
+
+        mds_sink_chunk_t *c = &out->chunks[out->count++];
+        c->uri = q->arena + slot->uri_off;
+        c->auth_header = q->arena + slot->auth_off;
+        c->data = (const uint8_t *)q->arena + slot->data_off;
+        c->len = slot->len;
+        c->sequence = slot->sequence;
+        c->received_us = slot->received_us;
+        r->emitted++;
+    }
+}
+
+static int rate_process(void *impl, const mds_sink_chunk_t *in, size_t count,
+                        mds_stage_output_t *out) {
+    rate_stage_t *r = impl;
+    size_t i = 0;
+    int ret = 0;
+
+    rate_release(r);
+    rate_refill(r);
+
+    for (; i < count; i++) {
+        /* Nothing overtakes a queued chunk */
+        if (r->queue.count == 0 && out->count < out->capacity && rate_admit(r, in[i].len)) {
+            out->chunks[out->count++] = in[i];
+            continue;
+        }
+
+        ret = r->queue.count < MDS_PIPELINE_MAX_BATCH ? batch_hold(&r->queue, &in[i]) : -ENOBUFS;
+        if (ret < 0) {
+            break;
+        }
+    }
+
+    /* Only now: holding may move the arena that emitted chunks point into */
+    rate_emit_queued(r, out, false);
+    return i > 0 ? (int)i : ret;
+}
+
+static int rate_poll(void *impl, mds_stage_output_t *out) {
+    rate_stage_t *r = impl;
+
+    rate_release(r);
+    rate_refill(r);
+    rate_emit_queued(r, out, false);
+    return 0;
+}
+
+static int rate_flush(void *impl, mds_stage_output_t *out) {
+    rate_stage_t *r = impl;
+
+    rate_release(r);
+    rate_refill(r);
+    rate_emit_queued(r, out, true);
+    return 0;
+}
+
+static void rate_destroy(void *impl) {
+    rate_stage_t *r = impl;
+    free(r->queue.arena);
+    free(r);
+}
+
+static const mds_stage_ops_t rate_ops = {
+    .name = "rate_limit",
+    .process = rate_process,
+    .poll = rate_poll,
+    .flush = rate_flush,
+    .destroy = rate_destroy,
+};
+
+int mds_pipeline_add_rate_limit(mds_pipeline_t *pipeline, uint32_t bytes_per_s,
+                                uint32_t burst_bytes) {
+    if (pipeline == NULL || bytes_per_s == 0) {
+        return -EINVAL;
+    }
+
+    rate_stage_t *r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        return -ENOMEM;
+    }
+
+    r->rate = bytes_per_s;
+    r->capacity = (uint64_t)(burst_bytes ? burst_bytes : bytes_per_s) * 1000000u;
+    r->tokens = r->capacity;
+    r->last_us = mds_time_now_us();
+
+    r->queue.max_batch = MDS_PIPELINE_MAX_BATCH;
+    r->queue.arena_capacity = MDS_PIPELINE_MAX_BATCH * BATCH_SLOT_RESERVE;
+    r->queue.arena = malloc(r->queue.arena_capacity);
+    if (r->queue.arena == NULL) {
+        free(r);
+        return -ENOMEM;
+    }
+    return pipeline_add_owned(pipeline, &rate_ops, r);
+}
+
+/* ============================================================================
+ * Tee Stage
+ * ========================================================================== */
+
+typedef struct {
+    mds_chunk_upload_callback_t callback;
+    void *user_data;
+} tee_stage_t;
+
+static int tee_process(void *impl, const mds_sink_chunk_t *in, size_t count,
+                       mds_stage_output_t *out) {
+    tee_stage_t *t = impl;
+    size_t n = count < out->capacity ? count : out->capacity;
+
+    for (size_t i = 0; i < n; i++) {
+        int ret = t->callback(in[i].uri, in[i].auth_header, in[i].data, in[i].len,
+                              t->user_data);
+        if (ret < 0 && out->error == 0) {
+            out->error = ret;
+        }
+    }
+
+    memcpy(out->chunks + out->count, in, n * sizeof(*in));
+    out->count += n;
+    return (int)n;
+}
+
+static const mds_stage_ops_t tee_ops = {
+    .name = "tee",
+    .process = tee_process,
+    .destroy = free,
+};
+
+int mds_pipeline_add_tee(mds_pipeline_t *pipeline, mds_chunk_upload_callback_t callback,
+                         void *user_data) {
+    if (pipeline == NULL || callback == NULL) {
+        return -EINVAL;
+    }
+
+    tee_stage_t *t = calloc(1, sizeof(*t));
+    if (t == NULL) {
+        return -ENOMEM;
+    }
+    t->callback = callback;
+    t->user_data = user_data;
+    return pipeline_add_owned(pipeline, &tee_ops, t);
+}
+
+/* ============================================================================
+ * Sink Stage
+ * ========================================================================== */
+
+static int sink_process(void *impl, const mds_sink_chunk_t *in, size_t count,
+                        mds_stage_output_t *out) {
+    mds_sink_t *sink = impl;
+    size_t n = count < out->capacity ? count : out->capacity;
+
+    /* Skip past chunks the sink rejects so the rest still reach it */
+    for (size_t i = 0; i < n;) {
+        size_t accepted = 0;
+        int ret = mds_sink_submit_batch(sink, in + i, n - i, &accepted);
+        i += accepted;
+        if (ret < 0) {
+            if (out->error == 0) {
+                out->error = ret;
+            }
+            i++;
+        }
+    }
+
+    memcpy(out->chunks + out->count, in, n * sizeof(*in));
+    out->count += n;
+    return (int)n;
+}
+
+static int sink_poll(void *impl, mds_stage_output_t *out) {
+    (void)out;
+    return mds_sink_poll((mds_sink_t *)impl, 0);
+}
+
+static int sink_flush(void *impl, mds_stage_output_t *out) {
+    (void)out;
+    return mds_sink_flush((mds_sink_t *)impl);
+}
+
+static const mds_stage_ops_t sink_ops = {
+    .name = "sink",
+    .process = sink_process,
+    .poll = sink_poll,
+    .flush = sink_flush,
+};
+
+int mds_pipeline_add_sink(mds_pipeline_t *pipeline, mds_sink_t *sink) {
+    if (pipeline == NULL || sink == NULL) {
+        return -EINVAL;
+    }
+    return mds_pipeline_add_stage(pipeline, &sink_ops, sink);
+}
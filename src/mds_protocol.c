@@ -6,21 +6,13 @@
 #include "mds_bridge/mds_protocol.h"
 #include "mds_bridge/mds_backend.h"
 #include "mds_backend_hid_internal.h"
+#include "mds_protocol_internal.h"
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
-
-/* MDS Session structure */
-struct mds_session {
-    mds_backend_t *backend;
-    uint8_t last_sequence;
-    bool streaming_enabled;
-
-    /* Chunk upload */
-    mds_chunk_upload_callback_t upload_callback;
-    void *upload_user_data;
-};
+#include <limits.h>
+#include <time.h>
 
 
 /* ============================================================================
@@ -38,8 +30,8 @@ static bool mds_validate_sequence(uint8_t prev_seq, uint8_t new_seq) {
     return (new_seq == expected);
 }
 
-static int mds_parse_stream_packet(const uint8_t *buffer, size_t buffer_len,
-                                    mds_stream_packet_t *packet) {
+int mds_parse_stream_packet(const uint8_t *buffer, size_t buffer_len,
+                            mds_stream_packet_t *packet) {
     if (buffer == NULL || packet == NULL) {
         return -EINVAL;
     }
@@ -64,6 +56,138 @@ static int mds_parse_stream_packet(const uint8_t *buffer, size_t buffer_len,
     return 0;
 }
 
+/* Backend access is serialized so control calls can run alongside the reader */
+static int mds_session_backend_read(mds_session_t *session, uint8_t report_id,
+                                    uint8_t *buffer, size_t length, int timeout_ms) {
+    pthread_mutex_lock(&session->lock);
+    int ret = mds_backend_read(session->backend, report_id, buffer, length, timeout_ms);
+    pthread_mutex_unlock(&session->lock);
+    return ret;
+}
+
+static int mds_session_backend_write(mds_session_t *session, uint8_t report_id,
+                                     const uint8_t *buffer, size_t length) {
+    pthread_mutex_lock(&session->lock);
+    int ret = mds_backend_write(session->backend, report_id, buffer, length);
+    pthread_mutex_unlock(&session->lock);
+    return ret;
+}
+
+
+/* ============================================================================
+ * Deadlines
+ * ========================================================================== */
+
+static uint64_t mono_time_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+uint64_t mds_deadline_after(uint32_t timeout_ms) {
+    uint64_t deadline = mono_time_ms() + timeout_ms;
+    return deadline != MDS_DEADLINE_NONE ? deadline : 1;
+}
+
+/* Backend timeout for a transfer that may use 1/steps of the time left
+ * before deadline_ms (steps = 1: all of it). -ETIME once the deadline has
+ * passed. */
+static int mds_deadline_share(uint64_t deadline_ms, unsigned steps, int *timeout_ms) {
+    if (deadline_ms == MDS_DEADLINE_NONE) {
+        *timeout_ms = -1;
+        return 0;
+    }
+
+    uint64_t now = mono_time_ms();
+    if (now >= deadline_ms) {
+        return -ETIME;
+    }
+
+    uint64_t share = (deadline_ms - now) / steps;
+    if (share == 0) {
+        share = 1;  /* 0 would be a non-blocking read */
+    } else if (share > INT_MAX) {
+        share = INT_MAX;
+    }
+    *timeout_ms = (int)share;
+    return 0;
+}
+
+/* Read a report within 1/steps of the time left before deadline_ms; a
+ * timeout is a deadline miss only once the deadline itself has passed */
+static int mds_session_read_by(mds_session_t *session, uint8_t report_id,
+                               uint8_t *buffer, size_t length,
+                               uint64_t deadline_ms, unsigned steps) {
+    int timeout_ms;
+    int ret = mds_deadline_share(deadline_ms, steps, &timeout_ms);
+    if (ret < 0) {
+        return ret;
+    }
+
+    ret = mds_session_backend_read(session, report_id, buffer, length, timeout_ms);
+    if (ret < 0 && deadline_ms != MDS_DEADLINE_NONE && mds_read_is_timeout(ret) &&
+        mono_time_ms() >= deadline_ms) {
+        return -ETIME;
+    }
+    return ret;
+}
+
+/* Writes take no timeout, so the deadline can only stop one being sent */
+static int mds_session_write_by(mds_session_t *session, uint8_t report_id,
+                                const uint8_t *buffer, size_t length,
+                                uint64_t deadline_ms) {
+    int timeout_ms;
+    int ret = mds_deadline_share(deadline_ms, 1, &timeout_ms);
+    if (ret < 0) {
+        return ret;
+    }
+
+    return mds_session_backend_write(session, report_id, buffer, length);
+}
+
+static int mds_read_features(mds_session_t *session, uint32_t *features,
+                             uint64_t deadline_ms) {
+    uint8_t data[4] = {0};
+    int ret = mds_session_read_by(session, MDS_REPORT_ID_SUPPORTED_FEATURES,
+                                  data, sizeof(data), deadline_ms, 1);
+    if (ret < 0) {
+        return ret;
+    }
+
+    if (ret < 4) {
+        return -EINVAL;
+    }
+
+    /* Features is stored as little-endian 32-bit value */
+    *features = (uint32_t)data[0] |
+                ((uint32_t)data[1] << 8) |
+                ((uint32_t)data[2] << 16) |
+                ((uint32_t)data[3] << 24);
+
+    return 0;
+}
+
+/* Read a string report of up to report_len bytes into a null-terminated buffer */
+static int mds_read_string(mds_session_t *session, uint8_t report_id, size_t report_len,
+                           char *out, size_t max_len, uint64_t deadline_ms) {
+    uint8_t data[MDS_MAX_URI_LEN > MDS_MAX_AUTH_LEN ? MDS_MAX_URI_LEN : MDS_MAX_AUTH_LEN];
+    if (report_len > sizeof(data)) {
+        report_len = sizeof(data);
+    }
+
+    int ret = mds_session_read_by(session, report_id, data, report_len, deadline_ms, 1);
+    if (ret < 0) {
+        return ret;
+    }
+
+    /* Copy string, ensuring null termination */
+    size_t copy_len = ((size_t)ret < max_len) ? (size_t)ret : (max_len - 1);
+    memcpy(out, data, copy_len);
+    out[copy_len] = '\0';
+
+    return 0;
+}
+
 
 /* ============================================================================
  * MDS Session Management
@@ -81,9 +205,22 @@ int mds_session_create(mds_backend_t *backend, mds_session_t **session) {
         return -ENOMEM;
     }
 
+    if (pthread_mutex_init(&s->lock, NULL) != 0) {
+        free(s);
+        return -ENOMEM;
+    }
+
+    if (pthread_mutex_init(&s->reader.lock, NULL) != 0) {
+        pthread_mutex_destroy(&s->lock);
+        free(s);
+        return -ENOMEM;
+    }
+
     s->backend = backend;
     s->last_sequence = MDS_SEQUENCE_MAX;  /* Initialize to max so first packet (0) is valid */
     s->streaming_enabled = false;
+    s->reader.pipe_fds[0] = -1;
+    s->reader.pipe_fds[1] = -1;
 
     *session = s;
     return 0;
@@ -140,6 +277,9 @@ void mds_session_destroy(mds_session_t *session) {
         return;
     }
 
+    /* Stop the background reader before touching the backend */
+    mds_reader_stop(session);
+
     /* Disable streaming if enabled */
     if (session->streaming_enabled) {
         mds_stream_disable(session);
@@ -150,6 +290,10 @@ void mds_session_destroy(mds_session_t *session) {
         mds_backend_destroy(session->backend);
     }
 
+    mds_timeseries_free(session);
+    mds_session_set_config(session, NULL, NULL);
+    pthread_mutex_destroy(&session->reader.lock);
+    pthread_mutex_destroy(&session->lock);
     free(session);
 }
 
@@ -157,130 +301,191 @@ void mds_session_destroy(mds_session_t *session) {
  * Device Configuration
  * ========================================================================== */
 
+/* Copy a report string, stopping at a NUL and truncating to the field */
+static void config_copy_string(char *dst, size_t dst_len, const uint8_t *src, size_t len) {
+    size_t copy_len = len < dst_len ? len : dst_len - 1;
+    memcpy(dst, src, copy_len);
+    dst[copy_len] = '\0';
+}
+
+int mds_parse_config_report(const uint8_t *data, size_t len, mds_device_config_t *config) {
+    if (data == NULL || config == NULL) {
+        return -EINVAL;
+    }
+
+    mds_device_config_t parsed;
+    unsigned int seen = 0;
+    size_t pos = 0;
+
+    memset(&parsed, 0, sizeof(parsed));
+    while (pos + 2 <= len && data[pos] != MDS_CONFIG_TAG_END) {
+        uint8_t tag = data[pos];
+        size_t value_len = data[pos + 1];
+        const uint8_t *value = &data[pos + 2];
+        if (pos + 2 + value_len > len) {
+            return -EINVAL;
+        }
+
+        switch (tag) {
+            case MDS_CONFIG_TAG_SUPPORTED_FEATURES:
+                if (value_len < 4) {
+                    return -EINVAL;
+                }
+                parsed.supported_features = (uint32_t)value[0] |
+                                            ((uint32_t)value[1] << 8) |
+                                            ((uint32_t)value[2] << 16) |
+                                            ((uint32_t)value[3] << 24);
+                break;
+            case MDS_CONFIG_TAG_DEVICE_IDENTIFIER:
+                config_copy_string(parsed.device_identifier, sizeof(parsed.device_identifier),
+                                   value, value_len);
+                break;
+            case MDS_CONFIG_TAG_DATA_URI:
+                config_copy_string(parsed.data_uri, sizeof(parsed.data_uri), value, value_len);
+                break;
+            case MDS_CONFIG_TAG_AUTHORIZATION:
+                config_copy_string(parsed.authorization, sizeof(parsed.authorization),
+                                   value, value_len);
+                break;
+            default:
+                /* Newer firmware may add fields */
+                break;
+        }
+        if (tag <= MDS_CONFIG_TAG_AUTHORIZATION) {
+            seen |= 1u << tag;
+        }
+        pos += 2 + value_len;
+    }
+
+    unsigned int required = (1u << MDS_CONFIG_TAG_SUPPORTED_FEATURES) |
+                            (1u << MDS_CONFIG_TAG_DEVICE_IDENTIFIER) |
+                            (1u << MDS_CONFIG_TAG_DATA_URI) |
+                            (1u << MDS_CONFIG_TAG_AUTHORIZATION);
+    if (seen != required) {
+        return -EINVAL;
+    }
+
+    *config = parsed;
+    return 0;
+}
+
 int mds_read_device_config(mds_session_t *session, mds_device_config_t *config) {
+    return mds_read_device_config_deadline(session, config, MDS_DEADLINE_NONE);
+}
+
+int mds_read_device_config_deadline(mds_session_t *session, mds_device_config_t *config,
+                                    uint64_t deadline_ms) {
     if (session == NULL || config == NULL) {
         return -EINVAL;
     }
 
     int ret;
 
+    /* One transfer if the firmware has the combined report. It is optional,
+     * so it only gets the share of the time one of the five reads would */
+    if (!session->config_report_unsupported) {
+        uint8_t data[MDS_MAX_CONFIG_REPORT_LEN];
+        mds_device_config_t combined;
+        ret = mds_session_read_by(session, MDS_REPORT_ID_CONFIG, data, sizeof(data),
+                                  deadline_ms, 5);
+        if (ret > 0 && mds_parse_config_report(data, (size_t)ret, &combined) == 0 &&
+            (combined.supported_features & MDS_FEATURE_CONFIG_REPORT)) {
+            *config = combined;
+            return 0;
+        }
+        /* Anything else, including a stall past its share, means fall back */
+    }
+
     /* Read supported features */
-    ret = mds_get_supported_features(session, &config->supported_features);
+    ret = mds_read_features(session, &config->supported_features, deadline_ms);
     if (ret < 0) {
         return ret;
     }
 
     /* Read device identifier */
-    ret = mds_get_device_identifier(session, config->device_identifier,
-                                     sizeof(config->device_identifier));
+    ret = mds_read_string(session, MDS_REPORT_ID_DEVICE_IDENTIFIER, MDS_MAX_DEVICE_ID_LEN,
+                          config->device_identifier, sizeof(config->device_identifier),
+                          deadline_ms);
     if (ret < 0) {
         return ret;
     }
 
     /* Read data URI */
-    ret = mds_get_data_uri(session, config->data_uri,
-                          sizeof(config->data_uri));
+    ret = mds_read_string(session, MDS_REPORT_ID_DATA_URI, MDS_MAX_URI_LEN,
+                          config->data_uri, sizeof(config->data_uri),
+                          deadline_ms);
     if (ret < 0) {
         return ret;
     }
 
     /* Read authorization */
-    ret = mds_get_authorization(session, config->authorization,
-                               sizeof(config->authorization));
+    ret = mds_read_string(session, MDS_REPORT_ID_AUTHORIZATION, MDS_MAX_AUTH_LEN,
+                          config->authorization, sizeof(config->authorization),
+                          deadline_ms);
     if (ret < 0) {
         return ret;
     }
 
+    /* Older firmware: only ask for the combined report again if advertised */
+    session->config_report_unsupported =
+        (config->supported_features & MDS_FEATURE_CONFIG_REPORT) == 0;
+
     return 0;
 }
 
 int mds_get_supported_features(mds_session_t *session, uint32_t *features) {
-    if (session == NULL || features == NULL) {
-        return -EINVAL;
-    }
-
-    uint8_t data[4] = {0};
-    int ret = mds_backend_read(session->backend,
-                                MDS_REPORT_ID_SUPPORTED_FEATURES,
-                                data, sizeof(data), -1);
-    if (ret < 0) {
-        return ret;
-    }
+    return mds_get_supported_features_deadline(session, features, MDS_DEADLINE_NONE);
+}
 
-    if (ret < 4) {
+int mds_get_supported_features_deadline(mds_session_t *session, uint32_t *features,
+                                        uint64_t deadline_ms) {
+    if (session == NULL || features == NULL) {
         return -EINVAL;
     }
 
-    /* Features is stored as little-endian 32-bit value */
-    *features = (uint32_t)data[0] |
-                ((uint32_t)data[1] << 8) |
-                ((uint32_t)data[2] << 16) |
-                ((uint32_t)data[3] << 24);
-
-    return 0;
+    return mds_read_features(session, features, deadline_ms);
 }
 
 int mds_get_device_identifier(mds_session_t *session, char *device_id, size_t max_len) {
+    return mds_get_device_identifier_deadline(session, device_id, max_len, MDS_DEADLINE_NONE);
+}
+
+int mds_get_device_identifier_deadline(mds_session_t *session, char *device_id, size_t max_len,
+                                       uint64_t deadline_ms) {
     if (session == NULL || device_id == NULL || max_len == 0) {
         return -EINVAL;
     }
 
-    uint8_t data[MDS_MAX_DEVICE_ID_LEN];
-    int ret = mds_backend_read(session->backend,
-                                MDS_REPORT_ID_DEVICE_IDENTIFIER,
-                                data, sizeof(data), -1);
-    if (ret < 0) {
-        return ret;
-    }
-
-    /* Copy string, ensuring null termination */
-    size_t copy_len = ((size_t)ret < max_len) ? (size_t)ret : (max_len - 1);
-    memcpy(device_id, data, copy_len);
-    device_id[copy_len] = '\0';
-
-    return 0;
+    return mds_read_string(session, MDS_REPORT_ID_DEVICE_IDENTIFIER, MDS_MAX_DEVICE_ID_LEN,
+                           device_id, max_len, deadline_ms);
 }
 
 int mds_get_data_uri(mds_session_t *session, char *uri, size_t max_len) {
+    return mds_get_data_uri_deadline(session, uri, max_len, MDS_DEADLINE_NONE);
+}
+
+int mds_get_data_uri_deadline(mds_session_t *session, char *uri, size_t max_len,
+                              uint64_t deadline_ms) {
     if (session == NULL || uri == NULL || max_len == 0) {
         return -EINVAL;
     }
 
-    uint8_t data[MDS_MAX_URI_LEN];
-    int ret = mds_backend_read(session->backend,
-                                MDS_REPORT_ID_DATA_URI,
-                                data, sizeof(data), -1);
-    if (ret < 0) {
-        return ret;
-    }
-
-    /* Copy string, ensuring null termination */
-    size_t copy_len = ((size_t)ret < max_len) ? (size_t)ret : (max_len - 1);
-    memcpy(uri, data, copy_len);
-    uri[copy_len] = '\0';
-
-    return 0;
+    return mds_read_string(session, MDS_REPORT_ID_DATA_URI, MDS_MAX_URI_LEN,
+                           uri, max_len, deadline_ms);
 }
 
 int mds_get_authorization(mds_session_t *session, char *auth, size_t max_len) {
+    return mds_get_authorization_deadline(session, auth, max_len, MDS_DEADLINE_NONE);
+}
+
+int mds_get_authorization_deadline(mds_session_t *session, char *auth, size_t max_len,
+                                   uint64_t deadline_ms) {
     if (session == NULL || auth == NULL || max_len == 0) {
         return -EINVAL;
     }
 
-    uint8_t data[MDS_MAX_AUTH_LEN];
-    int ret = mds_backend_read(session->backend,
-                                MDS_REPORT_ID_AUTHORIZATION,
-                                data, sizeof(data), -1);
-    if (ret < 0) {
-        return ret;
-    }
-
-    /* Copy string, ensuring null termination */
-    size_t copy_len = ((size_t)ret < max_len) ? (size_t)ret : (max_len - 1);
-    memcpy(auth, data, copy_len);
-    auth[copy_len] = '\0';
-
-    return 0;
+    return mds_read_string(session, MDS_REPORT_ID_AUTHORIZATION, MDS_MAX_AUTH_LEN,
+                           auth, max_len, deadline_ms);
 }
 
 /* ============================================================================
@@ -288,6 +493,10 @@ int mds_get_authorization(mds_session_t *session, char *auth, size_t max_len) {
  * ========================================================================== */
 
 int mds_stream_enable(mds_session_t *session) {
+    return mds_stream_enable_deadline(session, MDS_DEADLINE_NONE);
+}
+
+int mds_stream_enable_deadline(mds_session_t *session, uint64_t deadline_ms) {
     if (session == NULL) {
         return -EINVAL;
     }
@@ -297,9 +506,8 @@ int mds_stream_enable(mds_session_t *session) {
     buffer[0] = MDS_STREAM_MODE_ENABLED;
 
     /* Stream Control is a FEATURE report */
-    int ret = mds_backend_write(session->backend,
-                                 MDS_REPORT_ID_STREAM_CONTROL,
-                                 buffer, sizeof(buffer));
+    int ret = mds_session_write_by(session, MDS_REPORT_ID_STREAM_CONTROL,
+                                   buffer, sizeof(buffer), deadline_ms);
     if (ret < 0) {
         return ret;
     }
@@ -309,6 +517,10 @@ int mds_stream_enable(mds_session_t *session) {
 }
 
 int mds_stream_disable(mds_session_t *session) {
+    return mds_stream_disable_deadline(session, MDS_DEADLINE_NONE);
+}
+
+int mds_stream_disable_deadline(mds_session_t *session, uint64_t deadline_ms) {
     if (session == NULL) {
         return -EINVAL;
     }
@@ -318,9 +530,8 @@ int mds_stream_disable(mds_session_t *session) {
     buffer[0] = MDS_STREAM_MODE_DISABLED;
 
     /* Stream Control is a FEATURE report */
-    int ret = mds_backend_write(session->backend,
-                                 MDS_REPORT_ID_STREAM_CONTROL,
-                                 buffer, sizeof(buffer));
+    int ret = mds_session_write_by(session, MDS_REPORT_ID_STREAM_CONTROL,
+                                   buffer, sizeof(buffer), deadline_ms);
     if (ret < 0) {
         return ret;
     }
@@ -339,11 +550,22 @@ int mds_stream_read_packet(mds_session_t *session, mds_stream_packet_t *packet,
         return -EINVAL;
     }
 
+    /* Stream data belongs to the background reader while it runs */
+    if (session->reader.running) {
+        return -EBUSY;
+    }
+
     uint8_t data[MDS_MAX_CHUNK_DATA_LEN + 1];  /* +1 for sequence byte */
 
-    int ret = mds_backend_read(session->backend,
-                                MDS_REPORT_ID_STREAM_DATA,
-                                data, sizeof(data), timeout_ms);
+    pthread_mutex_lock(&session->lock);
+    uint64_t start_us = session->timeseries.buckets ? mds_time_now_us() : 0;
+    int ret = mds_backend_read(session->backend, MDS_REPORT_ID_STREAM_DATA,
+                               data, sizeof(data), timeout_ms);
+    if (session->timeseries.buckets != NULL) {
+        mds_timeseries_record_read_locked(session, ret, data,
+                                          start_us, mds_time_now_us());
+    }
+    pthread_mutex_unlock(&session->lock);
     if (ret < 0) {
         return ret;
     }
@@ -378,10 +600,10 @@ int mds_set_upload_callback(mds_session_t *session,
 }
 
 /* Common packet processing logic (validate, update sequence, upload) */
-static int mds_process_packet_common(mds_session_t *session,
-                                      const mds_device_config_t *config,
-                                      const mds_stream_packet_t *pkt,
-                                      mds_stream_packet_t *packet_out) {
+int mds_process_packet_common(mds_session_t *session,
+                              const mds_device_config_t *config,
+                              const mds_stream_packet_t *pkt,
+                              mds_stream_packet_t *packet_out) {
     /* Validate sequence if we have a previous sequence */
     if (session->last_sequence != MDS_SEQUENCE_MAX) {
         if (!mds_validate_sequence(session->last_sequence, pkt->sequence)) {
@@ -401,25 +623,44 @@ static int mds_process_packet_common(mds_session_t *session,
     }
 
     /* Upload chunk if callback is configured */
-    if (session->upload_callback != NULL) {
-        int ret = session->upload_callback(config->data_uri,
-                                            config->authorization,
-                                            pkt->data,
-                                            pkt->data_len,
-                                            session->upload_user_data);
-        if (ret < 0) {
-            return ret;
-        }
+    if (session->upload_callback == NULL) {
+        return 0;
     }
 
-    return 0;
+    int ret;
+    if (config) {
+        ret = session->upload_callback(config->data_uri, config->authorization,
+                                       pkt->data, pkt->data_len,
+                                       session->upload_user_data);
+        return ret < 0 ? ret : 0;
+    }
+
+    /* Interned config: hold references so mds_session_set_config() can
+     * swap it while the callback runs */
+    pthread_mutex_lock(&session->lock);
+    mds_config_table_t *table = session->config_table;
+    const mds_config_entry_t *uri = session->config_uri;
+    const mds_config_entry_t *auth = session->config_auth;
+    mds_config_retain(table, uri);
+    mds_config_retain(table, auth);
+    pthread_mutex_unlock(&session->lock);
+
+    if (uri == NULL) {
+        return -EINVAL;
+    }
+
+    ret = session->upload_callback(uri->str, auth->str, pkt->data, pkt->data_len,
+                                   session->upload_user_data);
+    mds_config_release(table, uri);
+    mds_config_release(table, auth);
+    return ret < 0 ? ret : 0;
 }
 
 int mds_process_stream(mds_session_t *session,
                        const mds_device_config_t *config,
                        int timeout_ms,
                        mds_stream_packet_t *packet) {
-    if (session == NULL || config == NULL) {
+    if (session == NULL || (config == NULL && !mds_session_has_config(session))) {
         return -EINVAL;
     }
 
@@ -437,7 +678,7 @@ int mds_process_stream_from_bytes(mds_session_t *session,
                                    const uint8_t *buffer,
                                    size_t buffer_len,
                                    mds_stream_packet_t *packet) {
-    if (session == NULL || config == NULL || buffer == NULL) {
+    if (session == NULL || (config == NULL && !mds_session_has_config(session)) || buffer == NULL) {
         return -EINVAL;
     }
 
@@ -447,5 +688,59 @@ int mds_process_stream_from_bytes(mds_session_t *session,
         return ret;
     }
 
+    mds_timeseries_record_external(session, buffer, buffer_len);
+
     return mds_process_packet_common(session, config, &pkt, packet);
 }
+
+int mds_process_stream_batch(mds_session_t *session,
+                              const mds_device_config_t *config,
+                              const uint8_t *buffer,
+                              size_t buffer_len,
+                              const size_t *record_lens,
+                              size_t record_count,
+                              size_t *processed) {
+    if (processed) {
+        *processed = 0;
+    }
+
+    if (session == NULL || (config == NULL && !mds_session_has_config(session))) {
+        return -EINVAL;
+    }
+
+    if (record_count > 0 && (buffer == NULL || record_lens == NULL)) {
+        return -EINVAL;
+    }
+
+    /* Every record must lie inside buffer before any is processed */
+    size_t remaining = buffer_len;
+    for (size_t i = 0; i < record_count; i++) {
+        if (record_lens[i] > remaining) {
+            return -EINVAL;
+        }
+        remaining -= record_lens[i];
+    }
+
+    const uint8_t *cursor = buffer;
+    for (size_t i = 0; i < record_count; i++) {
+        mds_stream_packet_t pkt;
+        int ret = mds_parse_stream_packet(cursor, record_lens[i], &pkt);
+        if (ret < 0) {
+            return ret;
+        }
+
+        mds_timeseries_record_external(session, cursor, record_lens[i]);
+
+        ret = mds_process_packet_common(session, config, &pkt, NULL);
+        if (ret < 0) {
+            return ret;
+        }
+
+        cursor += record_lens[i];
+        if (processed) {
+            *processed = i + 1;
+        }
+    }
+
+    return 0;
+}
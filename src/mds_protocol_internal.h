@@ -0,0 +1,170 @@
+/**
+ * @file mds_protocol_internal.h
+ * @brief Internal MDS session state shared between protocol source files
+ *
+ * This header is for internal use only and should not be installed as a public API.
+ */
+
+#ifndef MDS_PROTOCOL_INTERNAL_H
+#define MDS_PROTOCOL_INTERNAL_H
+
+#include "mds_bridge/mds_protocol.h"
+#include "mds_bridge/mds_config.h"
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Backend read timeout used by the background reader between stop checks */
+#define MDS_READER_POLL_TIMEOUT_MS          50
+
+/**
+ * Background reader state
+ *
+ * The reader thread performs blocking backend reads and queues raw stream
+ * records in a ring, so control calls and mds_process_pending() never wait
+ * for a read in progress. A self-pipe is made readable whenever the ring is
+ * non-empty so the host can wait on it with poll()/select()/epoll.
+ */
+typedef struct {
+    pthread_t thread;
+    bool running;
+    bool stop;
+
+    /* Guards the ring, the self-pipe state, overflows and last_error. The
+     * backend read itself runs without any lock held. */
+    pthread_mutex_t lock;
+
+    /* Self-pipe: [0] is handed to the host, [1] is written by the reader */
+    int pipe_fds[2];
+    bool signaled;
+
+    /* Ring of raw stream records (sequence byte + data) */
+    uint8_t (*records)[MDS_MAX_CHUNK_DATA_LEN + 1];
+    size_t *record_lens;
+    size_t capacity;
+    size_t head;
+    size_t count;
+
+    /* Records dropped because the ring was full */
+    size_t overflows;
+
+    /* Last non-timeout backend error seen by the reader (0 if none) */
+    int last_error;
+} mds_reader_t;
+
+/**
+ * Per-second time-series recorder state (see mds_session_enable_timeseries())
+ *
+ * buckets is a ring of capacity entries; head is the newest bucket. Updated
+ * under the session lock.
+ */
+typedef struct {
+    mds_timeseries_bucket_t *buckets;
+    size_t capacity;
+    size_t head;
+    size_t count;
+
+    /* Arrival tracking for gaps and inter-arrival time */
+    uint64_t last_arrival_us;
+    uint8_t last_sequence;
+    bool have_sequence;
+} mds_timeseries_t;
+
+/* MDS Session structure */
+struct mds_session {
+    mds_backend_t *backend;
+    uint8_t last_sequence;
+    bool streaming_enabled;
+
+    /* Chunk upload */
+    mds_chunk_upload_callback_t upload_callback;
+    void *upload_user_data;
+
+    /* Serializes control backend access, the time-series recorder and the
+     * interned configuration. The background reader has its own lock. */
+    pthread_mutex_t lock;
+
+    /* Background reader (see mds_session_start_reader()) */
+    mds_reader_t reader;
+
+    /* Throughput/jitter recorder (disabled while buckets is NULL) */
+    mds_timeseries_t timeseries;
+
+    /* Interned configuration (see mds_session_set_config()), used when
+     * processing is passed a NULL config */
+    mds_config_table_t *config_table;
+    const mds_config_entry_t *config_uri;
+    const mds_config_entry_t *config_auth;
+
+    /* Device did not answer the combined configuration report */
+    bool config_report_unsupported;
+};
+
+/**
+ * Parse a stream record (sequence byte + data) into a packet
+ */
+int mds_parse_stream_packet(const uint8_t *buffer, size_t buffer_len,
+                            mds_stream_packet_t *packet);
+
+/**
+ * Validate sequence, update tracking, copy out and upload a parsed packet
+ *
+ * A NULL config uploads with the session's interned configuration.
+ */
+int mds_process_packet_common(mds_session_t *session,
+                              const mds_device_config_t *config,
+                              const mds_stream_packet_t *pkt,
+                              mds_stream_packet_t *packet_out);
+
+/**
+ * Stop the background reader if it is running (no-op otherwise)
+ */
+void mds_reader_stop(mds_session_t *session);
+
+/**
+ * True if a backend read result means "no data yet" rather than an error
+ */
+bool mds_read_is_timeout(int ret);
+
+/**
+ * Monotonic clock in microseconds
+ */
+uint64_t mds_time_now_us(void);
+
+/**
+ * Record the outcome of a stream-data backend read that ran from start_us to
+ * end_us. Caller holds session->lock and has checked timeseries is enabled.
+ */
+void mds_timeseries_record_read_locked(mds_session_t *session, int ret,
+                                       const uint8_t *data,
+                                       uint64_t start_us, uint64_t end_us);
+
+/**
+ * Record a stream record received outside the backend (from_bytes/batch
+ * paths). Takes session->lock; no-op when the recorder is disabled.
+ */
+void mds_timeseries_record_external(mds_session_t *session,
+                                    const uint8_t *data, size_t len);
+
+/**
+ * Release recorder memory
+ */
+void mds_timeseries_free(mds_session_t *session);
+
+/**
+ * Take another reference to an interned entry. NULL is ignored.
+ */
+void mds_config_retain(mds_config_table_t *table, const mds_config_entry_t *entry);
+
+/**
+ * True if the session holds an interned configuration
+ */
+bool mds_session_has_config(mds_session_t *session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MDS_PROTOCOL_INTERNAL_H */
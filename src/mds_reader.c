@@ -0,0 +1,314 @@
+/**
+ * @file mds_reader.c
+ * @brief Background stream reader with a pollable readiness fd
+ *
+ * The reader thread owns stream-data reads from the backend and queues raw
+ * records in a fixed-size ring. A self-pipe becomes readable whenever records
+ * (or a reader error) are pending, so hosts can integrate MDS sessions into
+ * poll()/epoll/kqueue or asyncio loops and drain everything with one call to
+ * mds_process_pending().
+ */
+
+#include "mds_bridge/mds_protocol.h"
+#include "mds_bridge/memfault_hid.h"
+#include "mds_protocol_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Default ring size when the caller passes 0 */
+#define MDS_READER_DEFAULT_DEPTH            256
+
+/* Back-off after a backend error, to avoid spinning on a dead device */
+#define MDS_READER_ERROR_BACKOFF_MS         10
+
+/* ============================================================================
+ * Internal Helper Functions
+ * ========================================================================== */
+
+static void reader_sleep_ms(unsigned int ms) {
+    struct timespec ts = {
+        .tv_sec = ms / 1000,
+        .tv_nsec = (long)(ms % 1000) * 1000000L,
+    };
+    nanosleep(&ts, NULL);
+}
+
+bool mds_read_is_timeout(int ret) {
+    return ret == 0 ||
+           ret == -ETIMEDOUT ||
+           ret == -EAGAIN ||
+           ret == MEMFAULT_HID_ERROR_TIMEOUT;
+}
+
+/* Make the poll fd readable. Caller holds reader->lock. */
+static void reader_signal_locked(mds_reader_t *reader) {
+    if (!reader->signaled) {
+        const uint8_t byte = 1;
+        if (write(reader->pipe_fds[1], &byte, 1) == 1) {
+            reader->signaled = true;
+        }
+    }
+}
+
+/* Drain the self-pipe once nothing is pending. Caller holds reader->lock. */
+static void reader_clear_locked(mds_reader_t *reader) {
+    if (reader->signaled && reader->count == 0 && reader->last_error == 0) {
+        uint8_t scratch[16];
+        while (read(reader->pipe_fds[0], scratch, sizeof(scratch)) > 0) {
+        }
+        reader->signaled = false;
+    }
+}
+
+static int reader_set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return -errno;
+    }
+    return 0;
+}
+
+static void reader_free(mds_reader_t *reader) {
+    for (int i = 0; i < 2; i++) {
+        if (reader->pipe_fds[i] >= 0) {
+            close(reader->pipe_fds[i]);
+            reader->pipe_fds[i] = -1;
+        }
+    }
+
+    free(reader->records);
+    free(reader->record_lens);
+    reader->records = NULL;
+    reader->record_lens = NULL;
+    reader->capacity = 0;
+    reader->head = 0;
+    reader->count = 0;
+    reader->signaled = false;
+}
+
+static void *reader_thread_main(void *arg) {
+    mds_session_t *session = (mds_session_t *)arg;
+    mds_reader_t *reader = &session->reader;
+    uint8_t data[MDS_MAX_CHUNK_DATA_LEN + 1];
+
+    while (!__atomic_load_n(&reader->stop, __ATOMIC_ACQUIRE)) {
+        uint64_t start_us = mds_time_now_us();
+
+        /* No lock held: control calls and draining go ahead meanwhile */
+        int ret = mds_backend_read(session->backend, MDS_REPORT_ID_STREAM_DATA,
+                                   data, sizeof(data), MDS_READER_POLL_TIMEOUT_MS);
+        pthread_mutex_lock(&session->lock);
+        if (session->timeseries.buckets != NULL) {
+            mds_timeseries_record_read_locked(session, ret, data,
+                                              start_us, mds_time_now_us());
+        }
+        pthread_mutex_unlock(&session->lock);
+
+        pthread_mutex_lock(&reader->lock);
+        if (ret > 0) {
+            if (reader->count < reader->capacity) {
+                size_t idx = (reader->head + reader->count) % reader->capacity;
+                memcpy(reader->records[idx], data, (size_t)ret);
+                reader->record_lens[idx] = (size_t)ret;
+                reader->count++;
+            } else {
+                reader->overflows++;
+            }
+            reader_signal_locked(reader);
+        } else if (!mds_read_is_timeout(ret)) {
+            reader->last_error = ret;
+            reader_signal_locked(reader);
+        }
+        pthread_mutex_unlock(&reader->lock);
+
+        if (ret > 0) {
+            continue;
+        }
+
+        if (!mds_read_is_timeout(ret)) {
+            reader_sleep_ms(MDS_READER_ERROR_BACKOFF_MS);
+        } else if (mds_time_now_us() - start_us < 1000) {
+            /* Backend returned immediately (non-blocking transport); don't
+             * spin */
+            reader_sleep_ms(1);
+        }
+    }
+
+    return NULL;
+}
+
+/* ============================================================================
+ * Background Reader
+ * ========================================================================== */
+
+int mds_session_start_reader(mds_session_t *session, size_t queue_depth) {
+    if (session == NULL || session->backend == NULL) {
+        return -EINVAL;
+    }
+
+    mds_reader_t *reader = &session->reader;
+    if (reader->running) {
+        return -EALREADY;
+    }
+
+    if (queue_depth == 0) {
+        queue_depth = MDS_READER_DEFAULT_DEPTH;
+    }
+
+    reader->records = calloc(queue_depth, sizeof(*reader->records));
+    reader->record_lens = calloc(queue_depth, sizeof(*reader->record_lens));
+    if (reader->records == NULL || reader->record_lens == NULL) {
+        reader_free(reader);
+        return -ENOMEM;
+    }
+
+    if (pipe(reader->pipe_fds) != 0) {
+        int err = -errno;
+        reader->pipe_fds[0] = -1;
+        reader->pipe_fds[1] = -1;
+        reader_free(reader);
+        return err;
+    }
+
+    int ret = reader_set_nonblocking(reader->pipe_fds[0]);
+    if (ret == 0) {
+        ret = reader_set_nonblocking(reader->pipe_fds[1]);
+    }
+    if (ret < 0) {
+        reader_free(reader);
+        return ret;
+    }
+
+    reader->capacity = queue_depth;
+    reader->head = 0;
+    reader->count = 0;
+    reader->overflows = 0;
+    reader->last_error = 0;
+    reader->stop = false;
+
+    if (pthread_create(&reader->thread, NULL, reader_thread_main, session) != 0) {
+        reader_free(reader);
+        return -EAGAIN;
+    }
+
+    reader->running = true;
+    return 0;
+}
+
+void mds_reader_stop(mds_session_t *session) {
+    mds_reader_t *reader = &session->reader;
+    if (!reader->running) {
+        return;
+    }
+
+    __atomic_store_n(&reader->stop, true, __ATOMIC_RELEASE);
+    pthread_join(reader->thread, NULL);
+    reader->running = false;
+
+    reader_free(reader);
+}
+
+int mds_session_stop_reader(mds_session_t *session) {
+    if (session == NULL) {
+        return -EINVAL;
+    }
+
+    mds_reader_stop(session);
+    return 0;
+}
+
+int mds_session_get_poll_fd(mds_session_t *session) {
+    if (session == NULL) {
+        return -EINVAL;
+    }
+
+    if (!session->reader.running) {
+        return -ENOTCONN;
+    }
+
+    return session->reader.pipe_fds[0];
+}
+
+int mds_session_get_reader_stats(mds_session_t *session,
+                                 mds_reader_stats_t *stats) {
+    if (session == NULL || stats == NULL) {
+        return -EINVAL;
+    }
+
+    mds_reader_t *reader = &session->reader;
+    pthread_mutex_lock(&reader->lock);
+    stats->queued = reader->count;
+    stats->capacity = reader->capacity;
+    stats->overflows = reader->overflows;
+    stats->last_error = reader->last_error;
+    pthread_mutex_unlock(&reader->lock);
+
+    return 0;
+}
+
+int mds_process_pending(mds_session_t *session,
+                        const mds_device_config_t *config,
+                        mds_stream_packet_t *packets,
+                        int *upload_results,
+                        size_t max_packets,
+                        size_t *count) {
+    if (count) {
+        *count = 0;
+    }
+
+    if (session == NULL || (config == NULL && !mds_session_has_config(session)) || count == NULL) {
+        return -EINVAL;
+    }
+
+    mds_reader_t *reader = &session->reader;
+    if (!reader->running) {
+        return -ENOTCONN;
+    }
+
+    size_t limit = (packets != NULL || upload_results != NULL) ? max_packets : SIZE_MAX;
+    size_t processed = 0;
+    uint8_t record[MDS_MAX_CHUNK_DATA_LEN + 1];
+
+    while (processed < limit) {
+        pthread_mutex_lock(&reader->lock);
+        if (reader->count == 0) {
+            pthread_mutex_unlock(&reader->lock);
+            break;
+        }
+        size_t record_len = reader->record_lens[reader->head];
+        memcpy(record, reader->records[reader->head], record_len);
+        reader->head = (reader->head + 1) % reader->capacity;
+        reader->count--;
+        pthread_mutex_unlock(&reader->lock);
+
+        mds_stream_packet_t pkt;
+        if (mds_parse_stream_packet(record, record_len, &pkt) < 0) {
+            continue;
+        }
+
+        /* Upload failures are reported per packet; draining carries on so
+         * one bad upload does not strand the rest of the queue */
+        int ret = mds_process_packet_common(session, config, &pkt,
+                                            packets ? &packets[processed] : NULL);
+        if (upload_results) {
+            upload_results[processed] = ret;
+        }
+        processed++;
+    }
+
+    int err = 0;
+    pthread_mutex_lock(&reader->lock);
+    if (processed == 0 && reader->count == 0 && reader->last_error != 0) {
+        err = reader->last_error;
+        reader->last_error = 0;
+    }
+    reader_clear_locked(reader);
+    pthread_mutex_unlock(&reader->lock);
+
+    *count = processed;
+    return err;
+}
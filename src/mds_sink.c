@@ -0,0 +1,501 @@
+/**
+ * @file mds_sink.c
+ * @brief Sink core: bounded queue, batching and overflow handling
+ *
+ * Queued chunks are single allocations (strings after the payload, as in
+ * the fan-out stage) held in a ring. Delivery runs on the submitting or
+ * polling thread under the sink lock, so outputs need no locking of their
+ * own and always see chunks in submission order.
+ *
+ * With a p99 age target, every MDS_SINK_TUNE_WINDOW delivered chunks the
+ * batch size and linger are adjusted: grown while the age has plenty of
+ * headroom and the output is busy most of the time (per-request cost
+ * dominates), halved when the age gets close to the target.
+ */
+
+#include "mds_bridge/mds_sink.h"
+#include "mds_protocol_internal.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+/* Tuning thresholds, as fractions of the p99 age target */
+#define TUNE_GROW_BELOW             0.5
+#define TUNE_SHRINK_ABOVE           0.8
+
+/* Grow only while the output is busy for at least this share of the window */
+#define TUNE_BUSY_PCT               50
+
+typedef struct {
+    uint64_t queued_us;
+    uint64_t sequence;
+    uint64_t received_us;
+    const char *uri;
+    const char *auth_header;
+    size_t len;
+    uint8_t data[];
+} sink_item_t;
+
+struct mds_sink {
+    const mds_sink_ops_t *ops;
+    void *impl;
+    mds_sink_config_t config;
+
+    pthread_mutex_t lock;
+    sink_item_t **queue;            /* Ring of queue_depth entries */
+    size_t head;
+    size_t count;
+
+    mds_sink_stats_t stats;
+
+    /* Batch tuning (used when config.target_p99_age_ms is set) */
+    uint32_t tune_ages_us[MDS_SINK_TUNE_WINDOW];
+    size_t tune_samples;
+    uint64_t tune_window_us;        /* Start of the current window */
+    uint64_t tune_busy_us;          /* Time spent in the output during it */
+    mds_sink_tune_decision_t tune_history[MDS_SINK_TUNE_HISTORY];
+    size_t tune_history_count;      /* Total decisions; the ring holds the last few */
+};
+
+/* ============================================================================
+ * Internal Helper Functions
+ * ========================================================================== */
+
+static uint64_t wall_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static sink_item_t *item_create(const char *uri, const char *auth_header,
+                                const uint8_t *data, size_t len) {
+    size_t uri_len = strlen(uri) + 1;
+    size_t auth_len = strlen(auth_header) + 1;
+
+    sink_item_t *item = malloc(sizeof(*item) + len + uri_len + auth_len);
+    if (item == NULL) {
+        return NULL;
+    }
+
+    char *strings = (char *)item->data + len;
+    memcpy(item->data, data, len);
+    memcpy(strings, uri, uri_len);
+    memcpy(strings + uri_len, auth_header, auth_len);
+
+    item->queued_us = mds_time_now_us();
+    item->received_us = wall_time_us();
+    item->uri = strings;
+    item->auth_header = strings + uri_len;
+    item->len = len;
+    return item;
+}
+
+static void sink_pop_locked(mds_sink_t *sink) {
+    free(sink->queue[sink->head]);
+    sink->head = (sink->head + 1) % sink->config.queue_depth;
+    sink->count--;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Decide on the batch size and linger for the next window */
+static void sink_tune_locked(mds_sink_t *sink, uint64_t now_us) {
+    mds_sink_config_t *config = &sink->config;
+    uint64_t target_us = (uint64_t)config->target_p99_age_ms * 1000u;
+    uint32_t max_delay_ms = config->target_p99_age_ms / 2;
+
+    qsort(sink->tune_ages_us, sink->tune_samples, sizeof(sink->tune_ages_us[0]), compare_u32);
+    uint32_t p99 = sink->tune_ages_us[(sink->tune_samples * 99 - 1) / 100];
+
+    uint64_t elapsed = now_us - sink->tune_window_us;
+    uint64_t busy_pct = elapsed ? sink->tune_busy_us * 100u / elapsed : 100u;
+
+    mds_sink_tune_action_t action = MDS_SINK_TUNE_HOLD;
+    if (p99 > target_us * TUNE_SHRINK_ABOVE) {
+        action = MDS_SINK_TUNE_SHRINK;
+        config->max_batch = config->max_batch > 1 ? config->max_batch / 2 : 1;
+        config->max_delay_ms = config->max_delay_ms > 1 ? config->max_delay_ms / 2 : 1;
+    } else if (!sink->ops->per_chunk && p99 < target_us * TUNE_GROW_BELOW &&
+               busy_pct >= TUNE_BUSY_PCT &&
+               (config->max_batch < MDS_SINK_MAX_BATCH || config->max_delay_ms < max_delay_ms)) {
+        action = MDS_SINK_TUNE_GROW;
+        config->max_batch += config->max_batch / 4 > 0 ? config->max_batch / 4 : 1;
+        if (config->max_batch > MDS_SINK_MAX_BATCH) {
+            config->max_batch = MDS_SINK_MAX_BATCH;
+        }
+        /* Only ever lengthen the linger, up to half the target */
+        if (config->max_delay_ms < max_delay_ms) {
+            config->max_delay_ms += config->max_delay_ms / 4 > 0 ? config->max_delay_ms / 4 : 1;
+            if (config->max_delay_ms > max_delay_ms) {
+                config->max_delay_ms = max_delay_ms;
+            }
+        }
+    }
+
+    mds_sink_tune_decision_t *d = &sink->tune_history[sink->tune_history_count % MDS_SINK_TUNE_HISTORY];
+    d->time_us = now_us;
+    d->p99_age_us = p99;
+    d->utilization_pct = (uint32_t)(busy_pct < 100 ? busy_pct : 100);
+    d->action = action;
+    d->max_batch = config->max_batch;
+    d->max_delay_ms = config->max_delay_ms;
+    sink->tune_history_count++;
+
+    sink->tune_samples = 0;
+    sink->tune_busy_us = 0;
+    sink->tune_window_us = now_us;
+}
+
+static void sink_tune_sample_locked(mds_sink_t *sink, uint64_t age_us, uint64_t now_us) {
+    sink->tune_ages_us[sink->tune_samples++] = age_us > UINT32_MAX ? UINT32_MAX : (uint32_t)age_us;
+    if (sink->tune_samples == MDS_SINK_TUNE_WINDOW) {
+        sink_tune_locked(sink, now_us);
+    }
+}
+
+/* A full batch is due at once; a partial one after max_delay_ms */
+static bool sink_batch_due_locked(const mds_sink_t *sink) {
+    if (sink->count >= sink->config.max_batch) {
+        return true;
+    }
+    if (sink->count == 0 || sink->config.max_delay_ms == 0) {
+        return false;
+    }
+
+    uint64_t waited_us = mds_time_now_us() - sink->queue[sink->head]->queued_us;
+    return waited_us >= (uint64_t)sink->config.max_delay_ms * 1000u;
+}
+
+/*
+ * Hand batches to the output while they are due (or while anything is
+ * queued, with all). Stops when the output takes nothing, or only part of
+ * a batch outside a flush, so a stalled output is not spun on.
+ */
+static int sink_deliver_locked(mds_sink_t *sink, bool all) {
+    while (sink->count > 0 && (all || sink_batch_due_locked(sink))) {
+        mds_sink_chunk_t batch[MDS_SINK_MAX_BATCH];
+        int results[MDS_SINK_MAX_BATCH];
+        size_t n = sink->count < sink->config.max_batch ? sink->count : sink->config.max_batch;
+
+        for (size_t i = 0; i < n; i++) {
+            const sink_item_t *item = sink->queue[(sink->head + i) % sink->config.queue_depth];
+            batch[i].uri = item->uri;
+            batch[i].auth_header = item->auth_header;
+            batch[i].data = item->data;
+            batch[i].len = item->len;
+            batch[i].sequence = item->sequence;
+            batch[i].received_us = item->received_us;
+            results[i] = 0;
+        }
+
+        uint64_t start_us = mds_time_now_us();
+        int ret = sink->ops->submit_batch(sink->impl, batch, n, results);
+        uint64_t now_us = mds_time_now_us();
+        sink->tune_busy_us += now_us - start_us;
+        sink->stats.batches++;
+        if (ret < 0) {
+            sink->stats.last_error = ret;
+            return ret;
+        }
+
+        size_t consumed = (size_t)ret < n ? (size_t)ret : n;
+        for (size_t i = 0; i < consumed; i++) {
+            if (results[i] == 0) {
+                sink->stats.delivered++;
+                sink->stats.bytes_delivered += batch[i].len;
+            } else {
+                sink->stats.failed++;
+                sink->stats.last_error = results[i];
+            }
+            if (sink->config.target_p99_age_ms) {
+                sink_tune_sample_locked(sink, now_us - sink->queue[sink->head]->queued_us, now_us);
+            }
+            sink_pop_locked(sink);
+        }
+
+        if (consumed == 0 || (consumed < n && !all)) {
+            break;
+        }
+    }
+    return 0;
+}
+
+/* Make room for one chunk according to the overflow policy */
+static int sink_make_room_locked(mds_sink_t *sink) {
+    if (sink->count < sink->config.queue_depth) {
+        return 0;
+    }
+
+    switch (sink->config.overflow) {
+        case MDS_SINK_OVERFLOW_DROP_OLDEST:
+            sink_pop_locked(sink);
+            sink->stats.dropped++;
+            return 0;
+        case MDS_SINK_OVERFLOW_DELIVER:
+            sink_deliver_locked(sink, true);
+            if (sink->count < sink->config.queue_depth) {
+                return 0;
+            }
+            break;
+        case MDS_SINK_OVERFLOW_REJECT:
+        default:
+            break;
+    }
+
+    sink->stats.dropped++;
+    return -ENOBUFS;
+}
+
+static int sink_enqueue_locked(mds_sink_t *sink, const char *uri, const char *auth_header,
+                               const uint8_t *data, size_t len) {
+    int ret = sink_make_room_locked(sink);
+    if (ret < 0) {
+        return ret;
+    }
+
+    sink_item_t *item = item_create(uri, auth_header, data, len);
+    if (item == NULL) {
+        return -ENOMEM;
+    }
+
+    item->sequence = sink->stats.submitted;
+    sink->queue[(sink->head + sink->count) % sink->config.queue_depth] = item;
+    sink->count++;
+    sink->stats.submitted++;
+    if (sink->count > sink->stats.max_queued) {
+        sink->stats.max_queued = sink->count;
+    }
+    return 0;
+}
+
+/* ============================================================================
+ * Sink Management
+ * ========================================================================== */
+
+mds_sink_t *mds_sink_create(const mds_sink_ops_t *ops, void *impl,
+                            const mds_sink_config_t *config) {
+    if (ops == NULL || ops->submit_batch == NULL) {
+        return NULL;
+    }
+
+    mds_sink_t *sink = calloc(1, sizeof(*sink));
+    if (sink == NULL) {
+        return NULL;
+    }
+
+    if (config) {
+        sink->config = *config;
+    }
+    if (sink->config.queue_depth == 0) {
+        sink->config.queue_depth = MDS_SINK_DEFAULT_DEPTH;
+    }
+    if (sink->config.max_batch == 0) {
+        sink->config.max_batch = MDS_SINK_DEFAULT_BATCH;
+    }
+    if (sink->config.max_batch > MDS_SINK_MAX_BATCH) {
+        sink->config.max_batch = MDS_SINK_MAX_BATCH;
+    }
+    if (sink->config.target_p99_age_ms) {
+        /* A tuned sink must not hold a partial batch until the next poll,
+         * nor start lingering longer than tuning would ever allow */
+        uint32_t cap_ms = sink->config.target_p99_age_ms / 2;
+        if (sink->config.max_delay_ms > cap_ms) {
+            sink->config.max_delay_ms = cap_ms;
+        }
+        if (sink->config.max_delay_ms == 0) {
+            sink->config.max_delay_ms = 1;
+        }
+    }
+    sink->tune_window_us = mds_time_now_us();
+
+    sink->queue = calloc(sink->config.queue_depth, sizeof(*sink->queue));
+    if (sink->queue == NULL || pthread_mutex_init(&sink->lock, NULL) != 0) {
+        free(sink->queue);
+        free(sink);
+        return NULL;
+    }
+
+    sink->ops = ops;
+    sink->impl = impl;
+    return sink;
+}
+
+void mds_sink_destroy(mds_sink_t *sink) {
+    if (sink == NULL) {
+        return;
+    }
+
+    mds_sink_flush(sink);
+
+    while (sink->count > 0) {
+        sink_pop_locked(sink);
+    }
+    if (sink->ops->destroy) {
+        sink->ops->destroy(sink->impl);
+    }
+
+    pthread_mutex_destroy(&sink->lock);
+    free(sink->queue);
+    free(sink);
+}
+
+/* ============================================================================
+ * Delivery
+ * ========================================================================== */
+
+int mds_sink_submit(mds_sink_t *sink, const char *uri, const char *auth_header,
+                    const uint8_t *data, size_t len) {
+    if (sink == NULL || uri == NULL || auth_header == NULL || (data == NULL && len > 0)) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&sink->lock);
+    int ret = sink_enqueue_locked(sink, uri, auth_header, data, len);
+    if (ret == 0) {
+        /* Output errors leave the chunk queued; they show up in the stats */
+        sink_deliver_locked(sink, false);
+    }
+    pthread_mutex_unlock(&sink->lock);
+
+    return ret;
+}
+
+int mds_sink_submit_batch(mds_sink_t *sink, const mds_sink_chunk_t *chunks,
+                          size_t count, size_t *accepted) {
+    if (accepted) {
+        *accepted = 0;
+    }
+
+    if (sink == NULL || (chunks == NULL && count > 0)) {
+        return -EINVAL;
+    }
+
+    int ret = 0;
+    size_t i = 0;
+
+    pthread_mutex_lock(&sink->lock);
+    for (; i < count; i++) {
+        const mds_sink_chunk_t *c = &chunks[i];
+        if (c->uri == NULL || c->auth_header == NULL || (c->data == NULL && c->len > 0)) {
+            ret = -EINVAL;
+            break;
+        }
+
+        ret = sink_enqueue_locked(sink, c->uri, c->auth_header, c->data, c->len);
+        if (ret < 0) {
+            break;
+        }
+    }
+    sink_deliver_locked(sink, false);
+    pthread_mutex_unlock(&sink->lock);
+
+    if (accepted) {
+        *accepted = i;
+    }
+    return ret;
+}
+
+int mds_sink_flush(mds_sink_t *sink) {
+    if (sink == NULL) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&sink->lock);
+    int ret = sink_deliver_locked(sink, true);
+    if (ret == 0 && sink->count > 0) {
+        ret = sink->stats.last_error ? sink->stats.last_error : -EAGAIN;
+    }
+    if (ret == 0 && sink->ops->flush) {
+        ret = sink->ops->flush(sink->impl);
+        if (ret < 0) {
+            sink->stats.last_error = ret;
+        }
+    }
+    pthread_mutex_unlock(&sink->lock);
+
+    return ret;
+}
+
+int mds_sink_poll(mds_sink_t *sink, int timeout_ms) {
+    if (sink == NULL) {
+        return -EINVAL;
+    }
+
+    /* A partial batch waits out max_delay_ms; without one it goes now */
+    pthread_mutex_lock(&sink->lock);
+    int ret = sink_deliver_locked(sink, sink->config.max_delay_ms == 0);
+    if (ret == 0 && sink->ops->poll) {
+        ret = sink->ops->poll(sink->impl, timeout_ms);
+    }
+    pthread_mutex_unlock(&sink->lock);
+
+    return ret;
+}
+
+int mds_sink_get_stats(mds_sink_t *sink, mds_sink_stats_t *stats) {
+    if (sink == NULL || stats == NULL) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&sink->lock);
+    *stats = sink->stats;
+    stats->queued = sink->count;
+    stats->max_batch = sink->config.max_batch;
+    stats->max_delay_ms = sink->config.max_delay_ms;
+    pthread_mutex_unlock(&sink->lock);
+
+    return 0;
+}
+
+int mds_sink_get_tune_history(mds_sink_t *sink, mds_sink_tune_decision_t *decisions,
+                              size_t max, size_t *count) {
+    if (sink == NULL || count == NULL || (decisions == NULL && max > 0)) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&sink->lock);
+    size_t kept = sink->tune_history_count < MDS_SINK_TUNE_HISTORY ?
+                  sink->tune_history_count : MDS_SINK_TUNE_HISTORY;
+    size_t n = kept < max ? kept : max;
+    size_t first = sink->tune_history_count - n;
+    for (size_t i = 0; i < n; i++) {
+        decisions[i] = sink->tune_history[(first + i) % MDS_SINK_TUNE_HISTORY];
+    }
+    pthread_mutex_unlock(&sink->lock);
+
+    *count = n;
+    return 0;
+}
+
+int mds_sink_callback(const char *uri, const char *auth_header,
+                      const uint8_t *chunk_data, size_t chunk_len, void *user_data) {
+    return mds_sink_submit((mds_sink_t *)user_data, uri, auth_header, chunk_data, chunk_len);
+}
+
+/* ============================================================================
+ * Null Output
+ * ========================================================================== */
+
+static int null_submit_batch(void *impl, const mds_sink_chunk_t *chunks, size_t count,
+                             int *results) {
+    (void)impl;
+    (void)chunks;
+    (void)results;
+    return (int)count;
+}
+
+static const mds_sink_ops_t null_ops = {
+    .name = "null",
+    .submit_batch = null_submit_batch,
+};
+
+mds_sink_t *mds_sink_create_null(const mds_sink_config_t *config) {
+    return mds_sink_create(&null_ops, NULL, config);
+}
@@ -0,0 +1,85 @@
+/**
+ * @file mds_sink_internal.h
+ * @brief Helpers shared by the built-in sink outputs
+ *
+ * This header is for internal use only and should not be installed as a public API.
+ */
+
+#ifndef MDS_SINK_INTERNAL_H
+#define MDS_SINK_INTERNAL_H
+
+#include "mds_bridge/mds_sink.h"
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Fill in a UNIX socket address
+ *
+ * @return 0 on success, -ENAMETOOLONG if path does not fit
+ */
+int mds_sink_unix_addr(const char *path, struct sockaddr_un *addr);
+
+/**
+ * Open a stream socket connected to addr (SIGPIPE suppressed where supported)
+ *
+ * @return File descriptor, or negative error code
+ */
+int mds_sink_unix_connect(const struct sockaddr_un *addr);
+
+/**
+ * Write iov in full, resuming after short writes (iov is modified)
+ *
+ * @param is_socket Use sendmsg() without SIGPIPE instead of writev()
+ * @param err Receives the error that stopped the write (0 if none)
+ *
+ * @return Bytes written
+ */
+size_t mds_sink_write_all(int fd, bool is_socket, struct iovec *iov, int iovcnt, int *err);
+
+/**
+ * Count the records of record_len[] that fit completely in the first written bytes
+ *
+ * @param bytes Receives the size of those records
+ */
+size_t mds_sink_records_complete(const size_t *record_len, size_t count, size_t written,
+                                 size_t *bytes);
+
+/**
+ * Length of the base64 encoding (with padding) of len bytes
+ */
+static inline size_t mds_base64_encoded_len(size_t len) {
+    return (len + 2) / 3 * 4;
+}
+
+/**
+ * Base64-encode (standard alphabet, padded) with the fastest encoder the CPU supports
+ *
+ * @param dst Buffer of at least mds_base64_encoded_len(len) bytes; not NUL-terminated
+ *
+ * @return Characters written
+ */
+size_t mds_base64_encode(const uint8_t *src, size_t len, char *dst);
+
+/**
+ * Portable encoder; same output as mds_base64_encode()
+ */
+size_t mds_base64_encode_scalar(const uint8_t *src, size_t len, char *dst);
+
+/**
+ * Name of the encoder mds_base64_encode() uses ("avx2", "ssse3", "neon" or "scalar")
+ */
+const char *mds_base64_impl(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MDS_SINK_INTERNAL_H */
@@ -0,0 +1,264 @@
+/**
+ * @file mds_sink_ndjson.c
+ * @brief NDJSON export output for log pipelines
+ *
+ * A batch is encoded into a set of segment buffers that are kept between
+ * batches, so steady-state export does not allocate. A record never spans
+ * two segments; the segments are written with a single writev()/sendmsg().
+ * Payloads are base64-encoded with the vectorised encoder in mds_base64.c.
+ */
+
+#include "mds_sink_internal.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/** Size of one reusable encode buffer */
+#define NDJSON_SEGMENT_SIZE     (64 * 1024)
+
+/** Bytes of a record besides the device and payload (keys, numbers, newline) */
+#define NDJSON_RECORD_OVERHEAD  96
+
+typedef struct {
+    char *buf;
+    size_t capacity;
+    size_t used;
+} ndjson_segment_t;
+
+typedef struct {
+    int fd;
+    bool is_socket;
+    struct sockaddr_un addr;
+    ndjson_segment_t segments[MDS_SINK_MAX_BATCH];
+} ndjson_output_t;
+
+/* ============================================================================
+ * Record Encoding
+ * ========================================================================== */
+
+static char *put_str(char *dst, const char *s) {
+    size_t len = strlen(s);
+    memcpy(dst, s, len);
+    return dst + len;
+}
+
+static char *put_u64(char *dst, uint64_t v) {
+    char digits[20];
+    size_t n = 0;
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    while (n > 0) {
+        *dst++ = digits[--n];
+    }
+    return dst;
+}
+
+/* JSON string contents; control characters become \u00XX */
+static char *put_escaped(char *dst, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            *dst++ = '\\';
+            *dst++ = (char)c;
+        } else if (c < 0x20) {
+            dst = put_str(dst, "\\u00");
+            *dst++ = hex[c >> 4];
+            *dst++ = hex[c & 0xF];
+        } else {
+            *dst++ = (char)c;
+        }
+    }
+    return dst;
+}
+
+static const char *chunk_device(const mds_sink_chunk_t *chunk) {
+    const char *slash = strrchr(chunk->uri, '/');
+    return slash ? slash + 1 : chunk->uri;
+}
+
+static size_t record_bound(const mds_sink_chunk_t *chunk) {
+    return NDJSON_RECORD_OVERHEAD + 6 * strlen(chunk_device(chunk)) +
+           mds_base64_encoded_len(chunk->len);
+}
+
+static size_t record_encode(char *dst, const mds_sink_chunk_t *chunk) {
+    char *p = dst;
+    p = put_str(p, "{\"device\":\"");
+    p = put_escaped(p, chunk_device(chunk));
+    p = put_str(p, "\",\"seq\":");
+    p = put_u64(p, chunk->sequence);
+    p = put_str(p, ",\"received_us\":");
+    p = put_u64(p, chunk->received_us);
+    p = put_str(p, ",\"data\":\"");
+    p += mds_base64_encode(chunk->data, chunk->len, p);
+    p = put_str(p, "\"}\n");
+    return (size_t)(p - dst);
+}
+
+/* ============================================================================
+ * Output Operations
+ * ========================================================================== */
+
+static int segment_reserve(ndjson_segment_t *seg, size_t need) {
+    if (need <= seg->capacity) {
+        return 0;
+    }
+
+    size_t capacity = need > NDJSON_SEGMENT_SIZE ? need : NDJSON_SEGMENT_SIZE;
+    char *buf = realloc(seg->buf, capacity);
+    if (buf == NULL) {
+        return -ENOMEM;
+    }
+    seg->buf = buf;
+    seg->capacity = capacity;
+    return 0;
+}
+
+static int ndjson_submit_batch(void *impl, const mds_sink_chunk_t *chunks, size_t count,
+                               int *results) {
+    ndjson_output_t *out = impl;
+    size_t record_len[MDS_SINK_MAX_BATCH];
+    size_t seg_index = 0;
+    (void)results;
+
+    if (out->fd < 0) {
+        out->fd = mds_sink_unix_connect(&out->addr);
+        if (out->fd < 0) {
+            int err = out->fd;
+            out->fd = -1;
+            return err;
+        }
+    }
+
+    out->segments[0].used = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t need = record_bound(&chunks[i]);
+        ndjson_segment_t *seg = &out->segments[seg_index];
+
+        if (seg->used + need > seg->capacity) {
+            if (seg->used > 0) {
+                seg = &out->segments[++seg_index];
+                seg->used = 0;
+            }
+            if (segment_reserve(seg, need) < 0) {
+                if (i == 0) {
+                    return -ENOMEM;
+                }
+                /* Send what was encoded; the rest is offered again */
+                count = i;
+                if (seg->used == 0) {
+                    seg_index--;
+                }
+                break;
+            }
+        }
+
+        record_len[i] = record_encode(seg->buf + seg->used, &chunks[i]);
+        seg->used += record_len[i];
+    }
+
+    struct iovec iov[MDS_SINK_MAX_BATCH];
+    for (size_t s = 0; s <= seg_index; s++) {
+        iov[s].iov_base = out->segments[s].buf;
+        iov[s].iov_len = out->segments[s].used;
+    }
+
+    off_t start = out->is_socket ? -1 : lseek(out->fd, 0, SEEK_END);
+    int err;
+    size_t written = mds_sink_write_all(out->fd, out->is_socket, iov, (int)seg_index + 1, &err);
+    if (err == 0) {
+        return (int)count;
+    }
+
+    size_t bytes;
+    size_t done = mds_sink_records_complete(record_len, count, written, &bytes);
+    if (out->is_socket) {
+        /* Reconnect rather than continue after a torn line */
+        close(out->fd);
+        out->fd = -1;
+    } else if (start >= 0 && bytes < written && ftruncate(out->fd, start + (off_t)bytes) < 0) {
+        return -errno;
+    }
+    return done > 0 ? (int)done : err;
+}
+
+static int ndjson_flush(void *impl) {
+    ndjson_output_t *out = impl;
+    if (out->is_socket || out->fd < 0) {
+        return 0;
+    }
+    return fsync(out->fd) == 0 ? 0 : -errno;
+}
+
+static void ndjson_destroy(void *impl) {
+    ndjson_output_t *out = impl;
+    if (out->fd >= 0) {
+        close(out->fd);
+    }
+    for (size_t i = 0; i < MDS_SINK_MAX_BATCH; i++) {
+        free(out->segments[i].buf);
+    }
+    free(out);
+}
+
+static const mds_sink_ops_t ndjson_ops = {
+    .name = "ndjson",
+    .submit_batch = ndjson_submit_batch,
+    .flush = ndjson_flush,
+    .destroy = ndjson_destroy,
+};
+
+/* ============================================================================
+ * Public API
+ * ========================================================================== */
+
+mds_sink_t *mds_sink_create_ndjson(const char *path, const mds_sink_config_t *config) {
+    if (path == NULL) {
+        return NULL;
+    }
+
+    ndjson_output_t *out = calloc(1, sizeof(*out));
+    if (out == NULL) {
+        return NULL;
+    }
+
+    /* The mode comes from the prefix, never from what is at path: a socket
+     * path must not turn into a file because the server is not up yet */
+    out->is_socket = strncmp(path, MDS_SINK_UNIX_PREFIX, strlen(MDS_SINK_UNIX_PREFIX)) == 0;
+    int ret = 0;
+    if (out->is_socket) {
+        out->fd = -1;
+        ret = mds_sink_unix_addr(path + strlen(MDS_SINK_UNIX_PREFIX), &out->addr);
+        if (ret == 0) {
+            /* Connected later, on the first batch, if nothing listens yet */
+            out->fd = mds_sink_unix_connect(&out->addr);
+        }
+    } else {
+        struct stat st;
+        if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+            ret = -EINVAL;  /* A socket needs the unix: prefix */
+        } else {
+            out->fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+            ret = out->fd < 0 ? -errno : 0;
+        }
+    }
+
+    if (ret < 0 || segment_reserve(&out->segments[0], NDJSON_SEGMENT_SIZE) < 0) {
+        ndjson_destroy(out);
+        return NULL;
+    }
+
+    mds_sink_t *sink = mds_sink_create(&ndjson_ops, out, config);
+    if (sink == NULL) {
+        ndjson_destroy(out);
+    }
+    return sink;
+}
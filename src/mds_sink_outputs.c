@@ -0,0 +1,377 @@
+/**
+ * @file mds_sink_outputs.c
+ * @brief Built-in sink outputs: HTTP, file and UNIX socket, and their shared helpers
+ *
+ * File and socket outputs write a whole batch with one writev()/sendmsg()
+ * call. A record is only counted as consumed once all of its bytes are out;
+ * a file is truncated back to the last complete record after a failed
+ * write, and a socket is closed so the reader never sees a torn record
+ * followed by more data.
+ */
+
+#include "mds_sink_internal.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/* Records written by one call: header, URI and data per chunk */
+#define SINK_IOV_PER_RECORD     3
+
+/* Disable SIGPIPE for writes to a closed socket */
+#ifdef MSG_NOSIGNAL
+#define SINK_SEND_FLAGS         MSG_NOSIGNAL
+#else
+#define SINK_SEND_FLAGS         0
+#endif
+
+/* ============================================================================
+ * Shared Helpers
+ * ========================================================================== */
+
+int mds_sink_unix_addr(const char *path, struct sockaddr_un *addr) {
+    size_t path_len = strlen(path);
+    if (path_len >= sizeof(addr->sun_path)) {
+        return -ENAMETOOLONG;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path, path_len + 1);
+    return 0;
+}
+
+int mds_sink_unix_connect(const struct sockaddr_un *addr) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -errno;
+    }
+
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+    if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+        int err = -errno;
+        close(fd);
+        return err;
+    }
+    return fd;
+}
+
+size_t mds_sink_write_all(int fd, bool is_socket, struct iovec *iov, int iovcnt, int *err) {
+    size_t written = 0;
+
+    *err = 0;
+    while (iovcnt > 0) {
+        ssize_t n;
+        if (is_socket) {
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovcnt;
+            n = sendmsg(fd, &msg, SINK_SEND_FLAGS);
+        } else {
+            n = writev(fd, iov, iovcnt);
+        }
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            *err = -errno;
+            break;
+        }
+
+        written += (size_t)n;
+        while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return written;
+}
+
+size_t mds_sink_records_complete(const size_t *record_len, size_t count, size_t written,
+                                 size_t *bytes) {
+    size_t done = 0;
+    *bytes = 0;
+    while (done < count && *bytes + record_len[done] <= written) {
+        *bytes += record_len[done];
+        done++;
+    }
+    return done;
+}
+
+/* ============================================================================
+ * Record Encoding
+ * ========================================================================== */
+
+typedef struct {
+    uint8_t headers[MDS_SINK_MAX_BATCH][MDS_SINK_RECORD_HEADER_LEN];
+    struct iovec iov[MDS_SINK_MAX_BATCH * SINK_IOV_PER_RECORD];
+    size_t record_len[MDS_SINK_MAX_BATCH];
+    size_t count;
+} sink_records_t;
+
+static int records_encode(sink_records_t *r, const mds_sink_chunk_t *chunks, size_t count) {
+    r->count = count;
+    for (size_t i = 0; i < count; i++) {
+        size_t uri_len = strlen(chunks[i].uri);
+        if (uri_len > UINT16_MAX || chunks[i].len > UINT32_MAX) {
+            return -EMSGSIZE;
+        }
+
+        uint8_t *h = r->headers[i];
+        uint32_t len = (uint32_t)chunks[i].len;
+        h[0] = (uint8_t)len;
+        h[1] = (uint8_t)(len >> 8);
+        h[2] = (uint8_t)(len >> 16);
+        h[3] = (uint8_t)(len >> 24);
+        h[4] = (uint8_t)uri_len;
+        h[5] = (uint8_t)(uri_len >> 8);
+
+        struct iovec *iov = &r->iov[i * SINK_IOV_PER_RECORD];
+        iov[0].iov_base = h;
+        iov[0].iov_len = MDS_SINK_RECORD_HEADER_LEN;
+        iov[1].iov_base = (void *)chunks[i].uri;
+        iov[1].iov_len = uri_len;
+        iov[2].iov_base = (void *)chunks[i].data;
+        iov[2].iov_len = chunks[i].len;
+        r->record_len[i] = MDS_SINK_RECORD_HEADER_LEN + uri_len + chunks[i].len;
+    }
+    return 0;
+}
+
+static size_t records_write(int fd, bool is_socket, sink_records_t *r, int *err) {
+    return mds_sink_write_all(fd, is_socket, r->iov, (int)(r->count * SINK_IOV_PER_RECORD), err);
+}
+
+static size_t records_complete(const sink_records_t *r, size_t written, size_t *bytes) {
+    return mds_sink_records_complete(r->record_len, r->count, written, bytes);
+}
+
+/* ============================================================================
+ * File Output
+ * ========================================================================== */
+
+typedef struct {
+    int fd;
+} file_output_t;
+
+static int file_submit_batch(void *impl, const mds_sink_chunk_t *chunks, size_t count,
+                             int *results) {
+    file_output_t *out = impl;
+    sink_records_t records;
+    (void)results;
+
+    int ret = records_encode(&records, chunks, count);
+    if (ret < 0) {
+        return ret;
+    }
+
+    off_t start = lseek(out->fd, 0, SEEK_END);
+    int err;
+    size_t written = records_write(out->fd, false, &records, &err);
+    if (err == 0) {
+        return (int)count;
+    }
+
+    /* Cut a torn record off so the file stays readable */
+    size_t bytes;
+    size_t done = records_complete(&records, written, &bytes);
+    if (start >= 0 && bytes < written && ftruncate(out->fd, start + (off_t)bytes) < 0) {
+        return -errno;
+    }
+    return done > 0 ? (int)done : err;
+}
+
+static int file_flush(void *impl) {
+    file_output_t *out = impl;
+    return fsync(out->fd) == 0 ? 0 : -errno;
+}
+
+static void file_destroy(void *impl) {
+    file_output_t *out = impl;
+    close(out->fd);
+    free(out);
+}
+
+static const mds_sink_ops_t file_ops = {
+    .name = "file",
+    .submit_batch = file_submit_batch,
+    .flush = file_flush,
+    .destroy = file_destroy,
+};
+
+mds_sink_t *mds_sink_create_file(const char *path, const mds_sink_config_t *config) {
+    if (path == NULL) {
+        return NULL;
+    }
+
+    file_output_t *out = calloc(1, sizeof(*out));
+    if (out == NULL) {
+        return NULL;
+    }
+
+    out->fd = open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (out->fd < 0) {
+        free(out);
+        return NULL;
+    }
+
+    mds_sink_t *sink = mds_sink_create(&file_ops, out, config);
+    if (sink == NULL) {
+        file_destroy(out);
+    }
+    return sink;
+}
+
+/* ============================================================================
+ * UNIX Socket Output
+ * ========================================================================== */
+
+typedef struct {
+    int fd;
+    struct sockaddr_un addr;
+} unix_output_t;
+
+static int unix_connect(unix_output_t *out) {
+    int fd = mds_sink_unix_connect(&out->addr);
+    if (fd < 0) {
+        return fd;
+    }
+    out->fd = fd;
+    return 0;
+}
+
+static int unix_submit_batch(void *impl, const mds_sink_chunk_t *chunks, size_t count,
+                             int *results) {
+    unix_output_t *out = impl;
+    sink_records_t records;
+    (void)results;
+
+    if (out->fd < 0) {
+        int ret = unix_connect(out);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+
+    int ret = records_encode(&records, chunks, count);
+    if (ret < 0) {
+        return ret;
+    }
+
+    int err;
+    size_t written = records_write(out->fd, true, &records, &err);
+    if (err == 0) {
+        return (int)count;
+    }
+
+    /* The stream may end in a torn record; start over on a new connection */
+    close(out->fd);
+    out->fd = -1;
+
+    size_t bytes;
+    size_t done = records_complete(&records, written, &bytes);
+    return done > 0 ? (int)done : err;
+}
+
+static void unix_destroy(void *impl) {
+    unix_output_t *out = impl;
+    if (out->fd >= 0) {
+        close(out->fd);
+    }
+    free(out);
+}
+
+static const mds_sink_ops_t unix_ops = {
+    .name = "unix",
+    .submit_batch = unix_submit_batch,
+    .destroy = unix_destroy,
+};
+
+mds_sink_t *mds_sink_create_unix(const char *path, const mds_sink_config_t *config) {
+    if (path == NULL) {
+        return NULL;
+    }
+
+    unix_output_t *out = calloc(1, sizeof(*out));
+    if (out == NULL) {
+        return NULL;
+    }
+
+    out->fd = -1;
+    if (mds_sink_unix_addr(path, &out->addr) < 0 || unix_connect(out) < 0) {
+        free(out);
+        return NULL;
+    }
+
+    mds_sink_t *sink = mds_sink_create(&unix_ops, out, config);
+    if (sink == NULL) {
+        unix_destroy(out);
+    }
+    return sink;
+}
+
+/* ============================================================================
+ * HTTP Output
+ * ========================================================================== */
+
+/* Worth retrying later: queue full, transport error, 5xx or 429 */
+static bool http_transient(chunks_uploader_t *uploader, int ret) {
+    if (ret == -ENOBUFS) {
+        return true;
+    }
+    if (ret != -EIO) {
+        return false;
+    }
+
+    chunks_upload_stats_t stats;
+    chunks_uploader_get_stats(uploader, &stats);
+    return stats.last_http_status == 0 || stats.last_http_status >= 500 ||
+           stats.last_http_status == 429;
+}
+
+static int http_submit_batch(void *impl, const mds_sink_chunk_t *chunks, size_t count,
+                             int *results) {
+    chunks_uploader_t *uploader = impl;
+
+    for (size_t i = 0; i < count; i++) {
+        int ret = chunks_uploader_callback(chunks[i].uri, chunks[i].auth_header,
+                                           chunks[i].data, chunks[i].len, uploader);
+        if (ret < 0 && http_transient(uploader, ret)) {
+            return i > 0 ? (int)i : ret;
+        }
+        results[i] = ret;
+    }
+    return (int)count;
+}
+
+/* One upload request per chunk: larger batches would only add latency */
+static const mds_sink_ops_t http_ops = {
+    .name = "http",
+    .submit_batch = http_submit_batch,
+    .per_chunk = true,
+};
+
+mds_sink_t *mds_sink_create_http(chunks_uploader_t *uploader, const mds_sink_config_t *config) {
+    if (uploader == NULL) {
+        return NULL;
+    }
+    return mds_sink_create(&http_ops, uploader, config);
+}
@@ -0,0 +1,266 @@
+/**
+ * @file mds_timeseries.c
+ * @brief Fixed-memory per-second throughput and jitter recorder
+ */
+
+#include "mds_bridge/mds_protocol.h"
+#include "mds_protocol_internal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+
+/* ============================================================================
+ * Internal Helper Functions
+ * ========================================================================== */
+
+uint64_t mds_time_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static uint32_t clamp_u32(uint64_t value) {
+    return value > UINT32_MAX ? UINT32_MAX : (uint32_t)value;
+}
+
+/* Return the bucket for the current wall-clock second, opening new (zeroed)
+ * buckets for any idle seconds since the newest one. */
+static mds_timeseries_bucket_t *timeseries_current(mds_timeseries_t *ts) {
+    uint64_t now = (uint64_t)time(NULL);
+
+    if (ts->count == 0) {
+        ts->head = 0;
+        ts->count = 1;
+        memset(&ts->buckets[0], 0, sizeof(ts->buckets[0]));
+        ts->buckets[0].timestamp = now;
+        return &ts->buckets[0];
+    }
+
+    mds_timeseries_bucket_t *newest = &ts->buckets[ts->head];
+    if (now <= newest->timestamp) {
+        /* Same second, or the wall clock stepped back: keep accumulating */
+        return newest;
+    }
+
+    uint64_t missing = now - newest->timestamp;
+    if (missing > ts->capacity) {
+        /* Idle longer than the ring: only the last capacity seconds remain */
+        missing = ts->capacity;
+    }
+
+    for (uint64_t i = missing; i > 0; i--) {
+        ts->head = (ts->head + 1) % ts->capacity;
+        if (ts->count < ts->capacity) {
+            ts->count++;
+        }
+        memset(&ts->buckets[ts->head], 0, sizeof(ts->buckets[ts->head]));
+        ts->buckets[ts->head].timestamp = now - (i - 1);
+    }
+
+    return &ts->buckets[ts->head];
+}
+
+static void timeseries_add_packet(mds_timeseries_t *ts, uint8_t sequence,
+                                  size_t len, uint64_t arrival_us) {
+    mds_timeseries_bucket_t *bucket = timeseries_current(ts);
+
+    bucket->packets++;
+    bucket->bytes = clamp_u32((uint64_t)bucket->bytes + len);
+
+    if (ts->have_sequence &&
+        sequence != ((ts->last_sequence + 1) & MDS_SEQUENCE_MASK)) {
+        bucket->gaps++;
+    }
+    ts->last_sequence = sequence;
+    ts->have_sequence = true;
+
+    if (ts->last_arrival_us != 0 && arrival_us > ts->last_arrival_us) {
+        uint32_t gap_us = clamp_u32(arrival_us - ts->last_arrival_us);
+        if (gap_us > bucket->max_interarrival_us) {
+            bucket->max_interarrival_us = gap_us;
+        }
+    }
+    ts->last_arrival_us = arrival_us;
+}
+
+void mds_timeseries_record_read_locked(mds_session_t *session, int ret,
+                                       const uint8_t *data,
+                                       uint64_t start_us, uint64_t end_us) {
+    mds_timeseries_t *ts = &session->timeseries;
+
+    if (ret > 0) {
+        timeseries_add_packet(ts, data[0] & MDS_SEQUENCE_MASK, (size_t)ret - 1, end_us);
+    } else if (mds_read_is_timeout(ret)) {
+        mds_timeseries_bucket_t *bucket = timeseries_current(ts);
+        bucket->read_stall_us = clamp_u32((uint64_t)bucket->read_stall_us +
+                                          (end_us - start_us));
+    }
+}
+
+void mds_timeseries_record_external(mds_session_t *session,
+                                    const uint8_t *data, size_t len) {
+    if (session->timeseries.buckets == NULL || len == 0) {
+        return;
+    }
+
+    uint64_t now_us = mds_time_now_us();
+    pthread_mutex_lock(&session->lock);
+    if (session->timeseries.buckets != NULL) {
+        timeseries_add_packet(&session->timeseries, data[0] & MDS_SEQUENCE_MASK,
+                              len - 1, now_us);
+    }
+    pthread_mutex_unlock(&session->lock);
+}
+
+void mds_timeseries_free(mds_session_t *session) {
+    free(session->timeseries.buckets);
+    memset(&session->timeseries, 0, sizeof(session->timeseries));
+}
+
+/* Snapshot the ring, oldest first, into a newly allocated array */
+static int timeseries_snapshot(mds_session_t *session,
+                               mds_timeseries_bucket_t **out, size_t *count) {
+    *out = NULL;
+    *count = 0;
+
+    pthread_mutex_lock(&session->lock);
+    mds_timeseries_t *ts = &session->timeseries;
+    if (ts->buckets == NULL) {
+        pthread_mutex_unlock(&session->lock);
+        return -ENODATA;
+    }
+
+    size_t n = ts->count;
+    mds_timeseries_bucket_t *copy = NULL;
+    if (n > 0) {
+        copy = malloc(n * sizeof(*copy));
+        if (copy == NULL) {
+            pthread_mutex_unlock(&session->lock);
+            return -ENOMEM;
+        }
+
+        size_t oldest = (ts->head + ts->capacity - (n - 1)) % ts->capacity;
+        for (size_t i = 0; i < n; i++) {
+            copy[i] = ts->buckets[(oldest + i) % ts->capacity];
+        }
+    }
+    pthread_mutex_unlock(&session->lock);
+
+    *out = copy;
+    *count = n;
+    return 0;
+}
+
+/* ============================================================================
+ * Time-Series Recorder
+ * ========================================================================== */
+
+int mds_session_enable_timeseries(mds_session_t *session, size_t num_buckets) {
+    if (session == NULL) {
+        return -EINVAL;
+    }
+
+    mds_timeseries_bucket_t *buckets = NULL;
+    if (num_buckets > 0) {
+        buckets = calloc(num_buckets, sizeof(*buckets));
+        if (buckets == NULL) {
+            return -ENOMEM;
+        }
+    }
+
+    pthread_mutex_lock(&session->lock);
+    mds_timeseries_bucket_t *old = session->timeseries.buckets;
+    memset(&session->timeseries, 0, sizeof(session->timeseries));
+    session->timeseries.buckets = buckets;
+    session->timeseries.capacity = num_buckets;
+    pthread_mutex_unlock(&session->lock);
+
+    free(old);
+    return 0;
+}
+
+int mds_session_get_timeseries(mds_session_t *session,
+                               mds_timeseries_bucket_t *buckets,
+                               size_t max_buckets,
+                               size_t *count) {
+    if (count) {
+        *count = 0;
+    }
+
+    if (session == NULL || count == NULL || (buckets == NULL && max_buckets > 0)) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&session->lock);
+    mds_timeseries_t *ts = &session->timeseries;
+    if (ts->buckets == NULL) {
+        pthread_mutex_unlock(&session->lock);
+        return -ENODATA;
+    }
+
+    /* Keep the newest buckets when the caller's array is smaller */
+    size_t n = ts->count < max_buckets ? ts->count : max_buckets;
+    if (n > 0) {
+        size_t first = (ts->head + ts->capacity - (n - 1)) % ts->capacity;
+        for (size_t i = 0; i < n; i++) {
+            buckets[i] = ts->buckets[(first + i) % ts->capacity];
+        }
+    }
+    pthread_mutex_unlock(&session->lock);
+
+    *count = n;
+    return 0;
+}
+
+int mds_timeseries_dump_csv(mds_session_t *session, FILE *fp) {
+    if (session == NULL || fp == NULL) {
+        return -EINVAL;
+    }
+
+    mds_timeseries_bucket_t *buckets;
+    size_t count;
+    int ret = timeseries_snapshot(session, &buckets, &count);
+    if (ret < 0) {
+        return ret;
+    }
+
+    fprintf(fp, "timestamp,packets,bytes,gaps,max_interarrival_us,read_stall_us\n");
+    for (size_t i = 0; i < count; i++) {
+        const mds_timeseries_bucket_t *b = &buckets[i];
+        fprintf(fp, "%" PRIu64 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n",
+                b->timestamp, b->packets, b->bytes, b->gaps,
+                b->max_interarrival_us, b->read_stall_us);
+    }
+
+    free(buckets);
+    return ferror(fp) ? -EIO : 0;
+}
+
+int mds_timeseries_dump_json(mds_session_t *session, FILE *fp) {
+    if (session == NULL || fp == NULL) {
+        return -EINVAL;
+    }
+
+    mds_timeseries_bucket_t *buckets;
+    size_t count;
+    int ret = timeseries_snapshot(session, &buckets, &count);
+    if (ret < 0) {
+        return ret;
+    }
+
+    fprintf(fp, "[");
+    for (size_t i = 0; i < count; i++) {
+        const mds_timeseries_bucket_t *b = &buckets[i];
+        fprintf(fp, "%s\n  {\"timestamp\": %" PRIu64 ", \"packets\": %" PRIu32
+                ", \"bytes\": %" PRIu32 ", \"gaps\": %" PRIu32
+                ", \"max_interarrival_us\": %" PRIu32 ", \"read_stall_us\": %" PRIu32 "}",
+                i == 0 ? "" : ",", b->timestamp, b->packets, b->bytes, b->gaps,
+                b->max_interarrival_us, b->read_stall_us);
+    }
+    fprintf(fp, "%s]\n", count > 0 ? "\n" : "");
+
+    free(buckets);
+    return ferror(fp) ? -EIO : 0;
+}
@@ -0,0 +1,548 @@
+/**
+ * @file mds_workers.c
+ * @brief Upload worker pool with per-device queues and work stealing
+ *
+ * The pool lock guards the device table, the per-device chunk lists and the
+ * statistics; each deque has its own lock so workers can look for work in
+ * each other's deques without it. Lock order is pool, then deque.
+ */
+
+#include "mds_bridge/mds_workers.h"
+#include "mds_protocol_internal.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#define WORKERS_BUCKETS             256
+
+/* One queued chunk; strings live after the data in the same allocation */
+typedef struct workers_item {
+    struct workers_item *next;
+    const char *uri;
+    const char *auth_header;
+    size_t len;
+    uint8_t data[];
+} workers_item_t;
+
+typedef struct workers_device {
+    struct workers_device *next;    /* Hash chain */
+    workers_item_t *head;           /* Queued chunks, oldest first */
+    workers_item_t *tail;
+    size_t home;                    /* Worker whose deque the device starts in */
+    bool scheduled;                 /* In a deque or being uploaded */
+    char uri[];
+} workers_device_t;
+
+/* Ready devices; the owner takes from the front, thieves from the back */
+typedef struct {
+    pthread_mutex_t lock;
+    workers_device_t **ring;
+    size_t capacity;
+    size_t head;
+    size_t count;
+} workers_deque_t;
+
+typedef struct {
+    struct mds_workers *pool;
+    size_t index;
+    mds_chunk_upload_callback_t callback;
+    void *user_data;
+
+    pthread_t thread;
+    pthread_cond_t wake;
+    bool sleeping;
+    uint64_t started_us;
+
+    workers_deque_t deque;
+    mds_worker_stats_t stats;
+} workers_worker_t;
+
+struct mds_workers {
+    pthread_mutex_t lock;
+    pthread_cond_t idle;            /* Nothing queued or being uploaded */
+
+    workers_worker_t *workers[MDS_WORKERS_MAX];
+    size_t worker_count;
+    size_t max_batch;
+    size_t queue_depth;
+    size_t ready;                   /* Devices in deques */
+    bool started;
+    bool stopping;
+
+    workers_device_t *buckets[WORKERS_BUCKETS];
+    mds_workers_stats_t stats;
+};
+
+/* ============================================================================
+ * Internal Helper Functions
+ * ========================================================================== */
+
+static uint32_t uri_hash(const char *uri) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)uri; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static workers_item_t *item_create(const char *uri, const char *auth_header,
+                                   const uint8_t *data, size_t len) {
+    size_t uri_len = strlen(uri) + 1;
+    size_t auth_len = strlen(auth_header) + 1;
+
+    workers_item_t *item = malloc(sizeof(*item) + len + uri_len + auth_len);
+    if (item == NULL) {
+        return NULL;
+    }
+
+    char *strings = (char *)item->data + len;
+    memcpy(item->data, data, len);
+    memcpy(strings, uri, uri_len);
+    memcpy(strings + uri_len, auth_header, auth_len);
+
+    item->next = NULL;
+    item->uri = strings;
+    item->auth_header = strings + uri_len;
+    item->len = len;
+    return item;
+}
+
+/* Find the device for uri, creating it on first use; pool lock held */
+static workers_device_t *device_get_locked(mds_workers_t *pool, const char *uri) {
+    uint32_t hash = uri_hash(uri);
+    workers_device_t **bucket = &pool->buckets[hash % WORKERS_BUCKETS];
+
+    for (workers_device_t *device = *bucket; device; device = device->next) {
+        if (strcmp(device->uri, uri) == 0) {
+            return device;
+        }
+    }
+
+    size_t uri_len = strlen(uri) + 1;
+    workers_device_t *device = calloc(1, sizeof(*device) + uri_len);
+    if (device == NULL) {
+        return NULL;
+    }
+    memcpy(device->uri, uri, uri_len);
+    device->home = hash % pool->worker_count;
+    device->next = *bucket;
+    *bucket = device;
+    pool->stats.devices++;
+    return device;
+}
+
+/* Returns the new number of devices in the deque, or 0 if it could not grow */
+static size_t deque_push(workers_deque_t *deque, workers_device_t *device) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count == deque->capacity) {
+        size_t capacity = deque->capacity ? deque->capacity * 2 : 16;
+        workers_device_t **ring = malloc(capacity * sizeof(*ring));
+        if (ring == NULL) {
+            pthread_mutex_unlock(&deque->lock);
+            return 0;
+        }
+        for (size_t i = 0; i < deque->count; i++) {
+            ring[i] = deque->ring[(deque->head + i) % deque->capacity];
+        }
+        free(deque->ring);
+        deque->ring = ring;
+        deque->capacity = capacity;
+        deque->head = 0;
+    }
+    deque->ring[(deque->head + deque->count) % deque->capacity] = device;
+    size_t count = ++deque->count;
+    pthread_mutex_unlock(&deque->lock);
+    return count;
+}
+
+static workers_device_t *deque_take(workers_deque_t *deque, bool newest) {
+    workers_device_t *device = NULL;
+
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0) {
+        if (newest) {
+            device = deque->ring[(deque->head + deque->count - 1) % deque->capacity];
+        } else {
+            device = deque->ring[deque->head];
+            deque->head = (deque->head + 1) % deque->capacity;
+        }
+        deque->count--;
+    }
+    pthread_mutex_unlock(&deque->lock);
+
+    return device;
+}
+
+/* Wake the worker that should take a newly ready device; pool lock held */
+static void wake_for_locked(mds_workers_t *pool, size_t home) {
+    workers_worker_t *target = pool->workers[home];
+    if (!target->sleeping) {
+        /* Home is busy: let an idle peer steal it */
+        target = NULL;
+        for (size_t i = 1; i < pool->worker_count && target == NULL; i++) {
+            workers_worker_t *peer = pool->workers[(home + i) % pool->worker_count];
+            if (peer->sleeping) {
+                target = peer;
+            }
+        }
+    }
+    if (target) {
+        target->sleeping = false;
+        pthread_cond_signal(&target->wake);
+    }
+}
+
+/* Make a device ready in a worker's deque; returns the deque's length. Pool lock held */
+static size_t schedule_locked(mds_workers_t *pool, workers_device_t *device, size_t worker) {
+    size_t count;
+    while ((count = deque_push(&pool->workers[worker]->deque, device)) == 0) {
+        /* Out of memory growing the deque: any other deque will do */
+        worker = (worker + 1) % pool->worker_count;
+    }
+    pool->ready++;
+    return count;
+}
+
+/* Own deque first, then the peers' starting with the next worker */
+static workers_device_t *worker_take(workers_worker_t *worker, bool *stolen) {
+    mds_workers_t *pool = worker->pool;
+    size_t count = __atomic_load_n(&pool->worker_count, __ATOMIC_ACQUIRE);
+
+    workers_device_t *device = deque_take(&worker->deque, false);
+    *stolen = false;
+    for (size_t i = 1; i < count && device == NULL; i++) {
+        device = deque_take(&pool->workers[(worker->index + i) % count]->deque, true);
+        *stolen = device != NULL;
+    }
+    return device;
+}
+
+/* Upload up to max_batch chunks of a device, then requeue or release it */
+static void worker_run(workers_worker_t *worker, workers_device_t *device, bool stolen) {
+    mds_workers_t *pool = worker->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->ready--;
+    workers_item_t *batch = device->head;
+    workers_item_t *last = batch;
+    size_t n = 1;
+    while (n < pool->max_batch && last->next) {
+        last = last->next;
+        n++;
+    }
+    device->head = last->next;
+    if (device->head == NULL) {
+        device->tail = NULL;
+    }
+    last->next = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    size_t delivered = 0;
+    int last_error = 0;
+    uint64_t start_us = mds_time_now_us();
+    for (workers_item_t *item = batch; item; item = item->next) {
+        int ret = worker->callback(item->uri, item->auth_header, item->data, item->len,
+                                   worker->user_data);
+        if (ret == 0) {
+            delivered++;
+        } else {
+            last_error = ret;
+        }
+    }
+    uint64_t busy_us = mds_time_now_us() - start_us;
+
+    pthread_mutex_lock(&pool->lock);
+    worker->stats.batches++;
+    worker->stats.steals += stolen ? 1 : 0;
+    worker->stats.delivered += delivered;
+    worker->stats.failed += n - delivered;
+    worker->stats.busy_us += busy_us;
+    if (last_error) {
+        worker->stats.last_error = last_error;
+    }
+    pool->stats.queued -= n;
+
+    if (device->head) {
+        /* This worker comes straight back for it; wake a peer only for the rest */
+        if (schedule_locked(pool, device, worker->index) > 1) {
+            wake_for_locked(pool, worker->index);
+        }
+    } else {
+        device->scheduled = false;
+    }
+    if (pool->stats.queued == 0) {
+        pthread_cond_broadcast(&pool->idle);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    while (batch) {
+        workers_item_t *next = batch->next;
+        free(batch);
+        batch = next;
+    }
+}
+
+static void *worker_thread(void *arg) {
+    workers_worker_t *worker = arg;
+    mds_workers_t *pool = worker->pool;
+
+    for (;;) {
+        bool stolen;
+        workers_device_t *device = worker_take(worker, &stolen);
+        if (device) {
+            worker_run(worker, device, stolen);
+            continue;
+        }
+
+        /* Workers exit once nothing is ready; a device still being uploaded
+         * is requeued by the worker holding it, which takes it again */
+        pthread_mutex_lock(&pool->lock);
+        if (pool->ready == 0 && !pool->stopping) {
+            worker->sleeping = true;
+            while (worker->sleeping && !pool->stopping) {
+                pthread_cond_wait(&worker->wake, &pool->lock);
+            }
+            worker->sleeping = false;
+        }
+        bool done = pool->stopping && pool->ready == 0;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (done) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static void worker_free(workers_worker_t *worker) {
+    pthread_cond_destroy(&worker->wake);
+    pthread_mutex_destroy(&worker->deque.lock);
+    free(worker->deque.ring);
+    free(worker);
+}
+
+/* ============================================================================
+ * Pool Management
+ * ========================================================================== */
+
+mds_workers_t *mds_workers_create(size_t max_batch, size_t queue_depth) {
+    mds_workers_t *pool = calloc(1, sizeof(*pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pool->max_batch = max_batch ? max_batch : MDS_WORKERS_DEFAULT_BATCH;
+    pool->queue_depth = queue_depth ? queue_depth : MDS_WORKERS_DEFAULT_DEPTH;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    return pool;
+}
+
+void mds_workers_destroy(mds_workers_t *pool) {
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    for (size_t i = 0; i < pool->worker_count; i++) {
+        pthread_cond_signal(&pool->workers[i]->wake);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->workers[i]->thread, NULL);
+        worker_free(pool->workers[i]);
+    }
+
+    for (size_t b = 0; b < WORKERS_BUCKETS; b++) {
+        workers_device_t *device = pool->buckets[b];
+        while (device) {
+            workers_device_t *next = device->next;
+            while (device->head) {
+                workers_item_t *item = device->head;
+                device->head = item->next;
+                free(item);
+            }
+            free(device);
+            device = next;
+        }
+    }
+
+    pthread_cond_destroy(&pool->idle);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+int mds_workers_add_worker(mds_workers_t *pool,
+                           mds_chunk_upload_callback_t callback,
+                           void *user_data) {
+    if (pool == NULL || callback == NULL) {
+        return -EINVAL;
+    }
+
+    workers_worker_t *worker = calloc(1, sizeof(*worker));
+    if (worker == NULL) {
+        return -ENOMEM;
+    }
+
+    worker->pool = pool;
+    worker->callback = callback;
+    worker->user_data = user_data;
+    worker->started_us = mds_time_now_us();
+    pthread_cond_init(&worker->wake, NULL);
+    pthread_mutex_init(&worker->deque.lock, NULL);
+
+    /* Held from the check to the count update, so concurrent adds get
+     * distinct slots and no chunk is delivered in between */
+    pthread_mutex_lock(&pool->lock);
+    int ret = pool->started ? -EBUSY : pool->worker_count >= MDS_WORKERS_MAX ? -ENOSPC : 0;
+    if (ret == 0) {
+        worker->index = pool->worker_count;
+        pool->workers[worker->index] = worker;
+        if (pthread_create(&worker->thread, NULL, worker_thread, worker) != 0) {
+            pool->workers[worker->index] = NULL;
+            ret = -EAGAIN;
+        } else {
+            __atomic_store_n(&pool->worker_count, pool->worker_count + 1, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (ret < 0) {
+        worker_free(worker);
+        return ret;
+    }
+
+    return (int)worker->index;
+}
+
+/* ============================================================================
+ * Delivery
+ * ========================================================================== */
+
+int mds_workers_callback(const char *uri,
+                         const char *auth_header,
+                         const uint8_t *chunk_data,
+                         size_t chunk_len,
+                         void *user_data) {
+    if (uri == NULL || auth_header == NULL || chunk_data == NULL || user_data == NULL) {
+        return -EINVAL;
+    }
+
+    mds_workers_t *pool = (mds_workers_t *)user_data;
+    workers_item_t *item = item_create(uri, auth_header, chunk_data, chunk_len);
+    if (item == NULL) {
+        return -ENOMEM;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->started = true;
+
+    int ret = 0;
+    workers_device_t *device = NULL;
+    if (pool->worker_count == 0 || pool->stats.queued >= pool->queue_depth) {
+        pool->stats.dropped++;
+        ret = -ENOSPC;
+    } else if ((device = device_get_locked(pool, uri)) == NULL) {
+        ret = -ENOMEM;
+    }
+
+    if (ret == 0) {
+        if (device->tail) {
+            device->tail->next = item;
+        } else {
+            device->head = item;
+        }
+        device->tail = item;
+        pool->stats.queued++;
+        if (pool->stats.queued > pool->stats.max_queued) {
+            pool->stats.max_queued = pool->stats.queued;
+        }
+
+        if (!device->scheduled) {
+            device->scheduled = true;
+            schedule_locked(pool, device, device->home);
+            wake_for_locked(pool, device->home);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (ret < 0) {
+        free(item);
+    }
+    return ret;
+}
+
+int mds_workers_flush(mds_workers_t *pool, int timeout_ms) {
+    if (pool == NULL) {
+        return -EINVAL;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeout_ms >= 0) {
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    int ret = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (pool->stats.queued > 0 && ret == 0) {
+        if (timeout_ms < 0) {
+            pthread_cond_wait(&pool->idle, &pool->lock);
+        } else {
+            ret = pthread_cond_timedwait(&pool->idle, &pool->lock, &deadline);
+        }
+    }
+    bool drained = pool->stats.queued == 0;
+    pthread_mutex_unlock(&pool->lock);
+
+    return drained ? 0 : -ETIMEDOUT;
+}
+
+int mds_workers_get_worker_stats(mds_workers_t *pool, int worker,
+                                 mds_worker_stats_t *stats) {
+    if (pool == NULL || stats == NULL || worker < 0) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if ((size_t)worker >= pool->worker_count) {
+        pthread_mutex_unlock(&pool->lock);
+        return -EINVAL;
+    }
+
+    workers_worker_t *w = pool->workers[worker];
+    *stats = w->stats;
+    pthread_mutex_lock(&w->deque.lock);
+    stats->queued = w->deque.count;
+    pthread_mutex_unlock(&w->deque.lock);
+
+    uint64_t uptime_us = mds_time_now_us() - w->started_us;
+    uint64_t pct = uptime_us ? stats->busy_us * 100u / uptime_us : 0;
+    stats->utilization_pct = (uint32_t)(pct < 100 ? pct : 100);
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
+
+int mds_workers_get_stats(mds_workers_t *pool, mds_workers_stats_t *stats) {
+    if (pool == NULL || stats == NULL) {
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file bench_config.c
+ * @brief Configuration bring-up time, single reports against the combined report
+ *
+ * Usage: bench_config [loads] [transfer_us]
+ *
+ * Opens a session on the mock device and loads its configuration loads
+ * times (default 200), once as older firmware with only the four single
+ * reports and once with the combined configuration report. Every feature
+ * report transfer is delayed by transfer_us (default 1000), roughly one USB
+ * control round trip.
+ */
+
+#include "mds_bridge/mds_protocol.h"
+#include "mock_hidapi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_VID   0x1234
+#define BENCH_PID   0x5678
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    int loads = argc > 1 ? atoi(argv[1]) : 200;
+    unsigned int transfer_us = argc > 2 ? (unsigned int)atoi(argv[2]) : 1000;
+    static const char *const modes[] = {"single reports", "combined report"};
+
+    mock_hid_set_verbose(false);
+    mock_hid_set_transfer_delay_us(transfer_us);
+
+    printf("%-16s %12s %12s\n", "mode", "transfers", "us/load");
+
+    for (int combined = 0; combined < 2; combined++) {
+        mds_session_t *session = NULL;
+        mds_device_config_t config;
+
+        mock_hid_set_config_report(combined != 0);
+        if (mds_session_create_hid(BENCH_VID, BENCH_PID, NULL, &session) < 0) {
+            fprintf(stderr, "Failed to open the mock device\n");
+            return 1;
+        }
+
+        /* The first load negotiates; measure the steady state */
+        mds_read_device_config(session, &config);
+        int reads = mock_hid_get_feature_reads();
+
+        double start = now_s();
+        for (int i = 0; i < loads; i++) {
+            if (mds_read_device_config(session, &config) < 0) {
+                fprintf(stderr, "Failed to read the configuration\n");
+                return 1;
+            }
+        }
+        double elapsed = now_s() - start;
+
+        printf("%-16s %12.1f %12.1f\n", modes[combined],
+               (double)(mock_hid_get_feature_reads() - reads) / loads,
+               elapsed * 1e6 / loads);
+        mds_session_destroy(session);
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+/**
+ * @file bench_pipeline.c
+ * @brief Cost per chunk of each built-in pipeline stage, measured on its own
+ *
+ * Usage: bench_pipeline [chunks]
+ *
+ * Runs chunks (default 1000000) MDS-sized chunks through a pipeline holding
+ * a single stage, in batches of 16, and reports the time the stage itself
+ * spent (mds_pipeline_stage_stats_t.busy_ns) and the wall time per chunk.
+ * Configure with -DCMAKE_BUILD_TYPE=Release for meaningful numbers.
+ */
+
+#include "mds_bridge/mds_pipeline.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_BATCH     16
+
+typedef enum {
+    BENCH_FILTER,
+    BENCH_BATCH_STAGE,
+    BENCH_RATE_LIMIT,
+    BENCH_TEE,
+    BENCH_SINK,
+    BENCH_STAGE_COUNT,
+} bench_stage_t;
+
+static const char *const stage_names[BENCH_STAGE_COUNT] = {
+    "filter", "batch", "rate_limit", "tee", "sink (null)",
+};
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static bool keep_even(const mds_sink_chunk_t *chunk, void *user_data) {
+    (void)user_data;
+    return (chunk->sequence & 1) == 0;
+}
+
+static int discard(const char *uri, const char *auth_header, const uint8_t *data, size_t len,
+                   void *user_data) {
+    (void)uri;
+    (void)auth_header;
+    (void)data;
+    (void)len;
+    (void)user_data;
+    return 0;
+}
+
+static int add_stage(mds_pipeline_t *pipeline, bench_stage_t which, mds_sink_t *sink) {
+    switch (which) {
+        case BENCH_FILTER:
+            return mds_pipeline_add_filter(pipeline, keep_even, NULL);
+        case BENCH_BATCH_STAGE:
+            return mds_pipeline_add_batch(pipeline, 32, 0);
+        case BENCH_RATE_LIMIT:
+            return mds_pipeline_add_rate_limit(pipeline, UINT32_MAX, 0);
+        case BENCH_TEE:
+            return mds_pipeline_add_tee(pipeline, discard, NULL);
+        case BENCH_SINK:
+        default:
+            return mds_pipeline_add_sink(pipeline, sink);
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t total = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+    static uint8_t payload[MDS_MAX_CHUNK_DATA_LEN];
+    mds_sink_chunk_t chunks[BENCH_BATCH];
+
+    memset(payload, 0xA5, sizeof(payload));
+    for (size_t i = 0; i < BENCH_BATCH; i++) {
+        chunks[i].uri = "https://chunks.memfault.com/api/v0/chunks/DEVICE-0001";
+        chunks[i].auth_header = "Memfault-Project-Key:0123456789abcdef";
+        chunks[i].data = payload;
+        chunks[i].len = 20 + i * 43 / BENCH_BATCH;
+        chunks[i].received_us = 0;
+    }
+
+    printf("%-12s %12s %12s %12s\n", "stage", "stage ns", "wall ns", "out/in");
+
+    for (int s = 0; s < BENCH_STAGE_COUNT; s++) {
+        mds_pipeline_t *pipeline = mds_pipeline_create();
+        mds_sink_t *sink = mds_sink_create_null(NULL);
+        if (pipeline == NULL || sink == NULL || add_stage(pipeline, (bench_stage_t)s, sink) < 0) {
+            fprintf(stderr, "Failed to set up stage %s\n", stage_names[s]);
+            return 1;
+        }
+
+        double start = now_s();
+        for (size_t done = 0; done < total; done += BENCH_BATCH) {
+            for (size_t i = 0; i < BENCH_BATCH; i++) {
+                chunks[i].sequence = done + i;
+            }
+            mds_pipeline_submit_batch(pipeline, chunks, BENCH_BATCH);
+        }
+        mds_pipeline_flush(pipeline);
+        double elapsed = now_s() - start;
+
+        mds_pipeline_stage_stats_t stats;
+        mds_pipeline_get_stage_stats(pipeline, 0, &stats);
+        printf("%-12s %12.1f %12.1f %12.2f\n", stage_names[s],
+               (double)stats.busy_ns / (double)stats.chunks_in,
+               elapsed * 1e9 / (double)stats.chunks_in,
+               (double)stats.chunks_out / (double)stats.chunks_in);
+
+        mds_pipeline_destroy(pipeline);
+        mds_sink_destroy(sink);
+    }
+    return 0;
+}
@@ -7,12 +7,15 @@
  */
 
 #include <hidapi.h>
+#include "mock_hidapi.h"
 #include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
 
 /* Mock device configuration */
 #define MOCK_VID 0x1234
@@ -25,6 +28,17 @@
 #define MDS_REPORT_ID_AUTHORIZATION       0x04
 #define MDS_REPORT_ID_STREAM_CONTROL      0x05
 #define MDS_REPORT_ID_STREAM_DATA         0x06
+#define MDS_REPORT_ID_CONFIG              0x07
+
+/* Combined configuration report: supported_features bit and TLV tags */
+#define MDS_FEATURE_CONFIG_REPORT         0x01
+#define MDS_CONFIG_TAG_SUPPORTED_FEATURES 0x01
+#define MDS_CONFIG_TAG_DEVICE_IDENTIFIER  0x02
+#define MDS_CONFIG_TAG_DATA_URI           0x03
+#define MDS_CONFIG_TAG_AUTHORIZATION      0x04
+
+/* Largest feature report, as in memfault_hid_internal.h */
+#define MOCK_MAX_FEATURE_REPORT           256
 
 /* Mock device state */
 typedef struct {
@@ -39,7 +53,7 @@ typedef struct {
     size_t input_queue_count;
 
     /* Feature report storage (by report ID) */
-    uint8_t feature_reports[256][65];  /* One per report ID, 64 bytes + report ID */
+    uint8_t feature_reports[256][MOCK_MAX_FEATURE_REPORT + 1];  /* One per report ID, data + report ID */
     size_t feature_report_len[256];
     bool feature_report_set[256];
 
@@ -52,6 +66,28 @@ typedef struct {
 static mock_device_state_t g_mock_device = {0};
 static bool g_initialized = false;
 
+/* Transfers may come from a reader thread and a control thread at once, as
+ * with a real device; each one runs under this lock */
+static pthread_mutex_t g_mock_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Test controls; kept across hid_init() and hid_open() */
+static struct {
+    bool config_report;
+    bool verbose;
+    unsigned int transfer_delay_us;
+    bool blocking_reads;
+    int feature_reads;
+    int reads_waiting;              /* Interrupt reads waiting out their timeout */
+    int feature_reads_overlapped;   /* GET_FEATURE transfers during such a wait */
+} g_mock_control = {.verbose = true};
+
+#define MOCK_PRINTF(...) \
+    do { \
+        if (g_mock_control.verbose) { \
+            printf(__VA_ARGS__); \
+        } \
+    } while (0)
+
 /* Device info for enumeration */
 static struct hid_device_info g_device_info = {
     .path = "mock://device/1",
@@ -76,7 +112,7 @@ int HID_API_EXPORT hid_init(void) {
         return 0;
     }
 
-    printf("[MOCK] hid_init()\n");
+    MOCK_PRINTF("[MOCK] hid_init()\n");
     memset(&g_mock_device, 0, sizeof(g_mock_device));
     g_initialized = true;
     return 0;
@@ -87,7 +123,7 @@ int HID_API_EXPORT hid_exit(void) {
         return 0;
     }
 
-    printf("[MOCK] hid_exit()\n");
+    MOCK_PRINTF("[MOCK] hid_exit()\n");
     g_initialized = false;
     return 0;
 }
@@ -98,7 +134,7 @@ int HID_API_EXPORT hid_exit(void) {
 
 struct hid_device_info HID_API_EXPORT * hid_enumerate(unsigned short vendor_id,
                                                        unsigned short product_id) {
-    printf("[MOCK] hid_enumerate(0x%04X, 0x%04X)\n", vendor_id, product_id);
+    MOCK_PRINTF("[MOCK] hid_enumerate(0x%04X, 0x%04X)\n", vendor_id, product_id);
 
     /* Return our mock device if VID/PID matches (or if both are 0) */
     if ((vendor_id == 0 && product_id == 0) ||
@@ -110,7 +146,7 @@ struct hid_device_info HID_API_EXPORT * hid_enumerate(unsigned short vendor_id,
 }
 
 void HID_API_EXPORT hid_free_enumeration(struct hid_device_info *devs) {
-    printf("[MOCK] hid_free_enumeration(%p)\n", devs);
+    MOCK_PRINTF("[MOCK] hid_free_enumeration(%p)\n", devs);
     /* Nothing to free - we return a static structure */
     (void)devs;
 }
@@ -123,8 +159,8 @@ static void mds_initialize_feature_reports(void) {
     /* Initialize MDS Supported Features (Report ID 0x01) */
     uint8_t *features = g_mock_device.feature_reports[MDS_REPORT_ID_SUPPORTED_FEATURES];
     features[0] = MDS_REPORT_ID_SUPPORTED_FEATURES;
-    /* Little-endian 32-bit 0x00000000 */
-    features[1] = 0x00;
+    /* Little-endian 32-bit bitmask */
+    features[1] = g_mock_control.config_report ? MDS_FEATURE_CONFIG_REPORT : 0x00;
     features[2] = 0x00;
     features[3] = 0x00;
     features[4] = 0x00;
@@ -155,7 +191,30 @@ static void mds_initialize_feature_reports(void) {
     g_mock_device.feature_report_len[MDS_REPORT_ID_AUTHORIZATION] = 1 + strlen(auth_str) + 1;
     g_mock_device.feature_report_set[MDS_REPORT_ID_AUTHORIZATION] = true;
 
-    printf("[MOCK] MDS feature reports initialized\n");
+    /* Combined configuration report (Report ID 0x07): the same fields as TLV */
+    g_mock_device.feature_report_set[MDS_REPORT_ID_CONFIG] = g_mock_control.config_report;
+    if (g_mock_control.config_report) {
+        uint8_t *config = g_mock_device.feature_reports[MDS_REPORT_ID_CONFIG];
+        size_t len = 0;
+        config[len++] = MDS_REPORT_ID_CONFIG;
+        config[len++] = MDS_CONFIG_TAG_SUPPORTED_FEATURES;
+        config[len++] = 4;
+        memcpy(&config[len], &features[1], 4);
+        len += 4;
+
+        const uint8_t tags[] = {MDS_CONFIG_TAG_DEVICE_IDENTIFIER, MDS_CONFIG_TAG_DATA_URI,
+                                MDS_CONFIG_TAG_AUTHORIZATION};
+        const char *values[] = {id_str, uri_str, auth_str};
+        for (int i = 0; i < 3; i++) {
+            config[len++] = tags[i];
+            config[len++] = (uint8_t)strlen(values[i]);
+            memcpy(&config[len], values[i], strlen(values[i]));
+            len += strlen(values[i]);
+        }
+        g_mock_device.feature_report_len[MDS_REPORT_ID_CONFIG] = len;
+    }
+
+    MOCK_PRINTF("[MOCK] MDS feature reports initialized\n");
 }
 
 /* ============================================================================
@@ -165,7 +224,7 @@ static void mds_initialize_feature_reports(void) {
 hid_device * HID_API_EXPORT hid_open(unsigned short vendor_id,
                                       unsigned short product_id,
                                       const wchar_t *serial_number) {
-    printf("[MOCK] hid_open(0x%04X, 0x%04X, %ls)\n",
+    MOCK_PRINTF("[MOCK] hid_open(0x%04X, 0x%04X, %ls)\n",
            vendor_id, product_id, serial_number ? serial_number : L"NULL");
 
     if (vendor_id != MOCK_VID || product_id != MOCK_PID) {
@@ -173,7 +232,7 @@ hid_device * HID_API_EXPORT hid_open(unsigned short vendor_id,
     }
 
     if (g_mock_device.open) {
-        printf("[MOCK]   Device already open!\n");
+        MOCK_PRINTF("[MOCK]   Device already open!\n");
         return NULL;
     }
 
@@ -182,6 +241,7 @@ hid_device * HID_API_EXPORT hid_open(unsigned short vendor_id,
 
     /* Initialize MDS feature reports */
     mds_initialize_feature_reports();
+    g_mock_control.feature_reads = 0;
 
     /* Initialize MDS streaming state */
     g_mock_device.mds_streaming_enabled = false;
@@ -193,14 +253,14 @@ hid_device * HID_API_EXPORT hid_open(unsigned short vendor_id,
 }
 
 hid_device * HID_API_EXPORT hid_open_path(const char *path) {
-    printf("[MOCK] hid_open_path(%s)\n", path);
+    MOCK_PRINTF("[MOCK] hid_open_path(%s)\n", path);
 
     if (strcmp(path, g_device_info.path) != 0) {
         return NULL;
     }
 
     if (g_mock_device.open) {
-        printf("[MOCK]   Device already open!\n");
+        MOCK_PRINTF("[MOCK]   Device already open!\n");
         return NULL;
     }
 
@@ -209,6 +269,7 @@ hid_device * HID_API_EXPORT hid_open_path(const char *path) {
 
     /* Initialize MDS feature reports */
     mds_initialize_feature_reports();
+    g_mock_control.feature_reads = 0;
 
     /* Initialize MDS streaming state */
     g_mock_device.mds_streaming_enabled = false;
@@ -219,7 +280,7 @@ hid_device * HID_API_EXPORT hid_open_path(const char *path) {
 }
 
 void HID_API_EXPORT hid_close(hid_device *dev) {
-    printf("[MOCK] hid_close(%p)\n", dev);
+    MOCK_PRINTF("[MOCK] hid_close(%p)\n", dev);
 
     if (dev == (hid_device *)&g_mock_device) {
         g_mock_device.open = false;
@@ -238,7 +299,7 @@ void HID_API_EXPORT hid_close(hid_device *dev) {
 /* Helper to queue a mock MDS stream data packet */
 static void mds_queue_stream_packet(const char *chunk_data, size_t chunk_len) {
     if (g_mock_device.input_queue_count >= 10) {
-        printf("[MOCK]   Input queue full, can't queue stream packet\n");
+        MOCK_PRINTF("[MOCK]   Input queue full, can't queue stream packet\n");
         return;
     }
 
@@ -265,32 +326,32 @@ static void mds_queue_stream_packet(const char *chunk_data, size_t chunk_len) {
     g_mock_device.mds_sequence_counter = (g_mock_device.mds_sequence_counter + 1) & 0x1F;
     g_mock_device.mds_chunk_sent_count++;
 
-    printf("[MOCK]   Queued MDS stream packet #%zu (seq=%u, %zu bytes)\n",
+    MOCK_PRINTF("[MOCK]   Queued MDS stream packet #%zu (seq=%u, %zu bytes)\n",
            g_mock_device.mds_chunk_sent_count,
            packet[1], chunk_len);
 }
 
-int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t length) {
+static int mock_hid_write(hid_device *dev, const unsigned char *data, size_t length) {
     if (dev != (hid_device *)&g_mock_device || !g_mock_device.open) {
         return -1;
     }
 
     uint8_t report_id = data[0];
-    printf("[MOCK] hid_write(report_id=0x%02X, length=%zu)\n", report_id, length);
-    printf("[MOCK]   Data: ");
+    MOCK_PRINTF("[MOCK] hid_write(report_id=0x%02X, length=%zu)\n", report_id, length);
+    MOCK_PRINTF("[MOCK]   Data: ");
     for (size_t i = 0; i < length && i < 16; i++) {
-        printf("%02X ", data[i]);
+        MOCK_PRINTF("%02X ", data[i]);
     }
     if (length > 16) {
-        printf("...");
+        MOCK_PRINTF("...");
     }
-    printf("\n");
+    MOCK_PRINTF("\n");
 
     /* Handle MDS Stream Control (Report ID 0x05) */
     if (report_id == MDS_REPORT_ID_STREAM_CONTROL && length >= 2) {
         uint8_t mode = data[1];
         if (mode == 0x01) {  /* MDS_STREAM_MODE_ENABLED */
-            printf("[MOCK]   MDS Streaming ENABLED\n");
+            MOCK_PRINTF("[MOCK]   MDS Streaming ENABLED\n");
             g_mock_device.mds_streaming_enabled = true;
             g_mock_device.mds_sequence_counter = 0;
 
@@ -299,7 +360,7 @@ int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t
             mds_queue_stream_packet("MOCK_CHUNK_DATA_002", 19);
             mds_queue_stream_packet("MOCK_CHUNK_DATA_003", 19);
         } else {  /* MDS_STREAM_MODE_DISABLED */
-            printf("[MOCK]   MDS Streaming DISABLED\n");
+            MOCK_PRINTF("[MOCK]   MDS Streaming DISABLED\n");
             g_mock_device.mds_streaming_enabled = false;
         }
         return (int)length;
@@ -312,15 +373,15 @@ int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t
         g_mock_device.input_queue_len[idx] = length;
         g_mock_device.input_queue_tail = (g_mock_device.input_queue_tail + 1) % 10;
         g_mock_device.input_queue_count++;
-        printf("[MOCK]   Echoed to input queue (count=%zu)\n", g_mock_device.input_queue_count);
+        MOCK_PRINTF("[MOCK]   Echoed to input queue (count=%zu)\n", g_mock_device.input_queue_count);
     } else {
-        printf("[MOCK]   Input queue full, dropping echo\n");
+        MOCK_PRINTF("[MOCK]   Input queue full, dropping echo\n");
     }
 
     return (int)length;
 }
 
-int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length) {
+static int mock_hid_read(hid_device *dev, unsigned char *data, size_t length) {
     if (dev != (hid_device *)&g_mock_device || !g_mock_device.open) {
         return -1;
     }
@@ -346,15 +407,15 @@ int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length)
     g_mock_device.input_queue_head = (g_mock_device.input_queue_head + 1) % 10;
     g_mock_device.input_queue_count--;
 
-    printf("[MOCK] hid_read() -> %zu bytes (report_id=0x%02X, remaining=%zu)\n",
+    MOCK_PRINTF("[MOCK] hid_read() -> %zu bytes (report_id=0x%02X, remaining=%zu)\n",
            copy_len, data[0], g_mock_device.input_queue_count);
 
     return (int)copy_len;
 }
 
-int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data,
-                                     size_t length, int milliseconds) {
-    printf("[MOCK] hid_read_timeout(timeout=%d)\n", milliseconds);
+static int mock_hid_read_timeout(hid_device *dev, unsigned char *data,
+                                 size_t length, int milliseconds) {
+    MOCK_PRINTF("[MOCK] hid_read_timeout(timeout=%d)\n", milliseconds);
 
     if (dev != (hid_device *)&g_mock_device || !g_mock_device.open) {
         return -1;
@@ -367,34 +428,34 @@ int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data,
     }
 
     /* Return queued input report */
-    return hid_read(dev, data, length);
+    return mock_hid_read(dev, data, length);
 }
 
-int HID_API_EXPORT hid_send_output_report(hid_device *dev,
-                                           const unsigned char *data,
-                                           size_t length) {
+static int mock_hid_send_output_report(hid_device *dev,
+                                       const unsigned char *data,
+                                       size_t length) {
     if (dev != (hid_device *)&g_mock_device || !g_mock_device.open) {
         return -1;
     }
 
     uint8_t report_id = data[0];
-    printf("[MOCK] hid_send_output_report(report_id=0x%02X, length=%zu) Data: ",
+    MOCK_PRINTF("[MOCK] hid_send_output_report(report_id=0x%02X, length=%zu) Data: ",
            report_id, length);
 
     /* Print data for debugging */
     for (size_t i = 0; i < length && i < 16; i++) {
-        printf("%02X ", data[i]);
+        MOCK_PRINTF("%02X ", data[i]);
     }
     if (length > 16) {
-        printf("...");
+        MOCK_PRINTF("...");
     }
-    printf("\n");
+    MOCK_PRINTF("\n");
 
     /* Handle MDS Stream Control (Report ID 0x05) */
     if (report_id == MDS_REPORT_ID_STREAM_CONTROL && length >= 2) {
         uint8_t mode = data[1];
         if (mode == 0x01) {  /* MDS_STREAM_MODE_ENABLED */
-            printf("[MOCK]   MDS Streaming ENABLED\n");
+            MOCK_PRINTF("[MOCK]   MDS Streaming ENABLED\n");
             g_mock_device.mds_streaming_enabled = true;
             g_mock_device.mds_sequence_counter = 0;
 
@@ -403,7 +464,7 @@ int HID_API_EXPORT hid_send_output_report(hid_device *dev,
             mds_queue_stream_packet("MOCK_CHUNK_DATA_002", 19);
             mds_queue_stream_packet("MOCK_CHUNK_DATA_003", 19);
         } else {  /* MDS_STREAM_MODE_DISABLED */
-            printf("[MOCK]   MDS Streaming DISABLED\n");
+            MOCK_PRINTF("[MOCK]   MDS Streaming DISABLED\n");
             g_mock_device.mds_streaming_enabled = false;
         }
         return (int)length;
@@ -412,22 +473,22 @@ int HID_API_EXPORT hid_send_output_report(hid_device *dev,
     return (int)length;
 }
 
-int HID_API_EXPORT hid_send_feature_report(hid_device *dev,
-                                            const unsigned char *data,
-                                            size_t length) {
+static int mock_hid_send_feature_report(hid_device *dev,
+                                        const unsigned char *data,
+                                        size_t length) {
     if (dev != (hid_device *)&g_mock_device || !g_mock_device.open) {
         return -1;
     }
 
     uint8_t report_id = data[0];
-    printf("[MOCK] hid_send_feature_report(report_id=0x%02X, length=%zu)\n",
+    MOCK_PRINTF("[MOCK] hid_send_feature_report(report_id=0x%02X, length=%zu)\n",
            report_id, length);
 
     /* Handle MDS Stream Control (Report ID 0x05) - now a FEATURE report */
     if (report_id == MDS_REPORT_ID_STREAM_CONTROL && length >= 2) {
         uint8_t mode = data[1];
         if (mode == 0x01) {  /* MDS_STREAM_MODE_ENABLED */
-            printf("[MOCK]   MDS Streaming ENABLED\n");
+            MOCK_PRINTF("[MOCK]   MDS Streaming ENABLED\n");
             g_mock_device.mds_streaming_enabled = true;
             g_mock_device.mds_sequence_counter = 0;
 
@@ -436,7 +497,7 @@ int HID_API_EXPORT hid_send_feature_report(hid_device *dev,
             mds_queue_stream_packet("MOCK_CHUNK_DATA_002", 19);
             mds_queue_stream_packet("MOCK_CHUNK_DATA_003", 19);
         } else {  /* MDS_STREAM_MODE_DISABLED */
-            printf("[MOCK]   MDS Streaming DISABLED\n");
+            MOCK_PRINTF("[MOCK]   MDS Streaming DISABLED\n");
             g_mock_device.mds_streaming_enabled = false;
         }
     }
@@ -450,27 +511,38 @@ int HID_API_EXPORT hid_send_feature_report(hid_device *dev,
     g_mock_device.feature_report_len[report_id] = length;
     g_mock_device.feature_report_set[report_id] = true;
 
-    printf("[MOCK]   Stored feature report 0x%02X (%zu bytes)\n", report_id, length);
+    MOCK_PRINTF("[MOCK]   Stored feature report 0x%02X (%zu bytes)\n", report_id, length);
 
     return (int)length;
 }
 
-int HID_API_EXPORT hid_get_feature_report(hid_device *dev,
-                                           unsigned char *data,
-                                           size_t length) {
+static int mock_hid_get_feature_report(hid_device *dev,
+                                       unsigned char *data,
+                                       size_t length) {
     if (dev != (hid_device *)&g_mock_device || !g_mock_device.open) {
         return -1;
     }
 
     uint8_t report_id = data[0];
-    printf("[MOCK] hid_get_feature_report(report_id=0x%02X)\n", report_id);
+    MOCK_PRINTF("[MOCK] hid_get_feature_report(report_id=0x%02X)\n", report_id);
+
+    g_mock_control.feature_reads++;
+    if (g_mock_control.reads_waiting > 0) {
+        g_mock_control.feature_reads_overlapped++;
+    }
+
+    /* Firmware without the combined report stalls the request */
+    if (report_id == MDS_REPORT_ID_CONFIG && !g_mock_device.feature_report_set[report_id]) {
+        MOCK_PRINTF("[MOCK]   Report not supported\n");
+        return -1;
+    }
 
     /* Check if feature report was previously set */
     if (!g_mock_device.feature_report_set[report_id]) {
         /* Return default/empty report */
         memset(data, 0, length);
         data[0] = report_id;
-        printf("[MOCK]   Returning default feature report (not previously set)\n");
+        MOCK_PRINTF("[MOCK]   Returning default feature report (not previously set)\n");
         return (int)length;
     }
 
@@ -482,17 +554,79 @@ int HID_API_EXPORT hid_get_feature_report(hid_device *dev,
 
     memcpy(data, g_mock_device.feature_reports[report_id], copy_len);
 
-    printf("[MOCK]   Returning stored feature report (%zu bytes)\n", copy_len);
+    MOCK_PRINTF("[MOCK]   Returning stored feature report (%zu bytes)\n", copy_len);
 
     return (int)copy_len;
 }
 
+int HID_API_EXPORT hid_write(hid_device *dev, const unsigned char *data, size_t length) {
+    pthread_mutex_lock(&g_mock_lock);
+    int ret = mock_hid_write(dev, data, length);
+    pthread_mutex_unlock(&g_mock_lock);
+    return ret;
+}
+
+int HID_API_EXPORT hid_read(hid_device *dev, unsigned char *data, size_t length) {
+    pthread_mutex_lock(&g_mock_lock);
+    int ret = mock_hid_read(dev, data, length);
+    pthread_mutex_unlock(&g_mock_lock);
+    return ret;
+}
+
+int HID_API_EXPORT hid_read_timeout(hid_device *dev, unsigned char *data,
+                                     size_t length, int milliseconds) {
+    pthread_mutex_lock(&g_mock_lock);
+    if (g_mock_control.blocking_reads && milliseconds > 0 &&
+        g_mock_device.input_queue_count == 0) {
+        /* Wait out the timeout like a real interrupt endpoint, unlocked */
+        g_mock_control.reads_waiting++;
+        pthread_mutex_unlock(&g_mock_lock);
+        usleep((useconds_t)milliseconds * 1000);
+        pthread_mutex_lock(&g_mock_lock);
+        g_mock_control.reads_waiting--;
+    }
+    int ret = mock_hid_read_timeout(dev, data, length, milliseconds);
+    pthread_mutex_unlock(&g_mock_lock);
+    return ret;
+}
+
+int HID_API_EXPORT hid_send_output_report(hid_device *dev,
+                                           const unsigned char *data,
+                                           size_t length) {
+    pthread_mutex_lock(&g_mock_lock);
+    int ret = mock_hid_send_output_report(dev, data, length);
+    pthread_mutex_unlock(&g_mock_lock);
+    return ret;
+}
+
+int HID_API_EXPORT hid_send_feature_report(hid_device *dev,
+                                            const unsigned char *data,
+                                            size_t length) {
+    pthread_mutex_lock(&g_mock_lock);
+    int ret = mock_hid_send_feature_report(dev, data, length);
+    pthread_mutex_unlock(&g_mock_lock);
+    return ret;
+}
+
+int HID_API_EXPORT hid_get_feature_report(hid_device *dev,
+                                           unsigned char *data,
+                                           size_t length) {
+    if (g_mock_control.transfer_delay_us) {
+        usleep(g_mock_control.transfer_delay_us);
+    }
+
+    pthread_mutex_lock(&g_mock_lock);
+    int ret = mock_hid_get_feature_report(dev, data, length);
+    pthread_mutex_unlock(&g_mock_lock);
+    return ret;
+}
+
 /* ============================================================================
  * Utility Functions
  * ========================================================================== */
 
 int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock) {
-    printf("[MOCK] hid_set_nonblocking(%d)\n", nonblock);
+    MOCK_PRINTF("[MOCK] hid_set_nonblocking(%d)\n", nonblock);
 
     if (dev != (hid_device *)&g_mock_device || !g_mock_device.open) {
         return -1;
@@ -501,3 +635,47 @@ int HID_API_EXPORT hid_set_nonblocking(hid_device *dev, int nonblock) {
     g_mock_device.nonblocking = (nonblock != 0);
     return 0;
 }
+
+/* ============================================================================
+ * Test Controls
+ * ========================================================================== */
+
+void mock_hid_set_config_report(bool enabled) {
+    g_mock_control.config_report = enabled;
+    mds_initialize_feature_reports();
+}
+
+void mock_hid_set_transfer_delay_us(unsigned int delay_us) {
+    g_mock_control.transfer_delay_us = delay_us;
+}
+
+void mock_hid_set_blocking_reads(bool blocking) {
+    pthread_mutex_lock(&g_mock_lock);
+    g_mock_control.blocking_reads = blocking;
+    pthread_mutex_unlock(&g_mock_lock);
+}
+
+int mock_hid_get_feature_reads(void) {
+    pthread_mutex_lock(&g_mock_lock);
+    int reads = g_mock_control.feature_reads;
+    pthread_mutex_unlock(&g_mock_lock);
+    return reads;
+}
+
+int mock_hid_get_reads_waiting(void) {
+    pthread_mutex_lock(&g_mock_lock);
+    int waiting = g_mock_control.reads_waiting;
+    pthread_mutex_unlock(&g_mock_lock);
+    return waiting;
+}
+
+int mock_hid_get_overlapped_feature_reads(void) {
+    pthread_mutex_lock(&g_mock_lock);
+    int reads = g_mock_control.feature_reads_overlapped;
+    pthread_mutex_unlock(&g_mock_lock);
+    return reads;
+}
+
+void mock_hid_set_verbose(bool verbose) {
+    g_mock_control.verbose = verbose;
+}
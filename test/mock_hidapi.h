@@ -0,0 +1,60 @@
+/**
+ * @file mock_hidapi.h
+ * @brief Mock hidapi control interface for tests and benchmarks
+ */
+
+#ifndef MOCK_HIDAPI_H
+#define MOCK_HIDAPI_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Emulate firmware with the combined configuration report
+ *
+ * Off by default (firmware with only the four single reports). Rebuilds the
+ * device's feature reports.
+ */
+void mock_hid_set_config_report(bool enabled);
+
+/**
+ * @brief Delay every feature report transfer by delay_us, like a USB
+ *        control round trip
+ */
+void mock_hid_set_transfer_delay_us(unsigned int delay_us);
+
+/**
+ * @brief Make hid_read_timeout() wait out its timeout when no input report
+ *        is queued, instead of returning at once (off by default)
+ */
+void mock_hid_set_blocking_reads(bool blocking);
+
+/**
+ * @brief Get the number of GET_FEATURE transfers since the device was opened
+ */
+int mock_hid_get_feature_reads(void);
+
+/**
+ * @brief Get the number of interrupt reads currently waiting out their timeout
+ */
+int mock_hid_get_reads_waiting(void);
+
+/**
+ * @brief Get the number of GET_FEATURE transfers made while an interrupt read
+ *        was waiting (i.e. not serialized behind it)
+ */
+int mock_hid_get_overlapped_feature_reads(void);
+
+/**
+ * @brief Enable or disable the mock's trace output (on by default)
+ */
+void mock_hid_set_verbose(bool verbose);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MOCK_HIDAPI_H */
@@ -12,11 +12,98 @@
 #include <stdbool.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "mock_libcurl.h"
+#include "chunks_uploader_internal.h"
+#include "mock_netem.h"
 
 /* On some platforms (Linux), curl.h defines these as macros.
  * We need to undefine them to provide our mock implementations. */
 #undef curl_easy_setopt
 #undef curl_easy_getinfo
+#undef curl_multi_setopt
+#undef curl_share_setopt
+
+/* Per-URL-prefix response override */
+#define MOCK_CURL_MAX_URL_RULES 8
+
+/* URLs of the first requests after a reset, in the order they were performed */
+#define MOCK_CURL_URL_LOG 64
+
+typedef struct {
+    char prefix[256];
+    long response_code;
+    CURLcode error_code;
+    double total_time;
+    int hits;
+} mock_curl_url_rule_t;
+
+/* Per-handle request state */
+typedef struct {
+    char url[512];
+    const void *postfields;
+    long postfieldsize;
+    void *private_ptr;
+    void *share;
+    long num_connects;
+    long timeout_ms;
+    long response_code;
+    double total_time;
+    const struct curl_slist *resolve;
+    curl_off_t namelookup_us;
+
+    /* Emulated outcome, decided when the transfer starts */
+    bool netem_scheduled;
+    mock_netem_result_t netem;
+} mock_curl_handle_t;
+
+/* Multi handle: added easy handles are performed on the next multi_perform */
+#define MOCK_CURL_MAX_MULTI_HANDLES 64
+
+typedef struct {
+    CURL *handles[MOCK_CURL_MAX_MULTI_HANDLES];
+    bool performed[MOCK_CURL_MAX_MULTI_HANDLES];
+    int count;
+
+    /* Socket interface: a transfer gets a fake socket on the first timeout
+     * action and completes when activity is reported on that socket */
+    curl_socket_callback socket_fn;
+    void *socket_data;
+    curl_multi_timer_callback timer_fn;
+    void *timer_data;
+    curl_socket_t fds[MOCK_CURL_MAX_MULTI_HANDLES];
+    curl_socket_t next_fd;
+
+    CURLMsg msgs[MOCK_CURL_MAX_MULTI_HANDLES];
+    int msg_count;
+    CURLMsg current_msg;
+} mock_curl_multi_t;
+
+/* Connection cache: one entry per (cache owner, origin). The owner is the
+ * share handle when one is set, otherwise the easy handle itself. */
+#define MOCK_CURL_MAX_CONNECTIONS 128
+
+typedef struct {
+    const void *owner;
+    char origin[256];
+} mock_curl_connection_t;
+
+/* TLS stand-in server: client session caches, keyed like connections */
+#define MOCK_CURL_MAX_TLS_SESSIONS 32
+#define MOCK_CURL_MAX_TLS_TICKETS 64
+
+typedef struct {
+    const void *owner;
+    char key[256];
+    char ticket[32];
+    long long valid_until;
+} mock_curl_tls_session_t;
 
 /* Mock state */
 typedef struct {
@@ -28,15 +115,73 @@ typedef struct {
     CURLcode error_code;
     int request_count;
     bool verbose;
+
+    mock_curl_url_rule_t url_rules[MOCK_CURL_MAX_URL_RULES];
+    int url_rule_count;
+
+    /* Response of the last performed request (rule or default) */
+    long effective_code;
+    double effective_total_time;
+
+    /* Totals across all requests */
+    size_t total_bytes;
+    int max_in_flight;
+
+    mock_curl_connection_t connections[MOCK_CURL_MAX_CONNECTIONS];
+    int connection_count;
+    int connections_opened;
+
+    char url_log[MOCK_CURL_URL_LOG][256];
+
+    mock_curl_tls_session_t tls_sessions[MOCK_CURL_MAX_TLS_SESSIONS];
+    int tls_session_count;
+    long long tls_ticket_expiry[MOCK_CURL_MAX_TLS_TICKETS];
+    int tls_tickets_issued;
+    long tls_ticket_lifetime;
+    int tls_full_handshakes;
+    int tls_resumed_handshakes;
+
+    char last_resolve[256];
+
+    mock_curl_server_fn server_fn;
+    void *server_data;
+
+    bool multi_newest_first;
+    int easy_init_failures;
 } mock_curl_state_t;
 
 static mock_curl_state_t mock_state = {0};
 
+/* DNS stand-in: getaddrinfo() answers from this table. It is read by
+ * resolver threads, so it has its own lock and survives mock_state resets. */
+#define MOCK_CURL_MAX_DNS_HOSTS 8
+
+typedef struct {
+    char host[128];
+    char addr[INET_ADDRSTRLEN];
+} mock_curl_dns_host_t;
+
+static struct {
+    pthread_mutex_t lock;
+    mock_curl_dns_host_t hosts[MOCK_CURL_MAX_DNS_HOSTS];
+    int count;
+    int delay_ms;
+    int queries;
+} mock_dns = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
 /* Reset mock state */
 void mock_curl_reset(void) {
     memset(&mock_state, 0, sizeof(mock_state));
+    mock_netem_enable(NULL);
     mock_state.response_code = 200;  /* Default to success */
     mock_state.error_code = CURLE_OK;
+    mock_state.tls_ticket_lifetime = 7200;
+
+    pthread_mutex_lock(&mock_dns.lock);
+    mock_dns.count = 0;
+    mock_dns.delay_ms = 0;
+    mock_dns.queries = 0;
+    pthread_mutex_unlock(&mock_dns.lock);
 }
 
 /* Set mock response */
@@ -54,40 +199,308 @@ const char* mock_curl_get_last_url(void) {
     return mock_state.last_url;
 }
 
+const char* mock_curl_get_last_headers(void) {
+    return mock_state.last_headers;
+}
+
+const char* mock_curl_get_request_url(int index) {
+    if (index < 0 || index >= mock_state.request_count || index >= MOCK_CURL_URL_LOG) {
+        return NULL;
+    }
+    return mock_state.url_log[index];
+}
+
+void mock_curl_set_server(mock_curl_server_fn fn, void *user_data) {
+    mock_state.server_fn = fn;
+    mock_state.server_data = user_data;
+}
+
+void mock_curl_set_multi_newest_first(bool newest_first) {
+    mock_state.multi_newest_first = newest_first;
+}
+
 const uint8_t* mock_curl_get_last_data(size_t *len) {
     *len = mock_state.last_data_len;
     return mock_state.last_data;
 }
 
+static mock_curl_url_rule_t *mock_find_rule(const char *prefix) {
+    for (int i = 0; i < mock_state.url_rule_count; i++) {
+        if (strcmp(mock_state.url_rules[i].prefix, prefix) == 0) {
+            return &mock_state.url_rules[i];
+        }
+    }
+    return NULL;
+}
+
+void mock_curl_set_url_response(const char *url_prefix, long http_code,
+                                CURLcode error, double total_time_s) {
+    mock_curl_url_rule_t *rule = mock_find_rule(url_prefix);
+    if (rule == NULL) {
+        if (mock_state.url_rule_count >= MOCK_CURL_MAX_URL_RULES) {
+            return;
+        }
+        rule = &mock_state.url_rules[mock_state.url_rule_count++];
+        memset(rule, 0, sizeof(*rule));
+        strncpy(rule->prefix, url_prefix, sizeof(rule->prefix) - 1);
+    }
+
+    rule->response_code = http_code;
+    rule->error_code = error;
+    rule->total_time = total_time_s;
+}
+
+int mock_curl_get_url_request_count(const char *url_prefix) {
+    mock_curl_url_rule_t *rule = mock_find_rule(url_prefix);
+    return rule ? rule->hits : 0;
+}
+
+size_t mock_curl_get_total_bytes(void) {
+    return mock_state.total_bytes;
+}
+
+int mock_curl_get_max_in_flight(void) {
+    return mock_state.max_in_flight;
+}
+
+int mock_curl_get_connections_opened(void) {
+    return mock_state.connections_opened;
+}
+
+void mock_curl_get_tls_handshakes(int *full, int *resumed) {
+    *full = mock_state.tls_full_handshakes;
+    *resumed = mock_state.tls_resumed_handshakes;
+}
+
+void mock_curl_set_tls_ticket_lifetime(long seconds) {
+    mock_state.tls_ticket_lifetime = seconds;
+}
+
+void mock_curl_fail_easy_init(int count) {
+    mock_state.easy_init_failures = count;
+}
+
+void mock_curl_set_dns(const char *host, const char *addr) {
+    pthread_mutex_lock(&mock_dns.lock);
+    int i = 0;
+    while (i < mock_dns.count && strcmp(mock_dns.hosts[i].host, host) != 0) {
+        i++;
+    }
+    if (addr == NULL) {
+        if (i < mock_dns.count) {
+            mock_dns.hosts[i] = mock_dns.hosts[--mock_dns.count];
+        }
+    } else if (i < MOCK_CURL_MAX_DNS_HOSTS) {
+        snprintf(mock_dns.hosts[i].host, sizeof(mock_dns.hosts[i].host), "%s", host);
+        snprintf(mock_dns.hosts[i].addr, sizeof(mock_dns.hosts[i].addr), "%s", addr);
+        if (i == mock_dns.count) {
+            mock_dns.count++;
+        }
+    }
+    pthread_mutex_unlock(&mock_dns.lock);
+}
+
+void mock_curl_set_dns_delay_ms(int delay_ms) {
+    pthread_mutex_lock(&mock_dns.lock);
+    mock_dns.delay_ms = delay_ms;
+    pthread_mutex_unlock(&mock_dns.lock);
+}
+
+int mock_curl_get_dns_queries(void) {
+    pthread_mutex_lock(&mock_dns.lock);
+    int queries = mock_dns.queries;
+    pthread_mutex_unlock(&mock_dns.lock);
+    return queries;
+}
+
+const char *mock_curl_get_last_resolve(void) {
+    return mock_state.last_resolve;
+}
+
+/* Answer from the DNS table (IPv4 only) after the configured delay */
+int getaddrinfo(const char *node, const char *service, const struct addrinfo *hints,
+                struct addrinfo **res) {
+    (void)hints;
+    struct sockaddr_in sin;
+    memset(&sin, 0, sizeof(sin));
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons((uint16_t)(service ? atoi(service) : 0));
+
+    pthread_mutex_lock(&mock_dns.lock);
+    int delay_ms = mock_dns.delay_ms;
+    bool found = false;
+    mock_dns.queries++;
+    for (int i = 0; node && i < mock_dns.count && !found; i++) {
+        found = strcmp(mock_dns.hosts[i].host, node) == 0 &&
+                inet_pton(AF_INET, mock_dns.hosts[i].addr, &sin.sin_addr) == 1;
+    }
+    pthread_mutex_unlock(&mock_dns.lock);
+
+    if (delay_ms > 0) {
+        usleep((useconds_t)delay_ms * 1000);
+    }
+    if (!found) {
+        return EAI_NONAME;
+    }
+
+    struct addrinfo *ai = calloc(1, sizeof(*ai) + sizeof(sin));
+    if (ai == NULL) {
+        return EAI_MEMORY;
+    }
+    ai->ai_family = AF_INET;
+    ai->ai_socktype = SOCK_STREAM;
+    ai->ai_addrlen = sizeof(sin);
+    ai->ai_addr = (struct sockaddr *)(void *)(ai + 1);
+    memcpy(ai->ai_addr, &sin, sizeof(sin));
+    *res = ai;
+    return 0;
+}
+
+void freeaddrinfo(struct addrinfo *res) {
+    while (res) {
+        struct addrinfo *next = res->ai_next;
+        free(res);
+        res = next;
+    }
+}
+
+static mock_curl_tls_session_t *mock_tls_find(const void *owner, const char *key) {
+    for (int i = 0; i < mock_state.tls_session_count; i++) {
+        if (mock_state.tls_sessions[i].owner == owner &&
+            strcmp(mock_state.tls_sessions[i].key, key) == 0) {
+            return &mock_state.tls_sessions[i];
+        }
+    }
+    return NULL;
+}
+
+/* Store a ticket in owner's session cache (one per server) */
+static void mock_tls_store(const void *owner, const char *key, const char *ticket,
+                           long long valid_until) {
+    mock_curl_tls_session_t *session = mock_tls_find(owner, key);
+    if (session == NULL) {
+        if (mock_state.tls_session_count >= MOCK_CURL_MAX_TLS_SESSIONS) {
+            return;
+        }
+        session = &mock_state.tls_sessions[mock_state.tls_session_count++];
+        session->owner = owner;
+        snprintf(session->key, sizeof(session->key), "%s", key);
+    }
+    snprintf(session->ticket, sizeof(session->ticket), "%s", ticket);
+    session->valid_until = valid_until;
+}
+
+/* Drop owner's session cache */
+static void mock_tls_forget(const void *owner) {
+    for (int i = 0; i < mock_state.tls_session_count; i++) {
+        if (mock_state.tls_sessions[i].owner == owner) {
+            mock_state.tls_sessions[i--] = mock_state.tls_sessions[--mock_state.tls_session_count];
+        }
+    }
+}
+
+/* Handshake of a new https connection to "host:port" */
+static void mock_tls_handshake(const void *owner, const char *key) {
+    long long now = (long long)time(NULL);
+    mock_curl_tls_session_t *session = mock_tls_find(owner, key);
+    int ticket = 0;
+
+    if (session && sscanf(session->ticket, "MOCK-TICKET-%d", &ticket) == 1 &&
+        ticket >= 1 && ticket <= mock_state.tls_tickets_issued &&
+        mock_state.tls_ticket_expiry[ticket - 1] > now) {
+        mock_state.tls_resumed_handshakes++;
+        return;
+    }
+
+    mock_state.tls_full_handshakes++;
+    if (mock_state.tls_tickets_issued >= MOCK_CURL_MAX_TLS_TICKETS) {
+        return;
+    }
+
+    long long valid_until = now + mock_state.tls_ticket_lifetime;
+    char issued[32];
+    mock_state.tls_ticket_expiry[mock_state.tls_tickets_issued++] = valid_until;
+    snprintf(issued, sizeof(issued), "MOCK-TICKET-%d", mock_state.tls_tickets_issued);
+    mock_tls_store(owner, key, issued, valid_until);
+}
+
+/* Reuse a cached connection to the URL's origin, or open one */
+static long mock_connect(const void *owner, const char *url) {
+    char origin[256];
+    const char *host = strstr(url, "://");
+    size_t len = host ? (size_t)(host + 3 - url) + strcspn(host + 3, "/?#") : strlen(url);
+    if (len >= sizeof(origin)) {
+        len = sizeof(origin) - 1;
+    }
+    memcpy(origin, url, len);
+    origin[len] = '\0';
+
+    for (int i = 0; i < mock_state.connection_count; i++) {
+        if (mock_state.connections[i].owner == owner &&
+            strcmp(mock_state.connections[i].origin, origin) == 0) {
+            return 0;
+        }
+    }
+
+    if (mock_state.connection_count < MOCK_CURL_MAX_CONNECTIONS) {
+        mock_curl_connection_t *conn = &mock_state.connections[mock_state.connection_count++];
+        conn->owner = owner;
+        strcpy(conn->origin, origin);
+    }
+    mock_state.connections_opened++;
+
+    if (strncmp(url, "https://", 8) == 0) {
+        char key[256];
+        const char *server = origin + 8;
+        snprintf(key, sizeof(key), strchr(server, ':') ? "%s" : "%s:443", server);
+        mock_tls_handshake(owner, key);
+    }
+    return 1;
+}
+
+/* Close every connection cached by owner */
+static void mock_disconnect(const void *owner) {
+    for (int i = 0; i < mock_state.connection_count; i++) {
+        if (mock_state.connections[i].owner == owner) {
+            mock_state.connections[i--] = mock_state.connections[--mock_state.connection_count];
+        }
+    }
+}
+
 /* ============================================================================
  * Mock libcurl API Implementation
  * ========================================================================== */
 
 CURL *curl_easy_init(void) {
     printf("[MOCK CURL] curl_easy_init()\n");
+    if (mock_state.easy_init_failures > 0) {
+        mock_state.easy_init_failures--;
+        return NULL;
+    }
     /* Initialize mock state with default success values */
     if (mock_state.response_code == 0) {
         mock_state.response_code = 202;  /* HTTP 202 Accepted (Memfault default) */
         mock_state.error_code = CURLE_OK;
     }
-    /* Return a non-NULL pointer (not actually used, just needs to be non-NULL) */
-    static int dummy = 0;
-    return (CURL *)&dummy;
+    return (CURL *)calloc(1, sizeof(mock_curl_handle_t));
 }
 
 void curl_easy_cleanup(CURL *curl) {
     printf("[MOCK CURL] curl_easy_cleanup(%p)\n", curl);
-    (void)curl;
+    mock_disconnect(curl);
+    mock_tls_forget(curl);
+    free(curl);
 }
 
 void curl_easy_reset(CURL *curl) {
     if (mock_state.verbose) {
         printf("[MOCK CURL] curl_easy_reset(%p)\n", curl);
     }
-    (void)curl;
+    memset(curl, 0, sizeof(mock_curl_handle_t));
 }
 
 CURLcode curl_easy_setopt(CURL *curl, CURLoption option, ...) {
+    mock_curl_handle_t *handle = (mock_curl_handle_t *)curl;
     va_list args;
     va_start(args, option);
 
@@ -98,6 +511,7 @@ CURLcode curl_easy_setopt(CURL *curl, CURLoption option, ...) {
                 printf("[MOCK CURL] curl_easy_setopt(CURLOPT_URL, %s)\n", url);
             }
             strncpy(mock_state.last_url, url, sizeof(mock_state.last_url) - 1);
+            strncpy(handle->url, url, sizeof(handle->url) - 1);
             break;
         }
         case CURLOPT_POST: {
@@ -113,6 +527,7 @@ CURLcode curl_easy_setopt(CURL *curl, CURLoption option, ...) {
                 printf("[MOCK CURL] curl_easy_setopt(CURLOPT_POSTFIELDS, %p)\n", data);
             }
             /* Store pointer but don't copy yet - wait for POSTFIELDSIZE */
+            handle->postfields = data;
             break;
         }
         case CURLOPT_POSTFIELDSIZE: {
@@ -122,6 +537,7 @@ CURLcode curl_easy_setopt(CURL *curl, CURLoption option, ...) {
             }
             /* Note: In real usage, POSTFIELDS is set before POSTFIELDSIZE */
             /* We'll capture the data in curl_easy_perform */
+            handle->postfieldsize = size;
             break;
         }
         case CURLOPT_HTTPHEADER: {
@@ -144,6 +560,7 @@ CURLcode curl_easy_setopt(CURL *curl, CURLoption option, ...) {
             if (mock_state.verbose) {
                 printf("[MOCK CURL] curl_easy_setopt(CURLOPT_TIMEOUT_MS, %ld)\n", timeout);
             }
+            handle->timeout_ms = timeout;
             break;
         }
         case CURLOPT_VERBOSE: {
@@ -154,6 +571,18 @@ CURLcode curl_easy_setopt(CURL *curl, CURLoption option, ...) {
             mock_state.verbose = (verbose != 0);
             break;
         }
+        case CURLOPT_PRIVATE: {
+            handle->private_ptr = va_arg(args, void *);
+            break;
+        }
+        case CURLOPT_SHARE: {
+            handle->share = va_arg(args, void *);
+            break;
+        }
+        case CURLOPT_RESOLVE: {
+            handle->resolve = va_arg(args, const struct curl_slist *);
+            break;
+        }
         default:
             if (mock_state.verbose) {
                 printf("[MOCK CURL] curl_easy_setopt(%d, ...)\n", option);
@@ -175,33 +604,117 @@ CURLcode curl_easy_setopt_data(CURL *curl, const void *data, long size) {
     return CURLE_OK;
 }
 
-CURLcode curl_easy_perform(CURL *curl) {
+static CURLcode mock_perform_handle(mock_curl_handle_t *handle) {
+    size_t body_len = handle->postfields && handle->postfieldsize > 0 ? (size_t)handle->postfieldsize : 0;
+    if (mock_state.request_count < MOCK_CURL_URL_LOG) {
+        strncpy(mock_state.url_log[mock_state.request_count], handle->url,
+                sizeof(mock_state.url_log[0]) - 1);
+    }
     mock_state.request_count++;
+    handle->num_connects = mock_connect(handle->share ? handle->share : (void *)handle, handle->url);
 
-    printf("[MOCK CURL] curl_easy_perform() - Request #%d\n", mock_state.request_count);
-    printf("[MOCK CURL]   URL: %s\n", mock_state.last_url);
-    printf("[MOCK CURL]   HTTP Code: %ld\n", mock_state.response_code);
+    /* Capture the request body */
+    if (body_len > 0) {
+        size_t len = body_len;
+        mock_state.total_bytes += len;
+        mock_state.last_data_len = len < sizeof(mock_state.last_data) ? len : sizeof(mock_state.last_data);
+        memcpy(mock_state.last_data, handle->postfields, mock_state.last_data_len);
+    }
 
     /* In a real implementation, we'd parse and execute the request */
     /* For the mock, we just return the pre-configured response */
+    CURLcode error = mock_state.error_code;
+    handle->response_code = mock_state.response_code;
+    handle->total_time = 0.0;
 
-    (void)curl;
-    return mock_state.error_code;
+    bool ruled = false;
+    for (int i = 0; i < mock_state.url_rule_count; i++) {
+        mock_curl_url_rule_t *rule = &mock_state.url_rules[i];
+        if (strncmp(handle->url, rule->prefix, strlen(rule->prefix)) == 0) {
+            rule->hits++;
+            error = rule->error_code;
+            handle->response_code = rule->response_code;
+            handle->total_time = rule->total_time;
+            ruled = true;
+            break;
+        }
+    }
+
+    /* Without a rule, the stand-in server or the emulated link decides */
+    if (!ruled && mock_state.server_fn) {
+        error = CURLE_OK;
+        handle->response_code = mock_state.server_fn(handle->url, handle->postfields, body_len,
+                                                     mock_state.server_data);
+    } else if (!ruled && mock_netem_active()) {
+        if (!handle->netem_scheduled) {
+            mock_netem_schedule(body_len, handle->timeout_ms, &handle->netem);
+        }
+        mock_netem_complete(&handle->netem, body_len);
+        error = handle->netem.result;
+        handle->response_code = handle->netem.http_code;
+        handle->total_time = (handle->netem.done_ms - handle->netem.start_ms) / 1000.0;
+    }
+    handle->netem_scheduled = false;
+
+    /* Without a resolve entry libcurl looks the host up itself */
+    snprintf(mock_state.last_resolve, sizeof(mock_state.last_resolve), "%s",
+             handle->resolve ? handle->resolve->data : "");
+    pthread_mutex_lock(&mock_dns.lock);
+    handle->namelookup_us = handle->resolve ? 0 : (curl_off_t)mock_dns.delay_ms * 1000;
+    pthread_mutex_unlock(&mock_dns.lock);
+
+    strncpy(mock_state.last_url, handle->url, sizeof(mock_state.last_url) - 1);
+    mock_state.effective_code = handle->response_code;
+    mock_state.effective_total_time = handle->total_time;
+
+    /* Emulated runs issue thousands of requests; only trace them when verbose */
+    if (!mock_netem_active() || mock_state.verbose) {
+        printf("[MOCK CURL] curl_easy_perform() - Request #%d\n", mock_state.request_count);
+        printf("[MOCK CURL]   URL: %s\n", handle->url);
+        printf("[MOCK CURL]   HTTP Code: %ld\n", handle->response_code);
+    }
+
+    return error;
+}
+
+CURLcode curl_easy_perform(CURL *curl) {
+    return mock_perform_handle((mock_curl_handle_t *)curl);
 }
 
 CURLcode curl_easy_getinfo(CURL *curl, CURLINFO info, ...) {
+    mock_curl_handle_t *handle = (mock_curl_handle_t *)curl;
     va_list args;
     va_start(args, info);
 
     switch (info) {
         case CURLINFO_RESPONSE_CODE: {
             long *code = va_arg(args, long *);
-            *code = mock_state.response_code;
+            *code = handle->response_code;
             if (mock_state.verbose) {
                 printf("[MOCK CURL] curl_easy_getinfo(CURLINFO_RESPONSE_CODE) -> %ld\n", *code);
             }
             break;
         }
+        case CURLINFO_TOTAL_TIME: {
+            double *total = va_arg(args, double *);
+            *total = handle->total_time;
+            break;
+        }
+        case CURLINFO_NAMELOOKUP_TIME_T: {
+            curl_off_t *lookup = va_arg(args, curl_off_t *);
+            *lookup = handle->namelookup_us;
+            break;
+        }
+        case CURLINFO_NUM_CONNECTS: {
+            long *connects = va_arg(args, long *);
+            *connects = handle->num_connects;
+            break;
+        }
+        case CURLINFO_PRIVATE: {
+            void **ptr = va_arg(args, void **);
+            *ptr = handle->private_ptr;
+            break;
+        }
         default:
             if (mock_state.verbose) {
                 printf("[MOCK CURL] curl_easy_getinfo(%d, ...)\n", info);
@@ -210,7 +723,6 @@ CURLcode curl_easy_getinfo(CURL *curl, CURLINFO info, ...) {
     }
 
     va_end(args);
-    (void)curl;
     return CURLE_OK;
 }
 
@@ -277,3 +789,281 @@ CURLcode curl_global_init(long flags) {
 void curl_global_cleanup(void) {
     printf("[MOCK CURL] curl_global_cleanup()\n");
 }
+
+/* ============================================================================
+ * Mock libcurl TLS Session Export (libcurl 8.12+)
+ *
+ * Defined whenever the uploader can call them, so resumption is exercised
+ * even when the installed headers predate libcurl 8.12
+ * ========================================================================== */
+
+#if CHUNKS_HAVE_TLS_EXPORT
+
+CURLcode curl_easy_ssls_import(CURL *curl, const char *session_key,
+                               const unsigned char *shmac, size_t shmac_len,
+                               const unsigned char *sdata, size_t sdata_len) {
+    mock_curl_handle_t *handle = (mock_curl_handle_t *)curl;
+    char ticket[32];
+    (void)shmac;
+    (void)shmac_len;
+
+    if (session_key == NULL || sdata_len == 0 || sdata_len >= sizeof(ticket)) {
+        return CURLE_BAD_FUNCTION_ARGUMENT;
+    }
+    memcpy(ticket, sdata, sdata_len);
+    ticket[sdata_len] = '\0';
+    mock_tls_store(handle->share ? handle->share : (void *)handle, session_key, ticket, 0);
+    return CURLE_OK;
+}
+
+CURLcode curl_easy_ssls_export(CURL *curl, curl_ssls_export_cb *export_fn, void *userptr) {
+    mock_curl_handle_t *handle = (mock_curl_handle_t *)curl;
+    const void *owner = handle->share ? handle->share : (void *)handle;
+
+    for (int i = 0; i < mock_state.tls_session_count; i++) {
+        const mock_curl_tls_session_t *session = &mock_state.tls_sessions[i];
+        if (session->owner != owner) {
+            continue;
+        }
+        CURLcode ret = export_fn(curl, userptr, session->key, NULL, 0,
+                                 (const unsigned char *)session->ticket, strlen(session->ticket),
+                                 (curl_off_t)session->valid_until, 0x0304, NULL, 0);
+        if (ret != CURLE_OK) {
+            return ret;
+        }
+    }
+    return CURLE_OK;
+}
+
+#endif /* CHUNKS_HAVE_TLS_EXPORT */
+
+/* ============================================================================
+ * Mock libcurl Share API Implementation
+ * ========================================================================== */
+
+CURLSH *curl_share_init(void) {
+    /* Only the address matters: it owns the shared connection cache */
+    return (CURLSH *)calloc(1, 1);
+}
+
+CURLSHcode curl_share_setopt(CURLSH *share, CURLSHoption option, ...) {
+    (void)share;
+    (void)option;
+    return CURLSHE_OK;
+}
+
+CURLSHcode curl_share_cleanup(CURLSH *share) {
+    mock_disconnect(share);
+    mock_tls_forget(share);
+    free(share);
+    return CURLSHE_OK;
+}
+
+/* ============================================================================
+ * Mock libcurl Multi API Implementation
+ * ========================================================================== */
+
+CURLM *curl_multi_init(void) {
+    return (CURLM *)calloc(1, sizeof(mock_curl_multi_t));
+}
+
+CURLMcode curl_multi_cleanup(CURLM *multi) {
+    free(multi);
+    return CURLM_OK;
+}
+
+CURLMcode curl_multi_setopt(CURLM *multi, CURLMoption option, ...) {
+    mock_curl_multi_t *m = (mock_curl_multi_t *)multi;
+    va_list args;
+    va_start(args, option);
+
+    switch (option) {
+        case CURLMOPT_SOCKETFUNCTION:
+            m->socket_fn = va_arg(args, curl_socket_callback);
+            break;
+        case CURLMOPT_SOCKETDATA:
+            m->socket_data = va_arg(args, void *);
+            break;
+        case CURLMOPT_TIMERFUNCTION:
+            m->timer_fn = va_arg(args, curl_multi_timer_callback);
+            break;
+        case CURLMOPT_TIMERDATA:
+            m->timer_data = va_arg(args, void *);
+            break;
+        default:
+            break;
+    }
+
+    va_end(args);
+    return CURLM_OK;
+}
+
+CURLMcode curl_multi_add_handle(CURLM *multi, CURL *curl) {
+    mock_curl_multi_t *m = (mock_curl_multi_t *)multi;
+    if (m->count >= MOCK_CURL_MAX_MULTI_HANDLES) {
+        return CURLM_OUT_OF_MEMORY;
+    }
+
+    m->handles[m->count] = curl;
+    m->performed[m->count] = false;
+    m->fds[m->count] = CURL_SOCKET_BAD;
+    m->count++;
+    if (m->count > mock_state.max_in_flight) {
+        mock_state.max_in_flight = m->count;
+    }
+
+    /* Like libcurl, ask for an immediate timeout to start the transfer */
+    if (m->timer_fn) {
+        m->timer_fn(multi, 0, m->timer_data);
+    }
+    return CURLM_OK;
+}
+
+CURLMcode curl_multi_remove_handle(CURLM *multi, CURL *curl) {
+    mock_curl_multi_t *m = (mock_curl_multi_t *)multi;
+
+    for (int i = 0; i < m->count; i++) {
+        if (m->handles[i] == curl) {
+            memmove(&m->handles[i], &m->handles[i + 1], (size_t)(m->count - i - 1) * sizeof(m->handles[0]));
+            memmove(&m->performed[i], &m->performed[i + 1], (size_t)(m->count - i - 1) * sizeof(m->performed[0]));
+            memmove(&m->fds[i], &m->fds[i + 1], (size_t)(m->count - i - 1) * sizeof(m->fds[0]));
+            m->count--;
+            break;
+        }
+    }
+
+    /* Drop undelivered completion messages for this handle */
+    for (int i = 0; i < m->msg_count; i++) {
+        if (m->msgs[i].easy_handle == curl) {
+            memmove(&m->msgs[i], &m->msgs[i + 1], (size_t)(m->msg_count - i - 1) * sizeof(m->msgs[0]));
+            m->msg_count--;
+            i--;
+        }
+    }
+    return CURLM_OK;
+}
+
+static void mock_multi_finish(mock_curl_multi_t *m, int i) {
+    CURLMsg *msg = &m->msgs[m->msg_count++];
+    memset(msg, 0, sizeof(*msg));
+    msg->msg = CURLMSG_DONE;
+    msg->easy_handle = m->handles[i];
+    msg->data.result = mock_perform_handle((mock_curl_handle_t *)m->handles[i]);
+    m->performed[i] = true;
+}
+
+CURLMcode curl_multi_perform(CURLM *multi, int *running_handles) {
+    mock_curl_multi_t *m = (mock_curl_multi_t *)multi;
+    *running_handles = 0;
+
+    if (!mock_netem_active()) {
+        /* Every transfer completes on its first perform */
+        for (int n = 0; n < m->count; n++) {
+            int i = mock_state.multi_newest_first ? m->count - 1 - n : n;
+            if (!m->performed[i]) {
+                mock_multi_finish(m, i);
+            }
+        }
+        return CURLM_OK;
+    }
+
+    /* Start new transfers now; advance to the earliest completion */
+    double next_done = -1.0;
+    for (int i = 0; i < m->count; i++) {
+        mock_curl_handle_t *handle = (mock_curl_handle_t *)m->handles[i];
+        if (m->performed[i]) {
+            continue;
+        }
+        if (!handle->netem_scheduled) {
+            size_t body_len = handle->postfieldsize > 0 ? (size_t)handle->postfieldsize : 0;
+            mock_netem_schedule(body_len, handle->timeout_ms, &handle->netem);
+            handle->netem_scheduled = true;
+        }
+        if (next_done < 0 || handle->netem.done_ms < next_done) {
+            next_done = handle->netem.done_ms;
+        }
+    }
+
+    for (int i = 0; i < m->count; i++) {
+        mock_curl_handle_t *handle = (mock_curl_handle_t *)m->handles[i];
+        if (m->performed[i]) {
+            continue;
+        }
+        if (handle->netem.done_ms <= next_done) {
+            mock_multi_finish(m, i);
+        } else {
+            (*running_handles)++;
+        }
+    }
+    return CURLM_OK;
+}
+
+CURLMcode curl_multi_socket_action(CURLM *multi, curl_socket_t s, int ev_bitmask,
+                                   int *running_handles) {
+    mock_curl_multi_t *m = (mock_curl_multi_t *)multi;
+    (void)ev_bitmask;
+
+    if (s == CURL_SOCKET_TIMEOUT) {
+        /* "Connect" new transfers and ask the host to watch their sockets */
+        for (int i = 0; i < m->count; i++) {
+            if (!m->performed[i] && m->fds[i] == CURL_SOCKET_BAD) {
+                m->fds[i] = 1000 + m->next_fd++;
+                if (m->socket_fn) {
+                    m->socket_fn(m->handles[i], m->fds[i], CURL_POLL_INOUT, m->socket_data, NULL);
+                }
+            }
+        }
+    } else {
+        /* Activity completes the transfer on that socket */
+        for (int i = 0; i < m->count; i++) {
+            if (!m->performed[i] && m->fds[i] == s) {
+                mock_multi_finish(m, i);
+                if (m->socket_fn) {
+                    m->socket_fn(m->handles[i], s, CURL_POLL_REMOVE, m->socket_data, NULL);
+                }
+            }
+        }
+    }
+
+    *running_handles = 0;
+    for (int i = 0; i < m->count; i++) {
+        *running_handles += m->performed[i] ? 0 : 1;
+    }
+    return CURLM_OK;
+}
+
+CURLMcode curl_multi_poll(CURLM *multi, struct curl_waitfd extra_fds[],
+                          unsigned int extra_nfds, int timeout_ms, int *numfds) {
+    (void)multi;
+    (void)extra_fds;
+    (void)extra_nfds;
+    (void)timeout_ms;
+    if (numfds) {
+        *numfds = 0;
+    }
+    return CURLM_OK;
+}
+
+CURLMcode curl_multi_wait(CURLM *multi, struct curl_waitfd extra_fds[],
+                          unsigned int extra_nfds, int timeout_ms, int *numfds) {
+    return curl_multi_poll(multi, extra_fds, extra_nfds, timeout_ms, numfds);
+}
+
+CURLMsg *curl_multi_info_read(CURLM *multi, int *msgs_in_queue) {
+    mock_curl_multi_t *m = (mock_curl_multi_t *)multi;
+
+    if (m->msg_count == 0) {
+        *msgs_in_queue = 0;
+        return NULL;
+    }
+
+    m->current_msg = m->msgs[0];
+    memmove(&m->msgs[0], &m->msgs[1], (size_t)(m->msg_count - 1) * sizeof(m->msgs[0]));
+    m->msg_count--;
+    *msgs_in_queue = m->msg_count;
+    return &m->current_msg;
+}
+
+const char *curl_multi_strerror(CURLMcode error) {
+    return error == CURLM_OK ? "No error" : "Multi error";
+}
@@ -6,6 +6,7 @@
 #ifndef MOCK_LIBCURL_H
 #define MOCK_LIBCURL_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <curl/curl.h>
@@ -41,6 +42,20 @@ int mock_curl_get_request_count(void);
  */
 const char* mock_curl_get_last_url(void);
 
+/**
+ * @brief Get the URL of the index-th request since the last reset
+ *
+ * @return URL, or NULL if there was no such request (only the first 64 are kept)
+ */
+const char* mock_curl_get_request_url(int index);
+
+/**
+ * @brief Get the request headers last set, each followed by ';'
+ *
+ * @return Header string
+ */
+const char* mock_curl_get_last_headers(void);
+
 /**
  * @brief Get the last POST data that was sent
  *
@@ -49,6 +64,127 @@ const char* mock_curl_get_last_url(void);
  */
 const uint8_t* mock_curl_get_last_data(size_t *len);
 
+/**
+ * @brief Override the response for URLs starting with url_prefix
+ *
+ * Rules are checked in the order they were added and take precedence over
+ * mock_curl_set_response(). Adding a rule for an existing prefix replaces it.
+ *
+ * @param url_prefix URL prefix to match (e.g. "https://a.example.com")
+ * @param http_code HTTP status code
+ * @param error libcurl error code
+ * @param total_time_s Value reported for CURLINFO_TOTAL_TIME
+ */
+void mock_curl_set_url_response(const char *url_prefix, long http_code,
+                                CURLcode error, double total_time_s);
+
+/**
+ * @brief Get number of requests made to URLs matching a url_prefix rule
+ *
+ * @param url_prefix Prefix previously passed to mock_curl_set_url_response()
+ * @return Number of matching requests, or 0 if no such rule exists
+ */
+int mock_curl_get_url_request_count(const char *url_prefix);
+
+/**
+ * @brief Get total request body bytes sent across all requests
+ */
+size_t mock_curl_get_total_bytes(void);
+
+/**
+ * @brief Get the largest number of easy handles attached to one multi handle
+ */
+int mock_curl_get_max_in_flight(void);
+
+/**
+ * @brief Get number of connections opened
+ *
+ * Connections are cached per share handle (or per easy handle without one)
+ * and origin, and reused by later requests to the same origin.
+ */
+int mock_curl_get_connections_opened(void);
+
+/**
+ * @brief Get the handshakes seen by the TLS stand-in server
+ *
+ * The stand-in only models the session cache: no certificates are checked
+ * and no bytes of a real TLS handshake are exchanged, so tests built on it
+ * cover how the uploader stores and offers tickets, not whether a real
+ * server accepts them. Every new https connection performs a handshake. It is resumed
+ * (abbreviated) when the client's session cache holds a ticket the server
+ * issued and that has not expired; otherwise it is a full handshake after
+ * which the server issues a new ticket into the client's cache.
+ *
+ * @param full Receives the number of full handshakes
+ * @param resumed Receives the number of resumed handshakes
+ */
+void mock_curl_get_tls_handshakes(int *full, int *resumed);
+
+/**
+ * @brief Set the lifetime of tickets issued by the TLS stand-in server
+ *
+ * @param seconds Ticket lifetime (default 7200; 0 issues tickets that are already expired)
+ */
+void mock_curl_set_tls_ticket_lifetime(long seconds);
+
+/**
+ * @brief Make the next count calls to curl_easy_init() fail
+ *
+ * @param count Number of calls that return NULL
+ */
+void mock_curl_fail_easy_init(int count);
+
+/**
+ * @brief Set the address the DNS stand-in returns for host
+ *
+ * getaddrinfo() is replaced by the mock and answers from this table; hosts
+ * not in it fail with EAI_NONAME. The table is cleared by mock_curl_reset().
+ *
+ * @param host Host name
+ * @param addr IPv4 address, or NULL to remove the host
+ */
+void mock_curl_set_dns(const char *host, const char *addr);
+
+/**
+ * @brief Delay every getaddrinfo() answer (and the name lookup time reported
+ *        for transfers without a resolve entry) by delay_ms
+ */
+void mock_curl_set_dns_delay_ms(int delay_ms);
+
+/**
+ * @brief Get the number of getaddrinfo() calls since the last reset
+ */
+int mock_curl_get_dns_queries(void);
+
+/**
+ * @brief Get the CURLOPT_RESOLVE entry of the last performed request
+ *
+ * @return First entry of the list, or "" if none was set
+ */
+const char *mock_curl_get_last_resolve(void);
+
+/**
+ * @brief Stand-in server answering requests without a URL rule
+ *
+ * @return HTTP status code for the request
+ */
+typedef long (*mock_curl_server_fn)(const char *url, const uint8_t *body, size_t len,
+                                    void *user_data);
+
+/**
+ * @brief Hand every request without a URL rule to fn (NULL = default response)
+ *
+ * Cleared by mock_curl_reset().
+ */
+void mock_curl_set_server(mock_curl_server_fn fn, void *user_data);
+
+/**
+ * @brief Complete the most recently added multi transfers first
+ *
+ * Applies to curl_multi_perform without netem. Cleared by mock_curl_reset().
+ */
+void mock_curl_set_multi_newest_first(bool newest_first);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,195 @@
+/**
+ * @file mock_netem.c
+ * @brief Deterministic network emulation for the mock libcurl
+ */
+
+#include "mock_netem.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Timeout used for lost requests when the caller sets none */
+#define MOCK_NETEM_DEFAULT_TIMEOUT_MS   30000.0
+
+typedef struct {
+    bool active;
+    mock_netem_config_t config;
+    uint64_t rng;
+    double now_ms;
+    double link_free_ms;            /* When the uplink finishes queued bytes */
+    mock_netem_stats_t stats;
+
+    /* Durations of finished requests, for percentiles */
+    double *durations;
+    size_t duration_count;
+    size_t duration_capacity;
+} mock_netem_state_t;
+
+static mock_netem_state_t netem = {0};
+
+/* ============================================================================
+ * Random Numbers
+ * ========================================================================== */
+
+/* xorshift64*: fast, seedable, identical on every platform */
+static uint64_t netem_next(void) {
+    netem.rng ^= netem.rng >> 12;
+    netem.rng ^= netem.rng << 25;
+    netem.rng ^= netem.rng >> 27;
+    return netem.rng * 0x2545F4914F6CDD1Dull;
+}
+
+/* Uniform in (0, 1] */
+static double netem_uniform(void) {
+    return ((double)(netem_next() >> 11) + 1.0) / 9007199254740992.0;
+}
+
+static double netem_latency(void) {
+    const mock_netem_config_t *c = &netem.config;
+
+    switch (c->latency) {
+        case MOCK_NETEM_LATENCY_UNIFORM:
+            return fmax(0.0, c->latency_ms + (2.0 * netem_uniform() - 1.0) * c->jitter_ms);
+        case MOCK_NETEM_LATENCY_PARETO: {
+            double alpha = c->pareto_alpha > 0 ? c->pareto_alpha : 2.0;
+            return c->latency_ms / pow(netem_uniform(), 1.0 / alpha);
+        }
+        case MOCK_NETEM_LATENCY_CONSTANT:
+        default:
+            return c->latency_ms;
+    }
+}
+
+/* ============================================================================
+ * Emulation
+ * ========================================================================== */
+
+void mock_netem_enable(const mock_netem_config_t *config) {
+    free(netem.durations);
+    memset(&netem, 0, sizeof(netem));
+
+    if (config == NULL) {
+        return;
+    }
+
+    netem.active = true;
+    netem.config = *config;
+    netem.rng = config->seed ? config->seed : 0x9E3779B97F4A7C15ull;
+}
+
+bool mock_netem_active(void) {
+    return netem.active;
+}
+
+double mock_netem_now_ms(void) {
+    return netem.now_ms;
+}
+
+void mock_netem_advance(double ms) {
+    if (ms > 0) {
+        netem.now_ms += ms;
+    }
+}
+
+void mock_netem_schedule(size_t body_len, long timeout_ms, mock_netem_result_t *result) {
+    const mock_netem_config_t *c = &netem.config;
+    double timeout = timeout_ms > 0 ? (double)timeout_ms : MOCK_NETEM_DEFAULT_TIMEOUT_MS;
+
+    /* Draw every random value up front so outcomes never shift the sequence */
+    double latency = netem_latency();
+    double loss = netem_uniform();
+    double reset = netem_uniform();
+
+    result->start_ms = netem.now_ms;
+    result->result = CURLE_OK;
+    result->http_code = 202;
+
+    /* The body queues behind earlier transfers on the shared uplink */
+    double sent_ms = netem.now_ms;
+    if (c->bandwidth_bytes_per_sec > 0) {
+        double begin = fmax(netem.now_ms, netem.link_free_ms);
+        netem.link_free_ms = begin + (double)body_len * 1000.0 / c->bandwidth_bytes_per_sec;
+        sent_ms = netem.link_free_ms;
+    }
+    result->done_ms = sent_ms + latency;
+
+    if (loss < c->loss_rate) {
+        result->result = CURLE_OPERATION_TIMEDOUT;
+        result->http_code = 0;
+        result->done_ms = result->start_ms + timeout;
+    } else if (reset < c->reset_rate) {
+        result->result = CURLE_RECV_ERROR;
+        result->http_code = 0;
+    } else if (c->burst_status && c->burst_period_ms > 0 &&
+               fmod(sent_ms, c->burst_period_ms) < c->burst_duration_ms) {
+        result->http_code = c->burst_status;
+    }
+
+    /* Slow transfers hit the timeout too */
+    if (result->done_ms - result->start_ms > timeout) {
+        result->result = CURLE_OPERATION_TIMEDOUT;
+        result->http_code = 0;
+        result->done_ms = result->start_ms + timeout;
+    }
+}
+
+void mock_netem_complete(const mock_netem_result_t *result, size_t body_len) {
+    mock_netem_stats_t *s = &netem.stats;
+
+    if (result->done_ms > netem.now_ms) {
+        netem.now_ms = result->done_ms;
+    }
+
+    s->requests++;
+    if (result->result == CURLE_OPERATION_TIMEDOUT) {
+        s->timeouts++;
+    } else if (result->result != CURLE_OK) {
+        s->resets++;
+    } else if (result->http_code >= 200 && result->http_code < 300) {
+        s->succeeded++;
+        s->bytes_delivered += body_len;
+    } else {
+        s->burst_errors++;
+    }
+
+    if (netem.duration_count == netem.duration_capacity) {
+        size_t capacity = netem.duration_capacity ? netem.duration_capacity * 2 : 256;
+        double *grown = realloc(netem.durations, capacity * sizeof(double));
+        if (grown == NULL) {
+            return;
+        }
+        netem.durations = grown;
+        netem.duration_capacity = capacity;
+    }
+    netem.durations[netem.duration_count++] = result->done_ms - result->start_ms;
+}
+
+static int netem_compare(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+void mock_netem_get_stats(mock_netem_stats_t *stats) {
+    *stats = netem.stats;
+    stats->elapsed_ms = netem.now_ms;
+    if (netem.now_ms > 0) {
+        stats->throughput_bytes_per_sec = (double)stats->bytes_delivered * 1000.0 / netem.now_ms;
+    }
+
+    if (netem.duration_count == 0) {
+        return;
+    }
+
+    double *sorted = malloc(netem.duration_count * sizeof(double));
+    if (sorted == NULL) {
+        return;
+    }
+    memcpy(sorted, netem.durations, netem.duration_count * sizeof(double));
+    qsort(sorted, netem.duration_count, sizeof(double), netem_compare);
+
+    stats->p50_ms = sorted[(netem.duration_count - 1) / 2];
+    stats->p99_ms = sorted[(netem.duration_count - 1) * 99 / 100];
+    stats->max_ms = sorted[netem.duration_count - 1];
+    free(sorted);
+}
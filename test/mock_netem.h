@@ -0,0 +1,146 @@
+/**
+ * @file mock_netem.h
+ * @brief Deterministic network emulation for the mock libcurl
+ *
+ * When enabled, every request sent through the mock libcurl crosses an
+ * emulated link to the stand-in server: a seeded latency distribution, a
+ * shared bandwidth cap, random loss (the request times out), connection
+ * resets and periodic 429/5xx bursts. Time is virtual, so a run takes no
+ * wall-clock time and the same seed and request sequence always produce the
+ * same outcomes, latencies and throughput.
+ *
+ * Easy transfers complete immediately and advance the virtual clock by their
+ * duration. Multi transfers run concurrently: each curl_multi_perform()
+ * advances the clock to the next completion.
+ */
+
+#ifndef MOCK_NETEM_H
+#define MOCK_NETEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <curl/curl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Round-trip latency distribution
+ */
+typedef enum {
+    MOCK_NETEM_LATENCY_CONSTANT,    /* latency_ms */
+    MOCK_NETEM_LATENCY_UNIFORM,     /* latency_ms +/- jitter_ms */
+    MOCK_NETEM_LATENCY_PARETO,      /* latency_ms minimum, heavy tail of shape pareto_alpha */
+} mock_netem_latency_t;
+
+/**
+ * @brief Emulated link configuration
+ */
+typedef struct {
+    /** RNG seed; runs with the same seed are identical */
+    uint64_t seed;
+
+    /** Round-trip latency model */
+    mock_netem_latency_t latency;
+    double latency_ms;
+    double jitter_ms;
+    double pareto_alpha;
+
+    /** Uplink capacity in bytes per second, shared by all transfers (0 = unlimited) */
+    double bandwidth_bytes_per_sec;
+
+    /** Probability a request is lost and runs into its timeout */
+    double loss_rate;
+
+    /** Probability the connection is reset (CURLE_RECV_ERROR) */
+    double reset_rate;
+
+    /** Status returned during bursts (e.g. 429 or 503; 0 = no bursts) */
+    long burst_status;
+
+    /** Bursts cover [k * burst_period_ms, k * burst_period_ms + burst_duration_ms) */
+    double burst_period_ms;
+    double burst_duration_ms;
+} mock_netem_config_t;
+
+/**
+ * @brief Results of an emulated run
+ */
+typedef struct {
+    size_t requests;
+    size_t succeeded;
+    size_t timeouts;
+    size_t resets;
+    size_t burst_errors;
+
+    /** Request bytes that reached the server */
+    size_t bytes_delivered;
+
+    /** Virtual time since mock_netem_enable() */
+    double elapsed_ms;
+
+    /** Delivered bytes per virtual second */
+    double throughput_bytes_per_sec;
+
+    /** Request duration percentiles */
+    double p50_ms;
+    double p99_ms;
+    double max_ms;
+} mock_netem_stats_t;
+
+/**
+ * @brief Emulated outcome of one request
+ */
+typedef struct {
+    double start_ms;
+    double done_ms;
+    CURLcode result;
+    long http_code;
+} mock_netem_result_t;
+
+/**
+ * @brief Enable emulation (resetting clock, RNG and stats), or disable with NULL
+ */
+void mock_netem_enable(const mock_netem_config_t *config);
+
+/**
+ * @brief Whether emulation is enabled
+ */
+bool mock_netem_active(void);
+
+/**
+ * @brief Current virtual time in milliseconds
+ */
+double mock_netem_now_ms(void);
+
+/**
+ * @brief Advance virtual time (e.g. to model client-side waits)
+ */
+void mock_netem_advance(double ms);
+
+/**
+ * @brief Decide the outcome of a request starting now
+ *
+ * @param body_len Request body size
+ * @param timeout_ms Request timeout (0 = libcurl default of none; 30 s is used)
+ * @param result Pointer to receive the outcome
+ */
+void mock_netem_schedule(size_t body_len, long timeout_ms, mock_netem_result_t *result);
+
+/**
+ * @brief Record a finished request and move the clock to its completion
+ */
+void mock_netem_complete(const mock_netem_result_t *result, size_t body_len);
+
+/**
+ * @brief Get statistics for the run so far
+ */
+void mock_netem_get_stats(mock_netem_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MOCK_NETEM_H */
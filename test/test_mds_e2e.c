@@ -10,21 +10,25 @@
  * 1. Initialize library
  * 2. Open mock HID device
  * 3. Create MDS session
- * 4. Read device configuration
+ * 4. Read device configuration (single reports, then the combined report)
  * 5. Set up uploader with mock HTTP
  * 6. Enable streaming
  * 7. Process stream packets
  * 8. Upload chunks to mock cloud
  * 9. Verify upload statistics
- * 10. Clean shutdown
+ * 10. Drain packets through the background reader poll fd
+ * 11. Clean shutdown
  */
 
 #include "../src/memfault_hid_internal.h"
 #include "mds_bridge/mds_protocol.h"
 #include "mds_bridge/chunks_uploader.h"
+#include "mock_hidapi.h"
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <poll.h>
+#include <unistd.h>
 
 #define TEST_VID 0x1234
 #define TEST_PID 0x5678
@@ -51,6 +55,61 @@ static int test_assertions_failed = 0;
 #define TEST_SECTION(name) \
     printf("\n" COLOR_YELLOW "▸ %s" COLOR_RESET "\n", name)
 
+/* Backend for firmware without the combined report whose transfers take
+ * delay_ms[report_id] and, unlike hidapi feature reports, honour the read
+ * timeout. Records the timeout and start time of every read. */
+typedef struct {
+    unsigned int delay_ms[MDS_REPORT_ID_CONFIG + 1];
+    int timeouts_ms[8];
+    uint64_t started_ms[8];
+    size_t reads;
+} timed_backend_t;
+
+static int timed_backend_read(void *impl_data, uint8_t report_id, uint8_t *buffer,
+                              size_t length, int timeout_ms) {
+    timed_backend_t *timed = impl_data;
+    if (timed->reads < sizeof(timed->timeouts_ms) / sizeof(timed->timeouts_ms[0])) {
+        timed->timeouts_ms[timed->reads] = timeout_ms;
+        timed->started_ms[timed->reads] = mds_deadline_after(0);
+    }
+    timed->reads++;
+
+    if (report_id > MDS_REPORT_ID_CONFIG) {
+        return -EINVAL;
+    }
+    unsigned int delay_ms = timed->delay_ms[report_id];
+    if (report_id == MDS_REPORT_ID_CONFIG ||
+        (timeout_ms >= 0 && (unsigned int)timeout_ms < delay_ms)) {
+        usleep((useconds_t)timeout_ms * 1000u);
+        return -ETIMEDOUT;
+    }
+    usleep(delay_ms * 1000u);
+
+    const char *text = report_id == MDS_REPORT_ID_DEVICE_IDENTIFIER ? "TIMED-DEVICE" :
+                       report_id == MDS_REPORT_ID_DATA_URI ? "https://chunks.memfault.com/api/v0/chunks/TIMED" :
+                       "Memfault-Project-Key:timed";
+    if (report_id == MDS_REPORT_ID_SUPPORTED_FEATURES) {
+        memset(buffer, 0, length < 4 ? length : 4);
+        return 4;
+    }
+    size_t len = strlen(text) < length ? strlen(text) : length;
+    memcpy(buffer, text, len);
+    return (int)len;
+}
+
+static int timed_backend_write(void *impl_data, uint8_t report_id, const uint8_t *buffer,
+                               size_t length) {
+    (void)impl_data;
+    (void)report_id;
+    (void)buffer;
+    return (int)length;
+}
+
+static const mds_backend_ops_t timed_backend_ops = {
+    .read = timed_backend_read,
+    .write = timed_backend_write,
+};
+
 int main(void) {
     int ret;
     mds_session_t *session = NULL;
@@ -106,6 +165,97 @@ int main(void) {
         goto cleanup;
     }
 
+    TEST_SECTION("Negotiating the combined configuration report");
+    TEST_ASSERT(mock_hid_get_feature_reads() == 5,
+                "Older firmware: combined report refused, four single reports read");
+
+    mds_device_config_t combined;
+    int reads = mock_hid_get_feature_reads();
+    ret = mds_read_device_config(session, &combined);
+    TEST_ASSERT(ret == 0 && mock_hid_get_feature_reads() - reads == 4,
+                "Combined report not retried on this session");
+
+    /* Firmware update: the features bit brings the combined report back */
+    mock_hid_set_config_report(true);
+    reads = mock_hid_get_feature_reads();
+    mds_read_device_config(session, &combined);
+    TEST_ASSERT(mock_hid_get_feature_reads() - reads == 4 &&
+                (combined.supported_features & MDS_FEATURE_CONFIG_REPORT),
+                "Combined report advertised in supported features");
+    reads = mock_hid_get_feature_reads();
+    ret = mds_read_device_config(session, &combined);
+    TEST_ASSERT(ret == 0 && mock_hid_get_feature_reads() - reads == 1,
+                "Configuration read in one transfer");
+    TEST_ASSERT(strcmp(combined.device_identifier, config.device_identifier) == 0 &&
+                strcmp(combined.data_uri, config.data_uri) == 0 &&
+                strcmp(combined.authorization, config.authorization) == 0,
+                "Combined report matches the single reports");
+    mock_hid_set_config_report(false);
+
+    const uint8_t tlv[] = {0x01, 4, 0x01, 0, 0, 0,  0x02, 2, 'I', 'D',  0x7F, 1, 0xAA,
+                           0x03, 3, 'u', 'r', 'i',  0x04, 1, 'k',  0x00, 0x00};
+    ret = mds_parse_config_report(tlv, sizeof(tlv), &combined);
+    TEST_ASSERT(ret == 0 && strcmp(combined.device_identifier, "ID") == 0 &&
+                strcmp(combined.authorization, "k") == 0, "Unknown tags skipped");
+    TEST_ASSERT(mds_parse_config_report(tlv, 12, &combined) == -EINVAL &&
+                mds_parse_config_report(tlv, 9, &combined) == -EINVAL,
+                "Truncated or incomplete report rejected");
+
+    TEST_SECTION("Bounding configuration reads with a deadline");
+    /* A slow device: each transfer takes 30 ms and cannot be interrupted */
+    mock_hid_set_transfer_delay_us(30000);
+    reads = mock_hid_get_feature_reads();
+    ret = mds_read_device_config_deadline(session, &combined, mds_deadline_after(70));
+    printf("  Deadline 70 ms: returned %d after %d transfers\n", ret,
+           mock_hid_get_feature_reads() - reads);
+    TEST_ASSERT(ret == -ETIME, "Deadline miss reported as -ETIME");
+    /* Transfers start at 0, 30 and 60 ms at the latest; none after 70 ms */
+    TEST_ASSERT(mock_hid_get_feature_reads() - reads <= 3,
+                "No transfer started after the deadline");
+
+    reads = mock_hid_get_feature_reads();
+    char identifier[MDS_MAX_DEVICE_ID_LEN];
+    ret = mds_get_device_identifier_deadline(session, identifier, sizeof(identifier),
+                                             mds_deadline_after(0));
+    TEST_ASSERT(ret == -ETIME && mock_hid_get_feature_reads() == reads,
+                "Expired deadline fails without a transfer");
+    TEST_ASSERT(mds_stream_enable_deadline(session, mds_deadline_after(0)) == -ETIME,
+                "Stream control not sent after the deadline");
+
+    ret = mds_read_device_config_deadline(session, &combined, mds_deadline_after(2000));
+    TEST_ASSERT(ret == 0 && strcmp(combined.data_uri, config.data_uri) == 0,
+                "Configuration read within a generous deadline");
+    mock_hid_set_transfer_delay_us(0);
+
+    /* Required reads get all the time left; only the combined report gets a share */
+    timed_backend_t timed = {.delay_ms = {[MDS_REPORT_ID_SUPPORTED_FEATURES] = 80}};
+    mds_backend_t timed_backend = {.ops = &timed_backend_ops, .impl_data = &timed};
+    mds_session_t *timed_session = NULL;
+    mds_device_config_t timed_config;
+    ret = mds_session_create(&timed_backend, &timed_session);
+    TEST_ASSERT(ret == 0, "Session on a backend that honours read timeouts");
+    /* Compare each timeout with the time left when its read started, not
+     * with wall-clock windows that a loaded machine can blow through */
+    uint64_t deadline = mds_deadline_after(1000);
+    ret = mds_read_device_config_deadline(timed_session, &timed_config, deadline);
+    printf("  Read timeouts: combined %d ms, features %d ms\n",
+           timed.timeouts_ms[0], timed.timeouts_ms[1]);
+    TEST_ASSERT(ret == 0 && strcmp(timed_config.device_identifier, "TIMED-DEVICE") == 0,
+                "Slow first report read within the budget");
+    TEST_ASSERT(timed.reads == 5 && timed.timeouts_ms[0] > 0 && timed.timeouts_ms[0] <= 1000 / 5 &&
+                (int64_t)timed.timeouts_ms[1] >= (int64_t)(deadline - timed.started_ms[1]) &&
+                timed.timeouts_ms[1] > timed.timeouts_ms[0],
+                "Combined report capped to a fifth, features given the time left");
+
+    timed.reads = 0;
+    timed.delay_ms[MDS_REPORT_ID_SUPPORTED_FEATURES] = 2000;
+    deadline = mds_deadline_after(500);
+    ret = mds_read_device_config_deadline(timed_session, &timed_config, deadline);
+    TEST_ASSERT(ret == -ETIME && timed.reads == 1 &&
+                (int64_t)timed.timeouts_ms[0] >= (int64_t)(deadline - timed.started_ms[0]),
+                "Read still running at the deadline reported as -ETIME");
+    mds_session_destroy(timed_session);
+
     /* ========================================================================
      * Step 5: Set Up Uploader
      * ======================================================================== */
@@ -207,7 +357,86 @@ int main(void) {
     TEST_ASSERT(ret == 0, "Streaming disabled");
 
     /* ========================================================================
-     * Step 10: Cleanup
+     * Step 10: Background Reader (poll fd integration)
+     * ======================================================================== */
+    TEST_SECTION("Background reader with poll fd");
+
+    TEST_ASSERT(mds_session_get_poll_fd(session) == -ENOTCONN,
+                "No poll fd before reader starts");
+
+    ret = mds_session_start_reader(session, 16);
+    TEST_ASSERT(ret == 0, "Reader started");
+    TEST_ASSERT(mds_session_start_reader(session, 16) == -EALREADY,
+                "Second start rejected");
+
+    int poll_fd = mds_session_get_poll_fd(session);
+    TEST_ASSERT(poll_fd >= 0, "Poll fd available");
+
+    /* Control calls still work while the reader owns stream reads */
+    ret = mds_stream_enable(session);
+    TEST_ASSERT(ret == 0, "Streaming enabled with reader running");
+    TEST_ASSERT(mds_process_stream(session, &config, 0, NULL) == -EBUSY,
+                "Blocking read rejected while reader runs");
+
+    size_t pending_total = 0;
+    int upload_results[8];
+    for (int i = 0; i < 20 && pending_total < 3; i++) {
+        struct pollfd pfd = { .fd = poll_fd, .events = POLLIN };
+        if (poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+
+        size_t n = 0;
+        ret = mds_process_pending(session, &config, NULL, upload_results, 8, &n);
+        if (ret < 0) {
+            break;
+        }
+        for (size_t j = 0; j < n; j++) {
+            TEST_ASSERT(upload_results[j] == 0, "Pending packet uploaded");
+        }
+        pending_total += n;
+    }
+
+    printf("  Packets drained via poll fd: %zu\n", pending_total);
+    TEST_ASSERT(pending_total == 3, "All queued packets drained");
+
+    /* Drained and quiet: the fd must no longer be readable */
+    struct pollfd idle = { .fd = poll_fd, .events = POLLIN };
+    TEST_ASSERT(poll(&idle, 1, 0) == 0, "Poll fd clear once queue is empty");
+
+    /* Control calls must not queue behind the reader's blocking read: some
+     * run while a read is waiting (if serialized, none could) */
+    mock_hid_set_blocking_reads(true);
+    for (int i = 0; i < 2000 && mock_hid_get_reads_waiting() == 0; i++) {
+        usleep(1000);
+    }
+    uint32_t features = 0;
+    int overlapped = mock_hid_get_overlapped_feature_reads();
+    for (int i = 0; i < 10 && ret == 0; i++) {
+        ret = mds_get_supported_features(session, &features);
+    }
+    overlapped = mock_hid_get_overlapped_feature_reads() - overlapped;
+    mock_hid_set_blocking_reads(false);
+    printf("  10 control reads during reader polls: %d overlapped a read\n", overlapped);
+    TEST_ASSERT(ret == 0 && overlapped > 0, "Control calls not blocked by reader reads");
+
+    mds_reader_stats_t reader_stats;
+    ret = mds_session_get_reader_stats(session, &reader_stats);
+    TEST_ASSERT(ret == 0 && reader_stats.overflows == 0, "No reader overflows");
+
+    chunks_uploader_get_stats(uploader, &final_stats);
+    TEST_ASSERT(final_stats.chunks_uploaded == (size_t)chunks_processed + 3,
+                "Reader packets uploaded");
+
+    ret = mds_session_stop_reader(session);
+    TEST_ASSERT(ret == 0, "Reader stopped");
+    TEST_ASSERT(mds_session_get_poll_fd(session) == -ENOTCONN,
+                "Poll fd released after stop");
+
+    mds_stream_disable(session);
+
+    /* ========================================================================
+     * Step 11: Cleanup
      * ======================================================================== */
     TEST_SECTION("Cleanup");
 
@@ -7,10 +7,29 @@
 
 #include "mds_bridge/mds_protocol.h"
 #include "mds_bridge/chunks_uploader.h"
+#include "mds_bridge/mds_fanout.h"
+#include "mds_bridge/mds_archive.h"
+#include "mds_bridge/mds_backfill.h"
+#include "mds_bridge/mds_config.h"
+#include "mds_bridge/mds_sink.h"
+#include "mds_bridge/mds_pipeline.h"
+#include "mds_bridge/mds_workers.h"
+#include "mds_sink_internal.h"
+#include "chunks_uploader_internal.h"
 #include "mock_libcurl.h"
+#include "mock_netem.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 
 static int test_count = 0;
 static int test_passed = 0;
@@ -54,6 +73,428 @@ static int test_upload_callback(const char *uri, const char *auth_header,
     return data->last_result; /* Return configured result */
 }
 
+/* Processes records with the session's interned config while it is swapped */
+typedef struct {
+    mds_session_t *session;
+    int uploads;
+    int bad_uris;
+    int failures;
+    bool stop;
+} config_swap_t;
+
+static int config_swap_callback(const char *uri, const char *auth_header,
+                                const uint8_t *chunk_data, size_t chunk_len,
+                                void *user_data) {
+    config_swap_t *swap = (config_swap_t *)user_data;
+    (void)chunk_data;
+    (void)chunk_len;
+    usleep(10);  /* Widen the window for a swap to land mid-upload */
+    if (strncmp(uri, "https://swap.example.com/DEV-", 29) != 0 ||
+        strcmp(auth_header, "Memfault-Project-Key:swap") != 0) {
+        swap->bad_uris++;
+    }
+    __atomic_add_fetch(&swap->uploads, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static void *config_swap_thread(void *arg) {
+    config_swap_t *swap = (config_swap_t *)arg;
+    for (int i = 0; !__atomic_load_n(&swap->stop, __ATOMIC_ACQUIRE); i++) {
+        uint8_t record[] = {(uint8_t)(i & MDS_SEQUENCE_MASK), 's'};
+        int ret = mds_process_stream_from_bytes(swap->session, NULL, record, sizeof(record), NULL);
+        if (ret != 0 && ret != -EINVAL) {
+            swap->failures++;
+        }
+    }
+    return NULL;
+}
+
+/* Fan-out sink that blocks until released and records the first payload pointer */
+typedef struct {
+    bool released;                  /* Set and read with __atomic builtins */
+    const uint8_t *first_data;
+    int count;
+} slow_sink_data_t;
+
+static int slow_sink_callback(const char *uri, const char *auth_header,
+                              const uint8_t *chunk_data, size_t chunk_len,
+                              void *user_data) {
+    slow_sink_data_t *data = (slow_sink_data_t *)user_data;
+    while (!__atomic_load_n(&data->released, __ATOMIC_ACQUIRE)) {
+        usleep(1000);
+    }
+    if (data->count++ == 0) {
+        data->first_data = chunk_data;
+    }
+    (void)uri;
+    (void)auth_header;
+    (void)chunk_len;
+    return 0;
+}
+
+/* Fan-out sink that records the first payload pointer */
+static const uint8_t *fast_sink_first_data;
+
+static int fast_sink_callback(const char *uri, const char *auth_header,
+                              const uint8_t *chunk_data, size_t chunk_len,
+                              void *user_data) {
+    if (fast_sink_first_data == NULL) {
+        fast_sink_first_data = chunk_data;
+    }
+    return chunks_uploader_callback(uri, auth_header, chunk_data, chunk_len, user_data);
+}
+
+/* Sink output that takes at most `accept` chunks per call */
+typedef struct {
+    int accept;
+    int calls;
+} stuck_output_t;
+
+static int stuck_submit_batch(void *impl, const mds_sink_chunk_t *chunks, size_t count,
+                              int *results) {
+    stuck_output_t *out = (stuck_output_t *)impl;
+    out->calls++;
+    (void)chunks;
+    (void)results;
+    if (out->accept <= 0) {
+        return -EAGAIN;
+    }
+    return (size_t)out->accept < count ? out->accept : (int)count;
+}
+
+static const mds_sink_ops_t stuck_ops = {
+    .name = "stuck",
+    .submit_batch = stuck_submit_batch,
+};
+
+/* Sink output whose every call costs a fixed time, like one request */
+static int slow_submit_batch(void *impl, const mds_sink_chunk_t *chunks, size_t count,
+                             int *results) {
+    (void)chunks;
+    (void)results;
+    usleep(*(const unsigned *)impl);
+    return (int)count;
+}
+
+static const mds_sink_ops_t slow_ops = {
+    .name = "slow",
+    .submit_batch = slow_submit_batch,
+};
+
+/* Same cost, but per chunk: batching saves nothing */
+static const mds_sink_ops_t slow_per_chunk_ops = {
+    .name = "slow-per-chunk",
+    .submit_batch = slow_submit_batch,
+    .per_chunk = true,
+};
+
+/* Worker callback checking that each device is uploaded in order, by one worker at a time */
+#define ORDER_DEVICES 32
+
+typedef struct {
+    pthread_mutex_t lock;
+    int next_seq[ORDER_DEVICES];
+    int active[ORDER_DEVICES];
+    int violations;
+
+    /* While set, device 0's upload waits here, keeping its worker busy */
+    bool hold;
+    pthread_cond_t released;
+} order_check_t;
+
+static int order_check_callback(const char *uri, const char *auth_header,
+                                const uint8_t *chunk_data, size_t chunk_len, void *user_data) {
+    order_check_t *check = (order_check_t *)user_data;
+    int device = chunk_data[0];
+    int seq = chunk_data[1] | (chunk_data[2] << 8);
+    (void)uri;
+    (void)auth_header;
+    (void)chunk_len;
+
+    pthread_mutex_lock(&check->lock);
+    if (check->active[device]++ > 0 || check->next_seq[device] != seq) {
+        check->violations++;
+    }
+    check->next_seq[device] = seq + 1;
+    while (device == 0 && check->hold) {
+        pthread_cond_wait(&check->released, &check->lock);
+    }
+    pthread_mutex_unlock(&check->lock);
+
+    usleep(200);
+
+    pthread_mutex_lock(&check->lock);
+    check->active[device]--;
+    pthread_mutex_unlock(&check->lock);
+    return 0;
+}
+
+/* Wait up to 2 s for the uploader's background resolver to finish n lookups */
+static size_t wait_dns_lookups(chunks_uploader_t *uploader, size_t n) {
+    chunks_dns_stats_t stats = {0};
+    for (int i = 0; i < 2000; i++) {
+        chunks_uploader_get_dns_stats(uploader, &stats);
+        if (stats.lookups >= n) {
+            break;
+        }
+        usleep(1000);
+    }
+    return stats.lookups;
+}
+
+/* Pipeline filter passing chunks of at least *min_len bytes */
+static bool min_len_filter(const mds_sink_chunk_t *chunk, void *user_data) {
+    return chunk->len >= *(const size_t *)user_data;
+}
+
+/* Pipeline filter passing every chunk; counts chunks whose bytes are not all
+ * the low byte of their sequence number */
+static bool pattern_filter(const mds_sink_chunk_t *chunk, void *user_data) {
+    for (size_t i = 0; i < chunk->len; i++) {
+        if (chunk->data[i] != (uint8_t)chunk->sequence) {
+            (*(size_t *)user_data)++;
+            break;
+        }
+    }
+    return true;
+}
+
+/* Archive query callback collecting matches */
+typedef struct {
+    int count;
+    char last_device[64];
+    uint64_t last_timestamp;
+    uint8_t last_data[64];
+    size_t last_len;
+} archive_query_data_t;
+
+static int archive_query_callback(const char *device_id, uint64_t timestamp_us,
+                                  const uint8_t *data, size_t len, void *user_data) {
+    archive_query_data_t *q = (archive_query_data_t *)user_data;
+    q->count++;
+    strncpy(q->last_device, device_id, sizeof(q->last_device) - 1);
+    q->last_timestamp = timestamp_us;
+    q->last_len = len < sizeof(q->last_data) ? len : sizeof(q->last_data);
+    memcpy(q->last_data, data, q->last_len);
+    return 0;
+}
+
+/* Query callback that, on its first chunk, appends from another thread and
+ * waits (bounded) for the append to finish */
+typedef struct {
+    mds_archive_t *archive;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool started;
+    bool appended;
+    bool appended_during_query;
+} live_append_t;
+
+static void *live_append_thread(void *arg) {
+    live_append_t *live = (live_append_t *)arg;
+    const uint8_t chunk[8] = {0};
+    mds_archive_append(live->archive, "DEV-LIVE", 1700000000ull * 1000000ull, chunk, sizeof(chunk));
+    pthread_mutex_lock(&live->lock);
+    live->appended = true;
+    pthread_cond_signal(&live->cond);
+    pthread_mutex_unlock(&live->lock);
+    return NULL;
+}
+
+static int live_append_callback(const char *device_id, uint64_t timestamp_us,
+                                const uint8_t *data, size_t len, void *user_data) {
+    live_append_t *live = (live_append_t *)user_data;
+    (void)device_id;
+    (void)timestamp_us;
+    (void)data;
+    (void)len;
+    if (live->started) {
+        return 0;
+    }
+    live->started = pthread_create(&live->thread, NULL, live_append_thread, live) == 0;
+
+    struct timespec until;
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += 2;
+    pthread_mutex_lock(&live->lock);
+    while (live->started && !live->appended &&
+           pthread_cond_timedwait(&live->cond, &live->lock, &until) == 0) {
+    }
+    live->appended_during_query = live->appended;
+    pthread_mutex_unlock(&live->lock);
+    return 0;
+}
+
+/* Backfill progress callback; stops after max_requests completions */
+static int backfill_progress_callback(const mds_backfill_stats_t *stats, void *user_data) {
+    size_t max_requests = *(size_t *)user_data;
+    return (max_requests && stats->requests >= max_requests) ? 1 : 0;
+}
+
+/* Upload count 1 KiB chunks over the emulated link */
+static void run_emulated_uploads(const mock_netem_config_t *config, int count,
+                                 mock_netem_stats_t *stats) {
+    chunks_uploader_t *emulated = chunks_uploader_create();
+    chunks_uploader_set_timeout(emulated, 2000);
+    mock_curl_reset();
+    mock_netem_enable(config);
+
+    uint8_t chunk[1024];
+    for (int i = 0; i < count; i++) {
+        memset(chunk, i & 0xFF, sizeof(chunk));
+        chunks_uploader_callback("https://chunks.memfault.com/api/v0/chunks/NETEM",
+                                 "Memfault-Project-Key:test", chunk, sizeof(chunk), emulated);
+    }
+
+    mock_netem_get_stats(stats);
+    chunks_uploader_destroy(emulated);
+    mock_curl_reset();
+}
+
+/* Minimal host event loop: a watch list and one timer */
+typedef struct {
+    int fds[16];
+    int fd_count;
+    long timer_ms;
+    int socket_calls;
+    bool newest_first;      /* Complete the most recent transfers first */
+} event_loop_t;
+
+static int loop_socket_callback(int fd, int events, void *user_data) {
+    event_loop_t *loop = (event_loop_t *)user_data;
+    loop->socket_calls++;
+
+    for (int i = 0; i < loop->fd_count; i++) {
+        if (loop->fds[i] == fd) {
+            if (events == 0) {
+                loop->fds[i] = loop->fds[--loop->fd_count];
+            }
+            return 0;
+        }
+    }
+    if (events != 0 && loop->fd_count < 16) {
+        loop->fds[loop->fd_count++] = fd;
+    }
+    return 0;
+}
+
+static int loop_timer_callback(long timeout_ms, void *user_data) {
+    ((event_loop_t *)user_data)->timer_ms = timeout_ms;
+    return 0;
+}
+
+/* Dispatch timer and socket events until the uploader is idle */
+static void run_event_loop(chunks_uploader_t *u, event_loop_t *loop) {
+    for (int round = 0; round < 16 && chunks_uploader_pending(u) > 0; round++) {
+        if (loop->timer_ms >= 0) {
+            loop->timer_ms = -1;
+            chunks_uploader_on_timeout(u);
+        }
+        int ready[16];
+        int ready_count = loop->fd_count;
+        memcpy(ready, loop->fds, sizeof(ready));
+        for (int i = 0; i < ready_count; i++) {
+            int fd = ready[loop->newest_first ? ready_count - 1 - i : i];
+            chunks_uploader_on_socket(u, fd, CHUNKS_POLL_OUT);
+        }
+    }
+}
+
+/* Stand-in server: each device's chunks must arrive with consecutive sequence numbers */
+#define SEQ_DEVICES 4
+
+typedef struct {
+    int next_seq[SEQ_DEVICES];
+    int accepted;
+    int gaps;
+} seq_server_t;
+
+static long seq_server(const char *url, const uint8_t *body, size_t len, void *user_data) {
+    seq_server_t *server = (seq_server_t *)user_data;
+    int device = url[strlen(url) - 1] - '0';
+
+    if (len < 1 || device < 0 || device >= SEQ_DEVICES || body[0] != server->next_seq[device]) {
+        server->gaps++;
+        return 409;
+    }
+    server->next_seq[device]++;
+    server->accepted++;
+    return 202;
+}
+
+/* Stand-in backfill server: the first byte of each multipart part is that
+ * device's sequence number; the first `outage` requests fail with 503 */
+typedef struct {
+    seq_server_t seq;
+    int outage;
+} backfill_server_t;
+
+static long backfill_server(const char *url, const uint8_t *body, size_t len, void *user_data) {
+    backfill_server_t *server = (backfill_server_t *)user_data;
+    static const char part[] = "application/octet-stream\r\n\r\n";
+    int device = url[strlen(url) - 1] - '0';
+    int next = server->seq.next_seq[device];
+
+    if (server->outage > 0) {
+        server->outage--;
+        return 503;
+    }
+    for (size_t pos = 0; pos + sizeof(part) <= len; pos++) {
+        if (memcmp(body + pos, part, sizeof(part) - 1) != 0) {
+            continue;
+        }
+        if (body[pos + sizeof(part) - 1] != next) {
+            server->seq.gaps++;
+            return 409;
+        }
+        next++;
+    }
+    server->seq.next_seq[device] = next;
+    server->seq.accepted++;
+    return 202;
+}
+
+/* 50 devices across 5 project keys, one uploader per key, 3 chunks each */
+static int upload_device_fleet(chunks_uploader_t *per_key[5]) {
+    uint8_t chunk[32] = {0};
+    int failures = 0;
+
+    for (int round = 0; round < 3; round++) {
+        for (int device = 0; device < 50; device++) {
+            char uri[128];
+            char auth[64];
+            int key = device % 5;
+            snprintf(uri, sizeof(uri), "https://chunks.memfault.com/api/v0/chunks/FLEET-%02d", device);
+            snprintf(auth, sizeof(auth), "Memfault-Project-Key:project-%d", key);
+            chunk[0] = (uint8_t)round;
+            chunk[1] = (uint8_t)device;
+            if (chunks_uploader_callback(uri, auth, chunk, sizeof(chunk), per_key[key]) != 0) {
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+static void remove_directory(const char *path) {
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        char file[512];
+        snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+        unlink(file);
+    }
+    closedir(dir);
+    rmdir(path);
+}
+
 int main(void) {
     int ret;
 
@@ -213,6 +654,1663 @@ int main(void) {
     printf("  Total bytes: %zu\n", stats.bytes_uploaded);
     printf("  HTTP requests: %d\n", mock_curl_get_request_count());
 
+    /* Test 12: Batch Stream Processing */
+    TEST_START("Batch Stream Processing");
+
+    mds_session_t *session = NULL;
+    ret = mds_session_create(NULL, &session);
+    TEST_ASSERT(ret == 0, "Session created without backend");
+
+    mds_device_config_t batch_config = {0};
+    strncpy(batch_config.data_uri, test_uri, sizeof(batch_config.data_uri) - 1);
+    strncpy(batch_config.authorization, test_auth, sizeof(batch_config.authorization) - 1);
+
+    upload_data.upload_count = 0;
+    upload_data.last_result = 0;
+    mds_set_upload_callback(session, test_upload_callback, &upload_data);
+
+    /* Three records: seq 0 (3 bytes), seq 1 (1 byte), seq 2 (5 bytes) */
+    const uint8_t batch_buf[] = {
+        0x00, 0xA1, 0xA2, 0xA3,
+        0x01, 0xB1,
+        0x02, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5,
+    };
+    const size_t batch_lens[] = {4, 2, 6};
+    size_t processed = 0;
+
+    ret = mds_process_stream_batch(session, &batch_config, batch_buf, sizeof(batch_buf), batch_lens, 3, &processed);
+    TEST_ASSERT(ret == 0, "Batch processed successfully");
+    TEST_ASSERT(processed == 3, "All records processed");
+    TEST_ASSERT(upload_data.upload_count == 3, "Upload callback invoked per record");
+    TEST_ASSERT(upload_data.last_chunk_len == 5, "Last record length correct");
+
+    /* Upload failure stops the batch at the failing record */
+    upload_data.upload_count = 0;
+    upload_data.last_result = -5;
+    ret = mds_process_stream_batch(session, &batch_config, batch_buf, sizeof(batch_buf), batch_lens, 3, &processed);
+    TEST_ASSERT(ret == -5, "Batch returns upload error");
+    TEST_ASSERT(processed == 0, "No records reported as processed");
+    TEST_ASSERT(upload_data.upload_count == 1, "Batch stopped after first failure");
+
+    ret = mds_process_stream_batch(session, &batch_config, NULL, sizeof(batch_buf), batch_lens, 3, &processed);
+    TEST_ASSERT(ret < 0, "Rejects NULL buffer");
+
+    /* Lengths that run past the buffer are rejected before anything is sent */
+    upload_data.upload_count = 0;
+    upload_data.last_result = 0;
+    const size_t batch_long_lens[] = {4, 2, 7};
+    ret = mds_process_stream_batch(session, &batch_config, batch_buf, sizeof(batch_buf),
+                                   batch_long_lens, 3, &processed);
+    TEST_ASSERT(ret == -EINVAL && processed == 0 && upload_data.upload_count == 0,
+                "Rejects records past the end of the buffer");
+    const size_t batch_wrap_lens[] = {4, SIZE_MAX};
+    ret = mds_process_stream_batch(session, &batch_config, batch_buf, sizeof(batch_buf),
+                                   batch_wrap_lens, 2, &processed);
+    TEST_ASSERT(ret == -EINVAL && upload_data.upload_count == 0, "Rejects a wrapping length");
+
+    /* Test 13: Time-Series Recorder */
+    TEST_START("Time-Series Recorder");
+
+    mds_timeseries_bucket_t buckets[8];
+    size_t bucket_count = 0;
+
+    ret = mds_session_get_timeseries(session, buckets, 8, &bucket_count);
+    TEST_ASSERT(ret == -ENODATA, "No data before recorder is enabled");
+
+    ret = mds_session_enable_timeseries(session, 8);
+    TEST_ASSERT(ret == 0, "Recorder enabled");
+
+    upload_data.last_result = 0;
+    ret = mds_process_stream_batch(session, &batch_config, batch_buf, sizeof(batch_buf), batch_lens, 3, &processed);
+    TEST_ASSERT(ret == 0, "Batch recorded");
+
+    /* seq 2 -> seq 4 skips 3 */
+    const uint8_t gap_record[] = {0x04, 0xD1, 0xD2};
+    ret = mds_process_stream_from_bytes(session, &batch_config, gap_record, sizeof(gap_record), NULL);
+    TEST_ASSERT(ret == 0, "Out-of-sequence record processed");
+
+    ret = mds_session_get_timeseries(session, buckets, 8, &bucket_count);
+    TEST_ASSERT(ret == 0 && bucket_count >= 1, "Buckets retrieved");
+
+    /* The records may straddle a second boundary; sum every bucket */
+    uint32_t ts_packets = 0, ts_bytes = 0, ts_gaps = 0;
+    for (size_t i = 0; i < bucket_count; i++) {
+        ts_packets += buckets[i].packets;
+        ts_bytes += buckets[i].bytes;
+        ts_gaps += buckets[i].gaps;
+    }
+    TEST_ASSERT(ts_packets == 4, "Packets counted");
+    TEST_ASSERT(ts_bytes == 3 + 1 + 5 + 2, "Payload bytes counted");
+    TEST_ASSERT(ts_gaps == 1, "Sequence gap counted");
+
+    FILE *csv = tmpfile();
+    TEST_ASSERT(csv != NULL && mds_timeseries_dump_csv(session, csv) == 0, "CSV dumped");
+    if (csv) {
+        char header[128] = {0};
+        rewind(csv);
+        TEST_ASSERT(fgets(header, sizeof(header), csv) != NULL &&
+                    strcmp(header, "timestamp,packets,bytes,gaps,max_interarrival_us,read_stall_us\n") == 0,
+                    "CSV header correct");
+        fclose(csv);
+    }
+
+    FILE *json = tmpfile();
+    TEST_ASSERT(json != NULL && mds_timeseries_dump_json(session, json) == 0, "JSON dumped");
+    if (json) {
+        char line[256] = {0};
+        rewind(json);
+        TEST_ASSERT(fgets(line, sizeof(line), json) != NULL && line[0] == '[', "JSON array emitted");
+        fclose(json);
+    }
+
+    ret = mds_session_enable_timeseries(session, 0);
+    TEST_ASSERT(ret == 0, "Recorder disabled");
+
+    mds_session_destroy(session);
+
+    /* Test 14: Endpoint Failover */
+    TEST_START("Endpoint Failover");
+    mock_curl_reset();
+
+    const char *const origins[] = {"https://a.example.com", "https://b.example.com"};
+    const char *failover_uri = "https://A.example.com/api/v0/chunks/DEVICE";
+    const uint8_t failover_chunk[] = {0x01, 0x02, 0x03};
+    chunks_upload_stats_t failover_stats;
+
+    ret = chunks_uploader_set_endpoints(uploader, origins, 2);
+    TEST_ASSERT(ret == 0, "Endpoints configured");
+    ret = chunks_uploader_set_endpoints(uploader, origins, CHUNKS_MAX_ENDPOINTS + 1);
+    TEST_ASSERT(ret == -EINVAL, "Too many endpoints rejected");
+    chunks_uploader_set_probe_interval(uploader, 100);
+    chunks_uploader_reset_stats(uploader);
+
+    /* Primary times out, secondary is healthy */
+    mock_curl_set_url_response("https://a.example.com", 0, CURLE_OPERATION_TIMEDOUT, 0.1);
+    mock_curl_set_url_response("https://b.example.com", 202, CURLE_OK, 0.08);
+
+    ret = chunks_uploader_callback(failover_uri, "Memfault-Project-Key:test",
+                                   failover_chunk, sizeof(failover_chunk), uploader);
+    TEST_ASSERT(ret == 0, "Upload succeeds via secondary");
+    TEST_ASSERT(strcmp(mock_curl_get_last_url(), "https://b.example.com/api/v0/chunks/DEVICE") == 0,
+                "Path preserved on secondary");
+    chunks_uploader_get_stats(uploader, &failover_stats);
+    TEST_ASSERT(failover_stats.failovers == 1 && failover_stats.upload_failures == 0,
+                "Failover counted");
+
+    ret = chunks_uploader_callback(failover_uri, "Memfault-Project-Key:test",
+                                   failover_chunk, sizeof(failover_chunk), uploader);
+    TEST_ASSERT(ret == 0 && mock_curl_get_url_request_count("https://a.example.com") == 1,
+                "Failing primary skipped while backing off");
+
+    /* Primary recovers and is faster; probing brings traffic back */
+    mock_curl_set_url_response("https://a.example.com", 202, CURLE_OK, 0.05);
+    usleep(150000);
+    chunks_uploader_set_probe_interval(uploader, 0);
+    for (int i = 0; i < 10; i++) {
+        chunks_uploader_callback(failover_uri, "Memfault-Project-Key:test",
+                                 failover_chunk, sizeof(failover_chunk), uploader);
+    }
+    TEST_ASSERT(strncmp(mock_curl_get_last_url(), "https://a.example.com/", 22) == 0,
+                "Traffic returned to primary");
+
+    chunks_endpoint_stats_t endpoint_stats[CHUNKS_MAX_ENDPOINTS];
+    size_t endpoint_count = 0;
+    ret = chunks_uploader_get_endpoint_stats(uploader, "https://a.example.com",
+                                             endpoint_stats, CHUNKS_MAX_ENDPOINTS,
+                                             &endpoint_count);
+    TEST_ASSERT(ret == 0 && endpoint_count == 2, "Endpoint stats retrieved");
+    TEST_ASSERT(endpoint_stats[0].primary && endpoint_stats[0].failures == 1,
+                "Primary failure recorded");
+    TEST_ASSERT(endpoint_stats[0].share > 0.5 && endpoint_stats[1].requests == 2,
+                "Primary carries most traffic");
+    ret = chunks_uploader_get_endpoint_stats(uploader, "https://c.example.com",
+                                             endpoint_stats, CHUNKS_MAX_ENDPOINTS,
+                                             &endpoint_count);
+    TEST_ASSERT(ret == -ENOENT, "Unknown group rejected");
+
+    /* Client errors are not the endpoint's fault and do not fail over */
+    mock_curl_set_url_response("https://a.example.com", 400, CURLE_OK, 0.05);
+    ret = chunks_uploader_callback(failover_uri, "Memfault-Project-Key:test",
+                                   failover_chunk, sizeof(failover_chunk), uploader);
+    TEST_ASSERT(ret == -EIO && mock_curl_get_url_request_count("https://b.example.com") == 2,
+                "4xx returned without failover");
+
+    /* Test 15: Fan-Out Sinks */
+    TEST_START("Fan-Out Sinks");
+    mock_curl_reset();
+    chunks_uploader_reset_stats(uploader);
+
+    mds_fanout_t *fanout = mds_fanout_create();
+    TEST_ASSERT(fanout != NULL, "Fan-out created");
+
+    slow_sink_data_t slow = {0};
+    int cloud_sink = mds_fanout_add_sink(fanout, fast_sink_callback, uploader, 0);
+    int archive_sink = mds_fanout_add_sink(fanout, slow_sink_callback, &slow, 2);
+    TEST_ASSERT(cloud_sink == 0 && archive_sink == 1, "Sinks added");
+
+    const uint8_t fanout_chunk[] = {0xF0, 0xF1, 0xF2, 0xF3};
+    for (int i = 0; i < 5; i++) {
+        ret = mds_fanout_callback("https://chunks.memfault.com/api/v0/chunks/DEV",
+                                  "Memfault-Project-Key:test",
+                                  fanout_chunk, sizeof(fanout_chunk), fanout);
+        TEST_ASSERT(ret == 0, "Chunk fanned out");
+    }
+    TEST_ASSERT(mds_fanout_add_sink(fanout, slow_sink_callback, &slow, 0) == -EBUSY,
+                "Sinks cannot be added after delivery starts");
+
+    /* The blocked archive sink must not hold up the cloud sink */
+    mds_fanout_sink_stats_t sink_stats = {0};
+    for (int i = 0; i < 5000 && sink_stats.delivered < 5; i++) {
+        usleep(1000);
+        mds_fanout_get_sink_stats(fanout, cloud_sink, &sink_stats);
+    }
+    TEST_ASSERT(sink_stats.delivered == 5 && sink_stats.bytes_delivered == 5 * sizeof(fanout_chunk),
+                "Cloud sink delivered while archive is blocked");
+    TEST_ASSERT(mock_curl_get_request_count() == 5, "Five uploads performed");
+
+    mds_fanout_get_sink_stats(fanout, archive_sink, &sink_stats);
+    TEST_ASSERT(sink_stats.dropped >= 2 && sink_stats.max_queued <= 2,
+                "Full archive queue drops instead of blocking");
+
+    __atomic_store_n(&slow.released, true, __ATOMIC_RELEASE);
+    TEST_ASSERT(mds_fanout_flush(fanout, 2000) == 0, "Fan-out flushed");
+    mds_fanout_get_sink_stats(fanout, archive_sink, &sink_stats);
+    TEST_ASSERT(sink_stats.delivered + sink_stats.dropped == 5 && sink_stats.queued == 0,
+                "Archive sink accounted for every chunk");
+    TEST_ASSERT(slow.first_data == fast_sink_first_data, "Sinks share one payload buffer");
+
+    mds_fanout_destroy(fanout);
+
+    /* Test 16: Chunk Archive */
+    TEST_START("Chunk Archive");
+
+    char archive_dir[] = "/tmp/mds_archive_XXXXXX";
+    TEST_ASSERT(mkdtemp(archive_dir) != NULL, "Archive directory created");
+
+    mds_archive_config_t archive_config = {
+        .block_size = 256,
+    };
+    char long_dir[600];
+    memset(long_dir, 'a', sizeof(long_dir) - 1);
+    long_dir[0] = '/';
+    long_dir[sizeof(long_dir) - 1] = '\0';
+    errno = 0;
+    TEST_ASSERT(mds_archive_open(long_dir, &archive_config) == NULL && errno == ENAMETOOLONG,
+                "Directory too long for segment names rejected");
+
+    mds_archive_t *archive = mds_archive_open(archive_dir, &archive_config);
+    TEST_ASSERT(archive != NULL, "Archive opened");
+
+    /* Two devices interleaved, 1 ms apart, compressible payloads */
+    const uint64_t archive_base_us = 1700000000ull * 1000000ull;
+    uint8_t archive_chunk[32];
+    int append_errors = 0;
+    for (int i = 0; i < 20; i++) {
+        memset(archive_chunk, 0xA0 + (i % 2), sizeof(archive_chunk));
+        archive_chunk[0] = (uint8_t)i;
+        if (mds_archive_append(archive, (i % 2) ? "DEV-B" : "DEV-A",
+                               archive_base_us + (uint64_t)i * 1000,
+                               archive_chunk, sizeof(archive_chunk)) != 0) {
+            append_errors++;
+        }
+    }
+    TEST_ASSERT(append_errors == 0, "Chunks appended");
+
+    ret = mds_archive_callback("https://chunks.memfault.com/api/v0/chunks/DEV-C",
+                               "Memfault-Project-Key:test",
+                               archive_chunk, sizeof(archive_chunk), archive);
+    TEST_ASSERT(ret == 0, "Chunk archived through upload callback");
+
+    archive_query_data_t query = {0};
+    ret = mds_archive_query(archive, "DEV-A", archive_base_us, archive_base_us + 20000,
+                            archive_query_callback, &query);
+    TEST_ASSERT(ret == 10 && query.count == 10, "Device query returns only its chunks");
+    TEST_ASSERT(strcmp(query.last_device, "DEV-A") == 0 && query.last_data[0] == 18 &&
+                query.last_len == sizeof(archive_chunk), "Chunk content preserved");
+
+    memset(&query, 0, sizeof(query));
+    ret = mds_archive_query(archive, "DEV-A", archive_base_us + 4000, archive_base_us + 8000,
+                            archive_query_callback, &query);
+    TEST_ASSERT(ret == 3, "Time range query");
+
+    memset(&query, 0, sizeof(query));
+    ret = mds_archive_query(archive, NULL, 0, UINT64_MAX, archive_query_callback, &query);
+    TEST_ASSERT(ret == 21 && strcmp(query.last_device, "DEV-C") == 0,
+                "All-device query spans segments");
+
+    /* Appends are not held up by a query still in its callback */
+    live_append_t live = {.archive = archive};
+    pthread_mutex_init(&live.lock, NULL);
+    pthread_cond_init(&live.cond, NULL);
+    ret = mds_archive_query(archive, "DEV-A", 0, UINT64_MAX, live_append_callback, &live);
+    if (live.started) {
+        pthread_join(live.thread, NULL);
+    }
+    pthread_cond_destroy(&live.cond);
+    pthread_mutex_destroy(&live.lock);
+    TEST_ASSERT(ret == 10 && live.appended_during_query, "Append completes during a query");
+
+    mds_archive_stats_t archive_stats;
+    mds_archive_get_stats(archive, &archive_stats);
+    TEST_ASSERT(archive_stats.chunks == 22 && archive_stats.blocks >= 4,
+                "Chunks packed into several blocks");
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+    TEST_ASSERT(archive_stats.stored_bytes < archive_stats.raw_bytes, "Blocks compressed");
+
+    /* Raw-content dictionary: new blocks use it, old blocks stay readable */
+    uint8_t dictionary[256];
+    memset(dictionary, 0xA0, sizeof(dictionary));
+    ret = mds_archive_set_dictionary(archive, dictionary, sizeof(dictionary));
+    TEST_ASSERT(ret == 0, "Dictionary loaded");
+    mds_archive_append(archive, "DEV-A", archive_base_us + 30000,
+                       archive_chunk, sizeof(archive_chunk));
+    memset(&query, 0, sizeof(query));
+    ret = mds_archive_query(archive, "DEV-A", archive_base_us, archive_base_us + 30000,
+                            archive_query_callback, &query);
+    TEST_ASSERT(ret == 11 && query.last_timestamp == archive_base_us + 30000,
+                "Dictionary-compressed block readable");
+
+    /* Retraining keeps blocks of the earlier dictionary readable */
+    uint8_t retrained[256];
+    memset(retrained, 0xA1, sizeof(retrained));
+    ret = mds_archive_set_dictionary(archive, retrained, sizeof(retrained));
+    mds_archive_append(archive, "DEV-A", archive_base_us + 31000,
+                       archive_chunk, sizeof(archive_chunk));
+    memset(&query, 0, sizeof(query));
+    ret = ret == 0 ? mds_archive_query(archive, "DEV-A", archive_base_us, archive_base_us + 31000,
+                                       archive_query_callback, &query) : ret;
+    TEST_ASSERT(ret == 12 && query.last_timestamp == archive_base_us + 31000,
+                "Blocks of both dictionaries readable");
+    mds_archive_close(archive);
+#else
+    uint8_t dictionary[16] = {0};
+    ret = mds_archive_set_dictionary(archive, dictionary, sizeof(dictionary));
+    TEST_ASSERT(ret == -ENOTSUP, "Dictionaries need zstd");
+    mds_archive_close(archive);
+#endif
+
+    /* Reopen: index and segments persist */
+    archive = mds_archive_open(archive_dir, &archive_config);
+    memset(&query, 0, sizeof(query));
+    ret = mds_archive_query(archive, "DEV-B", 0, UINT64_MAX, archive_query_callback, &query);
+    TEST_ASSERT(ret == 10, "Archive readable after reopen");
+#ifdef MDS_BRIDGE_HAVE_ZSTD
+    memset(&query, 0, sizeof(query));
+    ret = mds_archive_query(archive, "DEV-A", 0, UINT64_MAX, archive_query_callback, &query);
+    TEST_ASSERT(ret == 12, "Dictionaries loaded from the archive after reopen");
+#endif
+    mds_archive_close(archive);
+
+    /* A full disk mid-block: the retry must land where the index expects it */
+    char full_dir[] = "/tmp/mds_archive_full_XXXXXX";
+    TEST_ASSERT(mkdtemp(full_dir) != NULL, "Disk-full archive created");
+    archive = mds_archive_open(full_dir, &archive_config);
+    mds_archive_append(archive, "DEV-F", archive_base_us, archive_chunk, sizeof(archive_chunk));
+    mds_archive_flush(archive);
+
+    off_t seg_size = 0;
+    DIR *full_listing = opendir(full_dir);
+    struct dirent *full_entry;
+    while (full_listing && (full_entry = readdir(full_listing)) != NULL) {
+        char full_path[600];
+        struct stat st;
+        snprintf(full_path, sizeof(full_path), "%s/%s", full_dir, full_entry->d_name);
+        if (strstr(full_entry->d_name, ".seg") && stat(full_path, &st) == 0) {
+            seg_size = st.st_size;
+        }
+    }
+    if (full_listing) {
+        closedir(full_listing);
+    }
+
+    /* Room for a block header but not its payload */
+    struct rlimit fsize_limit, saved_limit;
+    getrlimit(RLIMIT_FSIZE, &saved_limit);
+    fsize_limit = saved_limit;
+    fsize_limit.rlim_cur = (rlim_t)seg_size + 32;
+    void (*saved_xfsz)(int) = signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &fsize_limit);
+    uint8_t incompressible[200];
+    for (size_t i = 0; i < sizeof(incompressible); i++) {
+        incompressible[i] = (uint8_t)(i * 131 + 17);
+    }
+    mds_archive_append(archive, "DEV-F", archive_base_us + 1000, incompressible,
+                       sizeof(incompressible));
+    int full_ret = mds_archive_flush(archive);
+    setrlimit(RLIMIT_FSIZE, &saved_limit);
+    signal(SIGXFSZ, saved_xfsz);
+    TEST_ASSERT(full_ret < 0, "Flush fails on a full disk");
+
+    TEST_ASSERT(mds_archive_flush(archive) == 0, "Flush retried once space is back");
+    memset(&query, 0, sizeof(query));
+    ret = mds_archive_query(archive, "DEV-F", 0, UINT64_MAX, archive_query_callback, &query);
+    TEST_ASSERT(ret == 2 && memcmp(query.last_data, incompressible, sizeof(query.last_data)) == 0,
+                "Archive consistent after a failed flush");
+
+    /* A damaged block is skipped; the rest of the query still runs */
+    full_listing = opendir(full_dir);
+    while (full_listing && (full_entry = readdir(full_listing)) != NULL) {
+        char full_path[600];
+        snprintf(full_path, sizeof(full_path), "%s/%s", full_dir, full_entry->d_name);
+        FILE *seg_file = strstr(full_entry->d_name, ".seg") ? fopen(full_path, "r+b") : NULL;
+        if (seg_file) {
+            fputs("XXXX", seg_file);
+            fclose(seg_file);
+        }
+    }
+    if (full_listing) {
+        closedir(full_listing);
+    }
+    memset(&query, 0, sizeof(query));
+    ret = mds_archive_query(archive, "DEV-F", 0, UINT64_MAX, archive_query_callback, &query);
+    mds_archive_get_stats(archive, &archive_stats);
+    TEST_ASSERT(ret == 1 && query.last_timestamp == archive_base_us + 1000 &&
+                archive_stats.blocks_skipped == 1, "Damaged block skipped and counted");
+    mds_archive_close(archive);
+    remove_directory(full_dir);
+
+    /* Test 17: Backfill */
+    TEST_START("Backfill");
+
+    archive = mds_archive_open(archive_dir, &archive_config);
+    TEST_ASSERT(archive != NULL, "Archive reopened for backfill");
+    int backfill_errors = 0;
+    for (int i = 0; i < 40; i++) {
+        memset(archive_chunk, 0xB0, sizeof(archive_chunk));
+        archive_chunk[0] = (uint8_t)i;
+        if (mds_archive_append(archive, (i % 2) ? "BF-B" : "BF-A",
+                               archive_base_us + 100000 + (uint64_t)i * 1000,
+                               archive_chunk, sizeof(archive_chunk)) != 0) {
+            backfill_errors++;
+        }
+    }
+    TEST_ASSERT(backfill_errors == 0, "Backfill chunks archived");
+
+    /* Backfill covers the chunks from test 16 as well */
+    memset(&query, 0, sizeof(query));
+    const int archived_total = mds_archive_query(archive, NULL, 0, UINT64_MAX,
+                                                 archive_query_callback, &query);
+    mock_curl_reset();
+    mock_curl_set_url_response(MDS_BACKFILL_DEFAULT_URI_BASE "BF-A", 200, CURLE_OK, 0.0);
+    mds_backfill_config_t backfill_config = {
+        .auth_header = "Memfault-Project-Key:test",
+        .max_parallel = 4,
+        .max_batch_bytes = 64,
+    };
+    mds_backfill_stats_t first_run, second_run, third_run;
+    /* A device's batches go one at a time, so a block takes a few requests */
+    size_t stop_after = 4;
+    ret = mds_backfill_run(archive, &backfill_config, backfill_progress_callback,
+                           &stop_after, &first_run);
+    TEST_ASSERT(ret == -ECANCELED, "Backfill stopped by progress callback");
+    TEST_ASSERT(first_run.blocks_completed >= 1, "Checkpoint advanced");
+    TEST_ASSERT(mock_curl_get_max_in_flight() > 1, "Requests issued in parallel");
+
+    stop_after = 0;
+    ret = mds_backfill_run(archive, &backfill_config, backfill_progress_callback,
+                           &stop_after, &second_run);
+    TEST_ASSERT(ret == 0, "Backfill resumed and drained");
+    TEST_ASSERT(second_run.chunks_uploaded < (size_t)archived_total &&
+                first_run.chunks_uploaded + second_run.chunks_uploaded >= (size_t)archived_total,
+                "Resume skips acknowledged blocks without losing chunks");
+
+    size_t body_len = 0;
+    const uint8_t *body = mock_curl_get_last_data(&body_len);
+    TEST_ASSERT(body != NULL && body_len > 15 && memcmp(body, "--mds-backfill-", 15) == 0,
+                "Batch sent as multipart body");
+    TEST_ASSERT(mock_curl_get_url_request_count(MDS_BACKFILL_DEFAULT_URI_BASE "BF-A") > 0,
+                "Batch posted to device URL");
+
+    ret = mds_backfill_run(archive, &backfill_config, NULL, NULL, &third_run);
+    TEST_ASSERT(ret == 0 && third_run.chunks_uploaded == 0, "Nothing left after drain");
+
+    /* Persistent throttling gives up after max_retries attempts */
+    char checkpoint_path[512];
+    snprintf(checkpoint_path, sizeof(checkpoint_path), "%s/throttled.checkpoint", archive_dir);
+    mock_curl_reset();
+    mock_curl_set_response(429, CURLE_OK);
+    backfill_config.checkpoint_path = checkpoint_path;
+    backfill_config.max_parallel = 1;
+    backfill_config.max_retries = 2;
+    ret = mds_backfill_run(archive, &backfill_config, NULL, NULL, &third_run);
+    TEST_ASSERT(ret == -EIO && third_run.retries >= 1 && third_run.chunks_uploaded == 0,
+                "Backfill fails after retries");
+    mock_curl_reset();
+
+    mds_archive_close(archive);
+    remove_directory(archive_dir);
+
+    /* Transfers finish newest first and the first ones fail: a device's
+     * batches must still reach the server in order */
+    char order_dir[] = "/tmp/mds_backfill_XXXXXX";
+    TEST_ASSERT(mkdtemp(order_dir) != NULL, "Backfill order archive created");
+    archive = mds_archive_open(order_dir, &archive_config);
+    for (int i = 0; i < 24; i++) {
+        memset(archive_chunk, 0xC0, sizeof(archive_chunk));
+        archive_chunk[0] = (uint8_t)(i / 2);
+        mds_archive_append(archive, (i % 2) ? "BO-1" : "BO-0",
+                           archive_base_us + (uint64_t)i * 1000, archive_chunk, sizeof(archive_chunk));
+    }
+    backfill_server_t bf_server;
+    memset(&bf_server, 0, sizeof(bf_server));
+    bf_server.outage = 2;
+    mock_curl_reset();
+    mock_curl_set_server(backfill_server, &bf_server);
+    mock_curl_set_multi_newest_first(true);
+    backfill_config.checkpoint_path = NULL;
+    backfill_config.max_parallel = 4;
+    backfill_config.max_retries = 5;
+    ret = mds_backfill_run(archive, &backfill_config, NULL, NULL, &third_run);
+    TEST_ASSERT(ret == 0 && third_run.retries >= 1 && third_run.chunks_uploaded == 24 &&
+                bf_server.seq.gaps == 0 && bf_server.seq.next_seq[0] == 12 &&
+                bf_server.seq.next_seq[1] == 12, "Backfill keeps each device's batches in order");
+    mock_curl_reset();
+    mds_archive_close(archive);
+    remove_directory(order_dir);
+
+    /* Test 18: Dedup Window */
+    TEST_START("Dedup Window");
+
+    char dedup_path[] = "/tmp/mds_dedup_XXXXXX";
+    int dedup_fd = mkstemp(dedup_path);
+    TEST_ASSERT(dedup_fd >= 0, "Window file created");
+    close(dedup_fd);
+
+    chunks_uploader_t *dedup_uploader = chunks_uploader_create();
+    ret = chunks_uploader_enable_dedup(dedup_uploader, 64, dedup_path);
+    TEST_ASSERT(ret == 0, "Dedup enabled");
+
+    const char *dedup_uri = "https://chunks.memfault.com/api/v0/chunks/DEDUP-1";
+    const uint8_t dedup_chunk_a[] = {0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0x90};
+    const uint8_t dedup_chunk_b[] = {0x11, 0x22, 0x33};
+    chunks_upload_stats_t dedup_stats;
+
+    mock_curl_reset();
+    mock_curl_set_response(202, CURLE_OK);
+    chunks_uploader_callback(dedup_uri, "Memfault-Project-Key:test",
+                             dedup_chunk_a, sizeof(dedup_chunk_a), dedup_uploader);
+    ret = chunks_uploader_callback(dedup_uri, "Memfault-Project-Key:test",
+                                   dedup_chunk_a, sizeof(dedup_chunk_a), dedup_uploader);
+    chunks_uploader_get_stats(dedup_uploader, &dedup_stats);
+    TEST_ASSERT(ret == 0 && mock_curl_get_request_count() == 1 &&
+                dedup_stats.duplicates_suppressed == 1, "Acknowledged chunk not re-sent");
+
+    chunks_uploader_callback("https://chunks.memfault.com/api/v0/chunks/DEDUP-2",
+                             "Memfault-Project-Key:test",
+                             dedup_chunk_a, sizeof(dedup_chunk_a), dedup_uploader);
+    TEST_ASSERT(mock_curl_get_request_count() == 2, "Same payload from another device sent");
+
+    /* Lost response: the replay is sent and flagged */
+    mock_curl_set_response(0, CURLE_OPERATION_TIMEDOUT);
+    ret = chunks_uploader_callback(dedup_uri, "Memfault-Project-Key:test",
+                                   dedup_chunk_b, sizeof(dedup_chunk_b), dedup_uploader);
+    TEST_ASSERT(ret == -EIO, "Timed-out upload fails");
+    mock_curl_set_response(202, CURLE_OK);
+    ret = chunks_uploader_callback(dedup_uri, "Memfault-Project-Key:test",
+                                   dedup_chunk_b, sizeof(dedup_chunk_b), dedup_uploader);
+    chunks_uploader_get_stats(dedup_uploader, &dedup_stats);
+    TEST_ASSERT(ret == 0 && mock_curl_get_request_count() == 4 &&
+                dedup_stats.ambiguous_replays == 1, "Ambiguous replay sent and flagged");
+    chunks_uploader_destroy(dedup_uploader);
+
+    /* Window survives a restart */
+    dedup_uploader = chunks_uploader_create();
+    chunks_uploader_enable_dedup(dedup_uploader, 64, dedup_path);
+    chunks_uploader_callback(dedup_uri, "Memfault-Project-Key:test",
+                             dedup_chunk_b, sizeof(dedup_chunk_b), dedup_uploader);
+    chunks_uploader_get_stats(dedup_uploader, &dedup_stats);
+    TEST_ASSERT(mock_curl_get_request_count() == 4 && dedup_stats.duplicates_suppressed == 1,
+                "Persisted window suppresses duplicate");
+
+    /* Primary times out (may have stored it), alternate rejects: still flagged */
+    const char *const dedup_origins[] = {"https://a.example.com", "https://b.example.com"};
+    const char *dedup_failover_uri = "https://a.example.com/api/v0/chunks/DEDUP-3";
+    chunks_uploader_set_endpoints(dedup_uploader, dedup_origins, 2);
+    mock_curl_set_url_response("https://a.example.com", 0, CURLE_OPERATION_TIMEDOUT, 0.1);
+    mock_curl_set_url_response("https://b.example.com", 400, CURLE_OK, 0.01);
+    ret = chunks_uploader_callback(dedup_failover_uri, "Memfault-Project-Key:test",
+                                   dedup_chunk_b, sizeof(dedup_chunk_b), dedup_uploader);
+    TEST_ASSERT(ret == -EIO, "Failed over upload rejected by the alternate");
+    mock_curl_set_url_response("https://b.example.com", 202, CURLE_OK, 0.01);
+    ret = chunks_uploader_callback(dedup_failover_uri, "Memfault-Project-Key:test",
+                                   dedup_chunk_b, sizeof(dedup_chunk_b), dedup_uploader);
+    chunks_uploader_get_stats(dedup_uploader, &dedup_stats);
+    TEST_ASSERT(ret == 0 && dedup_stats.ambiguous_replays == 1,
+                "Replay flagged when any attempt timed out");
+
+    /* Bounded memory: old entries are evicted */
+    uint8_t dedup_chunk[8] = {0};
+    for (int i = 0; i < 1000; i++) {
+        memcpy(dedup_chunk, &i, sizeof(i));
+        chunks_uploader_callback(dedup_uri, "Memfault-Project-Key:test",
+                                 dedup_chunk, sizeof(dedup_chunk), dedup_uploader);
+    }
+    int sent_before = mock_curl_get_request_count();
+    chunks_uploader_callback(dedup_uri, "Memfault-Project-Key:test",
+                             dedup_chunk_a, sizeof(dedup_chunk_a), dedup_uploader);
+    TEST_ASSERT(mock_curl_get_request_count() == sent_before + 1, "Old entries evicted");
+    chunks_uploader_destroy(dedup_uploader);
+    unlink(dedup_path);
+    mock_curl_reset();
+
+    /* Test 19: Network Emulation */
+    TEST_START("Network Emulation");
+
+    mock_netem_config_t netem_config = {
+        .seed = 1234,
+        .latency = MOCK_NETEM_LATENCY_PARETO,
+        .latency_ms = 40.0,
+        .pareto_alpha = 1.5,
+        .bandwidth_bytes_per_sec = 64 * 1024,
+        .loss_rate = 0.02,
+        .reset_rate = 0.01,
+        .burst_status = 429,
+        .burst_period_ms = 5000.0,
+        .burst_duration_ms = 500.0,
+    };
+    mock_netem_stats_t netem_first, netem_second;
+    run_emulated_uploads(&netem_config, 300, &netem_first);
+    run_emulated_uploads(&netem_config, 300, &netem_second);
+
+    TEST_ASSERT(netem_first.requests == 300, "Every request crossed the link");
+    TEST_ASSERT(netem_first.timeouts > 0 && netem_first.resets > 0 && netem_first.burst_errors > 0,
+                "Loss, resets and bursts injected");
+    TEST_ASSERT(netem_first.throughput_bytes_per_sec <= netem_config.bandwidth_bytes_per_sec &&
+                netem_first.p99_ms > netem_first.p50_ms, "Bandwidth cap and latency tail applied");
+    TEST_ASSERT(netem_first.succeeded == netem_second.succeeded &&
+                netem_first.elapsed_ms == netem_second.elapsed_ms &&
+                netem_first.p99_ms == netem_second.p99_ms,
+                "Same seed reproduces the run");
+
+    netem_config.seed = 4321;
+    run_emulated_uploads(&netem_config, 300, &netem_second);
+    TEST_ASSERT(netem_first.elapsed_ms != netem_second.elapsed_ms, "Seed changes the run");
+
+    /* Test 20: Event-Loop Mode */
+    TEST_START("Event-Loop Mode");
+
+    event_loop_t loop = {.timer_ms = -1};
+    chunks_uploader_t *loop_uploader = chunks_uploader_create();
+    ret = chunks_uploader_set_event_loop(loop_uploader, loop_socket_callback, NULL, &loop);
+    TEST_ASSERT(ret == -EINVAL, "Timer callback required");
+    ret = chunks_uploader_set_event_loop(loop_uploader, loop_socket_callback,
+                                         loop_timer_callback, &loop);
+    TEST_ASSERT(ret == 0, "Event loop attached");
+
+    mock_curl_reset();
+    uint8_t loop_chunk[16] = {0x42};
+    int queued_ok = 0;
+    for (int i = 0; i < 3; i++) {
+        char loop_uri[64];
+        loop_chunk[1] = (uint8_t)i;
+        snprintf(loop_uri, sizeof(loop_uri), "https://chunks.memfault.com/api/v0/chunks/LOOP-%d", i);
+        if (chunks_uploader_callback(loop_uri, "Memfault-Project-Key:test",
+                                     loop_chunk, sizeof(loop_chunk), loop_uploader) == 0) {
+            queued_ok++;
+        }
+    }
+    TEST_ASSERT(queued_ok == 3 && mock_curl_get_request_count() == 0 &&
+                chunks_uploader_pending(loop_uploader) == 3, "Callback queues without blocking");
+    TEST_ASSERT(loop.timer_ms == 0, "Timer armed");
+    ret = chunks_uploader_set_event_loop(loop_uploader, NULL, NULL, NULL);
+    TEST_ASSERT(ret == -EBUSY, "Mode switch refused while pending");
+
+    chunks_uploader_on_timeout(loop_uploader);
+    TEST_ASSERT(loop.fd_count == 3, "Sockets handed to the host loop");
+    run_event_loop(loop_uploader, &loop);
+
+    chunks_upload_stats_t loop_stats;
+    chunks_uploader_get_stats(loop_uploader, &loop_stats);
+    TEST_ASSERT(chunks_uploader_pending(loop_uploader) == 0 && loop_stats.chunks_uploaded == 3 &&
+                mock_curl_get_request_count() == 3, "Uploads completed from the loop");
+    TEST_ASSERT(loop.fd_count == 0, "Sockets released");
+
+    /* Failover re-queues on the next endpoint */
+    const char *const loop_origins[] = {"https://x.example.com", "https://y.example.com"};
+    chunks_uploader_set_endpoints(loop_uploader, loop_origins, 2);
+    mock_curl_set_url_response("https://x.example.com", 503, CURLE_OK, 0.01);
+    mock_curl_set_url_response("https://y.example.com", 202, CURLE_OK, 0.01);
+    chunks_uploader_callback("https://x.example.com/api/v0/chunks/LOOP", "Memfault-Project-Key:test",
+                             loop_chunk, sizeof(loop_chunk), loop_uploader);
+    run_event_loop(loop_uploader, &loop);
+    chunks_uploader_get_stats(loop_uploader, &loop_stats);
+    TEST_ASSERT(loop_stats.failovers == 1 && loop_stats.chunks_uploaded == 4 &&
+                mock_curl_get_url_request_count("https://y.example.com") == 1,
+                "Failover in event-loop mode");
+
+    ret = chunks_uploader_set_event_loop(loop_uploader, NULL, NULL, NULL);
+    TEST_ASSERT(ret == 0, "Back to blocking mode");
+    chunks_uploader_destroy(loop_uploader);
+    mock_curl_reset();
+
+    /* Test 21: Connection Pool */
+    TEST_START("Connection Pool");
+
+    chunks_uploader_t *per_key[5];
+    for (int i = 0; i < 5; i++) {
+        per_key[i] = chunks_uploader_create();
+    }
+
+    /* Private caches: every project key's uploader opens its own connection */
+    mock_curl_reset();
+    TEST_ASSERT(upload_device_fleet(per_key) == 0, "Fleet uploaded without pool");
+    int unpooled_connections = mock_curl_get_connections_opened();
+    TEST_ASSERT(unpooled_connections == 5, "One connection per project key without pool");
+
+    chunks_pool_t *pool = chunks_pool_create(0);
+    TEST_ASSERT(pool != NULL, "Pool created");
+    for (int i = 0; i < 5; i++) {
+        chunks_uploader_set_pool(per_key[i], pool);
+    }
+
+    mock_curl_reset();
+    TEST_ASSERT(upload_device_fleet(per_key) == 0, "Fleet uploaded through pool");
+    TEST_ASSERT(mock_curl_get_request_count() == 150 && mock_curl_get_connections_opened() == 1,
+                "150 requests from 50 devices and 5 keys share one connection");
+
+    chunks_pool_stats_t pool_stats;
+    chunks_pool_get_stats(pool, &pool_stats);
+    TEST_ASSERT(pool_stats.requests == 150 && pool_stats.connections_opened == 1 &&
+                pool_stats.hosts == 1 && pool_stats.uploaders == 5, "Pool stats");
+
+    /* Another host gets its own connection; auth headers still differ per request */
+    chunks_uploader_callback("https://chunks-eu.memfault.com:443/api/v0/chunks/EU-1",
+                             "Memfault-Project-Key:project-eu", dedup_chunk_a,
+                             sizeof(dedup_chunk_a), per_key[0]);
+    chunks_pool_get_stats(pool, &pool_stats);
+    TEST_ASSERT(pool_stats.hosts == 2 && mock_curl_get_connections_opened() == 2,
+                "Pool keyed on scheme, host and port");
+
+    TEST_ASSERT(chunks_pool_destroy(pool) == -EBUSY, "Pool in use cannot be destroyed");
+    for (int i = 0; i < 5; i++) {
+        chunks_uploader_destroy(per_key[i]);
+    }
+    TEST_ASSERT(chunks_pool_destroy(pool) == 0, "Pool destroyed");
+    mock_curl_reset();
+
+    /* Test 22: Interned Config */
+    TEST_START("Interned Config");
+
+    mds_config_table_t *config_table = mds_config_table_create();
+    TEST_ASSERT(config_table != NULL, "Config table created");
+
+    const mds_config_entry_t *uri_entry = mds_config_intern(
+        config_table, MDS_CONFIG_URI, "HTTPS://Chunks.Memfault.com/api/v0/chunks/DEV-00");
+    TEST_ASSERT(uri_entry != NULL &&
+                strcmp(uri_entry->origin, "https://chunks.memfault.com:443") == 0 &&
+                strcmp(uri_entry->host, "chunks.memfault.com") == 0 &&
+                strcmp(uri_entry->device, "DEV-00") == 0, "URI parsed when interned");
+
+    const mds_config_entry_t *auth_entry = mds_config_intern(
+        config_table, MDS_CONFIG_AUTH, "Memfault-Project-Key:fleet");
+    TEST_ASSERT(auth_entry != NULL && strcmp(auth_entry->header, "Memfault-Project-Key: fleet") == 0,
+                "Header line prebuilt when interned");
+
+    /* 20 sessions (devices) sharing one project key */
+    mds_session_t *fleet[20];
+    mds_device_config_t fleet_config = {0};
+    strcpy(fleet_config.authorization, "Memfault-Project-Key:fleet");
+    chunks_uploader_t *interned_uploader = chunks_uploader_create();
+    chunks_uploader_set_config_table(interned_uploader, config_table);
+
+    for (int i = 0; i < 20; i++) {
+        mds_session_create(NULL, &fleet[i]);
+        snprintf(fleet_config.data_uri, sizeof(fleet_config.data_uri),
+                 "https://chunks.memfault.com/api/v0/chunks/DEV-%02d", i);
+        mds_session_set_config(fleet[i], config_table, &fleet_config);
+        mds_set_upload_callback(fleet[i], chunks_uploader_callback, interned_uploader);
+    }
+    TEST_ASSERT(mds_config_table_count(config_table) == 22,
+                "One shared auth entry, one URI per device");
+    TEST_ASSERT(mds_config_intern(config_table, MDS_CONFIG_AUTH, fleet_config.authorization) == auth_entry,
+                "Equal strings intern to the same entry");
+    mds_config_release(config_table, auth_entry);
+
+    char auth_copy[64];
+    strcpy(auth_copy, auth_entry->str);
+    TEST_ASSERT(mds_config_find(config_table, auth_entry->str) == auth_entry &&
+                mds_config_find(config_table, auth_copy) == NULL, "Lookup by pointer, not contents");
+
+    mock_curl_reset();
+    int interned_failures = 0;
+    for (int i = 0; i < 20; i++) {
+        uint8_t record[] = {0x00, 'i', (uint8_t)i};
+        if (mds_process_stream_from_bytes(fleet[i], NULL, record, sizeof(record), NULL) != 0) {
+            interned_failures++;
+        }
+    }
+    TEST_ASSERT(interned_failures == 0 && mock_curl_get_request_count() == 20,
+                "Sessions upload with interned config");
+    TEST_ASSERT(strcmp(mock_curl_get_last_url(), "https://chunks.memfault.com/api/v0/chunks/DEV-19") == 0 &&
+                strstr(mock_curl_get_last_headers(), "Memfault-Project-Key: fleet;") != NULL,
+                "Interned URI and cached headers sent");
+
+    mds_session_t *plain_session;
+    mds_session_create(NULL, &plain_session);
+    uint8_t plain_record[] = {0x00, 'p'};
+    TEST_ASSERT(mds_process_stream_from_bytes(plain_session, NULL, plain_record,
+                                              sizeof(plain_record), NULL) == -EINVAL,
+                "NULL config needs interned config");
+    mds_session_destroy(plain_session);
+
+    /* Swapping and clearing the config while another thread processes */
+    config_swap_t swap = {0};
+    mds_device_config_t swap_config = {0};
+    strcpy(swap_config.authorization, "Memfault-Project-Key:swap");
+    strcpy(swap_config.data_uri, "https://swap.example.com/DEV-0");
+    mds_session_create(NULL, &swap.session);
+    mds_session_set_config(swap.session, config_table, &swap_config);
+    mds_set_upload_callback(swap.session, config_swap_callback, &swap);
+    pthread_t swap_thread;
+    pthread_create(&swap_thread, NULL, config_swap_thread, &swap);
+    uint64_t swap_deadline = mds_deadline_after(10000);
+    for (int i = 0; i < 1000 || (__atomic_load_n(&swap.uploads, __ATOMIC_RELAXED) < 100 &&
+                                 mds_deadline_after(0) < swap_deadline); i++) {
+        snprintf(swap_config.data_uri, sizeof(swap_config.data_uri),
+                 "https://swap.example.com/DEV-%d", i % 3);
+        mds_session_set_config(swap.session, i % 5 == 4 ? NULL : config_table, &swap_config);
+    }
+    __atomic_store_n(&swap.stop, true, __ATOMIC_RELEASE);
+    pthread_join(swap_thread, NULL);
+    TEST_ASSERT(swap.uploads >= 100 && swap.bad_uris == 0 && swap.failures == 0,
+                "Config swapped safely while processing");
+    mds_session_destroy(swap.session);
+
+    TEST_ASSERT(mds_config_table_destroy(config_table) == -EBUSY, "Referenced table not destroyed");
+    for (int i = 0; i < 20; i++) {
+        mds_session_destroy(fleet[i]);
+    }
+    mds_config_release(config_table, uri_entry);
+    mds_config_release(config_table, auth_entry);
+    chunks_uploader_destroy(interned_uploader);
+    TEST_ASSERT(mds_config_table_count(config_table) == 0 &&
+                mds_config_table_destroy(config_table) == 0, "Entries freed with last reference");
+    mock_curl_reset();
+
+    /* Test 23: Deadlines and Expiry */
+    TEST_START("Deadlines and Expiry");
+
+    chunks_uploader_t *aging = chunks_uploader_create();
+    upload_test_data_t diverted = {0};
+    chunks_queue_policy_t queue_policy = {
+        .order = CHUNKS_QUEUE_EDF,
+        .max_age_ms = 60000,
+        .expired_fn = test_upload_callback,
+        .expired_user_data = &diverted,
+    };
+    ret = chunks_uploader_set_queue_policy(aging, &queue_policy);
+    TEST_ASSERT(ret == 0, "Queue policy set");
+
+    mock_curl_reset();
+    uint8_t aged_chunk[24] = {0x5A};
+    const char *aged_uri = "https://chunks.memfault.com/api/v0/chunks/AGED";
+    ret = chunks_uploader_submit(aging, aged_uri, "Memfault-Project-Key:test",
+                                 aged_chunk, sizeof(aged_chunk), 120000, 0);
+    TEST_ASSERT(ret == 0 && diverted.upload_count == 1 && mock_curl_get_request_count() == 0,
+                "Chunk past max age diverted instead of sent");
+
+    ret = chunks_uploader_submit(aging, aged_uri, "Memfault-Project-Key:test",
+                                 aged_chunk, sizeof(aged_chunk), 5000, 1000);
+    TEST_ASSERT(ret == 0 && mock_curl_get_request_count() == 1, "Chunk within max age sent");
+
+    chunks_upload_stats_t aging_stats;
+    chunks_uploader_get_stats(aging, &aging_stats);
+    TEST_ASSERT(aging_stats.expired_chunks == 1 && aging_stats.expired_bytes == sizeof(aged_chunk) &&
+                aging_stats.deadline_misses == 1, "Expired bytes and deadline misses counted");
+
+    /* Earliest deadline first once every request slot is busy */
+    event_loop_t edf_loop = {.timer_ms = -1};
+    chunks_uploader_set_event_loop(aging, loop_socket_callback, loop_timer_callback, &edf_loop);
+    mock_curl_reset();
+    for (int i = 0; i < CHUNKS_ASYNC_MAX_IN_FLIGHT; i++) {
+        char fill_uri[64];
+        aged_chunk[1] = (uint8_t)i;
+        snprintf(fill_uri, sizeof(fill_uri), "https://chunks.memfault.com/api/v0/chunks/FILL-%d", i);
+        chunks_uploader_submit(aging, fill_uri, "Memfault-Project-Key:test",
+                               aged_chunk, sizeof(aged_chunk), 0, 0);
+    }
+    const char *edf_devices[] = {"A", "B", "C", "D", "STALE"};
+    const uint32_t edf_deadlines[] = {30000, 10000, 0, 20000, 0};
+    const uint32_t edf_ages[] = {0, 0, 0, 0, 59990};
+    for (int i = 0; i < 5; i++) {
+        char edf_uri[96];
+        snprintf(edf_uri, sizeof(edf_uri), "https://chunks.memfault.com/api/v0/chunks/%s", edf_devices[i]);
+        chunks_uploader_submit(aging, edf_uri, "Memfault-Project-Key:test",
+                               aged_chunk, sizeof(aged_chunk), edf_ages[i], edf_deadlines[i]);
+    }
+    TEST_ASSERT(chunks_uploader_set_queue_policy(aging, NULL) == -EBUSY,
+                "Policy fixed while uploads are queued");
+
+    /* Let the last chunk pass its maximum age while it waits */
+    usleep(20000);
+    run_event_loop(aging, &edf_loop);
+
+    const char *edf_order[] = {"B", "D", "A", "C"};
+    int edf_in_order = 0;
+    for (int i = 0; i < 4; i++) {
+        const char *url = mock_curl_get_request_url(CHUNKS_ASYNC_MAX_IN_FLIGHT + i);
+        const char *device = url ? strrchr(url, '/') + 1 : "";
+        edf_in_order += strcmp(device, edf_order[i]) == 0;
+    }
+    TEST_ASSERT(edf_in_order == 4 && mock_curl_get_request_count() == CHUNKS_ASYNC_MAX_IN_FLIGHT + 4,
+                "Queued chunks sent by deadline, no deadline last");
+    TEST_ASSERT(diverted.upload_count == 2 && strstr(diverted.last_uri, "STALE") != NULL,
+                "Chunk expired while queued diverted");
+
+    chunks_age_stats_t age_stats;
+    chunks_uploader_get_age_stats(aging, &age_stats);
+    chunks_uploader_get_stats(aging, &aging_stats);
+    size_t aged_uploads = 0;
+    for (int i = 0; i < CHUNKS_AGE_BUCKETS; i++) {
+        aged_uploads += age_stats.counts[i];
+    }
+    TEST_ASSERT(aged_uploads == aging_stats.chunks_uploaded && age_stats.max_ms >= 5000 &&
+                age_stats.counts[13] >= 1, "Age distribution at upload");
+
+    chunks_uploader_set_event_loop(aging, NULL, NULL, NULL);
+    chunks_uploader_set_queue_policy(aging, NULL);
+    ret = chunks_uploader_submit(aging, aged_uri, "Memfault-Project-Key:test",
+                                 aged_chunk, sizeof(aged_chunk), 120000, 0);
+    TEST_ASSERT(ret == 0, "No expiry without max age");
+    chunks_uploader_destroy(aging);
+    mock_curl_reset();
+
+    /* Test 24: Sink Interface */
+    TEST_START("Sink Interface");
+
+    uint8_t sink_chunk[16] = {0x10, 0x20, 0x30};
+    const char *sink_uri = "https://chunks.memfault.com/api/v0/chunks/SINK";
+    mds_sink_stats_t sink_totals;
+
+    mds_sink_t *null_sink = mds_sink_create_null(NULL);
+    for (int i = 0; i < 3; i++) {
+        mds_sink_callback(sink_uri, "Memfault-Project-Key:test", sink_chunk, sizeof(sink_chunk), null_sink);
+    }
+    mds_sink_get_stats(null_sink, &sink_totals);
+    TEST_ASSERT(sink_totals.submitted == 3 && sink_totals.queued == 3 && sink_totals.delivered == 0,
+                "Partial batch held until poll");
+    mds_sink_poll(null_sink, 0);
+    mds_sink_get_stats(null_sink, &sink_totals);
+    TEST_ASSERT(sink_totals.delivered == 3 && sink_totals.batches == 1 && sink_totals.queued == 0,
+                "Poll delivers the partial batch at once");
+    mds_sink_destroy(null_sink);
+
+    /* With a linger, poll leaves a young partial batch for later */
+    mds_sink_config_t linger_config = {.max_delay_ms = 60000};
+    null_sink = mds_sink_create_null(&linger_config);
+    mds_sink_callback(sink_uri, "Memfault-Project-Key:test", sink_chunk, sizeof(sink_chunk), null_sink);
+    mds_sink_poll(null_sink, 0);
+    mds_sink_get_stats(null_sink, &sink_totals);
+    TEST_ASSERT(sink_totals.delivered == 0 && sink_totals.queued == 1,
+                "Poll honours max_delay_ms");
+    mds_sink_flush(null_sink);
+    mds_sink_get_stats(null_sink, &sink_totals);
+    TEST_ASSERT(sink_totals.delivered == 1 && sink_totals.queued == 0, "Flush forces delivery");
+    mds_sink_destroy(null_sink);
+
+    /* File output: records read back in order */
+    char sink_path[64];
+    snprintf(sink_path, sizeof(sink_path), "/tmp/mds_sink_test_%d.bin", (int)getpid());
+    unlink(sink_path);
+    mds_sink_config_t sink_config = {.max_batch = 2};
+    mds_sink_t *file_sink = mds_sink_create_file(sink_path, &sink_config);
+    mds_sink_submit(file_sink, sink_uri, "Memfault-Project-Key:test", sink_chunk, sizeof(sink_chunk));
+    mds_sink_submit(file_sink, sink_uri, "Memfault-Project-Key:test", sink_chunk, 3);
+    TEST_ASSERT(mds_sink_flush(file_sink) == 0, "File sink flushed");
+    mds_sink_destroy(file_sink);
+
+    uint8_t record[128];
+    size_t record_len = strlen(sink_uri) + MDS_SINK_RECORD_HEADER_LEN;
+    FILE *sink_file = fopen(sink_path, "rb");
+    size_t file_len = sink_file ? fread(record, 1, sizeof(record), sink_file) : 0;
+    if (sink_file) {
+        fclose(sink_file);
+    }
+    TEST_ASSERT(file_len == 2 * record_len + sizeof(sink_chunk) + 3 && record[0] == sizeof(sink_chunk) &&
+                record[4] == strlen(sink_uri) &&
+                memcmp(record + MDS_SINK_RECORD_HEADER_LEN, sink_uri, strlen(sink_uri)) == 0 &&
+                memcmp(record + record_len, sink_chunk, sizeof(sink_chunk)) == 0 &&
+                record[record_len + sizeof(sink_chunk)] == 3, "File records framed as documented");
+    unlink(sink_path);
+
+    /* UNIX socket output */
+    struct sockaddr_un sink_addr = {.sun_family = AF_UNIX};
+    snprintf(sink_addr.sun_path, sizeof(sink_addr.sun_path), "/tmp/mds_sink_test_%d.sock", (int)getpid());
+    unlink(sink_addr.sun_path);
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    bind(listen_fd, (struct sockaddr *)&sink_addr, sizeof(sink_addr));
+    listen(listen_fd, 1);
+    mds_sink_t *unix_sink = mds_sink_create_unix(sink_addr.sun_path, NULL);
+    TEST_ASSERT(unix_sink != NULL, "UNIX sink connected");
+    mds_sink_submit(unix_sink, sink_uri, "Memfault-Project-Key:test", sink_chunk, sizeof(sink_chunk));
+    TEST_ASSERT(mds_sink_flush(unix_sink) == 0, "UNIX sink flushed");
+
+    int peer_fd = accept(listen_fd, NULL, NULL);
+    size_t received = 0;
+    while (peer_fd >= 0 && received < record_len + sizeof(sink_chunk)) {
+        ssize_t n = read(peer_fd, record + received, sizeof(record) - received);
+        if (n <= 0) {
+            break;
+        }
+        received += (size_t)n;
+    }
+    TEST_ASSERT(received == record_len + sizeof(sink_chunk) &&
+                memcmp(record + record_len, sink_chunk, sizeof(sink_chunk)) == 0,
+                "Record received on the socket");
+    mds_sink_destroy(unix_sink);
+    close(peer_fd);
+    close(listen_fd);
+    unlink(sink_addr.sun_path);
+    TEST_ASSERT(mds_sink_create_unix(sink_addr.sun_path, NULL) == NULL, "UNIX sink needs a listener");
+
+    /* HTTP output: full batches go out at once, transient errors stay queued */
+    chunks_uploader_t *sink_uploader = chunks_uploader_create();
+    sink_config.max_batch = 4;
+    mds_sink_t *http_sink = mds_sink_create_http(sink_uploader, &sink_config);
+    mock_curl_reset();
+    for (int i = 0; i < 5; i++) {
+        sink_chunk[3] = (uint8_t)i;
+        mds_sink_submit(http_sink, sink_uri, "Memfault-Project-Key:test", sink_chunk, sizeof(sink_chunk));
+    }
+    TEST_ASSERT(mock_curl_get_request_count() == 4, "Full batch posted on submit");
+    TEST_ASSERT(mds_sink_flush(http_sink) == 0 && mock_curl_get_request_count() == 5,
+                "Remainder posted on flush");
+
+    mock_curl_set_response(503, CURLE_OK);
+    mds_sink_submit(http_sink, sink_uri, "Memfault-Project-Key:test", sink_chunk, sizeof(sink_chunk));
+    ret = mds_sink_flush(http_sink);
+    mds_sink_get_stats(http_sink, &sink_totals);
+    TEST_ASSERT(ret < 0 && sink_totals.queued == 1, "5xx leaves the chunk queued");
+    mock_curl_set_response(200, CURLE_OK);
+    TEST_ASSERT(mds_sink_flush(http_sink) == 0, "Chunk delivered once the server recovers");
+
+    mock_curl_set_response(400, CURLE_OK);
+    mds_sink_submit(http_sink, sink_uri, "Memfault-Project-Key:test", sink_chunk, sizeof(sink_chunk));
+    mds_sink_flush(http_sink);
+    mds_sink_get_stats(http_sink, &sink_totals);
+    TEST_ASSERT(sink_totals.delivered == 6 && sink_totals.failed == 1 && sink_totals.queued == 0,
+                "4xx counted as failed, not retried");
+    mds_sink_destroy(http_sink);
+    chunks_uploader_destroy(sink_uploader);
+    mock_curl_reset();
+
+    /* Overflow policies on an output that takes nothing */
+    stuck_output_t stuck = {0};
+    mds_sink_overflow_t policies[] = {MDS_SINK_OVERFLOW_DELIVER, MDS_SINK_OVERFLOW_REJECT,
+                                      MDS_SINK_OVERFLOW_DROP_OLDEST};
+    int overflow_results[3];
+    for (int p = 0; p < 3; p++) {
+        mds_sink_config_t stuck_config = {.queue_depth = 4, .overflow = policies[p]};
+        mds_sink_t *stuck_sink = mds_sink_create(&stuck_ops, &stuck, &stuck_config);
+        for (int i = 0; i < 5; i++) {
+            overflow_results[p] = mds_sink_submit(stuck_sink, sink_uri, "Memfault-Project-Key:test",
+                                                  sink_chunk, sizeof(sink_chunk));
+        }
+        mds_sink_get_stats(stuck_sink, &sink_totals);
+        TEST_ASSERT(sink_totals.dropped == 1 && sink_totals.queued == 4, "Queue bounded");
+        if (p == 2) {
+            stuck.accept = 3;
+            TEST_ASSERT(mds_sink_flush(stuck_sink) == 0, "Partial acceptance retried until drained");
+        }
+        mds_sink_destroy(stuck_sink);
+    }
+    TEST_ASSERT(overflow_results[0] == -ENOBUFS && overflow_results[1] == -ENOBUFS &&
+                overflow_results[2] == 0, "Overflow policy applied");
+
+    /* Test 25: NDJSON Export */
+    TEST_START("NDJSON Export");
+
+    char b64[512];
+    const char *b64_inputs[] = {"", "f", "fo", "foo", "foobar"};
+    const char *b64_expected[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYmFy"};
+    int b64_ok = 0;
+    for (int i = 0; i < 5; i++) {
+        size_t n = mds_base64_encode((const uint8_t *)b64_inputs[i], strlen(b64_inputs[i]), b64);
+        b64_ok += n == strlen(b64_expected[i]) && memcmp(b64, b64_expected[i], n) == 0;
+    }
+    TEST_ASSERT(b64_ok == 5, "Base64 test vectors");
+
+    uint8_t b64_src[300];
+    char b64_scalar[512];
+    int b64_same = 0;
+    for (size_t i = 0; i < sizeof(b64_src); i++) {
+        b64_src[i] = (uint8_t)(i * 151 + 7);
+    }
+    for (size_t len = 0; len <= sizeof(b64_src); len++) {
+        size_t n = mds_base64_encode(b64_src, len, b64);
+        b64_same += n == mds_base64_encode_scalar(b64_src, len, b64_scalar) &&
+                    n == mds_base64_encoded_len(len) && memcmp(b64, b64_scalar, n) == 0;
+    }
+    printf("  Encoder: %s\n", mds_base64_impl());
+    TEST_ASSERT(b64_same == (int)sizeof(b64_src) + 1, "Vector encoder matches scalar for every length");
+
+    snprintf(sink_path, sizeof(sink_path), "/tmp/mds_ndjson_test_%d.ndjson", (int)getpid());
+    unlink(sink_path);
+    mds_sink_t *ndjson_sink = mds_sink_create_ndjson(sink_path, NULL);
+    const uint8_t ndjson_chunk[] = {'f', 'o', 'o', 'b', 'a', 'r'};
+    mds_sink_submit(ndjson_sink, "https://chunks.memfault.com/api/v0/chunks/DEV\"1",
+                    "Memfault-Project-Key:test", ndjson_chunk, sizeof(ndjson_chunk));
+    mds_sink_submit(ndjson_sink, "https://chunks.memfault.com/api/v0/chunks/DEV2",
+                    "Memfault-Project-Key:test", ndjson_chunk, 3);
+    TEST_ASSERT(mds_sink_flush(ndjson_sink) == 0, "NDJSON sink flushed");
+    mds_sink_destroy(ndjson_sink);
+
+    char ndjson_lines[2][256] = {{0}};
+    FILE *ndjson_file = fopen(sink_path, "r");
+    for (int i = 0; ndjson_file && i < 2; i++) {
+        if (fgets(ndjson_lines[i], sizeof(ndjson_lines[i]), ndjson_file) == NULL) {
+            break;
+        }
+    }
+    if (ndjson_file) {
+        fclose(ndjson_file);
+    }
+    unlink(sink_path);
+    const char *ndjson_prefix = "{\"device\":\"DEV\\\"1\",\"seq\":0,\"received_us\":";
+    TEST_ASSERT(strncmp(ndjson_lines[0], ndjson_prefix, strlen(ndjson_prefix)) == 0 &&
+                strstr(ndjson_lines[0], ",\"data\":\"Zm9vYmFy\"}\n") != NULL,
+                "Record carries escaped device, sequence and payload");
+    ndjson_prefix = "{\"device\":\"DEV2\",\"seq\":1,";
+    TEST_ASSERT(strncmp(ndjson_lines[1], ndjson_prefix, strlen(ndjson_prefix)) == 0 &&
+                strstr(ndjson_lines[1], "\"data\":\"Zm9v\"}") != NULL, "One line per chunk");
+
+    /* Large batch spread over several segments, streamed to a socket */
+    snprintf(sink_addr.sun_path, sizeof(sink_addr.sun_path), "/tmp/mds_ndjson_test_%d.sock", (int)getpid());
+    unlink(sink_addr.sun_path);
+    char ndjson_socket[sizeof(sink_addr.sun_path) + 8];
+    snprintf(ndjson_socket, sizeof(ndjson_socket), MDS_SINK_UNIX_PREFIX "%s", sink_addr.sun_path);
+    sink_config.max_batch = 4;
+    ndjson_sink = mds_sink_create_ndjson(ndjson_socket, &sink_config);
+    TEST_ASSERT(ndjson_sink != NULL && access(sink_addr.sun_path, F_OK) != 0,
+                "Socket sink created before the server, without creating a file");
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    bind(listen_fd, (struct sockaddr *)&sink_addr, sizeof(sink_addr));
+    listen(listen_fd, 1);
+    TEST_ASSERT(mds_sink_create_ndjson(sink_addr.sun_path, NULL) == NULL,
+                "Socket path without the unix: prefix rejected");
+
+    /* Two records per segment; the whole batch stays within the socket buffer */
+    size_t big_len = 20000;
+    uint8_t *big_chunk = calloc(1, big_len);
+    for (int i = 0; i < 4; i++) {
+        mds_sink_submit(ndjson_sink, sink_uri, "Memfault-Project-Key:test", big_chunk, big_len);
+    }
+    peer_fd = accept(listen_fd, NULL, NULL);
+    TEST_ASSERT(peer_fd >= 0, "NDJSON sink connected once the server listens");
+    size_t expected_bytes = 4 * mds_base64_encoded_len(big_len);
+    size_t newlines = 0;
+    size_t stream_bytes = 0;
+    char stream_buf[4096];
+    while (newlines < 4) {
+        ssize_t n = read(peer_fd, stream_buf, sizeof(stream_buf));
+        if (n <= 0) {
+            break;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            newlines += stream_buf[i] == '\n';
+        }
+        stream_bytes += (size_t)n;
+    }
+    mds_sink_get_stats(ndjson_sink, &sink_totals);
+    TEST_ASSERT(newlines == 4 && stream_bytes > expected_bytes && sink_totals.delivered == 4 &&
+                sink_totals.batches == 1, "Batch written across segments in one call");
+    mds_sink_destroy(ndjson_sink);
+    free(big_chunk);
+    close(peer_fd);
+    close(listen_fd);
+    unlink(sink_addr.sun_path);
+
+    /* Test 26: TLS Session Resumption
+     * The mock's TLS stand-in tracks tickets and handshakes only; no real TLS
+     * server is involved, so this checks the uploader's side of resumption. */
+    TEST_START("TLS Session Resumption");
+
+    char tls_path[64];
+    snprintf(tls_path, sizeof(tls_path), "/tmp/mds_tls_test_%d.cache", (int)getpid());
+    unlink(tls_path);
+    chunks_uploader_t *tls_uploader = chunks_uploader_create();
+    ret = chunks_uploader_set_tls_cache(tls_uploader, tls_path, 0);
+#if CHUNKS_HAVE_TLS_EXPORT
+    TEST_ASSERT(ret == 0, "TLS session cache set");
+
+    mock_curl_reset();
+    int tls_full = 0;
+    int tls_resumed = 0;
+    uint8_t tls_chunk[8] = {0x7E};
+    chunks_uploader_callback(sink_uri, "Memfault-Project-Key:test", tls_chunk, sizeof(tls_chunk), tls_uploader);
+    chunks_uploader_callback(sink_uri, "Memfault-Project-Key:test", tls_chunk, sizeof(tls_chunk), tls_uploader);
+    mock_curl_get_tls_handshakes(&tls_full, &tls_resumed);
+    TEST_ASSERT(tls_full == 1 && tls_resumed == 0 && access(tls_path, R_OK) == 0,
+                "Full handshake once, ticket persisted");
+    chunks_uploader_destroy(tls_uploader);
+
+    /* Gateway restart */
+    tls_uploader = chunks_uploader_create();
+    chunks_uploader_set_tls_cache(tls_uploader, tls_path, 0);
+    chunks_uploader_callback(sink_uri, "Memfault-Project-Key:test", tls_chunk, sizeof(tls_chunk), tls_uploader);
+    mock_curl_get_tls_handshakes(&tls_full, &tls_resumed);
+    TEST_ASSERT(tls_full == 1 && tls_resumed == 1, "First upload after restart resumes the session");
+
+    /* No handle to replace the one using the cache: nothing changes */
+    mock_curl_fail_easy_init(1);
+    ret = chunks_uploader_set_tls_cache(tls_uploader, NULL, 0);
+    TEST_ASSERT(ret == -ENOMEM, "Cache kept when no fresh handle can be made");
+    ret = chunks_uploader_callback(sink_uri, "Memfault-Project-Key:test", tls_chunk,
+                                   sizeof(tls_chunk), tls_uploader);
+    TEST_ASSERT(ret == 0, "Upload still uses the kept cache");
+    chunks_uploader_destroy(tls_uploader);
+
+    /* Sessions are imported into a pool's shared cache */
+    chunks_pool_t *tls_pool = chunks_pool_create(0);
+    tls_uploader = chunks_uploader_create();
+    chunks_uploader_set_pool(tls_uploader, tls_pool);
+    chunks_uploader_set_tls_cache(tls_uploader, tls_path, 0);
+    chunks_uploader_callback(sink_uri, "Memfault-Project-Key:test", tls_chunk, sizeof(tls_chunk), tls_uploader);
+    mock_curl_get_tls_handshakes(&tls_full, &tls_resumed);
+    TEST_ASSERT(tls_full == 1 && tls_resumed == 2, "Resumed through a shared pool");
+    chunks_uploader_destroy(tls_uploader);
+    chunks_pool_destroy(tls_pool);
+
+    /* Tickets past the server's lifetime are not kept */
+    unlink(tls_path);
+    mock_curl_set_tls_ticket_lifetime(0);
+    for (int i = 0; i < 2; i++) {
+        tls_uploader = chunks_uploader_create();
+        chunks_uploader_set_tls_cache(tls_uploader, tls_path, 0);
+        chunks_uploader_callback(sink_uri, "Memfault-Project-Key:test", tls_chunk, sizeof(tls_chunk), tls_uploader);
+        chunks_uploader_destroy(tls_uploader);
+    }
+    mock_curl_get_tls_handshakes(&tls_full, &tls_resumed);
+    TEST_ASSERT(tls_full == 3 && tls_resumed == 2, "Expired session not resumed");
+    unlink(tls_path);
+    mock_curl_reset();
+#else
+    TEST_ASSERT(ret == -ENOTSUP, "Session persistence needs libcurl 8.12 entry points");
+    chunks_uploader_destroy(tls_uploader);
+#endif
+
+    /* Test 27: Stage Pipeline */
+    TEST_START("Stage Pipeline");
+
+    const char *pipe_uris[] = {"https://chunks.memfault.com/api/v0/chunks/DEVA",
+                               "https://chunks.memfault.com/api/v0/chunks/DEVB"};
+    const size_t pipe_lens[] = {2, 5, 5, 1, 5, 5};
+    const uint8_t pipe_chunk[40] = {0};
+    size_t pipe_min_len = 4;
+    upload_test_data_t pipe_tee = {0};
+    mds_sink_t *pipe_sink = mds_sink_create_null(NULL);
+    mds_pipeline_t *pipeline = mds_pipeline_create();
+    int filter_stage = mds_pipeline_add_filter(pipeline, min_len_filter, &pipe_min_len);
+    int batch_stage = mds_pipeline_add_batch(pipeline, 4, 0);
+    mds_pipeline_add_tee(pipeline, test_upload_callback, &pipe_tee);
+    int sink_stage = mds_pipeline_add_sink(pipeline, pipe_sink);
+    TEST_ASSERT(filter_stage == 0 && batch_stage == 1 && sink_stage == 3, "Stages added in order");
+
+    /* Two devices sharing the pipeline, as two sessions would */
+    for (int i = 0; i < 5; i++) {
+        mds_pipeline_callback(pipe_uris[i % 2], "Memfault-Project-Key:test", pipe_chunk, pipe_lens[i], pipeline);
+    }
+    TEST_ASSERT(pipe_tee.upload_count == 0, "Batch stage holds a partial batch");
+    ret = mds_pipeline_callback(pipe_uris[1], "Memfault-Project-Key:test", pipe_chunk, pipe_lens[5], pipeline);
+    TEST_ASSERT(ret == 0 && pipe_tee.upload_count == 4 && pipe_tee.last_chunk_len == 5 &&
+                strcmp(pipe_tee.last_uri, pipe_uris[1]) == 0, "Full batch passed down the chain");
+
+    mds_pipeline_stage_stats_t stage_stats;
+    mds_pipeline_get_stage_stats(pipeline, filter_stage, &stage_stats);
+    TEST_ASSERT(stage_stats.chunks_in == 6 && stage_stats.chunks_out == 4, "Filter dropped short chunks");
+
+    mds_pipeline_callback(pipe_uris[0], "Memfault-Project-Key:test", pipe_chunk, 5, pipeline);
+    TEST_ASSERT(mds_pipeline_flush(pipeline) == 0 && pipe_tee.upload_count == 5, "Flush emits the partial batch");
+    mds_sink_get_stats(pipe_sink, &sink_totals);
+    TEST_ASSERT(sink_totals.delivered == 5, "Sink stage delivered every batch");
+    mds_pipeline_destroy(pipeline);
+
+    /* Partial batches are emitted by poll after max_delay_ms */
+    pipeline = mds_pipeline_create();
+    mds_pipeline_add_batch(pipeline, 8, 1);
+    mds_pipeline_add_tee(pipeline, test_upload_callback, &pipe_tee);
+    mds_pipeline_callback(pipe_uris[0], "Memfault-Project-Key:test", pipe_chunk, 5, pipeline);
+    usleep(5000);
+    mds_pipeline_poll(pipeline);
+    TEST_ASSERT(pipe_tee.upload_count == 6, "Poll emits a batch that waited max_delay_ms");
+    mds_pipeline_destroy(pipeline);
+
+    /* Token bucket of 100 bytes passes two 40-byte chunks of five; the slow
+     * refill keeps a stall of up to 200 ms from letting a third through */
+    pipeline = mds_pipeline_create();
+    int rate_stage = mds_pipeline_add_rate_limit(pipeline, 200, 100);
+    mds_pipeline_add_tee(pipeline, test_upload_callback, &pipe_tee);
+    mds_pipeline_add_sink(pipeline, pipe_sink);
+    for (int i = 0; i < 5; i++) {
+        mds_pipeline_callback(pipe_uris[0], "Memfault-Project-Key:test", pipe_chunk, 40, pipeline);
+    }
+    mds_pipeline_get_stage_stats(pipeline, rate_stage, &stage_stats);
+    TEST_ASSERT(stage_stats.chunks_in == 5 && stage_stats.chunks_out == 2 && pipe_tee.upload_count == 8,
+                "Rate limit holds chunks over budget");
+
+    usleep(250000);
+    mds_pipeline_poll(pipeline);
+    mds_pipeline_get_stage_stats(pipeline, rate_stage, &stage_stats);
+    TEST_ASSERT(stage_stats.chunks_out > 2 && stage_stats.chunks_out < 5,
+                "Poll passes held chunks on as the bucket refills");
+
+    mds_pipeline_flush(pipeline);
+    mds_pipeline_get_stage_stats(pipeline, rate_stage, &stage_stats);
+    mds_sink_get_stats(pipe_sink, &sink_totals);
+    TEST_ASSERT(stage_stats.chunks_out == 5 && pipe_tee.upload_count == 11 &&
+                sink_totals.delivered == 10 && stage_stats.chunks_refused == 0,
+                "Flush passes on every held chunk");
+
+    /* A tee error is reported but the chunk still reaches the sink */
+    pipe_tee.last_result = -EIO;
+    ret = mds_pipeline_callback(pipe_uris[0], "Memfault-Project-Key:test", pipe_chunk, 1, pipeline);
+    mds_sink_flush(pipe_sink);
+    mds_sink_get_stats(pipe_sink, &sink_totals);
+    TEST_ASSERT(ret == -EIO && sink_totals.delivered == 11, "Stage error returned, chunk passed on");
+    mds_pipeline_destroy(pipeline);
+    mds_sink_destroy(pipe_sink);
+
+    /* Holding a chunk may grow the queue's storage while queued chunks go out */
+    static uint8_t big_chunks[12][2000];
+    mds_sink_chunk_t big[12];
+    size_t big_corrupt = 0;
+    for (size_t i = 0; i < 12; i++) {
+        memset(big_chunks[i], (int)i, sizeof(big_chunks[i]));
+        big[i] = (mds_sink_chunk_t){
+            .uri = pipe_uris[0],
+            .auth_header = "Memfault-Project-Key:test",
+            .data = big_chunks[i],
+            .len = sizeof(big_chunks[i]),
+            .sequence = i,
+        };
+    }
+    pipeline = mds_pipeline_create();
+    rate_stage = mds_pipeline_add_rate_limit(pipeline, 2000, 2000);
+    mds_pipeline_add_filter(pipeline, pattern_filter, &big_corrupt);
+    ret = mds_pipeline_submit_batch(pipeline, big, 11);
+    usleep(1050 * 1000);
+    ret = ret == 0 ? mds_pipeline_submit_batch(pipeline, &big[11], 1) : ret;
+    mds_pipeline_get_stage_stats(pipeline, rate_stage, &stage_stats);
+    TEST_ASSERT(ret == 0 && stage_stats.chunks_out == 2 && big_corrupt == 0,
+                "Queued chunks intact while new ones are held");
+    mds_pipeline_flush(pipeline);
+    mds_pipeline_get_stage_stats(pipeline, rate_stage, &stage_stats);
+    TEST_ASSERT(stage_stats.chunks_out == 12 && big_corrupt == 0, "Large held chunks flushed intact");
+    mds_pipeline_destroy(pipeline);
+
+    /* A chunk larger than the bucket passes when it is full; the queue is bounded */
+    mds_sink_chunk_t rate_chunks[MDS_PIPELINE_MAX_BATCH + 6];
+    for (size_t i = 0; i < MDS_PIPELINE_MAX_BATCH + 6; i++) {
+        rate_chunks[i] = (mds_sink_chunk_t){
+            .uri = pipe_uris[0],
+            .auth_header = "Memfault-Project-Key:test",
+            .data = pipe_chunk,
+            .len = sizeof(pipe_chunk),
+            .sequence = i,
+        };
+    }
+    pipeline = mds_pipeline_create();
+    rate_stage = mds_pipeline_add_rate_limit(pipeline, 1, 1);
+    ret = mds_pipeline_submit_batch(pipeline, rate_chunks, MDS_PIPELINE_MAX_BATCH + 6);
+    mds_pipeline_get_stage_stats(pipeline, rate_stage, &stage_stats);
+    TEST_ASSERT(ret == -ENOBUFS && stage_stats.chunks_out == 1 &&
+                stage_stats.chunks_in == MDS_PIPELINE_MAX_BATCH + 1 && stage_stats.chunks_refused == 5,
+                "Chunks refused and counted once the queue is full");
+    mds_pipeline_destroy(pipeline);
+
+    /* Test 28: Background DNS Cache */
+    TEST_START("Background DNS Cache");
+
+    mock_curl_reset();
+    mock_curl_set_dns("dns.example.com", "192.0.2.10");
+    mock_curl_set_dns_delay_ms(200);
+    const char *dns_uri = "https://dns.example.com/api/v0/chunks/DEV";
+    const uint8_t dns_chunk[] = {0x01, 0x02};
+    chunks_dns_stats_t dns_stats;
+    chunks_uploader_t *dns_uploader = chunks_uploader_create();
+    ret = chunks_uploader_set_dns_cache(dns_uploader, 1, CHUNKS_DNS_DEFAULT_MAX_STALE_S);
+    TEST_ASSERT(ret == 0, "DNS cache enabled");
+
+    /* Cold start: libcurl resolves, the cache looks the host up in the background */
+    chunks_uploader_callback(dns_uri, "Memfault-Project-Key:test", dns_chunk, sizeof(dns_chunk), dns_uploader);
+    chunks_uploader_get_dns_stats(dns_uploader, &dns_stats);
+    TEST_ASSERT(dns_stats.misses == 1 && mock_curl_get_last_resolve()[0] == '\0' &&
+                dns_stats.transfer_lookup_us == 200000, "First upload left to libcurl's resolver");
+    TEST_ASSERT(wait_dns_lookups(dns_uploader, 1) == 1, "Host resolved in the background");
+
+    chunks_uploader_callback(dns_uri, "Memfault-Project-Key:test", dns_chunk, sizeof(dns_chunk), dns_uploader);
+    chunks_uploader_get_dns_stats(dns_uploader, &dns_stats);
+    TEST_ASSERT(dns_stats.fresh_hits == 1 &&
+                strcmp(mock_curl_get_last_resolve(), "+dns.example.com:443:192.0.2.10") == 0 &&
+                dns_stats.transfer_lookup_us == 200000, "Cached address handed to libcurl");
+
+    /* Expired: the stale address is used while the slow refresh runs */
+    mock_curl_set_dns("dns.example.com", "192.0.2.20");
+    usleep(1100 * 1000);
+    chunks_uploader_callback(dns_uri, "Memfault-Project-Key:test", dns_chunk, sizeof(dns_chunk), dns_uploader);
+    chunks_uploader_get_dns_stats(dns_uploader, &dns_stats);
+    TEST_ASSERT(dns_stats.stale_hits == 1 && dns_stats.lookups == 1 &&
+                strcmp(mock_curl_get_last_resolve(), "+dns.example.com:443:192.0.2.10") == 0,
+                "Stale address served without waiting for the resolver");
+    wait_dns_lookups(dns_uploader, 2);
+    chunks_uploader_callback(dns_uri, "Memfault-Project-Key:test", dns_chunk, sizeof(dns_chunk), dns_uploader);
+    chunks_uploader_get_dns_stats(dns_uploader, &dns_stats);
+    TEST_ASSERT(strcmp(mock_curl_get_last_resolve(), "+dns.example.com:443:192.0.2.20") == 0 &&
+                dns_stats.fresh_hits == 2, "Refreshed address used");
+    TEST_ASSERT(dns_stats.max_lookup_us >= 200000 && dns_stats.total_lookup_us >= 400000,
+                "Resolver latency tracked");
+
+    /* A failed refresh keeps the previous address */
+    mock_curl_set_dns("dns.example.com", NULL);
+    mock_curl_set_dns_delay_ms(0);
+    usleep(1100 * 1000);
+    chunks_uploader_callback(dns_uri, "Memfault-Project-Key:test", dns_chunk, sizeof(dns_chunk), dns_uploader);
+    wait_dns_lookups(dns_uploader, 3);
+    chunks_uploader_callback(dns_uri, "Memfault-Project-Key:test", dns_chunk, sizeof(dns_chunk), dns_uploader);
+    chunks_uploader_get_dns_stats(dns_uploader, &dns_stats);
+    TEST_ASSERT(dns_stats.lookup_failures == 1 && dns_stats.stale_hits == 3 &&
+                strcmp(mock_curl_get_last_resolve(), "+dns.example.com:443:192.0.2.20") == 0,
+                "Lookup failure keeps serving the stale address");
+
+    /* Queued transfers read their resolve list when they start, after the addresses changed twice */
+    mock_curl_reset();
+    mock_curl_set_dns("dns.example.com", "192.0.2.10");
+    event_loop_t dns_loop = {.timer_ms = -1};
+    chunks_upload_stats_t dns_upload_stats;
+    chunks_uploader_t *dns_async = chunks_uploader_create();
+    chunks_uploader_set_dns_cache(dns_async, 1, CHUNKS_DNS_DEFAULT_MAX_STALE_S);
+    chunks_uploader_set_event_loop(dns_async, loop_socket_callback, loop_timer_callback, &dns_loop);
+    chunks_uploader_callback("https://dns.example.com/api/v0/chunks/DEV0", "Memfault-Project-Key:test",
+                             dns_chunk, sizeof(dns_chunk), dns_async);
+    run_event_loop(dns_async, &dns_loop);
+    wait_dns_lookups(dns_async, 1);
+    const char *dns_devices[] = {"DEV1", "DEV2", "DEV3", "DEV4", "DEV5"};
+    const char *dns_addrs[] = {"192.0.2.20", "192.0.2.30"};
+    for (size_t i = 0; i < 5; i++) {
+        char dev_uri[96];
+        snprintf(dev_uri, sizeof(dev_uri), "https://dns.example.com/api/v0/chunks/%s", dns_devices[i]);
+        if (i == 1 || i == 3) {
+            mock_curl_set_dns("dns.example.com", dns_addrs[i / 2]);
+            usleep(1100 * 1000);
+        }
+        chunks_uploader_callback(dev_uri, "Memfault-Project-Key:test", dns_chunk, sizeof(dns_chunk), dns_async);
+        wait_dns_lookups(dns_async, 1 + (i + 1) / 2);
+    }
+    run_event_loop(dns_async, &dns_loop);
+    chunks_uploader_get_stats(dns_async, &dns_upload_stats);
+    TEST_ASSERT(dns_upload_stats.chunks_uploaded == 6 &&
+                strcmp(mock_curl_get_last_resolve(), "+dns.example.com:443:192.0.2.30") == 0,
+                "Each queued request keeps its own resolve list");
+    chunks_uploader_set_event_loop(dns_async, NULL, NULL, NULL);
+    chunks_uploader_destroy(dns_async);
+    mock_curl_reset();
+    mock_curl_set_dns("dns.example.com", NULL);
+
+    TEST_ASSERT(chunks_uploader_set_dns_cache(dns_uploader, 0, 0) == 0, "DNS cache disabled");
+    chunks_uploader_callback(dns_uri, "Memfault-Project-Key:test", dns_chunk, sizeof(dns_chunk), dns_uploader);
+    TEST_ASSERT(mock_curl_get_last_resolve()[0] == '\0', "No resolve entry once disabled");
+    chunks_uploader_destroy(dns_uploader);
+    mock_curl_reset();
+
+    /* Test 29: Adaptive Batch Sizing */
+    TEST_START("Adaptive Batch Sizing");
+
+    /* Per-request cost dominates: batches grow while the age has headroom */
+    unsigned request_us = 500;
+    mds_sink_tune_decision_t decisions[MDS_SINK_TUNE_HISTORY];
+    size_t decision_count = 0;
+    mds_sink_config_t tune_config = {.queue_depth = 1024, .max_batch = 1, .max_delay_ms = 1,
+                                     .target_p99_age_ms = 100};
+    mds_sink_t *tune_sink = mds_sink_create(&slow_ops, &request_us, &tune_config);
+    for (int i = 0; i < 3000; i++) {
+        mds_sink_submit(tune_sink, sink_uri, "Memfault-Project-Key:test", sink_chunk, sizeof(sink_chunk));
+    }
+    mds_sink_flush(tune_sink);
+    mds_sink_get_stats(tune_sink, &sink_totals);
+    ret = mds_sink_get_tune_history(tune_sink, decisions, MDS_SINK_TUNE_HISTORY, &decision_count);
+    TEST_ASSERT(ret == 0 && decision_count > 0 && decisions[0].action == MDS_SINK_TUNE_GROW &&
+                decisions[0].max_batch == 2, "Busy output with headroom grows the batch");
+    TEST_ASSERT(sink_totals.max_batch > 16 && sink_totals.delivered == 3000,
+                "Batch size converged upwards");
+    TEST_ASSERT(decisions[decision_count - 1].p99_age_us < 100 * 1000,
+                "Achieved p99 age under target");
+    mds_sink_destroy(tune_sink);
+
+    /* The same load on an output paying per chunk is never batched up */
+    tune_sink = mds_sink_create(&slow_per_chunk_ops, &request_us, &tune_config);
+    for (int i = 0; i < MDS_SINK_TUNE_WINDOW * 4; i++) {
+        mds_sink_submit(tune_sink, sink_uri, "Memfault-Project-Key:test", sink_chunk, sizeof(sink_chunk));
+    }
+    mds_sink_flush(tune_sink);
+    mds_sink_get_stats(tune_sink, &sink_totals);
+    ret = mds_sink_get_tune_history(tune_sink, decisions, MDS_SINK_TUNE_HISTORY, &decision_count);
+    TEST_ASSERT(ret == 0 && decision_count >= 4 && decisions[0].action == MDS_SINK_TUNE_HOLD &&
+                sink_totals.max_batch == 1 && sink_totals.max_delay_ms == 1,
+                "Per-chunk output never grown");
+    mds_sink_destroy(tune_sink);
+
+    /* Requests slower than the target: batches shrink */
+    request_us = 12000;
+    tune_config = (mds_sink_config_t){.max_batch = 8, .max_delay_ms = 4, .target_p99_age_ms = 8};
+    tune_sink = mds_sink_create(&slow_ops, &request_us, &tune_config);
+    for (int i = 0; i < MDS_SINK_TUNE_WINDOW; i++) {
+        mds_sink_submit(tune_sink, sink_uri, "Memfault-Project-Key:test", sink_chunk, sizeof(sink_chunk));
+    }
+    mds_sink_flush(tune_sink);
+    mds_sink_get_stats(tune_sink, &sink_totals);
+    ret = mds_sink_get_tune_history(tune_sink, decisions, MDS_SINK_TUNE_HISTORY, &decision_count);
+    TEST_ASSERT(ret == 0 && decision_count == 1 && decisions[0].action == MDS_SINK_TUNE_SHRINK &&
+                decisions[0].p99_age_us >= 8000, "Age over target shrinks the batch");
+    TEST_ASSERT(sink_totals.max_batch == 4 && sink_totals.max_delay_ms == 2,
+                "Batch size and linger halved");
+    mds_sink_destroy(tune_sink);
+
+    /* A linger above half the target is capped from the start, never lowered by growing */
+    request_us = 500;
+    tune_config = (mds_sink_config_t){.max_batch = 1, .max_delay_ms = 40, .target_p99_age_ms = 20};
+    tune_sink = mds_sink_create(&slow_ops, &request_us, &tune_config);
+    mds_sink_get_stats(tune_sink, &sink_totals);
+    TEST_ASSERT(sink_totals.max_delay_ms == 10, "Starting linger capped at half the target");
+    for (int i = 0; i < MDS_SINK_TUNE_WINDOW * 4; i++) {
+        mds_sink_submit(tune_sink, sink_uri, "Memfault-Project-Key:test", sink_chunk, sizeof(sink_chunk));
+    }
+    mds_sink_flush(tune_sink);
+    ret = mds_sink_get_tune_history(tune_sink, decisions, MDS_SINK_TUNE_HISTORY, &decision_count);
+    bool linger_kept = ret == 0 && decision_count > 0;
+    for (size_t i = 0; i < decision_count; i++) {
+        linger_kept = linger_kept && (decisions[i].action != MDS_SINK_TUNE_GROW ||
+                                      decisions[i].max_delay_ms == 10);
+    }
+    TEST_ASSERT(linger_kept, "Growing never shortens the linger");
+    mds_sink_destroy(tune_sink);
+
+    /* Test 30: Work-Stealing Worker Pool */
+    TEST_START("Work-Stealing Worker Pool");
+
+    order_check_t order = {.lock = PTHREAD_MUTEX_INITIALIZER, .hold = true,
+                           .released = PTHREAD_COND_INITIALIZER};
+    mds_workers_t *workers = mds_workers_create(4, 2048);
+    int worker_ids[4];
+    for (int i = 0; i < 4; i++) {
+        worker_ids[i] = mds_workers_add_worker(workers, order_check_callback, &order);
+    }
+    TEST_ASSERT(worker_ids[0] == 0 && worker_ids[3] == 3, "Workers added");
+
+    /* One hot device and many light ones, interleaved */
+    int submitted = 0;
+    int seqs[ORDER_DEVICES] = {0};
+    for (int round = 0; round < 10; round++) {
+        for (int d = 0; d < ORDER_DEVICES; d++) {
+            for (int i = 0; i < (d == 0 ? 20 : 1); i++) {
+                char worker_uri[64];
+                uint8_t worker_chunk[3] = {(uint8_t)d, (uint8_t)(seqs[d] & 0xFF), (uint8_t)(seqs[d] >> 8)};
+                snprintf(worker_uri, sizeof(worker_uri), "https://chunks.memfault.com/api/v0/chunks/DEV-%d", d);
+                if (mds_workers_callback(worker_uri, "Memfault-Project-Key:test", worker_chunk,
+                                         sizeof(worker_chunk), workers) == 0) {
+                    seqs[d]++;
+                    submitted++;
+                }
+            }
+        }
+    }
+    TEST_ASSERT(submitted == 510, "Chunks queued per device");
+    TEST_ASSERT(mds_workers_add_worker(workers, order_check_callback, &order) == -EBUSY,
+                "Workers cannot be added after delivery starts");
+
+    /* The hot device's worker is stuck on it, so the devices waiting in its
+     * deque can only be uploaded by peers stealing them */
+    mds_worker_stats_t worker_stats;
+    size_t worker_steals = 0;
+    for (int wait = 0; wait < 5000 && worker_steals == 0; wait++) {
+        usleep(1000);
+        for (int i = 0; i < 4; i++) {
+            mds_workers_get_worker_stats(workers, i, &worker_stats);
+            worker_steals += worker_stats.steals;
+        }
+    }
+    pthread_mutex_lock(&order.lock);
+    order.hold = false;
+    pthread_cond_broadcast(&order.released);
+    pthread_mutex_unlock(&order.lock);
+    TEST_ASSERT(mds_workers_flush(workers, 5000) == 0, "Worker pool flushed");
+
+    size_t worker_delivered = 0, workers_used = 0;
+    worker_steals = 0;
+    for (int i = 0; i < 4; i++) {
+        mds_workers_get_worker_stats(workers, i, &worker_stats);
+        worker_delivered += worker_stats.delivered;
+        worker_steals += worker_stats.steals;
+        workers_used += worker_stats.busy_us > 0 ? 1 : 0;
+    }
+    TEST_ASSERT(order.violations == 0, "Each device uploaded in order by one worker at a time");
+    TEST_ASSERT(worker_delivered == 510 && workers_used > 1, "Work spread across workers");
+    TEST_ASSERT(worker_steals > 0, "Idle workers stole ready batches");
+
+    mds_workers_stats_t workers_totals;
+    mds_workers_get_stats(workers, &workers_totals);
+    TEST_ASSERT(workers_totals.devices == ORDER_DEVICES && workers_totals.queued == 0 &&
+                workers_totals.dropped == 0, "Pool statistics");
+    mds_workers_destroy(workers);
+
+    /* Test 31: Per-Device Upload Order */
+    TEST_START("Per-Device Upload Order");
+
+    /* Transfers finish newest first, so any two of one device in flight would swap */
+    seq_server_t seq;
+    memset(&seq, 0, sizeof(seq));
+    event_loop_t order_loop = {.timer_ms = -1, .newest_first = true};
+    chunks_uploader_t *order_uploader = chunks_uploader_create();
+    chunks_uploader_set_event_loop(order_uploader, loop_socket_callback, loop_timer_callback, &order_loop);
+    mock_curl_reset();
+    mock_curl_set_server(seq_server, &seq);
+
+    int order_queued = 0;
+    for (int n = 0; n < 6; n++) {
+        for (int d = 0; d < SEQ_DEVICES; d++) {
+            char order_uri[64];
+            uint8_t order_chunk[8] = {(uint8_t)n, (uint8_t)d};
+            snprintf(order_uri, sizeof(order_uri), "https://chunks.memfault.com/api/v0/chunks/ORDER-%d", d);
+            if (chunks_uploader_callback(order_uri, "Memfault-Project-Key:test", order_chunk,
+                                         sizeof(order_chunk), order_uploader) == 0) {
+                order_queued++;
+            }
+        }
+    }
+    TEST_ASSERT(order_queued == 6 * SEQ_DEVICES, "Chunks queued for every device");
+    run_event_loop(order_uploader, &order_loop);
+    TEST_ASSERT(chunks_uploader_pending(order_uploader) == 0 && seq.accepted == 6 * SEQ_DEVICES &&
+                seq.gaps == 0, "Server saw every device's chunks in sequence");
+    TEST_ASSERT(mock_curl_get_max_in_flight() == SEQ_DEVICES,
+                "One request in flight per device, devices in parallel");
+
+    chunks_uploader_destroy(order_uploader);
+    mock_curl_reset();
+
+    /* A prepared request whose endpoint went down meanwhile starts on the next one */
+    const char *const reroute_origins[] = {"https://x.example.com", "https://y.example.com"};
+    event_loop_t reroute_loop = {.timer_ms = -1};
+    chunks_upload_stats_t reroute_stats;
+    chunks_uploader_t *reroute = chunks_uploader_create();
+    chunks_uploader_set_event_loop(reroute, loop_socket_callback, loop_timer_callback, &reroute_loop);
+    chunks_uploader_set_endpoints(reroute, reroute_origins, 2);
+    mock_curl_set_url_response("https://x.example.com", 503, CURLE_OK, 0.01);
+    mock_curl_set_url_response("https://y.example.com", 202, CURLE_OK, 0.01);
+    for (int n = 0; n < 2; n++) {
+        uint8_t reroute_chunk[4] = {(uint8_t)n};
+        chunks_uploader_callback("https://x.example.com/api/v0/chunks/REROUTE", "Memfault-Project-Key:test",
+                                 reroute_chunk, sizeof(reroute_chunk), reroute);
+    }
+    run_event_loop(reroute, &reroute_loop);
+    chunks_uploader_get_stats(reroute, &reroute_stats);
+    TEST_ASSERT(reroute_stats.chunks_uploaded == 2 && reroute_stats.failovers == 1 &&
+                mock_curl_get_url_request_count("https://x.example.com") == 1 &&
+                mock_curl_get_url_request_count("https://y.example.com") == 2,
+                "Prepared request re-routed away from a failed endpoint");
+    chunks_uploader_set_event_loop(reroute, NULL, NULL, NULL);
+    chunks_uploader_destroy(reroute);
+    mock_curl_reset();
+
     /* Cleanup */
     TEST_START("Cleanup");
     chunks_uploader_destroy(uploader);